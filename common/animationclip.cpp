@@ -0,0 +1,667 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "timer.hpp"
+#include "jobsystem.hpp"
+#include "transforms.hpp"
+#include "fbxloader.hpp"
+#include "animationclip.hpp"
+
+#define ANIMATION_KEY_WORDS		4		// 16 bit words per key: the time, then three values
+#define ANIMATION_TIME_STEPS	65535.0f	// Key times from 0 (start) to this (duration)
+#define ANIMATION_SQRT_HALF		0.70710678118654752f
+
+#define TWO_PI 6.28318530717958647692f
+
+enum {
+	CHANNEL_TRANSLATION,
+	CHANNEL_ROTATION,
+	CHANNEL_SCALE,
+	CHANNELS
+};
+
+// Keys [first, first + count) of the clip, none = identity. Vector values are offset + step * word.
+struct ClipChannel {
+	int first;
+	int count;
+	float offset[3];
+	float step[3];
+};
+
+struct ClipTrack {
+	ClipChannel channels[CHANNELS];
+};
+
+struct AnimationClip {
+	float duration;
+	float timeScale;				// Seconds to key time
+	float inverseDuration;			// 0 for a clip of a single instant
+	std::vector<ClipTrack> tracks;
+	std::vector<unsigned short> keys;	// ANIMATION_KEY_WORDS per key, tracks and their channels in order
+	std::vector<std::string> names;
+	AnimationClipStats stats;
+};
+
+// Source keys of one channel as plain floats: dimension 3 (vectors) or 4 (quaternions, x y z w)
+struct SourceChannel {
+	std::vector<float> times;
+	std::vector<float> values;
+	int dimension;
+};
+
+
+
+// Vectors: linear. Rotations: normalized linear on the shorter arc.
+static void interpolate(const float * a, const float * b, float f, int dimension, float * out){
+	if (dimension == 3){
+		for (int i = 0; i < 3; i++)
+			out[i] = a[i] + (b[i] - a[i]) * f;
+		return;
+	}
+	float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+	float length = 0.0f;
+	for (int i = 0; i < 4; i++){
+		out[i] = a[i] + (b[i] * sign - a[i]) * f;
+		length += out[i] * out[i];
+	}
+	float scale = length > 0.0f ? 1.0f / sqrtf(length) : 0.0f;
+	for (int i = 0; i < 4; i++)
+		out[i] *= scale;
+}
+
+// Distance between vectors, angle between rotations (from the chord between the quaternions, precise when small)
+static float keyError(const float * a, const float * b, int dimension){
+	if (dimension == 3)
+		return sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+	float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+	float chord = 0.0f;
+	for (int i = 0; i < 4; i++)
+		chord += (a[i] - b[i] * sign) * (a[i] - b[i] * sign);
+	return 4.0f * asinf(glm::min(sqrtf(chord) * 0.5f, 1.0f));
+}
+
+// Indices of the keys to keep: one if the channel is constant within tolerance, otherwise the ends and, recursively,
+// the key furthest from the curve between two kept ones as long as that is further than tolerance (Douglas-Peucker)
+static void reduceChannel(const SourceChannel & channel, float tolerance, std::vector<int> & kept){
+	kept.clear();
+	int count = (int)channel.times.size();
+	int d = channel.dimension;
+	if (count == 0)
+		return;
+	const float * values = &channel.values[0];
+
+	bool constant = true;
+	for (int i = 1; i < count && constant; i++)
+		constant = keyError(values + i * d, values, d) <= tolerance;
+	if (constant){
+		kept.push_back(0);
+		return;
+	}
+
+	std::vector<char> keep(count, 0);
+	keep[0] = keep[count - 1] = 1;
+	std::vector<std::pair<int, int> > spans(1, std::make_pair(0, count - 1));
+	while (!spans.empty()){
+		int a = spans.back().first, b = spans.back().second;
+		spans.pop_back();
+		float span = channel.times[b] - channel.times[a];
+		int worst = -1;
+		float worstError = tolerance;
+		for (int i = a + 1; i < b; i++){
+			float interpolated[4];
+			interpolate(values + a * d, values + b * d, span > 0.0f ? (channel.times[i] - channel.times[a]) / span : 0.0f, d, interpolated);
+			float error = keyError(interpolated, values + i * d, d);
+			if (error > worstError){
+				worst = i;
+				worstError = error;
+			}
+		}
+		if (worst >= 0){
+			keep[worst] = 1;
+			spans.push_back(std::make_pair(a, worst));
+			spans.push_back(std::make_pair(worst, b));
+		}
+	}
+	for (int i = 0; i < count; i++){
+		if (keep[i])
+			kept.push_back(i);
+	}
+}
+
+// Smallest three: the largest component (made positive, so left out) in 2 bits, the others in 15 bits each
+// over [-sqrt(1/2), sqrt(1/2)], the only range they can have, 0 exactly on 16383
+static void encodeRotation(const float * q, unsigned short * words){
+	int largest = 0;
+	for (int i = 1; i < 4; i++){
+		if (fabsf(q[i]) > fabsf(q[largest]))
+			largest = i;
+	}
+	float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+	unsigned short packed[3];
+	for (int i = 0, w = 0; i < 4; i++){
+		if (i == largest)
+			continue;
+		float unit = glm::clamp(q[i] * sign / ANIMATION_SQRT_HALF * 0.5f + 0.5f, 0.0f, 1.0f);
+		packed[w++] = (unsigned short)(unit * 32766.0f + 0.5f);
+	}
+	words[0] = (unsigned short)(packed[0] | (largest & 1) << 15);
+	words[1] = (unsigned short)(packed[1] | (largest >> 1) << 15);
+	words[2] = packed[2];
+}
+
+static inline void decodeRotation(const unsigned short * words, float * q){
+	// Where the three stored components go, by the largest one's index
+	static const int slots[4][3] = { { 1, 2, 3 }, { 0, 2, 3 }, { 0, 1, 3 }, { 0, 1, 2 } };
+	int largest = (words[0] >> 15) | (words[1] >> 15) << 1;
+	float a = ((words[0] & 0x7fff) * (2.0f / 32766.0f) - 1.0f) * ANIMATION_SQRT_HALF;
+	float b = ((words[1] & 0x7fff) * (2.0f / 32766.0f) - 1.0f) * ANIMATION_SQRT_HALF;
+	float c = (words[2] * (2.0f / 32766.0f) - 1.0f) * ANIMATION_SQRT_HALF;
+	q[slots[largest][0]] = a;
+	q[slots[largest][1]] = b;
+	q[slots[largest][2]] = c;
+	q[largest] = sqrtf(glm::max(1.0f - a * a - b * b - c * c, 0.0f));
+}
+
+// Last key at or before time (a key time), at most count - 2 so the next one exists
+static inline int findKey(const unsigned short * keys, int count, float time){
+	int low = 0, size = count - 1;
+	while (size > 1){
+		int half = size >> 1;
+		low = keys[(low + half) * ANIMATION_KEY_WORDS] <= time ? low + half : low;
+		size -= half;
+	}
+	return low;
+}
+
+static inline float keyFactor(const unsigned short * a, const unsigned short * b, float time){
+	float span = (float)(b[0] - a[0]);
+	return span > 0.0f ? glm::clamp((time - a[0]) / span, 0.0f, 1.0f) : 0.0f;
+}
+
+static inline void sampleVector(const AnimationClip * clip, const ClipChannel & channel, float time, float identity, float * out){
+	if (channel.count == 0){
+		out[0] = out[1] = out[2] = identity;
+		return;
+	}
+	const unsigned short * keys = &clip->keys[channel.first * ANIMATION_KEY_WORDS];
+	if (channel.count == 1){
+		for (int i = 0; i < 3; i++)
+			out[i] = channel.offset[i] + channel.step[i] * keys[1 + i];
+		return;
+	}
+	const unsigned short * a = keys + findKey(keys, channel.count, time) * ANIMATION_KEY_WORDS;
+	const unsigned short * b = a + ANIMATION_KEY_WORDS;
+	float f = keyFactor(a, b, time);
+	for (int i = 0; i < 3; i++)
+		out[i] = channel.offset[i] + channel.step[i] * ((float)a[1 + i] + ((float)b[1 + i] - (float)a[1 + i]) * f);
+}
+
+static inline void sampleRotation(const AnimationClip * clip, const ClipChannel & channel, float time, float * out){
+	if (channel.count == 0){
+		out[0] = out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+		return;
+	}
+	const unsigned short * keys = &clip->keys[channel.first * ANIMATION_KEY_WORDS];
+	if (channel.count == 1){
+		decodeRotation(keys + 1, out);
+		return;
+	}
+	const unsigned short * a = keys + findKey(keys, channel.count, time) * ANIMATION_KEY_WORDS;
+	const unsigned short * b = a + ANIMATION_KEY_WORDS;
+	float qa[4], qb[4];
+	decodeRotation(a + 1, qa);
+	decodeRotation(b + 1, qb);
+	interpolate(qa, qb, keyFactor(a, b, time), 4, out);
+}
+
+// Translation, rotation (x y z w) and scale of a track at a key time
+static inline void sampleTrack(const AnimationClip * clip, const ClipTrack & track, float time, float * values){
+	sampleVector(clip, track.channels[CHANNEL_TRANSLATION], time, 0.0f, values);
+	sampleRotation(clip, track.channels[CHANNEL_ROTATION], time, values + 3);
+	sampleVector(clip, track.channels[CHANNEL_SCALE], time, 1.0f, values + 7);
+}
+
+static void encodeChannel(AnimationClip * clip, const SourceChannel & source, const std::vector<int> & kept, ClipChannel & channel){
+	channel.first = (int)clip->keys.size() / ANIMATION_KEY_WORDS;
+	channel.count = (int)kept.size();
+	int d = source.dimension;
+	for (int i = 0; i < 3; i++){
+		float low = 0.0f, high = 0.0f;
+		for (size_t k = 0; k < kept.size(); k++){
+			float value = source.values[kept[k] * d + i];
+			low = k == 0 ? value : glm::min(low, value);
+			high = k == 0 ? value : glm::max(high, value);
+		}
+		channel.offset[i] = low;
+		channel.step[i] = (high - low) / 65535.0f;
+	}
+
+	for (size_t k = 0; k < kept.size(); k++){
+		unsigned short words[ANIMATION_KEY_WORDS];
+		float time = glm::clamp(source.times[kept[k]] * clip->timeScale, 0.0f, ANIMATION_TIME_STEPS);
+		words[0] = (unsigned short)(time + 0.5f);
+		const float * value = &source.values[kept[k] * d];
+		if (d == 4){
+			encodeRotation(value, words + 1);
+		} else {
+			for (int i = 0; i < 3; i++)
+				words[1 + i] = (unsigned short)(channel.step[i] > 0.0f ? glm::clamp((value[i] - channel.offset[i]) / channel.step[i] + 0.5f, 0.0f, 65535.0f) : 0.0f);
+		}
+		clip->keys.insert(clip->keys.end(), words, words + ANIMATION_KEY_WORDS);
+	}
+}
+
+AnimationClip * createAnimationClip(const AnimationTrackKeys * tracks, int trackCount, float duration, const AnimationClipTolerances & tolerances){
+	AnimationClip * clip = new AnimationClip;
+	clip->duration = glm::max(duration, 0.0f);
+	clip->timeScale = clip->duration > 0.0f ? ANIMATION_TIME_STEPS / clip->duration : 0.0f;
+	clip->inverseDuration = clip->duration > 0.0f ? 1.0f / clip->duration : 0.0f;
+	clip->tracks.resize(trackCount > 0 ? trackCount : 0);
+	memset(&clip->stats, 0, sizeof(clip->stats));
+	clip->stats.tracks = (int)clip->tracks.size();
+	clip->stats.duration = clip->duration;
+
+	float channelTolerances[CHANNELS] = { tolerances.translation, tolerances.rotation, tolerances.scale };
+	float * channelErrors[CHANNELS] = { &clip->stats.translationError, &clip->stats.rotationError, &clip->stats.scaleError };
+	SourceChannel sources[CHANNELS];
+	std::vector<int> kept;
+	for (int t = 0; t < (int)clip->tracks.size(); t++){
+		const AnimationTrackKeys & keys = tracks[t];
+		clip->names.push_back(keys.name);
+
+		sources[CHANNEL_TRANSLATION].times = keys.translationTimes;
+		sources[CHANNEL_ROTATION].times = keys.rotationTimes;
+		sources[CHANNEL_SCALE].times = keys.scaleTimes;
+		for (int c = 0; c < CHANNELS; c++){
+			sources[c].dimension = c == CHANNEL_ROTATION ? 4 : 3;
+			sources[c].values.clear();
+		}
+		for (size_t k = 0; k < keys.translations.size(); k++)
+			sources[CHANNEL_TRANSLATION].values.insert(sources[CHANNEL_TRANSLATION].values.end(), &keys.translations[k].x, &keys.translations[k].x + 3);
+		for (size_t k = 0; k < keys.rotations.size(); k++){
+			float q[4] = { keys.rotations[k].x, keys.rotations[k].y, keys.rotations[k].z, keys.rotations[k].w };
+			sources[CHANNEL_ROTATION].values.insert(sources[CHANNEL_ROTATION].values.end(), q, q + 4);
+		}
+		for (size_t k = 0; k < keys.scales.size(); k++)
+			sources[CHANNEL_SCALE].values.insert(sources[CHANNEL_SCALE].values.end(), &keys.scales[k].x, &keys.scales[k].x + 3);
+
+		ClipTrack & track = clip->tracks[t];
+		for (int c = 0; c < CHANNELS; c++){
+			SourceChannel & source = sources[c];
+			int d = source.dimension;
+			if (source.values.size() != source.times.size() * d){
+				printf("[WARNING] Animation track %s: %d key times for %d values, channel left out.\n", keys.name.c_str(),
+					(int)source.times.size(), (int)(source.values.size() / d));
+				source.times.clear();
+				source.values.clear();
+			}
+			reduceChannel(source, channelTolerances[c], kept);
+			encodeChannel(clip, source, kept, track.channels[c]);
+
+			// Error at every source key of what is stored
+			for (size_t k = 0; k < source.times.size(); k++){
+				float values[10];
+				sampleTrack(clip, track, source.times[k] * clip->timeScale, values);
+				const float * stored = values + (c == CHANNEL_TRANSLATION ? 0 : c == CHANNEL_ROTATION ? 3 : 7);
+				*channelErrors[c] = glm::max(*channelErrors[c], keyError(stored, &source.values[k * d], d));
+			}
+			clip->stats.keys += (int)kept.size();
+			clip->stats.sourceKeys += (int)source.times.size();
+			clip->stats.sourceBytes += (int)(source.times.size() * (1 + d) * sizeof(float));
+		}
+	}
+	clip->stats.bytes = (int)(clip->tracks.size() * sizeof(ClipTrack) + clip->keys.size() * sizeof(unsigned short));
+	return clip;
+}
+
+void deleteAnimationClip(AnimationClip * clip){
+	delete clip;
+}
+
+int getAnimationClipTrackCount(const AnimationClip * clip){
+	return (int)clip->tracks.size();
+}
+
+float getAnimationClipDuration(const AnimationClip * clip){
+	return clip->duration;
+}
+
+const char * getAnimationClipTrackName(const AnimationClip * clip, int track){
+	return track >= 0 && track < (int)clip->names.size() ? clip->names[track].c_str() : NULL;
+}
+
+int findAnimationClipTrack(const AnimationClip * clip, const char * name){
+	for (size_t t = 0; t < clip->names.size(); t++){
+		if (clip->names[t] == name)
+			return (int)t;
+	}
+	return -1;
+}
+
+AnimationClipStats getAnimationClipStats(const AnimationClip * clip){
+	return clip->stats;
+}
+
+static void sampleRange(const AnimationSample * samples, int begin, int end, const TransformStreams & out){
+	for (int i = begin; i < end; i++){
+		const AnimationClip * clip = samples[i].clip;
+		if (clip == NULL || samples[i].track < 0 || samples[i].track >= (int)clip->tracks.size())
+			continue;
+		// Wrapped into [0, 1) of the duration, then to key time
+		float loops = samples[i].time * clip->inverseDuration;
+		float time = (loops - floorf(loops)) * ANIMATION_TIME_STEPS;
+		float values[10];
+		sampleTrack(clip, clip->tracks[samples[i].track], time, values);
+		out.px[i] = values[0];
+		out.py[i] = values[1];
+		out.pz[i] = values[2];
+		out.qx[i] = values[3];
+		out.qy[i] = values[4];
+		out.qz[i] = values[5];
+		out.qw[i] = values[6];
+		out.sx[i] = values[7];
+		out.sy[i] = values[8];
+		out.sz[i] = values[9];
+	}
+}
+
+void sampleAnimationClips(const AnimationSample * samples, int count, const TransformStreams & out){
+	parallelFor(count, 1024, [&](int begin, int end){
+		sampleRange(samples, begin, end, out);
+	});
+}
+
+// One FBX animation curve: times (KTime) and values, linear in between
+struct FBXCurve {
+	std::vector<long long> times;
+	std::vector<double> values;
+};
+
+static double evaluateCurve(const FBXCurve & curve, long long time){
+	size_t next = std::upper_bound(curve.times.begin(), curve.times.end(), time) - curve.times.begin();
+	if (next == 0)
+		return curve.values[0];
+	if (next == curve.times.size())
+		return curve.values.back();
+	double f = (double)(time - curve.times[next - 1]) / (double)(curve.times[next] - curve.times[next - 1]);
+	return curve.values[next - 1] + (curve.values[next] - curve.values[next - 1]) * f;
+}
+
+// The model's Lcl property: its keys (the union of its curves' keys), or the static value as one key
+static void readFBXChannel(const FBXNode * model, const char * property, double identity, long long start,
+	const std::vector<FBXCurve> * curves, const FBXNode * curveNode, std::vector<float> & times, std::vector<glm::dvec3> & values){
+	double value[3] = { identity, identity, identity };
+	getFBXProperty(model, property, value, 3);
+	std::vector<long long> keyTimes;
+	if (curves){
+		static const char * components[3] = { "d|X", "d|Y", "d|Z" };
+		for (int i = 0; i < 3; i++){
+			getFBXProperty(curveNode, components[i], &value[i], 1);
+			keyTimes.insert(keyTimes.end(), (*curves)[i].times.begin(), (*curves)[i].times.end());
+		}
+		std::sort(keyTimes.begin(), keyTimes.end());
+		keyTimes.erase(std::unique(keyTimes.begin(), keyTimes.end()), keyTimes.end());
+	}
+	if (keyTimes.empty()){
+		times.push_back(0.0f);
+		values.push_back(glm::dvec3(value[0], value[1], value[2]));
+		return;
+	}
+	for (size_t k = 0; k < keyTimes.size(); k++){
+		glm::dvec3 key(value[0], value[1], value[2]);
+		for (int i = 0; i < 3; i++){
+			if (!(*curves)[i].times.empty())
+				key[i] = evaluateCurve((*curves)[i], keyTimes[k]);
+		}
+		times.push_back((float)((double)(keyTimes[k] - start) / FBX_TIME_SECOND));
+		values.push_back(key);
+	}
+}
+
+AnimationClip * loadFBXAnimationClip(const char * path, const AnimationClipTolerances & tolerances){
+	FBXNode * root = loadFBX(path);
+	if (root == NULL)
+		return NULL;
+	std::vector<const FBXNode *> objects;
+	std::vector<FBXConnection> connections;
+	getFBXObjects(root, objects);
+	getFBXConnections(root, connections);
+	std::map<long long, const FBXNode *> byID;
+	const FBXNode * stack = NULL;
+	for (size_t i = 0; i < objects.size(); i++){
+		byID[getFBXObjectID(objects[i])] = objects[i];
+		if (stack == NULL && objects[i]->name == "AnimationStack")
+			stack = objects[i];
+	}
+
+	// The stack's layers, their curve nodes, the curves of those, and which model property each curve node drives
+	std::map<long long, int> layers;
+	std::map<long long, std::vector<FBXCurve> > curveNodes;
+	std::map<std::pair<long long, std::string>, long long> drivers;
+	for (int pass = 0; pass < 4; pass++){
+		for (size_t i = 0; i < connections.size(); i++){
+			const FBXConnection & c = connections[i];
+			std::map<long long, const FBXNode *>::const_iterator child = byID.find(c.child);
+			if (child == byID.end())
+				continue;
+			const std::string & kind = child->second->name;
+			if (pass == 0 && kind == "AnimationLayer" && stack && c.parent == getFBXObjectID(stack))
+				layers[c.child] = 1;
+			else if (pass == 1 && kind == "AnimationCurveNode" && layers.count(c.parent))
+				curveNodes[c.child].resize(3);
+			else if (pass == 2 && kind == "AnimationCurveNode" && curveNodes.count(c.child) && c.property.compare(0, 4, "Lcl ") == 0)
+				drivers[std::make_pair(c.parent, c.property)] = c.child;
+			else if (pass == 3 && kind == "AnimationCurve" && curveNodes.count(c.parent) && c.property.size() == 3 && c.property[2] >= 'X' && c.property[2] <= 'Z'){
+				FBXCurve & curve = curveNodes[c.parent][c.property[2] - 'X'];
+				const FBXNode * times = findFBXChild(child->second, "KeyTime");
+				const FBXNode * values = findFBXChild(child->second, "KeyValueFloat");
+				if (times && values && !times->properties.empty() && !values->properties.empty()
+					&& times->properties[0].integers.size() == values->properties[0].numbers.size()){
+					curve.times = times->properties[0].integers;
+					curve.values = values->properties[0].numbers;
+				}
+			}
+		}
+	}
+
+	// Time span: the stack's, or the scene's
+	double span[2] = { 0.0, 0.0 };
+	if (stack == NULL || !getFBXProperty(stack, "LocalStart", &span[0], 1) || !getFBXProperty(stack, "LocalStop", &span[1], 1)){
+		const FBXNode * settings = findFBXChild(root, "GlobalSettings");
+		if (!getFBXProperty(settings, "TimeSpanStart", &span[0], 1) || !getFBXProperty(settings, "TimeSpanStop", &span[1], 1))
+			span[0] = span[1] = 0.0;
+	}
+	long long start = (long long)span[0];
+
+	std::vector<AnimationTrackKeys> tracks;
+	static const char * properties[3] = { "Lcl Translation", "Lcl Rotation", "Lcl Scaling" };
+	for (size_t i = 0; i < objects.size(); i++){
+		const FBXNode * model = objects[i];
+		if (model->name != "Model")
+			continue;
+		double order = 0.0;
+		if (getFBXProperty(model, "RotationOrder", &order, 1) && order != 0.0)
+			printf("[WARNING] %s: model %s rotates in order %d, read as XYZ.\n", path, getFBXObjectName(model).c_str(), (int)order);
+
+		std::vector<float> times[3];
+		std::vector<glm::dvec3> values[3];
+		for (int p = 0; p < 3; p++){
+			std::map<std::pair<long long, std::string>, long long>::const_iterator driver = drivers.find(std::make_pair(getFBXObjectID(model), std::string(properties[p])));
+			const std::vector<FBXCurve> * curves = driver == drivers.end() ? NULL : &curveNodes[driver->second];
+			readFBXChannel(model, properties[p], p == 2 ? 1.0 : 0.0, start, curves, curves ? byID[driver->second] : NULL, times[p], values[p]);
+		}
+
+		AnimationTrackKeys keys;
+		keys.name = getFBXObjectName(model);
+		keys.translationTimes = times[0];
+		keys.rotationTimes = times[1];
+		keys.scaleTimes = times[2];
+		for (size_t k = 0; k < values[0].size(); k++)
+			keys.translations.push_back(glm::vec3(values[0][k]));
+		for (size_t k = 0; k < values[2].size(); k++)
+			keys.scales.push_back(glm::vec3(values[2][k]));
+
+		// Local rotation = pre-rotation * rotation * inverse post-rotation, kept on one hemisphere from key to key
+		double pre[3] = { 0.0, 0.0, 0.0 }, post[3] = { 0.0, 0.0, 0.0 };
+		getFBXProperty(model, "PreRotation", pre, 3);
+		getFBXProperty(model, "PostRotation", post, 3);
+		glm::quat preRotation = getFBXEulerRotation(pre), postRotation = glm::inverse(getFBXEulerRotation(post));
+		for (size_t k = 0; k < values[1].size(); k++){
+			glm::quat rotation = glm::normalize(preRotation * getFBXEulerRotation(&values[1][k].x) * postRotation);
+			if (k > 0 && glm::dot(rotation, keys.rotations[k - 1]) < 0.0f)
+				rotation = -rotation;
+			keys.rotations.push_back(rotation);
+		}
+		tracks.push_back(keys);
+	}
+	deleteFBX(root);
+
+	float duration = (float)((span[1] - span[0]) / FBX_TIME_SECOND);
+	return createAnimationClip(tracks.empty() ? NULL : &tracks[0], (int)tracks.size(), duration, tolerances);
+}
+
+// A skeleton-like clip at 60 Hz: the first track bobs, every track swings round its own axis a whole number of times
+// per loop and holds still for part of it, the second one also pulses in scale. Bone offsets stay constant.
+static void bakeClip(int clip, int trackCount, float duration, std::vector<AnimationTrackKeys> & tracks){
+	int frames = (int)(duration * 60.0f) + 1;
+	tracks.resize(trackCount);
+	for (int t = 0; t < trackCount; t++){
+		AnimationTrackKeys & keys = tracks[t];
+		char name[32];
+		sprintf(name, "bone%d", t);
+		keys.name = name;
+		glm::vec3 axis = glm::normalize(glm::vec3(sinf(t * 1.3f + clip), cosf(t * 0.7f), 0.5f));
+		float cycles = (float)(1 + (t + clip) % 3);
+		float amplitude = 0.3f + 0.1f * (t % 4);
+		glm::vec3 offset(0.0f, t == 0 ? 1.0f : 0.25f, 0.0f);
+		for (int f = 0; f < frames; f++){
+			float time = duration * f / (frames - 1);
+			float phase = time;
+			if (t % 3 == 1 && time > duration * 0.25f && time < duration * 0.5f)
+				phase = duration * 0.25f;
+			float wave = sinf(TWO_PI * cycles * phase / duration);
+			keys.translationTimes.push_back(time);
+			keys.translations.push_back(t == 0 ? offset + glm::vec3(0.0f, 0.1f * fabsf(wave), 0.0f) : offset);
+			keys.rotationTimes.push_back(time);
+			keys.rotations.push_back(glm::angleAxis(amplitude * wave, axis));
+			keys.scaleTimes.push_back(time);
+			keys.scales.push_back(glm::vec3(t == 1 ? 1.0f + 0.1f * wave : 1.0f));
+		}
+	}
+}
+
+// Uncompressed reference: float keys, binary search, the same interpolation
+static void sampleSourceTrack(const AnimationTrackKeys & keys, float time, float * values){
+	const std::vector<float> * times[3] = { &keys.translationTimes, &keys.rotationTimes, &keys.scaleTimes };
+	for (int c = 0; c < CHANNELS; c++){
+		int d = c == CHANNEL_ROTATION ? 4 : 3;
+		float * out = values + (c == CHANNEL_TRANSLATION ? 0 : c == CHANNEL_ROTATION ? 3 : 7);
+		size_t next = std::upper_bound(times[c]->begin(), times[c]->end(), time) - times[c]->begin();
+		size_t a = next == 0 ? 0 : next - 1, b = glm::min(next, times[c]->size() - 1);
+		float span = (*times[c])[b] - (*times[c])[a];
+		float f = span > 0.0f ? (time - (*times[c])[a]) / span : 0.0f;
+		const float * va = c == CHANNEL_TRANSLATION ? &keys.translations[a].x : c == CHANNEL_ROTATION ? &keys.rotations[a].x : &keys.scales[a].x;
+		const float * vb = c == CHANNEL_TRANSLATION ? &keys.translations[b].x : c == CHANNEL_ROTATION ? &keys.rotations[b].x : &keys.scales[b].x;
+		interpolate(va, vb, f, d, out);
+	}
+}
+
+void benchmarkAnimationClips(const char * fbxpath, int instances, int iterations){
+	AnimationClipTolerances tolerances = { 0.001f, 0.001f, 0.001f };
+	AnimationClip * imported = loadFBXAnimationClip(fbxpath, tolerances);
+	if (imported){
+		AnimationClipStats stats = getAnimationClipStats(imported);
+		printf("[DEBUG] Animation clip %s: %d tracks, %.2f s, %d keys (source %d), %d bytes (source %d)\n", fbxpath, stats.tracks,
+			stats.duration, stats.keys, stats.sourceKeys, stats.bytes, stats.sourceBytes);
+		deleteAnimationClip(imported);
+	}
+	if (instances <= 0 || iterations <= 0)
+		return;
+
+	// Baked clips, compressed
+	const int clipCount = 32, trackCount = 24;
+	const float duration = 4.0f;
+	std::vector<AnimationTrackKeys> sources[clipCount];
+	AnimationClip * clips[clipCount];
+	AnimationClipStats total;
+	memset(&total, 0, sizeof(total));
+	for (int c = 0; c < clipCount; c++){
+		bakeClip(c, trackCount, duration, sources[c]);
+		clips[c] = createAnimationClip(&sources[c][0], trackCount, duration, tolerances);
+		AnimationClipStats stats = getAnimationClipStats(clips[c]);
+		total.keys += stats.keys;
+		total.sourceKeys += stats.sourceKeys;
+		total.bytes += stats.bytes;
+		total.sourceBytes += stats.sourceBytes;
+		total.translationError = glm::max(total.translationError, stats.translationError);
+		total.rotationError = glm::max(total.rotationError, stats.rotationError);
+		total.scaleError = glm::max(total.scaleError, stats.scaleError);
+	}
+	printf("[DEBUG] Animation clips (%d baked, %d tracks, %.0f s at 60 Hz): %.1f KB per clip (source %.1f KB), %.1f%% of the keys kept, "
+		"largest error %.2g units, %.3f degrees, %.2g scale\n", clipCount, trackCount, duration, total.bytes / 1024.0 / clipCount,
+		total.sourceBytes / 1024.0 / clipCount, 100.0 * total.keys / total.sourceKeys, total.translationError,
+		glm::degrees(total.rotationError), total.scaleError);
+
+	// Every instance plays a clip from its own time, one frame further each iteration: its tracks next to each other
+	int count = instances * trackCount;
+	std::vector<AnimationSample> samples(count);
+	std::vector<float> startTimes(instances);
+	srand(1);
+	for (int i = 0; i < instances; i++)
+		startTimes[i] = duration * rand() / RAND_MAX;
+	std::vector<float> streams(10 * count);
+	TransformStreams out = { &streams[0], &streams[count], &streams[2 * count], &streams[3 * count], &streams[4 * count],
+		&streams[5 * count], &streams[6 * count], &streams[7 * count], &streams[8 * count], &streams[9 * count] };
+
+	double batchSeconds = 0.0, serialSeconds = 0.0, sourceSeconds = 0.0;
+	for (int it = 0; it < iterations; it++){
+		for (int i = 0; i < instances; i++){
+			for (int t = 0; t < trackCount; t++){
+				AnimationSample sample = { clips[i % clipCount], t, startTimes[i] + it / 60.0f };
+				samples[i * trackCount + t] = sample;
+			}
+		}
+		double start = getTime();
+		sampleAnimationClips(&samples[0], count, out);
+		batchSeconds += getTime() - start;
+
+		start = getTime();
+		sampleRange(&samples[0], 0, count, out);
+		serialSeconds += getTime() - start;
+
+		start = getTime();
+		for (int i = 0; i < count; i++){
+			const AnimationSample & sample = samples[i];
+			float values[10];
+			sampleSourceTrack(sources[i / trackCount % clipCount][sample.track], fmodf(sample.time, duration), values);
+			out.px[i] = values[0];
+			out.py[i] = values[1];
+			out.pz[i] = values[2];
+			out.qx[i] = values[3];
+			out.qy[i] = values[4];
+			out.qz[i] = values[5];
+			out.qw[i] = values[6];
+			out.sx[i] = values[7];
+			out.sy[i] = values[8];
+			out.sz[i] = values[9];
+		}
+		sourceSeconds += getTime() - start;
+	}
+
+	double tracks = (double)count * iterations;
+	printf("[DEBUG] Animation sampling (%d instances x %d tracks, %u threads): batch %.1f M tracks/s, one thread %.1f M tracks/s, "
+		"uncompressed float keys %.1f M tracks/s\n", instances, trackCount, getJobThreadCount(), tracks / batchSeconds / 1e6,
+		tracks / serialSeconds / 1e6, tracks / sourceSeconds / 1e6);
+	for (int c = 0; c < clipCount; c++)
+		deleteAnimationClip(clips[c]);
+}
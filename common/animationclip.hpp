@@ -0,0 +1,76 @@
+#ifndef ANIMATIONCLIP_HPP
+#define ANIMATIONCLIP_HPP
+
+// Keyframe animation clips: one track per animated node, each with translation, rotation and scale keys. Creating a
+// clip drops every key its neighbours interpolate to within a tolerance (Douglas-Peucker on the linear, or for
+// rotations normalized-lerp, curve), then quantizes what is left to 8 bytes a key: a 16 bit time and three 16 bit
+// values, vectors over the channel's range and rotations as their three smallest components (the largest one
+// follows from unit length). A track's three channels are stored one after the other, so sampling a track reads
+// one small contiguous block, and instances playing the same clip share it in the cache.
+//
+// Clips loop: times are taken modulo the duration. Clips are read-only once created and may be sampled from any thread.
+
+// Source keys of one track, times in seconds and increasing. An empty channel is the identity (0, no rotation, 1).
+struct AnimationTrackKeys {
+	std::string name;
+	std::vector<float> translationTimes;
+	std::vector<glm::vec3> translations;
+	std::vector<float> rotationTimes;
+	std::vector<glm::quat> rotations;
+	std::vector<float> scaleTimes;
+	std::vector<glm::vec3> scales;
+};
+
+// Largest error a dropped key may have: units, radians, scale units
+struct AnimationClipTolerances {
+	float translation;
+	float rotation;
+	float scale;
+};
+
+// Bytes are the keys and track headers (not the names), the source ones 4 byte floats for times and values.
+// The errors are the largest at the source keys, after reduction and quantization.
+struct AnimationClipStats {
+	int tracks;
+	int keys;
+	int sourceKeys;
+	int bytes;
+	int sourceBytes;
+	float duration;
+	float translationError;
+	float rotationError;		// Radians
+	float scaleError;
+};
+
+struct AnimationClip;
+
+AnimationClip * createAnimationClip(const AnimationTrackKeys * tracks, int trackCount, float duration, const AnimationClipTolerances & tolerances);
+void deleteAnimationClip(AnimationClip * clip);
+
+// Every Model of a binary FBX file is a track (with its Lcl Translation/Rotation/Scaling and PreRotation), animated by
+// the curves of the first AnimationStack. Curves are read at their keys and interpolated linearly in between, Euler
+// rotations in XYZ order. A file without animation gives one key per channel. NULL if the file can't be read.
+AnimationClip * loadFBXAnimationClip(const char * path, const AnimationClipTolerances & tolerances);
+
+int getAnimationClipTrackCount(const AnimationClip * clip);
+float getAnimationClipDuration(const AnimationClip * clip);
+const char * getAnimationClipTrackName(const AnimationClip * clip, int track);
+int findAnimationClipTrack(const AnimationClip * clip, const char * name);		// -1 if no track has the name
+AnimationClipStats getAnimationClipStats(const AnimationClip * clip);
+
+// One track of a clip at a time (seconds, wrapped round the duration)
+struct AnimationSample {
+	const AnimationClip * clip;
+	int track;
+	float time;
+};
+
+// Sample i's translation, rotation and scale go to element i of out. Large batches are split across the job system
+// (when called from the main thread or a job); keep an instance's or a clip's samples next to each other.
+void sampleAnimationClips(const AnimationSample * samples, int count, const TransformStreams & out);
+
+// Print the memory per clip and the error of fbxpath's import and of clips baked at 60 Hz, and the sampling throughput
+// (tracks per second) of instances playing the baked clips, batched and one thread, against uncompressed float keys
+void benchmarkAnimationClips(const char * fbxpath, int instances, int iterations);
+
+#endif
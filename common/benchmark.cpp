@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "timer.hpp"
+#include "benchmark.hpp"
+
+#define BENCHMARK_QUERIES		8		// GPU timer queries in flight, a frame's time is read back up to this many frames later
+#define BENCHMARK_BUCKETS		100		// Most histogram buckets before they get wider
+
+struct Benchmark {
+	int warmupFrames;
+	int measuredFrames;
+	int frame;					// Frames begun
+	double frameStart;
+
+	// Every frame, warm-up included, indexed by frame number (GPU times are filled in as the queries come back)
+	std::vector<float> cpuMilliseconds;
+	std::vector<float> gpuMilliseconds;
+	std::vector<float> submitMilliseconds;
+	std::vector<int> drawCalls;
+	std::vector<int> drawnInstances;
+
+	GLuint queries[BENCHMARK_QUERIES];
+	int queryFrame[BENCHMARK_QUERIES];		// Frame measured by each query, -1 = free
+};
+
+struct FrameTimeSummary {
+	float min, mean, p50, p95, p99, max;
+};
+
+
+
+Benchmark * createBenchmark(int warmupFrames, int measuredFrames){
+	Benchmark * benchmark = new Benchmark;
+	benchmark->warmupFrames = warmupFrames > 0 ? warmupFrames : 0;
+	benchmark->measuredFrames = measuredFrames > 0 ? measuredFrames : 1;
+	benchmark->frame = 0;
+	benchmark->frameStart = 0.0;
+
+	int frames = benchmark->warmupFrames + benchmark->measuredFrames;
+	benchmark->cpuMilliseconds.assign(frames, 0.0f);
+	benchmark->gpuMilliseconds.assign(frames, 0.0f);
+	benchmark->submitMilliseconds.assign(frames, 0.0f);
+	benchmark->drawCalls.assign(frames, 0);
+	benchmark->drawnInstances.assign(frames, 0);
+
+	glGenQueries(BENCHMARK_QUERIES, benchmark->queries);
+	for (int i = 0; i < BENCHMARK_QUERIES; i++)
+		benchmark->queryFrame[i] = -1;
+	return benchmark;
+}
+
+void deleteBenchmark(Benchmark * benchmark){
+	if (benchmark == NULL)
+		return;
+	glDeleteQueries(BENCHMARK_QUERIES, benchmark->queries);
+	delete benchmark;
+}
+
+int getBenchmarkFrame(Benchmark * benchmark){
+	return benchmark->frame;
+}
+
+bool isBenchmarkFinished(Benchmark * benchmark){
+	return benchmark->frame >= benchmark->warmupFrames + benchmark->measuredFrames;
+}
+
+// Read a query's result into its frame, waiting for it if asked to. False if it isn't available yet.
+static bool collectQuery(Benchmark * benchmark, int slot, bool wait){
+	if (benchmark->queryFrame[slot] < 0)
+		return true;
+	if (!wait){
+		GLuint available = 0;
+		glGetQueryObjectuiv(benchmark->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+	}
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(benchmark->queries[slot], GL_QUERY_RESULT, &nanoseconds);
+	benchmark->gpuMilliseconds[benchmark->queryFrame[slot]] = (float)(nanoseconds / 1000000.0);
+	benchmark->queryFrame[slot] = -1;
+	return true;
+}
+
+void beginBenchmarkFrame(Benchmark * benchmark){
+	// The query of BENCHMARK_QUERIES frames ago has to be read before it is reused
+	int slot = benchmark->frame % BENCHMARK_QUERIES;
+	collectQuery(benchmark, slot, true);
+
+	benchmark->frameStart = getTime();
+	glBeginQuery(GL_TIME_ELAPSED, benchmark->queries[slot]);
+}
+
+void endBenchmarkGPU(Benchmark * benchmark){
+	int slot = benchmark->frame % BENCHMARK_QUERIES;
+	glEndQuery(GL_TIME_ELAPSED);
+	benchmark->queryFrame[slot] = benchmark->frame;
+
+	// Older queries the GPU is done with, oldest first (they complete in order)
+	for (int i = 1; i < BENCHMARK_QUERIES; i++){
+		if (!collectQuery(benchmark, (slot + i) % BENCHMARK_QUERIES, false))
+			break;
+	}
+}
+
+void endBenchmarkFrame(Benchmark * benchmark, float submitMilliseconds, int drawCalls, int drawnInstances){
+	if (isBenchmarkFinished(benchmark))
+		return;
+	int frame = benchmark->frame;
+	benchmark->cpuMilliseconds[frame] = (float)((getTime() - benchmark->frameStart) * 1000.0);
+	benchmark->submitMilliseconds[frame] = submitMilliseconds;
+	benchmark->drawCalls[frame] = drawCalls;
+	benchmark->drawnInstances[frame] = drawnInstances;
+	benchmark->frame++;
+}
+
+// Nearest rank percentiles of the measured frames
+static FrameTimeSummary summarize(const float * milliseconds, int count){
+	std::vector<float> sorted(milliseconds, milliseconds + count);
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (int i = 0; i < count; i++)
+		sum += sorted[i];
+
+	FrameTimeSummary summary;
+	summary.min = sorted[0];
+	summary.max = sorted[count - 1];
+	summary.mean = (float)(sum / count);
+	summary.p50 = sorted[std::max((int)ceil(0.50 * count) - 1, 0)];
+	summary.p95 = sorted[std::max((int)ceil(0.95 * count) - 1, 0)];
+	summary.p99 = sorted[std::max((int)ceil(0.99 * count) - 1, 0)];
+	return summary;
+}
+
+static void writeFrameTimes(FILE * file, const char * name, const float * milliseconds, int count){
+	FrameTimeSummary summary = summarize(milliseconds, count);
+
+	// Narrowest bucket width that covers the slowest frame in BENCHMARK_BUCKETS buckets
+	static const float widths[] = { 0.1f, 0.25f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 25.0f, 50.0f, 100.0f };
+	float width = widths[0];
+	for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++){
+		width = widths[i];
+		if (summary.max < width * BENCHMARK_BUCKETS)
+			break;
+	}
+	std::vector<int> counts(BENCHMARK_BUCKETS, 0);
+	int buckets = 1;
+	for (int i = 0; i < count; i++){
+		int bucket = std::min((int)(milliseconds[i] / width), BENCHMARK_BUCKETS - 1);
+		counts[bucket]++;
+		buckets = std::max(buckets, bucket + 1);
+	}
+
+	fprintf(file, "\t\"%s\": {\n", name);
+	fprintf(file, "\t\t\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f,\n",
+		summary.min, summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+	fprintf(file, "\t\t\"histogram\": { \"bucket_ms\": %g, \"counts\": [", width);
+	for (int i = 0; i < buckets; i++)
+		fprintf(file, i ? ", %d" : "%d", counts[i]);
+	fprintf(file, "] }\n\t},\n");
+}
+
+// Quoted and escaped: driver strings (GL_RENDERER, GL_VERSION) may hold quotes, backslashes or control characters
+static void writeString(FILE * file, const char * text){
+	fputc('"', file);
+	for (const unsigned char * c = (const unsigned char *)(text ? text : ""); *c; c++){
+		if (*c == '"' || *c == '\\')
+			fprintf(file, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(file, "\\u%04x", *c);
+		else
+			fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+static void writeCounts(FILE * file, const char * name, const int * values, int count, bool last){
+	int low = values[0], high = values[0];
+	double sum = 0.0;
+	for (int i = 0; i < count; i++){
+		low = std::min(low, values[i]);
+		high = std::max(high, values[i]);
+		sum += values[i];
+	}
+	fprintf(file, "\t\"%s\": { \"min\": %d, \"mean\": %.2f, \"max\": %d }%s\n", name, low, sum / count, high, last ? "" : ",");
+}
+
+bool writeBenchmarkReport(Benchmark * benchmark, const BenchmarkInfo & info, const char * path){
+	for (int i = 0; i < BENCHMARK_QUERIES; i++)
+		collectQuery(benchmark, i, true);
+
+	// Only the measured frames that were run (all of them unless the run was cut short)
+	int measured = benchmark->frame - benchmark->warmupFrames;
+	if (measured <= 0){
+		printf("[WARNING] Benchmark ended during its warm-up, nothing measured.\n");
+		return false;
+	}
+	int first = benchmark->warmupFrames;
+	const float * cpu = &benchmark->cpuMilliseconds[first];
+	const float * gpu = &benchmark->gpuMilliseconds[first];
+
+	const float * submit = &benchmark->submitMilliseconds[first];
+
+	FrameTimeSummary cpuSummary = summarize(cpu, measured);
+	FrameTimeSummary gpuSummary = summarize(gpu, measured);
+	FrameTimeSummary submitSummary = summarize(submit, measured);
+	printf("Benchmark: %d frames after %d warm-up, CPU p50 %.3f ms p99 %.3f ms, GPU p50 %.3f ms p99 %.3f ms, submit p50 %.3f ms p99 %.3f ms\n",
+		measured, benchmark->warmupFrames, cpuSummary.p50, cpuSummary.p99, gpuSummary.p50, gpuSummary.p99, submitSummary.p50, submitSummary.p99);
+
+	FILE * file = fopen(path, "w");
+	if (file == NULL){
+		printf("[WARNING] Can't write %s.\n", path);
+		return false;
+	}
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"build\": ");
+	writeString(file, info.build);
+	fprintf(file, ",\n\t\"renderer\": ");
+	writeString(file, info.renderer);
+	fprintf(file, ",\n\t\"version\": ");
+	writeString(file, info.version);
+	fprintf(file, ",\n");
+	fprintf(file, "\t\"resolution\": [%d, %d],\n", info.width, info.height);
+	fprintf(file, "\t\"scene_objects\": %d,\n", info.sceneObjects);
+	fprintf(file, "\t\"instances\": %d,\n", info.instances);
+	fprintf(file, "\t\"tick_seconds\": %g,\n", info.tickSeconds);
+	fprintf(file, "\t\"warmup_frames\": %d,\n", benchmark->warmupFrames);
+	fprintf(file, "\t\"measured_frames\": %d,\n", measured);
+	writeFrameTimes(file, "cpu_frame_ms", cpu, measured);
+	writeFrameTimes(file, "gpu_frame_ms", gpu, measured);
+	writeFrameTimes(file, "cpu_submit_ms", submit, measured);
+	writeCounts(file, "draw_calls", &benchmark->drawCalls[first], measured, false);
+	writeCounts(file, "drawn_instances", &benchmark->drawnInstances[first], measured, true);
+	fprintf(file, "}\n");
+	fclose(file);
+	return true;
+}
+
+void evaluateCameraPath(const CameraKey * keys, int count, float t, glm::vec3 & eye, glm::vec3 & target){
+	// Segment and local parameter on the closed loop
+	float position = (t - floorf(t)) * count;
+	int segment = std::min((int)position, count - 1);
+	float u = position - segment;
+
+	const CameraKey & k0 = keys[(segment + count - 1) % count];
+	const CameraKey & k1 = keys[segment];
+	const CameraKey & k2 = keys[(segment + 1) % count];
+	const CameraKey & k3 = keys[(segment + 2) % count];
+
+	// Uniform Catmull-Rom: passes through every key with a continuous tangent
+	float u2 = u * u, u3 = u2 * u;
+	float w0 = -0.5f * u3 + u2 - 0.5f * u;
+	float w1 = 1.5f * u3 - 2.5f * u2 + 1.0f;
+	float w2 = -1.5f * u3 + 2.0f * u2 + 0.5f * u;
+	float w3 = 0.5f * u3 - 0.5f * u2;
+	eye = k0.eye * w0 + k1.eye * w1 + k2.eye * w2 + k3.eye * w3;
+	target = k0.target * w0 + k1.target * w1 + k2.target * w2 + k3.target * w3;
+}
@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+// Reproducible benchmark runs: warm-up frames followed by measured frames, each timed on the CPU (frame begun to
+// presented) and on the GPU (a GL_TIME_ELAPSED query around the scene, read back a few frames later so the
+// queries never stall the pipeline), with the CPU time spent recording and submitting the draws, the frame's draw
+// calls and drawn instances. The report is a JSON file with min/mean/p50/p95/p99/max and a histogram of each time,
+// meant to be compared across builds.
+// The camera follows a closed Catmull-Rom spline through a few keys, evaluated from the frame number, not the clock.
+
+struct CameraKey {
+	glm::vec3 eye;
+	glm::vec3 target;
+};
+
+// Written into the report next to the measurements
+struct BenchmarkInfo {
+	const char * build;			// ie. __DATE__ " " __TIME__
+	const char * renderer;		// GL_RENDERER
+	const char * version;		// GL_VERSION (the driver's)
+	int width, height;
+	int sceneObjects;
+	int instances;
+	double tickSeconds;			// Simulation step of every frame
+};
+
+struct Benchmark;
+
+// Needs the GL context (timer queries)
+Benchmark * createBenchmark(int warmupFrames, int measuredFrames);
+void deleteBenchmark(Benchmark * benchmark);
+
+// Frames begun so far (warm-up included), the frame number the scene and the camera are driven by
+int getBenchmarkFrame(Benchmark * benchmark);
+bool isBenchmarkFinished(Benchmark * benchmark);
+
+// beginBenchmarkFrame starts the CPU and GPU timers, endBenchmarkGPU stops the GPU one after the draws being measured,
+// endBenchmarkFrame records the frame once it is presented
+void beginBenchmarkFrame(Benchmark * benchmark);
+void endBenchmarkGPU(Benchmark * benchmark);
+void endBenchmarkFrame(Benchmark * benchmark, float submitMilliseconds, int drawCalls, int drawnInstances);
+
+// Waits for the GPU times still in flight, prints a summary and writes the JSON report. False if it can't be written.
+bool writeBenchmarkReport(Benchmark * benchmark, const BenchmarkInfo & info, const char * path);
+
+// Camera at t (0 to 1, wrapping) along the closed spline through keys
+void evaluateCameraPath(const CameraKey * keys, int count, float t, glm::vec3 & eye, glm::vec3 & target);
+
+#endif
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "timer.hpp"
+#include "culling.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE2
+#endif
+
+#define BVH_WIDTH		4		// Children per node
+#define BVH_NO_NODE		-1
+
+// Four child boxes as center/extent, one SSE register per component
+struct BVHNode {
+	float centerX[BVH_WIDTH], centerY[BVH_WIDTH], centerZ[BVH_WIDTH];
+	float extentX[BVH_WIDTH], extentY[BVH_WIDTH], extentZ[BVH_WIDTH];
+	int child[BVH_WIDTH];		// >= 0: node, < 0: object -1 - child
+	int count;					// Children used
+	int parent;
+	int parentSlot;
+};
+
+struct BVHObject {
+	BoundingBox box;
+	int node;
+	int slot;
+	bool dirty;
+};
+
+struct CullingBVH {
+	std::vector<BVHNode> nodes;
+	std::vector<BVHObject> objects;
+	std::vector<int> dirtyObjects;
+	bool rebuild;
+
+	std::vector<int> buildOrder;		// Scratch
+	std::vector<glm::vec3> centroids;
+	std::vector<int> stack;
+	CullingStats stats;
+};
+
+
+
+void computeMeshBounds(const glm::vec3 * positions, int count, BoundingBox & box, BoundingSphere & sphere){
+	box.min = glm::vec3(FLT_MAX);
+	box.max = glm::vec3(-FLT_MAX);
+	for (int i = 0; i < count; i++){
+		box.min = glm::min(box.min, positions[i]);
+		box.max = glm::max(box.max, positions[i]);
+	}
+
+	// Sphere around the box center, radius to the farthest vertex (tighter than the box's half diagonal)
+	sphere.center = (box.min + box.max) * 0.5f;
+	float radius2 = 0.0f;
+	for (int i = 0; i < count; i++){
+		glm::vec3 d = positions[i] - sphere.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	sphere.radius = sqrtf(radius2);
+}
+
+BoundingBox transformBoundingBox(const BoundingBox & box, const glm::mat4 & matrix){
+	// Center moves with the matrix, the extent grows by the absolute value of the rotation/scale part
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent;
+	for (int row = 0; row < 3; row++)
+		worldExtent[row] = fabsf(matrix[0][row]) * extent.x + fabsf(matrix[1][row]) * extent.y + fabsf(matrix[2][row]) * extent.z;
+
+	BoundingBox world = { worldCenter - worldExtent, worldCenter + worldExtent };
+	return world;
+}
+
+Frustum extractFrustum(const glm::mat4 & viewProjection){
+	// Rows of the matrix (glm is column major)
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];	// Left
+	frustum.planes[1] = rows[3] - rows[0];	// Right
+	frustum.planes[2] = rows[3] + rows[1];	// Bottom
+	frustum.planes[3] = rows[3] - rows[1];	// Top
+	frustum.planes[4] = rows[3] + rows[2];	// Near
+	frustum.planes[5] = rows[3] - rows[2];	// Far
+	for (int i = 0; i < 6; i++)
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	return frustum;
+}
+
+bool isBoxInFrustum(const Frustum & frustum, const BoundingBox & box){
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	for (int i = 0; i < 6; i++){
+		const glm::vec4 & plane = frustum.planes[i];
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+		if (distance < -radius)
+			return false;
+	}
+	return true;
+}
+
+// Test the four child boxes of a node: bit i of outside = child i entirely behind a plane,
+// bit i of partial = child i crosses a plane (only meaningful when not outside)
+static void testNode(const BVHNode & node, const Frustum & frustum, int & outside, int & partial){
+#ifdef CULLING_SSE2
+	__m128 cx = _mm_loadu_ps(node.centerX), cy = _mm_loadu_ps(node.centerY), cz = _mm_loadu_ps(node.centerZ);
+	__m128 ex = _mm_loadu_ps(node.extentX), ey = _mm_loadu_ps(node.extentY), ez = _mm_loadu_ps(node.extentZ);
+	__m128 outsideMask = _mm_setzero_ps();
+	__m128 partialMask = _mm_setzero_ps();
+	for (int i = 0; i < 6; i++){
+		const glm::vec4 & plane = frustum.planes[i];
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+			_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(plane.y)))),
+			_mm_mul_ps(ez, _mm_set1_ps(fabsf(plane.z))));
+		outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		partialMask = _mm_or_ps(partialMask, _mm_cmplt_ps(distance, radius));
+	}
+	outside = _mm_movemask_ps(outsideMask);
+	partial = _mm_movemask_ps(partialMask);
+#else
+	outside = 0;
+	partial = 0;
+	for (int c = 0; c < BVH_WIDTH; c++){
+		for (int i = 0; i < 6; i++){
+			const glm::vec4 & plane = frustum.planes[i];
+			float distance = node.centerX[c] * plane.x + node.centerY[c] * plane.y + node.centerZ[c] * plane.z + plane.w;
+			float radius = node.extentX[c] * fabsf(plane.x) + node.extentY[c] * fabsf(plane.y) + node.extentZ[c] * fabsf(plane.z);
+			if (distance + radius < 0.0f)
+				outside |= 1 << c;
+			if (distance < radius)
+				partial |= 1 << c;
+		}
+	}
+#endif
+}
+
+static void setSlot(BVHNode & node, int slot, const BoundingBox & box){
+	node.centerX[slot] = (box.min.x + box.max.x) * 0.5f;
+	node.centerY[slot] = (box.min.y + box.max.y) * 0.5f;
+	node.centerZ[slot] = (box.min.z + box.max.z) * 0.5f;
+	node.extentX[slot] = (box.max.x - box.min.x) * 0.5f;
+	node.extentY[slot] = (box.max.y - box.min.y) * 0.5f;
+	node.extentZ[slot] = (box.max.z - box.min.z) * 0.5f;
+}
+
+static BoundingBox nodeBounds(const BVHNode & node){
+	BoundingBox box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	for (int c = 0; c < node.count; c++){
+		glm::vec3 center(node.centerX[c], node.centerY[c], node.centerZ[c]);
+		glm::vec3 extent(node.extentX[c], node.extentY[c], node.extentZ[c]);
+		box.min = glm::min(box.min, center - extent);
+		box.max = glm::max(box.max, center + extent);
+	}
+	return box;
+}
+
+// Longest axis of the centroids of objects [begin, end) of buildOrder
+static int splitAxis(CullingBVH * bvh, int begin, int end){
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (int i = begin; i < end; i++){
+		low = glm::min(low, bvh->centroids[bvh->buildOrder[i]]);
+		high = glm::max(high, bvh->centroids[bvh->buildOrder[i]]);
+	}
+	glm::vec3 size = high - low;
+	return size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+}
+
+// Reorder [begin, end) so the first half has the smaller centroids along the longest axis, return the middle
+static int splitMedian(CullingBVH * bvh, int begin, int end){
+	int axis = splitAxis(bvh, begin, end);
+	int middle = (begin + end) / 2;
+	const std::vector<glm::vec3> & centroids = bvh->centroids;
+	std::nth_element(bvh->buildOrder.begin() + begin, bvh->buildOrder.begin() + middle, bvh->buildOrder.begin() + end,
+		[&centroids, axis](int a, int b){ return centroids[a][axis] < centroids[b][axis]; });
+	return middle;
+}
+
+// Build the node for objects [begin, end) of buildOrder, returns its bounds
+static BoundingBox buildNode(CullingBVH * bvh, int index, int begin, int end){
+	int ranges[BVH_WIDTH + 1];
+	int count;
+	if (end - begin <= BVH_WIDTH){
+		count = end - begin;
+		for (int c = 0; c <= count; c++)
+			ranges[c] = begin + c;
+	} else {
+		// Two median splits make four groups of about the same size
+		int middle = splitMedian(bvh, begin, end);
+		ranges[0] = begin;
+		ranges[1] = splitMedian(bvh, begin, middle);
+		ranges[2] = middle;
+		ranges[3] = splitMedian(bvh, middle, end);
+		ranges[4] = end;
+		count = BVH_WIDTH;
+	}
+
+	bvh->nodes[index].count = count;
+	for (int c = 0; c < count; c++){
+		BoundingBox box;
+		if (ranges[c + 1] - ranges[c] == 1){
+			int object = bvh->buildOrder[ranges[c]];
+			bvh->nodes[index].child[c] = -1 - object;
+			bvh->objects[object].node = index;
+			bvh->objects[object].slot = c;
+			box = bvh->objects[object].box;
+		} else {
+			int child = (int)bvh->nodes.size();
+			bvh->nodes.push_back(BVHNode());
+			bvh->nodes[child].parent = index;
+			bvh->nodes[child].parentSlot = c;
+			box = buildNode(bvh, child, ranges[c], ranges[c + 1]);
+			bvh->nodes[index].child[c] = child;
+		}
+		setSlot(bvh->nodes[index], c, box);
+	}
+
+	// Unused slots are never followed (the traversal stops at count), keep them zero
+	for (int c = count; c < BVH_WIDTH; c++){
+		BoundingBox empty = { glm::vec3(0.0f), glm::vec3(0.0f) };
+		setSlot(bvh->nodes[index], c, empty);
+		bvh->nodes[index].child[c] = 0;
+	}
+	return nodeBounds(bvh->nodes[index]);
+}
+
+static void buildBVH(CullingBVH * bvh){
+	int count = (int)bvh->objects.size();
+	bvh->nodes.clear();
+	bvh->buildOrder.resize(count);
+	bvh->centroids.resize(count);
+	for (int i = 0; i < count; i++){
+		bvh->buildOrder[i] = i;
+		bvh->centroids[i] = (bvh->objects[i].box.min + bvh->objects[i].box.max) * 0.5f;
+		bvh->objects[i].dirty = false;
+	}
+	bvh->dirtyObjects.clear();
+	bvh->rebuild = false;
+	if (count == 0)
+		return;
+
+	bvh->nodes.push_back(BVHNode());
+	bvh->nodes[0].parent = BVH_NO_NODE;
+	bvh->nodes[0].parentSlot = 0;
+	buildNode(bvh, 0, 0, count);
+}
+
+// Write the moved objects into their slots and grow/shrink the boxes above them, stopping where nothing changes
+static void refitBVH(CullingBVH * bvh){
+	for (size_t i = 0; i < bvh->dirtyObjects.size(); i++){
+		BVHObject & object = bvh->objects[bvh->dirtyObjects[i]];
+		object.dirty = false;
+		setSlot(bvh->nodes[object.node], object.slot, object.box);
+
+		int node = object.node;
+		while (bvh->nodes[node].parent != BVH_NO_NODE){
+			BVHNode & parent = bvh->nodes[bvh->nodes[node].parent];
+			int slot = bvh->nodes[node].parentSlot;
+			BoundingBox box = nodeBounds(bvh->nodes[node]);
+			glm::vec3 center = (box.min + box.max) * 0.5f;
+			glm::vec3 extent = (box.max - box.min) * 0.5f;
+			if (parent.centerX[slot] == center.x && parent.centerY[slot] == center.y && parent.centerZ[slot] == center.z &&
+				parent.extentX[slot] == extent.x && parent.extentY[slot] == extent.y && parent.extentZ[slot] == extent.z)
+				break;
+			setSlot(parent, slot, box);
+			node = bvh->nodes[node].parent;
+		}
+	}
+	bvh->dirtyObjects.clear();
+}
+
+CullingBVH * createCullingBVH(){
+	CullingBVH * bvh = new CullingBVH;
+	bvh->rebuild = false;
+	memset(&bvh->stats, 0, sizeof(bvh->stats));
+	return bvh;
+}
+
+void deleteCullingBVH(CullingBVH * bvh){
+	delete bvh;
+}
+
+int addCullingObject(CullingBVH * bvh, const BoundingBox & box){
+	BVHObject object = { box, 0, 0, false };
+	bvh->objects.push_back(object);
+	bvh->rebuild = true;
+	return (int)bvh->objects.size() - 1;
+}
+
+void updateCullingObject(CullingBVH * bvh, int object, const BoundingBox & box){
+	BVHObject & o = bvh->objects[object];
+	o.box = box;
+	if (!o.dirty && !bvh->rebuild){
+		o.dirty = true;
+		bvh->dirtyObjects.push_back(object);
+	}
+}
+
+int getCullingObjectCount(CullingBVH * bvh){
+	return (int)bvh->objects.size();
+}
+
+void cullBVH(CullingBVH * bvh, const Frustum & frustum, std::vector<int> & visible){
+	double start = getTime();
+	CullingStats & stats = bvh->stats;
+	stats.refitObjects = (int)bvh->dirtyObjects.size();
+	if (bvh->rebuild)
+		buildBVH(bvh);
+	else
+		refitBVH(bvh);
+
+	visible.clear();
+	stats.nodesTested = 0;
+	if (!bvh->nodes.empty()){
+		// Stack entries: node index, negated (-1 - node) for nodes entirely inside the frustum
+		std::vector<int> & stack = bvh->stack;
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty()){
+			int entry = stack.back();
+			stack.pop_back();
+			bool inside = entry < 0;
+			const BVHNode & node = bvh->nodes[inside ? -1 - entry : entry];
+
+			int outside = 0;
+			int partial = 0;
+			if (!inside){
+				testNode(node, frustum, outside, partial);
+				stats.nodesTested++;
+			}
+			for (int c = 0; c < node.count; c++){
+				if (outside & (1 << c))
+					continue;
+				int child = node.child[c];
+				if (child < 0)
+					visible.push_back(-1 - child);
+				else
+					stack.push_back(inside || !(partial & (1 << c)) ? -1 - child : child);
+			}
+		}
+	}
+
+	stats.objects = (int)bvh->objects.size();
+	stats.visible = (int)visible.size();
+	stats.culled = stats.objects - stats.visible;
+	stats.milliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+CullingStats getCullingStats(CullingBVH * bvh){
+	return bvh->stats;
+}
+
+void benchmarkCulling(int objects, int iterations){
+	// Random unit-ish boxes in a 200 unit cube around a camera looking down -Z, 1% of them moving every frame
+	CullingBVH * bvh = createCullingBVH();
+	std::vector<BoundingBox> boxes(objects);
+	srand(1);
+	for (int i = 0; i < objects; i++){
+		glm::vec3 center((float)rand() / RAND_MAX * 200.0f - 100.0f, (float)rand() / RAND_MAX * 200.0f - 100.0f, (float)rand() / RAND_MAX * 200.0f - 100.0f);
+		glm::vec3 extent(0.5f + (float)rand() / RAND_MAX);
+		boxes[i].min = center - extent;
+		boxes[i].max = center + extent;
+		addCullingObject(bvh, boxes[i]);
+	}
+	glm::mat4 projection = glm::mat4(0.0f);
+	float f = 1.0f / tanf(0.75f * 0.5f);		// glm::perspective(0.75f, 1.25f, 0.1f, 100.0f)
+	projection[0][0] = f / 1.25f;
+	projection[1][1] = f;
+	projection[2][2] = -(100.0f + 0.1f) / (100.0f - 0.1f);
+	projection[2][3] = -1.0f;
+	projection[3][2] = -(2.0f * 100.0f * 0.1f) / (100.0f - 0.1f);
+	Frustum frustum = extractFrustum(projection);
+
+	std::vector<int> visible;
+	cullBVH(bvh, frustum, visible);	// Builds the tree
+	double bvhSeconds = 0.0;
+	for (int it = 0; it < iterations; it++){
+		for (int i = it % 100; i < objects; i += 100){
+			glm::vec3 offset(sinf((float)(it + i)) * 0.1f, 0.0f, 0.0f);
+			boxes[i].min += offset;
+			boxes[i].max += offset;
+			updateCullingObject(bvh, i, boxes[i]);
+		}
+		double start = getTime();
+		cullBVH(bvh, frustum, visible);
+		bvhSeconds += getTime() - start;
+	}
+
+	// Reference: every box against the planes
+	int bruteVisible = 0;
+	double start = getTime();
+	for (int it = 0; it < iterations; it++){
+		bruteVisible = 0;
+		for (int i = 0; i < objects; i++)
+			bruteVisible += isBoxInFrustum(frustum, boxes[i]);
+	}
+	double bruteSeconds = getTime() - start;
+
+	CullingStats stats = getCullingStats(bvh);
+	printf("[DEBUG] Frustum culling (%d objects, %d moving): BVH %.3f ms (%d nodes tested), every box %.3f ms, %d visible, %d culled%s\n",
+		objects, stats.refitObjects, bvhSeconds * 1000.0 / iterations, stats.nodesTested, bruteSeconds * 1000.0 / iterations,
+		stats.visible, stats.culled, stats.visible == bruteVisible ? "" : " (MISMATCH)");
+	deleteCullingBVH(bvh);
+}
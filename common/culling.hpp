@@ -0,0 +1,61 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+// Frustum culling: objects are world space AABBs in a 4-wide bounding volume hierarchy (each node holds the boxes
+// of up to four children, tested against the six frustum planes at once with SSE). Moving an object refits only
+// the nodes above it; adding objects rebuilds the tree on the next cull. Subtrees entirely inside the frustum are
+// accepted without further tests.
+
+struct BoundingBox {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+struct BoundingSphere {
+	glm::vec3 center;
+	float radius;
+};
+
+// Planes (xyz = inward normal, w = distance) extracted from projection * view: left, right, bottom, top, near, far
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+// Last cull
+struct CullingStats {
+	int objects;
+	int visible;
+	int culled;
+	int nodesTested;
+	int refitObjects;		// Objects moved since the previous cull
+	float milliseconds;		// Rebuild/refit and traversal
+};
+
+// Mesh bounds, computed once at load time
+void computeMeshBounds(const glm::vec3 * positions, int count, BoundingBox & box, BoundingSphere & sphere);
+
+// World space AABB of a box transformed by a matrix
+BoundingBox transformBoundingBox(const BoundingBox & box, const glm::mat4 & matrix);
+
+Frustum extractFrustum(const glm::mat4 & viewProjection);
+bool isBoxInFrustum(const Frustum & frustum, const BoundingBox & box);
+
+struct CullingBVH;
+
+CullingBVH * createCullingBVH();
+void deleteCullingBVH(CullingBVH * bvh);
+
+// Returns the object's ID (0, 1, 2, ... in the order they are added)
+int addCullingObject(CullingBVH * bvh, const BoundingBox & box);
+void updateCullingObject(CullingBVH * bvh, int object, const BoundingBox & box);
+int getCullingObjectCount(CullingBVH * bvh);
+
+// IDs of the objects inside or intersecting the frustum, in no particular order
+void cullBVH(CullingBVH * bvh, const Frustum & frustum, std::vector<int> & visible);
+
+CullingStats getCullingStats(CullingBVH * bvh);
+
+// Print BVH cull time (with some objects moving every frame) against testing every box, for random objects
+void benchmarkCulling(int objects, int iterations);
+
+#endif
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "timer.hpp"
+#include "texture.hpp"
+#include "dxtdecoder.hpp"
+#include "jobsystem.hpp"
+
+// Software S3TC (DXT1/3/5) decoder, used when the driver can't take compressed uploads.
+// Every 4x4 block is expanded to 16 RGBA8 pixels. Colour interpolation uses (2*c0 + c1) / 3 on the
+// 8 bit expanded endpoints, like most reference decoders. With SSE2 the palette maths and the
+// colour/alpha merge work on all four channels / rows at once; the scalar path gives the same bytes.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DXT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define DXT_ROWS_PER_JOB 8	// Block rows decoded by a worker before it grabs the next job
+
+
+static bool s3tcChecked   = false;
+static bool s3tcSupported = false;
+
+bool isS3TCSupported(){
+	if (s3tcChecked)
+		return s3tcSupported;
+	s3tcChecked = true;
+
+	if (!GLEW_EXT_texture_compression_s3tc){
+		printf("[WARNING] S3TC texture compression is not supported, DDS textures will be decoded on the CPU.\n");
+		return false;
+	}
+
+	// Drivers that only partially implement the extension reject the upload itself
+	static const unsigned char testBlock[8] = { 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	while (glGetError() != GL_NO_ERROR) {}
+
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 4, 4, 0, sizeof(testBlock), testBlock);
+	s3tcSupported = (glGetError() == GL_NO_ERROR);
+	glDeleteTextures(1, &textureID);
+
+	if (!s3tcSupported)
+		printf("[WARNING] S3TC upload failed, DDS textures will be decoded on the CPU.\n");
+	return s3tcSupported;
+}
+
+// RGB565 to RGBA8 (packed little endian, alpha in the top byte), low bits replicated like the hardware does
+static inline unsigned int expand565(unsigned int c){
+	unsigned int r = (c >> 11) & 31;
+	unsigned int g = (c >> 5) & 63;
+	unsigned int b = c & 31;
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+	return r | (g << 8) | (b << 16);
+}
+
+// Build the 4 entry colour palette of a colour block
+static inline void colorPalette(const unsigned char * block, bool dxt1, unsigned int palette[4]){
+	unsigned int c0 = block[0] | (block[1] << 8);
+	unsigned int c1 = block[2] | (block[3] << 8);
+	unsigned int p0 = expand565(c0);
+	unsigned int p1 = expand565(c1);
+	unsigned int alpha = dxt1 ? 0xff000000u : 0u; // DXT3/5 take alpha from their own block
+	bool fourColors = !dxt1 || c0 > c1;
+
+#ifdef DXT_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p0), zero);
+	__m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p1), zero);
+	__m128i p2, p3;
+	if (fourColors){
+		// x / 3 == (x * 0xAAAB) >> 17 for every x this can produce
+		__m128i third = _mm_set1_epi16((short)0xAAAB);
+		p2 = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(a, a), b), third), 1);
+		p3 = _mm_srli_epi16(_mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(b, b), a), third), 1);
+	}else{
+		p2 = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+		p3 = zero;
+	}
+	palette[0] = p0 | alpha;
+	palette[1] = p1 | alpha;
+	palette[2] = (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(p2, zero)) | alpha;
+	palette[3] = fourColors ? ((unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(p3, zero)) | alpha) : 0u;
+#else
+	palette[0] = p0 | alpha;
+	palette[1] = p1 | alpha;
+	palette[2] = alpha;
+	palette[3] = fourColors ? alpha : 0u;
+	for (int shift = 0; shift < 24; shift += 8){
+		unsigned int a = (p0 >> shift) & 0xff;
+		unsigned int b = (p1 >> shift) & 0xff;
+		if (fourColors){
+			palette[2] |= ((2 * a + b) / 3) << shift;
+			palette[3] |= ((a + 2 * b) / 3) << shift;
+		}else{
+			palette[2] |= ((a + b) / 2) << shift;
+		}
+	}
+#endif
+}
+
+// Expand one block's colours into pixels[16] (row major)
+static inline void decodeColorBlock(const unsigned char * block, bool dxt1, unsigned int pixels[16]){
+	unsigned int palette[4];
+	colorPalette(block, dxt1, palette);
+	unsigned int bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+	for (int i = 0; i < 16; i++, bits >>= 2)
+		pixels[i] = palette[bits & 3];
+}
+
+// Alpha of DXT3: explicit 4 bit values
+static inline void decodeExplicitAlpha(const unsigned char * block, unsigned int alpha[16]){
+	for (int i = 0; i < 16; i++){
+		unsigned int a = (block[i / 2] >> ((i & 1) * 4)) & 15;
+		alpha[i] = (a * 17) << 24;
+	}
+}
+
+// Alpha of DXT5: two endpoints plus 3 bit indices into an 8 entry ramp
+static inline void decodeInterpolatedAlpha(const unsigned char * block, unsigned int alpha[16]){
+	unsigned int a0 = block[0];
+	unsigned int a1 = block[1];
+	unsigned int ramp[8];
+	ramp[0] = a0;
+	ramp[1] = a1;
+	if (a0 > a1){
+		for (unsigned int i = 1; i < 7; i++)
+			ramp[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+	}else{
+		for (unsigned int i = 1; i < 5; i++)
+			ramp[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+		ramp[6] = 0;
+		ramp[7] = 255;
+	}
+
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (unsigned long long)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++, bits >>= 3)
+		alpha[i] = ramp[bits & 7] << 24;
+}
+
+// pixels |= alpha, one 4 pixel row per instruction with SSE2
+static inline void mergeAlpha(unsigned int pixels[16], const unsigned int alpha[16]){
+#ifdef DXT_USE_SSE2
+	for (int row = 0; row < 16; row += 4){
+		__m128i c = _mm_loadu_si128((const __m128i *)(pixels + row));
+		__m128i a = _mm_loadu_si128((const __m128i *)(alpha + row));
+		_mm_storeu_si128((__m128i *)(pixels + row), _mm_or_si128(c, a));
+	}
+#else
+	for (int i = 0; i < 16; i++)
+		pixels[i] |= alpha[i];
+#endif
+}
+
+void decodeDXT(unsigned int fourCC, const unsigned char * blocks, unsigned int width, unsigned int height,
+	unsigned int firstBlockRow, unsigned int blockRowCount, unsigned char * out){
+
+	const bool dxt1 = (fourCC == FOURCC_DXT1);
+	const unsigned int blockSize = dxt1 ? 8 : 16;
+	const unsigned int blocksWide = (width + 3) / 4;
+	const unsigned int blocksHigh = (height + 3) / 4;
+	const size_t stride = (size_t)width * 4;
+
+	unsigned int lastBlockRow = firstBlockRow + blockRowCount;
+	if (lastBlockRow > blocksHigh)
+		lastBlockRow = blocksHigh;
+
+	unsigned int pixels[16];
+	unsigned int alpha[16];
+
+	for (unsigned int by = firstBlockRow; by < lastBlockRow; by++){
+		const unsigned char * block = blocks + (size_t)by * blocksWide * blockSize;
+		unsigned int rows = (height - by * 4 < 4) ? height - by * 4 : 4;
+
+		for (unsigned int bx = 0; bx < blocksWide; bx++, block += blockSize){
+			if (dxt1){
+				decodeColorBlock(block, true, pixels);
+			}else{
+				decodeColorBlock(block + 8, false, pixels);
+				if (fourCC == FOURCC_DXT3)
+					decodeExplicitAlpha(block, alpha);
+				else
+					decodeInterpolatedAlpha(block, alpha);
+				mergeAlpha(pixels, alpha);
+			}
+
+			// Copy the 4x4 tile out, clipped at the right and bottom edges
+			unsigned int columns = (width - bx * 4 < 4) ? width - bx * 4 : 4;
+			unsigned char * dst = out + (size_t)by * 4 * stride + (size_t)bx * 16;
+			for (unsigned int y = 0; y < rows; y++, dst += stride)
+				memcpy(dst, pixels + y * 4, columns * 4);
+		}
+	}
+}
+
+// One mipmap level inside the DDS payload and where its RGBA8 pixels go
+struct DXTLevel {
+	unsigned int width;
+	unsigned int height;
+	unsigned int offset;
+	size_t outOffset;
+};
+
+// A range of block rows of one level
+struct DXTJob {
+	unsigned int level;
+	unsigned int firstBlockRow;
+};
+
+static unsigned int collectLevels(unsigned int fourCC, unsigned int width, unsigned int height, unsigned int mipMapCount,
+	unsigned int bufsize, std::vector<DXTLevel> & levels, std::vector<DXTJob> & jobs){
+
+	unsigned int blockSize = (fourCC == FOURCC_DXT1) ? 8 : 16;
+	unsigned int offset = 0;
+	size_t outSize = 0;
+	unsigned int blockCount = 0;
+
+	for (unsigned int level = 0; level < mipMapCount; level++){
+		unsigned int blocksHigh = (height + 3) / 4;
+		unsigned int size = ((width + 3) / 4) * blocksHigh * blockSize;
+		if (offset + size > bufsize)
+			break; // Truncated file, keep the levels we have
+
+		DXTLevel l = { width, height, offset, outSize };
+		levels.push_back(l);
+		for (unsigned int row = 0; row < blocksHigh; row += DXT_ROWS_PER_JOB){
+			DXTJob job = { (unsigned int)levels.size() - 1, row };
+			jobs.push_back(job);
+		}
+
+		blockCount += size / blockSize;
+		offset += size;
+		outSize += (size_t)width * height * 4;
+		width  = width  > 1 ? width  / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return blockCount;
+}
+
+// Decode every job, on the job system's threads or only on the calling thread
+static void decodeLevels(unsigned int fourCC, const unsigned char * buffer, const std::vector<DXTLevel> & levels,
+	const std::vector<DXTJob> & jobs, unsigned char * out, bool parallel){
+
+	auto work = [&](int begin, int end){
+		for (int j = begin; j < end; j++){
+			const DXTLevel & l = levels[jobs[j].level];
+			decodeDXT(fourCC, buffer + l.offset, l.width, l.height, jobs[j].firstBlockRow, DXT_ROWS_PER_JOB, out + l.outOffset);
+		}
+	};
+
+	if (parallel)
+		parallelFor((int)jobs.size(), 1, work);
+	else
+		work(0, (int)jobs.size());
+}
+
+GLuint createTextureFromDXT(unsigned int fourCC, unsigned int width, unsigned int height,
+	unsigned int mipMapCount, const unsigned char * buffer, unsigned int bufsize){
+
+	std::vector<DXTLevel> levels;
+	std::vector<DXTJob> jobs;
+	collectLevels(fourCC, width, height, mipMapCount, bufsize, levels, jobs);
+	if (levels.empty())
+		return 0;
+
+	const DXTLevel & last = levels.back();
+	std::vector<unsigned char> pixels(last.outOffset + (size_t)last.width * last.height * 4);
+	decodeLevels(fourCC, buffer, levels, jobs, &pixels[0], true);
+
+	// Create one OpenGL texture
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+
+	for (unsigned int level = 0; level < levels.size(); level++){
+		const DXTLevel & l = levels[level];
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, l.width, l.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[l.outOffset]);
+	}
+
+	return textureID;
+}
+
+void benchmarkDXTDecoder(const char * imagepath, int iterations){
+	unsigned int width, height, mipMapCount, fourCC, bufsize;
+	unsigned char * buffer = readDDS(imagepath, width, height, mipMapCount, fourCC, bufsize);
+	if (buffer == NULL)
+		return;
+
+	std::vector<DXTLevel> levels;
+	std::vector<DXTJob> jobs;
+	unsigned int blockCount = collectLevels(fourCC, width, height, mipMapCount, bufsize, levels, jobs);
+	if (blockCount == 0 || (fourCC != FOURCC_DXT1 && fourCC != FOURCC_DXT3 && fourCC != FOURCC_DXT5)){
+		free(buffer);
+		return;
+	}
+
+	const DXTLevel & last = levels.back();
+	std::vector<unsigned char> pixels(last.outOffset + (size_t)last.width * last.height * 4);
+
+	unsigned int threadCounts[2] = { 1, getJobThreadCount() };
+	for (int t = 0; t < 2; t++){
+		double start = getTime();
+		for (int i = 0; i < iterations; i++)
+			decodeLevels(fourCC, buffer, levels, jobs, &pixels[0], t == 1);
+		double seconds = getTime() - start;
+
+		double blocksPerSecond = seconds > 0.0 ? (double)blockCount * iterations / seconds : 0.0;
+		printf("[DEBUG] DXT software decode (%s, %u threads): %.1f Mblocks/s, %.1f Mblocks/s per core\n", imagepath,
+			threadCounts[t], blocksPerSecond / 1e6, blocksPerSecond / 1e6 / threadCounts[t]);
+	}
+
+	free(buffer);
+}
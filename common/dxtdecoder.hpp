@@ -0,0 +1,24 @@
+#ifndef DXTDECODER_HPP
+#define DXTDECODER_HPP
+
+#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
+#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
+#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+
+// True if the driver really accepts GL_COMPRESSED_RGBA_S3TC_* uploads.
+// Checked once: the extension must be listed AND a 4x4 test block must upload without a GL error.
+bool isS3TCSupported();
+
+// Expand block rows [firstBlockRow, firstBlockRow + blockRowCount) of one DXT1/3/5 image
+// into tightly packed RGBA8 (width * height * 4 bytes). Edge blocks are clipped to the image size.
+void decodeDXT(unsigned int fourCC, const unsigned char * blocks, unsigned int width, unsigned int height,
+	unsigned int firstBlockRow, unsigned int blockRowCount, unsigned char * out);
+
+// Decode every mipmap of a DDS payload on the job system's threads and upload it as an uncompressed RGBA8 texture
+GLuint createTextureFromDXT(unsigned int fourCC, unsigned int width, unsigned int height,
+	unsigned int mipMapCount, const unsigned char * buffer, unsigned int bufsize);
+
+// Print software decode throughput (blocks/s per core) for a .DDS file, single and multithreaded
+void benchmarkDXTDecoder(const char * imagepath, int iterations);
+
+#endif
@@ -0,0 +1,667 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "timer.hpp"
+#include "jobsystem.hpp"
+#include "transforms.hpp"
+#include "splinepath.hpp"
+#include "animationclip.hpp"
+#include "ecs.hpp"
+
+#define ECS_COMPONENT_TYPES		6		// Bits of the component masks
+#define ECS_ALIGNMENT			32		// Of every array in a chunk (AVX2 loads)
+
+#define TWO_PI 6.28318530717958647692f
+
+// Bytes per entity of each component's array, the transform is 10 float streams
+static const size_t componentSizes[ECS_COMPONENT_TYPES] = {
+	10 * sizeof(float),
+	sizeof(SpinComponent),
+	sizeof(PulseScaleComponent),
+	sizeof(OscillateTranslateComponent),
+	sizeof(PathFollowComponent),
+	sizeof(AnimationClipComponent),
+};
+
+static const char * componentNames[ECS_COMPONENT_TYPES] = { "transform", "spin", "pulse-scale", "oscillate-translate", "path-follow", "animation-clip" };
+
+struct Chunk {
+	int count;
+	int entities[ECS_CHUNK_SIZE];
+	unsigned char * arrays[ECS_COMPONENT_TYPES];	// NULL for the components the archetype doesn't have
+	unsigned char * memory;
+};
+
+struct Archetype {
+	unsigned int components;
+	std::vector<Chunk *> chunks;			// All full but the last
+	int count;
+};
+
+// Where an entity is: element index of its archetype, in chunk index / ECS_CHUNK_SIZE
+struct EntityRecord {
+	int archetype;							// -1 = free id
+	int index;
+};
+
+struct EntityWorld {
+	std::vector<Archetype *> archetypes;
+	std::vector<EntityRecord> entities;
+	std::vector<int> freeEntities;
+	int entityCount;
+	std::vector<EntityChunk> views;			// runEntitySystem's matching chunks
+
+	EntityWorldStats stats;
+};
+
+struct EntityTick {
+	double time;
+	float tickSeconds;
+};
+
+
+
+EntityWorld * createEntityWorld(){
+	EntityWorld * world = new EntityWorld;
+	world->entityCount = 0;
+	memset(&world->stats, 0, sizeof(world->stats));
+	return world;
+}
+
+void deleteEntityWorld(EntityWorld * world){
+	if (world == NULL)
+		return;
+	for (size_t a = 0; a < world->archetypes.size(); a++){
+		for (size_t c = 0; c < world->archetypes[a]->chunks.size(); c++){
+			free(world->archetypes[a]->chunks[c]->memory);
+			delete world->archetypes[a]->chunks[c];
+		}
+		delete world->archetypes[a];
+	}
+	delete world;
+}
+
+static int findArchetype(EntityWorld * world, unsigned int components){
+	for (size_t a = 0; a < world->archetypes.size(); a++){
+		if (world->archetypes[a]->components == components)
+			return (int)a;
+	}
+	Archetype * archetype = new Archetype;
+	archetype->components = components;
+	archetype->count = 0;
+	world->archetypes.push_back(archetype);
+	return (int)world->archetypes.size() - 1;
+}
+
+// One allocation holding an aligned array per component of the archetype
+static Chunk * createChunk(unsigned int components){
+	Chunk * chunk = new Chunk;
+	chunk->count = 0;
+	size_t bytes = ECS_ALIGNMENT;
+	for (int c = 0; c < ECS_COMPONENT_TYPES; c++){
+		if (components & (1u << c))
+			bytes += (componentSizes[c] * ECS_CHUNK_SIZE + ECS_ALIGNMENT - 1) & ~(size_t)(ECS_ALIGNMENT - 1);
+	}
+	chunk->memory = (unsigned char *)malloc(bytes);
+	unsigned char * next = (unsigned char *)(((size_t)chunk->memory + ECS_ALIGNMENT - 1) & ~(size_t)(ECS_ALIGNMENT - 1));
+	for (int c = 0; c < ECS_COMPONENT_TYPES; c++){
+		chunk->arrays[c] = NULL;
+		if (components & (1u << c)){
+			chunk->arrays[c] = next;
+			next += (componentSizes[c] * ECS_CHUNK_SIZE + ECS_ALIGNMENT - 1) & ~(size_t)(ECS_ALIGNMENT - 1);
+		}
+	}
+	return chunk;
+}
+
+// Transform stream s of a chunk (px py pz qx qy qz qw sx sy sz)
+static float * transformStream(const Chunk * chunk, int s){
+	return (float *)chunk->arrays[0] + s * ECS_CHUNK_SIZE;
+}
+
+static TransformStreams chunkTransformStreams(const Chunk * chunk){
+	TransformStreams streams;
+	memset(&streams, 0, sizeof(streams));
+	if (chunk->arrays[0] == NULL)
+		return streams;
+	float ** components[10] = { &streams.px, &streams.py, &streams.pz, &streams.qx, &streams.qy, &streams.qz, &streams.qw, &streams.sx, &streams.sy, &streams.sz };
+	for (int s = 0; s < 10; s++)
+		*components[s] = transformStream(chunk, s);
+	return streams;
+}
+
+static void readTransform(const Chunk * chunk, int row, float values[10]){
+	for (int s = 0; s < 10; s++)
+		values[s] = transformStream(chunk, s)[row];
+}
+
+static void writeTransform(Chunk * chunk, int row, const float values[10]){
+	for (int s = 0; s < 10; s++)
+		transformStream(chunk, s)[row] = values[s];
+}
+
+// Copy the components both chunks have from one row to the other
+static void copyRow(Chunk * destination, int destinationRow, const Chunk * source, int sourceRow){
+	for (int c = 0; c < ECS_COMPONENT_TYPES; c++){
+		if (destination->arrays[c] == NULL || source->arrays[c] == NULL)
+			continue;
+		if (c == 0){
+			float values[10];
+			readTransform(source, sourceRow, values);
+			writeTransform(destination, destinationRow, values);
+		} else {
+			memcpy(destination->arrays[c] + destinationRow * componentSizes[c], source->arrays[c] + sourceRow * componentSizes[c], componentSizes[c]);
+		}
+	}
+}
+
+// Add the entity at the end of the archetype, components zero and the transform identity
+static int appendEntity(EntityWorld * world, int archetypeIndex, int entity){
+	Archetype * archetype = world->archetypes[archetypeIndex];
+	int index = archetype->count;
+	if (index / ECS_CHUNK_SIZE == (int)archetype->chunks.size())
+		archetype->chunks.push_back(createChunk(archetype->components));
+	Chunk * chunk = archetype->chunks[index / ECS_CHUNK_SIZE];
+	int row = index % ECS_CHUNK_SIZE;
+	chunk->entities[row] = entity;
+	chunk->count++;
+	archetype->count++;
+
+	for (int c = 1; c < ECS_COMPONENT_TYPES; c++){
+		if (chunk->arrays[c])
+			memset(chunk->arrays[c] + row * componentSizes[c], 0, componentSizes[c]);
+	}
+	if (chunk->arrays[0]){
+		const float identity[10] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+		writeTransform(chunk, row, identity);
+	}
+
+	world->entities[entity].archetype = archetypeIndex;
+	world->entities[entity].index = index;
+	return index;
+}
+
+// Fill the entity's row with the archetype's last entity, so the chunks stay packed
+static void removeFromArchetype(EntityWorld * world, int archetypeIndex, int index){
+	Archetype * archetype = world->archetypes[archetypeIndex];
+	int last = archetype->count - 1;
+	Chunk * chunk = archetype->chunks[index / ECS_CHUNK_SIZE];
+	Chunk * lastChunk = archetype->chunks[last / ECS_CHUNK_SIZE];
+	if (index != last){
+		int moved = lastChunk->entities[last % ECS_CHUNK_SIZE];
+		copyRow(chunk, index % ECS_CHUNK_SIZE, lastChunk, last % ECS_CHUNK_SIZE);
+		chunk->entities[index % ECS_CHUNK_SIZE] = moved;
+		world->entities[moved].index = index;
+	}
+	lastChunk->count--;
+	archetype->count--;
+	if (lastChunk->count == 0){
+		free(lastChunk->memory);
+		delete lastChunk;
+		archetype->chunks.pop_back();
+	}
+}
+
+static bool isEntity(EntityWorld * world, int entity){
+	return entity >= 0 && entity < (int)world->entities.size() && world->entities[entity].archetype >= 0;
+}
+
+int createEntity(EntityWorld * world, unsigned int components){
+	int entity;
+	if (!world->freeEntities.empty()){
+		entity = world->freeEntities.back();
+		world->freeEntities.pop_back();
+	} else {
+		entity = (int)world->entities.size();
+		EntityRecord record = { -1, 0 };
+		world->entities.push_back(record);
+	}
+	appendEntity(world, findArchetype(world, components), entity);
+	world->entityCount++;
+	return entity;
+}
+
+void destroyEntity(EntityWorld * world, int entity){
+	if (!isEntity(world, entity)){
+		printf("[WARNING] Entity %d doesn't exist, not destroyed.\n", entity);
+		return;
+	}
+	EntityRecord & record = world->entities[entity];
+	removeFromArchetype(world, record.archetype, record.index);
+	record.archetype = -1;
+	world->freeEntities.push_back(entity);
+	world->entityCount--;
+}
+
+int getEntityCount(EntityWorld * world){
+	return world->entityCount;
+}
+
+static void moveEntity(EntityWorld * world, int entity, unsigned int components){
+	EntityRecord record = world->entities[entity];
+	Archetype * source = world->archetypes[record.archetype];
+	if (source->components == components)
+		return;
+	int destinationArchetype = findArchetype(world, components);
+	int index = appendEntity(world, destinationArchetype, entity);
+	Archetype * destination = world->archetypes[destinationArchetype];
+	copyRow(destination->chunks[index / ECS_CHUNK_SIZE], index % ECS_CHUNK_SIZE, source->chunks[record.index / ECS_CHUNK_SIZE], record.index % ECS_CHUNK_SIZE);
+	removeFromArchetype(world, record.archetype, record.index);
+}
+
+void addComponents(EntityWorld * world, int entity, unsigned int components){
+	if (!isEntity(world, entity)){
+		printf("[WARNING] Entity %d doesn't exist, no components added.\n", entity);
+		return;
+	}
+	moveEntity(world, entity, getComponents(world, entity) | components);
+}
+
+void removeComponents(EntityWorld * world, int entity, unsigned int components){
+	if (!isEntity(world, entity)){
+		printf("[WARNING] Entity %d doesn't exist, no components removed.\n", entity);
+		return;
+	}
+	moveEntity(world, entity, getComponents(world, entity) & ~components);
+}
+
+unsigned int getComponents(EntityWorld * world, int entity){
+	if (!isEntity(world, entity))
+		return 0;
+	return world->archetypes[world->entities[entity].archetype]->components;
+}
+
+// The entity's chunk and row if it has the component (index into componentSizes), NULL otherwise
+static Chunk * findComponent(EntityWorld * world, int entity, int component, int & row){
+	if (!isEntity(world, entity)){
+		printf("[WARNING] Entity %d doesn't exist.\n", entity);
+		return NULL;
+	}
+	const EntityRecord & record = world->entities[entity];
+	Chunk * chunk = world->archetypes[record.archetype]->chunks[record.index / ECS_CHUNK_SIZE];
+	if (chunk->arrays[component] == NULL){
+		printf("[WARNING] Entity %d has no %s component.\n", entity, componentNames[component]);
+		return NULL;
+	}
+	row = record.index % ECS_CHUNK_SIZE;
+	return chunk;
+}
+
+static void getComponent(EntityWorld * world, int entity, int component, void * value){
+	int row;
+	Chunk * chunk = findComponent(world, entity, component, row);
+	if (chunk)
+		memcpy(value, chunk->arrays[component] + row * componentSizes[component], componentSizes[component]);
+	else
+		memset(value, 0, componentSizes[component]);
+}
+
+static void setComponent(EntityWorld * world, int entity, int component, const void * value){
+	int row;
+	Chunk * chunk = findComponent(world, entity, component, row);
+	if (chunk)
+		memcpy(chunk->arrays[component] + row * componentSizes[component], value, componentSizes[component]);
+}
+
+TransformComponent getTransform(EntityWorld * world, int entity){
+	TransformComponent transform;
+	float values[10] = { 0.0f };
+	int row;
+	Chunk * chunk = findComponent(world, entity, 0, row);
+	if (chunk)
+		readTransform(chunk, row, values);
+	transform.position = glm::vec3(values[0], values[1], values[2]);
+	transform.orientation = glm::quat(values[6], values[3], values[4], values[5]);
+	transform.scale = glm::vec3(values[7], values[8], values[9]);
+	return transform;
+}
+
+void setTransform(EntityWorld * world, int entity, const TransformComponent & transform){
+	int row;
+	Chunk * chunk = findComponent(world, entity, 0, row);
+	if (chunk == NULL)
+		return;
+	const glm::vec3 & p = transform.position;
+	const glm::quat & q = transform.orientation;
+	const glm::vec3 & s = transform.scale;
+	float values[10] = { p.x, p.y, p.z, q.x, q.y, q.z, q.w, s.x, s.y, s.z };
+	writeTransform(chunk, row, values);
+}
+
+SpinComponent getSpin(EntityWorld * world, int entity){
+	SpinComponent spin;
+	getComponent(world, entity, 1, &spin);
+	return spin;
+}
+
+void setSpin(EntityWorld * world, int entity, const SpinComponent & spin){
+	setComponent(world, entity, 1, &spin);
+}
+
+PulseScaleComponent getPulseScale(EntityWorld * world, int entity){
+	PulseScaleComponent pulseScale;
+	getComponent(world, entity, 2, &pulseScale);
+	return pulseScale;
+}
+
+void setPulseScale(EntityWorld * world, int entity, const PulseScaleComponent & pulseScale){
+	setComponent(world, entity, 2, &pulseScale);
+}
+
+OscillateTranslateComponent getOscillateTranslate(EntityWorld * world, int entity){
+	OscillateTranslateComponent oscillateTranslate;
+	getComponent(world, entity, 3, &oscillateTranslate);
+	return oscillateTranslate;
+}
+
+void setOscillateTranslate(EntityWorld * world, int entity, const OscillateTranslateComponent & oscillateTranslate){
+	setComponent(world, entity, 3, &oscillateTranslate);
+}
+
+PathFollowComponent getPathFollow(EntityWorld * world, int entity){
+	PathFollowComponent pathFollow;
+	getComponent(world, entity, 4, &pathFollow);
+	return pathFollow;
+}
+
+void setPathFollow(EntityWorld * world, int entity, const PathFollowComponent & pathFollow){
+	setComponent(world, entity, 4, &pathFollow);
+}
+
+AnimationClipComponent getAnimationClip(EntityWorld * world, int entity){
+	AnimationClipComponent animationClip;
+	getComponent(world, entity, 5, &animationClip);
+	return animationClip;
+}
+
+void setAnimationClip(EntityWorld * world, int entity, const AnimationClipComponent & animationClip){
+	setComponent(world, entity, 5, &animationClip);
+}
+
+void runEntitySystem(EntityWorld * world, unsigned int components, EntitySystem system, void * data){
+	// Views of the matching chunks, numbered in visiting order
+	std::vector<EntityChunk> & views = world->views;
+	views.clear();
+	int first = 0;
+	for (size_t a = 0; a < world->archetypes.size(); a++){
+		Archetype * archetype = world->archetypes[a];
+		if ((archetype->components & components) != components)
+			continue;
+		for (size_t c = 0; c < archetype->chunks.size(); c++){
+			Chunk * chunk = archetype->chunks[c];
+			EntityChunk view;
+			view.count = chunk->count;
+			view.first = first;
+			view.entities = chunk->entities;
+			view.components = archetype->components;
+			view.transforms = chunkTransformStreams(chunk);
+			view.spins = (SpinComponent *)chunk->arrays[1];
+			view.pulseScales = (PulseScaleComponent *)chunk->arrays[2];
+			view.oscillateTranslates = (OscillateTranslateComponent *)chunk->arrays[3];
+			view.pathFollows = (PathFollowComponent *)chunk->arrays[4];
+			view.animationClips = (AnimationClipComponent *)chunk->arrays[5];
+			views.push_back(view);
+			first += chunk->count;
+		}
+	}
+	if (views.empty())
+		return;
+
+	parallelFor((int)views.size(), 1, [&](int begin, int end){
+		for (int i = begin; i < end; i++)
+			system(views[i], data);
+	});
+}
+
+// Every animation of one chunk in a row, each a tight loop over its arrays
+static void animateChunk(const EntityChunk & chunk, void * data){
+	const EntityTick & tick = *(const EntityTick *)data;
+	const TransformStreams & t = chunk.transforms;
+	bool transforms = (chunk.components & COMPONENT_TRANSFORM) != 0;
+
+	if (chunk.spins){
+		SpinComponent * spins = chunk.spins;
+		for (int i = 0; i < chunk.count; i++){
+			float angle = spins[i].angle + spins[i].speed * tick.tickSeconds;
+			if (angle >= TWO_PI)
+				angle -= TWO_PI;
+			else if (angle < 0.0f)
+				angle += TWO_PI;
+			spins[i].angle = angle;
+		}
+		if (transforms){
+			for (int i = 0; i < chunk.count; i++){
+				float s = sinf(spins[i].angle * 0.5f);
+				t.qx[i] = spins[i].axis.x * s;
+				t.qy[i] = spins[i].axis.y * s;
+				t.qz[i] = spins[i].axis.z * s;
+				t.qw[i] = cosf(spins[i].angle * 0.5f);
+			}
+		}
+	}
+
+	if (chunk.pulseScales && transforms){
+		const PulseScaleComponent * pulses = chunk.pulseScales;
+		for (int i = 0; i < chunk.count; i++){
+			float scale = fabsf(sinf((float)(pulses[i].speed * tick.time + pulses[i].phase)));
+			t.sx[i] = scale;
+			t.sy[i] = scale;
+			t.sz[i] = scale;
+		}
+	}
+
+	if (chunk.oscillateTranslates && transforms){
+		const OscillateTranslateComponent * oscillations = chunk.oscillateTranslates;
+		for (int i = 0; i < chunk.count; i++){
+			float wave = sinf((float)(oscillations[i].speed * tick.time + oscillations[i].phase));
+			t.px[i] = oscillations[i].origin.x + oscillations[i].amplitude.x * wave;
+			t.py[i] = oscillations[i].origin.y + oscillations[i].amplitude.y * wave;
+			t.pz[i] = oscillations[i].origin.z + oscillations[i].amplitude.z * wave;
+		}
+	}
+
+	// Runs of followers on the same path: advance them, then place the whole run in one batch
+	if (chunk.pathFollows && transforms){
+		PathFollowComponent * followers = chunk.pathFollows;
+		float distances[ECS_CHUNK_SIZE];
+		for (int i = 0; i < chunk.count; ){
+			int first = i;
+			const SplinePath * path = followers[i].path;
+			while (i < chunk.count && followers[i].path == path)
+				i++;
+			if (path == NULL)
+				continue;
+			float period = isSplinePathClosed(path) ? getSplinePathLength(path) : 2.0f * getSplinePathLength(path);
+			for (int j = first; j < i; j++){
+				float distance = followers[j].distance + followers[j].speed * tick.tickSeconds;
+				if (period > 0.0f){
+					distance = fmodf(distance, period);
+					if (distance < 0.0f)
+						distance += period;
+				}
+				followers[j].distance = distance;
+				distances[j] = distance;
+			}
+			evaluateSplinePathBatch(path, distances + first, i - first, t.px + first, t.py + first, t.pz + first, NULL, NULL, NULL);
+		}
+	}
+
+	// Advance every clip player, then sample the whole chunk's tracks in one batch
+	if (chunk.animationClips && transforms){
+		AnimationClipComponent * players = chunk.animationClips;
+		AnimationSample samples[ECS_CHUNK_SIZE];
+		for (int i = 0; i < chunk.count; i++){
+			float time = players[i].time + players[i].speed * tick.tickSeconds;
+			float duration = players[i].clip ? getAnimationClipDuration(players[i].clip) : 0.0f;
+			if (duration > 0.0f){
+				time = fmodf(time, duration);
+				if (time < 0.0f)
+					time += duration;
+			}
+			players[i].time = time;
+			samples[i].clip = players[i].clip;
+			samples[i].track = players[i].track;
+			samples[i].time = time;
+		}
+		sampleAnimationClips(samples, chunk.count, t);
+	}
+}
+
+void updateEntities(EntityWorld * world, double time, double tickSeconds){
+	double start = getTime();
+	EntityTick tick = { time, (float)tickSeconds };
+	runEntitySystem(world, 0, animateChunk, &tick);
+
+	int archetypes = 0, chunks = 0;
+	for (size_t a = 0; a < world->archetypes.size(); a++){
+		archetypes += world->archetypes[a]->count > 0 ? 1 : 0;
+		chunks += (int)world->archetypes[a]->chunks.size();
+	}
+	world->stats.entities = world->entityCount;
+	world->stats.archetypes = archetypes;
+	world->stats.chunks = chunks;
+	world->stats.milliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+EntityWorldStats getEntityWorldStats(EntityWorld * world){
+	return world->stats;
+}
+
+// The per-object layout the scene used: every animation's parameters and a flag for each, one object after another
+struct BenchmarkObject {
+	bool rotating, scaling, translating, following;
+	SpinComponent spin;
+	PulseScaleComponent pulseScale;
+	OscillateTranslateComponent oscillateTranslate;
+	PathFollowComponent pathFollow;
+	TransformComponent transform;
+};
+
+static void animateObject(BenchmarkObject & object, double time, float tickSeconds){
+	if (object.rotating){
+		object.spin.angle += object.spin.speed * tickSeconds;
+		if (object.spin.angle >= TWO_PI)
+			object.spin.angle -= TWO_PI;
+		object.transform.orientation = glm::angleAxis(object.spin.angle, object.spin.axis);
+	}
+	if (object.scaling)
+		object.transform.scale = glm::vec3(fabsf(sinf((float)(object.pulseScale.speed * time + object.pulseScale.phase))));
+	if (object.translating){
+		const OscillateTranslateComponent & o = object.oscillateTranslate;
+		object.transform.position = o.origin + o.amplitude * sinf((float)(o.speed * time + o.phase));
+	}
+	if (object.following){
+		PathFollowComponent & follow = object.pathFollow;
+		float period = isSplinePathClosed(follow.path) ? getSplinePathLength(follow.path) : 2.0f * getSplinePathLength(follow.path);
+		follow.distance = fmodf(follow.distance + follow.speed * tickSeconds, period);
+		glm::vec3 tangent;
+		evaluateSplinePath(follow.path, follow.distance, object.transform.position, tangent);
+	}
+}
+
+struct BenchmarkCompose {
+	std::vector<glm::mat4> * world;
+};
+
+static void composeChunk(const EntityChunk & chunk, void * data){
+	std::vector<glm::mat4> & world = *((BenchmarkCompose *)data)->world;
+	composeTransforms(chunk.transforms, chunk.count, NULL, NULL, &world[chunk.first], NULL);
+}
+
+void benchmarkEntities(int entities, int iterations){
+	if (entities <= 0 || iterations <= 0)
+		return;
+
+	// The scene's five objects over and over (static, spinning, pulsing, oscillating, spinning along a path), out of phase
+	EntityWorld * world = createEntityWorld();
+	std::vector<BenchmarkObject> objects(entities);
+	const glm::vec3 route[4] = { glm::vec3(0.0f), glm::vec3(4.0f, 4.0f, -2.0f), glm::vec3(1.0f, 2.5f, -4.0f), glm::vec3(4.0f, -1.0f, -2.0f) };
+	SplinePath * path = createBezierPath(route, 4, false);
+	const unsigned int kinds[5] = {
+		COMPONENT_TRANSFORM,
+		COMPONENT_TRANSFORM | COMPONENT_SPIN,
+		COMPONENT_TRANSFORM | COMPONENT_PULSE_SCALE,
+		COMPONENT_TRANSFORM | COMPONENT_OSCILLATE_TRANSLATE,
+		COMPONENT_TRANSFORM | COMPONENT_SPIN | COMPONENT_PATH_FOLLOW,
+	};
+	for (int i = 0; i < entities; i++){
+		float phase = (float)(i % 97) * 0.25f;
+		glm::vec3 position((float)(i % 1000), (float)(i / 1000), 0.0f);
+		BenchmarkObject & object = objects[i];
+		unsigned int components = kinds[i % 5];
+		object.rotating = (components & COMPONENT_SPIN) != 0;
+		object.scaling = (components & COMPONENT_PULSE_SCALE) != 0;
+		object.translating = (components & COMPONENT_OSCILLATE_TRANSLATE) != 0;
+		object.following = (components & COMPONENT_PATH_FOLLOW) != 0;
+		SpinComponent spin = { glm::vec3(0.0f, 1.0f, 0.0f), 1.5f, fmodf(phase, TWO_PI) };
+		PulseScaleComponent pulseScale = { 0.3f, phase };
+		OscillateTranslateComponent oscillateTranslate = { position, glm::vec3(1.0f, 0.0f, 0.0f), 0.3f, phase };
+		PathFollowComponent pathFollow = { path, 0.5f, phase };
+		object.spin = spin;
+		object.pulseScale = pulseScale;
+		object.oscillateTranslate = oscillateTranslate;
+		object.pathFollow = pathFollow;
+		object.transform.position = position;
+		object.transform.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		object.transform.scale = glm::vec3(1.0f);
+
+		int entity = createEntity(world, components);
+		setTransform(world, entity, object.transform);
+		if (object.rotating)
+			setSpin(world, entity, spin);
+		if (object.scaling)
+			setPulseScale(world, entity, pulseScale);
+		if (object.translating)
+			setOscillateTranslate(world, entity, oscillateTranslate);
+		if (object.following)
+			setPathFollow(world, entity, pathFollow);
+	}
+
+	const double tickSeconds = 1.0 / 60.0;
+	double start = getTime();
+	for (int it = 0; it < iterations; it++)
+		updateEntities(world, it * tickSeconds, tickSeconds);
+	double entitySeconds = getTime() - start;
+
+	start = getTime();
+	for (int it = 0; it < iterations; it++){
+		for (int i = 0; i < entities; i++)
+			animateObject(objects[i], it * tickSeconds, (float)tickSeconds);
+	}
+	double objectSeconds = getTime() - start;
+
+	// World matrices straight from the chunks' transform streams
+	std::vector<glm::mat4> matrices(entities);
+	BenchmarkCompose compose = { &matrices };
+	start = getTime();
+	for (int it = 0; it < iterations; it++)
+		runEntitySystem(world, COMPONENT_TRANSFORM, composeChunk, &compose);
+	double composeSeconds = getTime() - start;
+
+	// Both must end up with the same transforms (entity i is object i: nothing was destroyed)
+	float error = 0.0f;
+	for (int i = 0; i < entities; i++){
+		TransformComponent transform = getTransform(world, i);
+		glm::vec3 position = glm::abs(transform.position - objects[i].transform.position);
+		glm::vec3 scale = glm::abs(transform.scale - objects[i].transform.scale);
+		float orientation = 1.0f - fabsf(glm::dot(transform.orientation, objects[i].transform.orientation));
+		error = glm::max(error, glm::max(glm::max(position.x, position.y), position.z));
+		error = glm::max(error, glm::max(glm::max(scale.x, scale.y), scale.z));
+		error = glm::max(error, orientation);
+	}
+
+	EntityWorldStats stats = getEntityWorldStats(world);
+	double updates = (double)entities * iterations;
+	printf("[DEBUG] Entities (%d, %d archetypes, %d chunks, %u threads): update %.3f ms (%.1f M/s), per-object loop %.3f ms (%.1f M/s), world matrices %.3f ms%s\n",
+		entities, stats.archetypes, stats.chunks, getJobThreadCount(), entitySeconds * 1000.0 / iterations, updates / entitySeconds / 1e6,
+		objectSeconds * 1000.0 / iterations, updates / objectSeconds / 1e6, composeSeconds * 1000.0 / iterations, error < 1e-3f ? "" : " (MISMATCH)");
+	deleteEntityWorld(world);
+	deleteSplinePath(path);
+}
@@ -0,0 +1,139 @@
+#ifndef ECS_HPP
+#define ECS_HPP
+
+// Entity-component storage: an entity is an id plus a set of components, and every entity with the same set (its
+// archetype) lives in the same chunks of ECS_CHUNK_SIZE entities. A chunk holds one packed array per component of
+// its archetype (transforms as structure of arrays, see transforms.hpp) with no gaps: removing an entity moves the
+// archetype's last one into its place, adding or removing components moves the entity to the other archetype.
+// Systems run over the chunks of every archetype that has the components they need, in parallel on the job system
+// (one chunk per job), and only ever touch the arrays they read and write.
+//
+// Entities are created, changed and destroyed outside of systems, from one thread at a time. Systems see whole
+// chunks: they may change components in place, not add or remove entities or components.
+
+#define ECS_CHUNK_SIZE 1024		// Entities per chunk (a multiple of 8, the SIMD transform kernels' width)
+
+enum {
+	COMPONENT_TRANSFORM				= 1 << 0,
+	COMPONENT_SPIN					= 1 << 1,
+	COMPONENT_PULSE_SCALE			= 1 << 2,
+	COMPONENT_OSCILLATE_TRANSLATE	= 1 << 3,
+	COMPONENT_PATH_FOLLOW			= 1 << 4,
+	COMPONENT_ANIMATION_CLIP		= 1 << 5,
+};
+
+// translate(position) * rotate(orientation) * scale(scale), what the animation systems write
+struct TransformComponent {
+	glm::vec3 position;
+	glm::quat orientation;
+	glm::vec3 scale;
+};
+
+// orientation = angleAxis(angle, axis), angle advances by speed (radians per second) every update and wraps at 2 pi
+struct SpinComponent {
+	glm::vec3 axis;				// Unit length
+	float speed;
+	float angle;
+};
+
+// scale = |sin(speed * time + phase)| on every axis
+struct PulseScaleComponent {
+	float speed;
+	float phase;
+};
+
+// position = origin + amplitude * sin(speed * time + phase)
+struct OscillateTranslateComponent {
+	glm::vec3 origin;
+	glm::vec3 amplitude;
+	float speed;
+	float phase;
+};
+
+// position = point distance along path (splinepath.hpp), distance advances by speed (units per second) every update:
+// round a closed path, back and forth along an open one. Followers of the same path next to each other in a chunk
+// are placed in one batch.
+struct PathFollowComponent {
+	const SplinePath * path;
+	float speed;
+	float distance;
+};
+
+// position, orientation and scale = track of clip (animationclip.hpp) at time, which advances by speed (clip seconds
+// per second) every update and loops. A chunk's players are sampled in one batch.
+struct AnimationClipComponent {
+	const AnimationClip * clip;
+	int track;
+	float speed;
+	float time;
+};
+
+// One chunk's packed arrays as a system sees them: element i of each is entities[i]'s, components the chunk's
+// archetype doesn't have are NULL
+struct EntityChunk {
+	int count;
+	int first;					// Entities of the chunks visited before this one (where its entities go in a packed output)
+	const int * entities;
+	unsigned int components;
+	TransformStreams transforms;
+	SpinComponent * spins;
+	PulseScaleComponent * pulseScales;
+	OscillateTranslateComponent * oscillateTranslates;
+	PathFollowComponent * pathFollows;
+	AnimationClipComponent * animationClips;
+};
+
+typedef void (*EntitySystem)(const EntityChunk & chunk, void * data);
+
+// Last updateEntities
+struct EntityWorldStats {
+	int entities;
+	int archetypes;				// With at least one entity
+	int chunks;
+	float milliseconds;
+};
+
+struct EntityWorld;
+
+EntityWorld * createEntityWorld();
+void deleteEntityWorld(EntityWorld * world);
+
+// Returns the entity's id, components are zero except the transform (identity). Ids of destroyed entities are reused.
+int createEntity(EntityWorld * world, unsigned int components);
+void destroyEntity(EntityWorld * world, int entity);
+int getEntityCount(EntityWorld * world);
+
+// Move the entity to the archetype with these components added or removed (the ones it keeps keep their values)
+void addComponents(EntityWorld * world, int entity, unsigned int components);
+void removeComponents(EntityWorld * world, int entity, unsigned int components);
+unsigned int getComponents(EntityWorld * world, int entity);
+
+// Entities without the component are left alone (set) or read as zero (get), with a warning
+TransformComponent getTransform(EntityWorld * world, int entity);
+void setTransform(EntityWorld * world, int entity, const TransformComponent & transform);
+SpinComponent getSpin(EntityWorld * world, int entity);
+void setSpin(EntityWorld * world, int entity, const SpinComponent & spin);
+PulseScaleComponent getPulseScale(EntityWorld * world, int entity);
+void setPulseScale(EntityWorld * world, int entity, const PulseScaleComponent & pulseScale);
+OscillateTranslateComponent getOscillateTranslate(EntityWorld * world, int entity);
+void setOscillateTranslate(EntityWorld * world, int entity, const OscillateTranslateComponent & oscillateTranslate);
+PathFollowComponent getPathFollow(EntityWorld * world, int entity);
+void setPathFollow(EntityWorld * world, int entity, const PathFollowComponent & pathFollow);
+AnimationClipComponent getAnimationClip(EntityWorld * world, int entity);
+void setAnimationClip(EntityWorld * world, int entity, const AnimationClipComponent & animationClip);
+
+// Run system over every chunk whose archetype has all of components, chunks in parallel, and wait for it. Run from
+// the main thread or a job to be parallel (elsewhere, like the simulation thread, the chunks run one after another).
+void runEntitySystem(EntityWorld * world, unsigned int components, EntitySystem system, void * data);
+
+// The animation systems (spin, then pulse-scale, oscillate-translate, path-follow and animation clips), writing the transforms of
+// the entities that have one: advance by tickSeconds to time (seconds)
+void updateEntities(EntityWorld * world, double time, double tickSeconds);
+
+EntityWorldStats getEntityWorldStats(EntityWorld * world);
+
+// Print updateEntities' time and entities per second for a mix of the scene's animations, against one object at a
+// time with a branch per animation, and the cost of composing the updated transforms into world matrices
+void benchmarkEntities(int entities, int iterations);
+
+#endif
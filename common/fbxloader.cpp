@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "imageloader.hpp"
+#include "profiler.hpp"
+#include "fbxloader.hpp"
+
+static const char FBX_MAGIC[] = "Kaydara FBX Binary  ";		// Then 0x1A 0x00, the version (uint32 LE) at byte 23
+static const size_t FBX_MAX_ARRAY_BYTES = 256 << 20;		// Per array property, once inflated
+static const int FBX_MAX_DEPTH = 64;						// Nested records (real files stay under 10)
+
+struct FBXReader {
+	const unsigned char * data;
+	size_t size;
+	bool wide;					// Version 7500 and up: 64 bit record offsets
+};
+
+
+
+static bool readFile(const char * path, std::vector<unsigned char> & out){
+	FILE * file = fopen(path, "rb");
+	if (!file){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", path);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	out.resize(size > 0 ? size : 0);
+	size_t read = size > 0 ? fread(&out[0], 1, size, file) : 0;
+	fclose(file);
+	return read == out.size() && !out.empty();
+}
+
+static unsigned long long readLE(const unsigned char * p, int bytes){
+	unsigned long long value = 0;
+	for (int i = bytes - 1; i >= 0; i--)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+static double readFloat(const unsigned char * p){
+	float value;
+	memcpy(&value, p, 4);
+	return value;
+}
+
+static double readDouble(const unsigned char * p){
+	double value;
+	memcpy(&value, p, 8);
+	return value;
+}
+
+// An array property: count elements of elementSize bytes, possibly deflated
+static bool readArray(const FBXReader & reader, size_t & offset, char type, FBXProperty & property){
+	if (offset + 12 > reader.size)
+		return false;
+	size_t count = (size_t)readLE(reader.data + offset, 4);
+	unsigned int encoding = (unsigned int)readLE(reader.data + offset + 4, 4);
+	size_t stored = (size_t)readLE(reader.data + offset + 8, 4);
+	offset += 12;
+	if (offset + stored > reader.size)
+		return false;
+
+	size_t elementSize = type == 'd' || type == 'l' ? 8 : type == 'b' ? 1 : 4;
+	if (count > FBX_MAX_ARRAY_BYTES / elementSize)
+		return false;
+	std::vector<unsigned char> inflated;
+	const unsigned char * elements = reader.data + offset;
+	if (encoding == 1){
+		inflated.resize(count * elementSize);
+		size_t written = 0;
+		if (count > 0 && (!zlibInflate(elements, stored, &inflated[0], inflated.size(), written) || written != inflated.size()))
+			return false;
+		elements = inflated.empty() ? NULL : &inflated[0];
+	} else if (stored != count * elementSize){
+		return false;
+	}
+	offset += stored;
+
+	if (type == 'f' || type == 'd'){
+		property.numbers.resize(count);
+		for (size_t i = 0; i < count; i++)
+			property.numbers[i] = type == 'f' ? readFloat(elements + i * 4) : readDouble(elements + i * 8);
+	} else {
+		property.integers.resize(count);
+		for (size_t i = 0; i < count; i++){
+			unsigned long long value = readLE(elements + i * elementSize, (int)elementSize);
+			property.integers[i] = type == 'l' ? (long long)value : type == 'i' ? (long long)(int)(unsigned int)value : (long long)value;
+		}
+	}
+	return true;
+}
+
+static bool readProperty(const FBXReader & reader, size_t & offset, FBXProperty & property){
+	if (offset >= reader.size)
+		return false;
+	property.type = (char)reader.data[offset++];
+	property.integer = 0;
+	property.number = 0.0;
+	size_t sizes[128] = { 0 };
+	sizes['Y'] = 2; sizes['C'] = 1; sizes['I'] = 4; sizes['L'] = 8; sizes['F'] = 4; sizes['D'] = 8;
+	switch (property.type){
+		case 'Y': case 'C': case 'I': case 'L': {
+			size_t size = sizes[(int)property.type];
+			if (offset + size > reader.size)
+				return false;
+			unsigned long long value = readLE(reader.data + offset, (int)size);
+			property.integer = size == 2 ? (long long)(short)value : size == 4 ? (long long)(int)(unsigned int)value : (long long)value;
+			property.number = (double)property.integer;
+			offset += size;
+			return true;
+		}
+		case 'F': case 'D':
+			if (offset + sizes[(int)property.type] > reader.size)
+				return false;
+			property.number = property.type == 'F' ? readFloat(reader.data + offset) : readDouble(reader.data + offset);
+			offset += sizes[(int)property.type];
+			return true;
+		case 'S': case 'R': {
+			if (offset + 4 > reader.size)
+				return false;
+			size_t length = (size_t)readLE(reader.data + offset, 4);
+			offset += 4;
+			if (offset + length > reader.size)
+				return false;
+			property.string.assign((const char *)reader.data + offset, length);
+			offset += length;
+			return true;
+		}
+		case 'f': case 'd': case 'l': case 'i': case 'b':
+			return readArray(reader, offset, property.type, property);
+		default:
+			return false;
+	}
+}
+
+// One node record and its nested ones. False on a malformed record or one nested deeper than FBX_MAX_DEPTH;
+// the null record ending a list sets end.
+static bool readNode(const FBXReader & reader, size_t & offset, FBXNode & node, bool & end, int depth){
+	int fieldSize = reader.wide ? 8 : 4;
+	size_t headerSize = 3 * fieldSize + 1;
+	if (offset + headerSize > reader.size)
+		return false;
+	size_t endOffset = (size_t)readLE(reader.data + offset, fieldSize);
+	size_t propertyCount = (size_t)readLE(reader.data + offset + fieldSize, fieldSize);
+	size_t propertyBytes = (size_t)readLE(reader.data + offset + 2 * fieldSize, fieldSize);
+	size_t nameLength = reader.data[offset + 3 * fieldSize];
+	end = endOffset == 0;
+	if (end){
+		offset += headerSize;
+		return true;
+	}
+	if (endOffset > reader.size || endOffset <= offset || offset + headerSize + nameLength + propertyBytes > endOffset)
+		return false;
+	if (propertyCount > propertyBytes || depth >= FBX_MAX_DEPTH)	// Every property takes at least its type byte
+		return false;
+	offset += headerSize;
+	node.name.assign((const char *)reader.data + offset, nameLength);
+	offset += nameLength;
+
+	size_t propertiesEnd = offset + propertyBytes;
+	node.properties.reserve(propertyCount);
+	for (size_t p = 0; p < propertyCount; p++){
+		node.properties.emplace_back();
+		if (!readProperty(reader, offset, node.properties.back()) || offset > propertiesEnd)
+			return false;
+	}
+	offset = propertiesEnd;
+
+	// Nested records up to the null one (there is none when the node has no children), read in place
+	while (offset < endOffset){
+		node.children.emplace_back();
+		bool childEnd = false;
+		if (!readNode(reader, offset, node.children.back(), childEnd, depth + 1) || childEnd){
+			node.children.pop_back();
+			if (!childEnd)
+				return false;
+			break;
+		}
+	}
+	offset = endOffset;
+	return true;
+}
+
+FBXNode * loadFBX(const char * path){
+	PROFILE_ZONE("loadFBX");
+	std::vector<unsigned char> file;
+	if (!readFile(path, file))
+		return NULL;
+	if (file.size() < 27 || memcmp(&file[0], FBX_MAGIC, 20) != 0){
+		printf("[WARNING] %s is not a binary FBX file (ASCII FBX is not read).\n", path);
+		return NULL;
+	}
+	FBXReader reader = { &file[0], file.size(), readLE(&file[23], 4) >= 7500 };
+
+	FBXNode * root = new FBXNode;
+	size_t offset = 27;
+	while (offset < file.size()){
+		root->children.emplace_back();
+		bool end = false;
+		if (!readNode(reader, offset, root->children.back(), end, 0)){
+			printf("[WARNING] %s: malformed FBX record at byte %u.\n", path, (unsigned int)offset);
+			delete root;
+			return NULL;
+		}
+		if (end){
+			root->children.pop_back();
+			break;
+		}
+	}
+	return root;
+}
+
+void deleteFBX(FBXNode * root){
+	delete root;
+}
+
+const FBXNode * findFBXChild(const FBXNode * node, const char * name){
+	if (node == NULL)
+		return NULL;
+	for (size_t i = 0; i < node->children.size(); i++){
+		if (node->children[i].name == name)
+			return &node->children[i];
+	}
+	return NULL;
+}
+
+void getFBXObjects(const FBXNode * root, std::vector<const FBXNode *> & objects){
+	const FBXNode * list = findFBXChild(root, "Objects");
+	if (list == NULL)
+		return;
+	for (size_t i = 0; i < list->children.size(); i++)
+		objects.push_back(&list->children[i]);
+}
+
+void getFBXConnections(const FBXNode * root, std::vector<FBXConnection> & connections){
+	const FBXNode * list = findFBXChild(root, "Connections");
+	if (list == NULL)
+		return;
+	for (size_t i = 0; i < list->children.size(); i++){
+		const FBXNode & c = list->children[i];
+		if (c.name != "C" || c.properties.size() < 3)
+			continue;
+		FBXConnection connection;
+		connection.child = c.properties[1].integer;
+		connection.parent = c.properties[2].integer;
+		if (c.properties.size() > 3)
+			connection.property = c.properties[3].string;
+		connections.push_back(connection);
+	}
+}
+
+long long getFBXObjectID(const FBXNode * object){
+	return object->properties.empty() ? 0 : object->properties[0].integer;
+}
+
+std::string getFBXObjectName(const FBXNode * object){
+	if (object->properties.size() < 2)
+		return std::string();
+	const std::string & name = object->properties[1].string;
+	return name.substr(0, name.find('\0'));
+}
+
+std::string getFBXObjectClass(const FBXNode * object){
+	return object->properties.size() < 3 ? std::string() : object->properties[2].string;
+}
+
+bool getFBXProperty(const FBXNode * object, const char * name, double * values, int count){
+	const FBXNode * properties = findFBXChild(object, "Properties70");
+	if (properties == NULL)
+		return false;
+	for (size_t i = 0; i < properties->children.size(); i++){
+		const FBXNode & p = properties->children[i];
+		if (p.properties.empty() || p.properties[0].string != name)
+			continue;
+		if ((int)p.properties.size() < 4 + count)
+			return false;
+		for (int v = 0; v < count; v++)
+			values[v] = p.properties[4 + v].number;
+		return true;
+	}
+	return false;
+}
+
+glm::quat getFBXEulerRotation(const double * degrees){
+	return glm::angleAxis((float)glm::radians(degrees[2]), glm::vec3(0.0f, 0.0f, 1.0f))
+		* glm::angleAxis((float)glm::radians(degrees[1]), glm::vec3(0.0f, 1.0f, 0.0f))
+		* glm::angleAxis((float)glm::radians(degrees[0]), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+void getFBXLocalTransform(const FBXNode * model, glm::vec3 & translation, glm::quat & rotation, glm::vec3 & scale){
+	double t[3] = { 0.0, 0.0, 0.0 }, r[3] = { 0.0, 0.0, 0.0 }, s[3] = { 1.0, 1.0, 1.0 };
+	double pre[3] = { 0.0, 0.0, 0.0 }, post[3] = { 0.0, 0.0, 0.0 };
+	getFBXProperty(model, "Lcl Translation", t, 3);
+	getFBXProperty(model, "Lcl Rotation", r, 3);
+	getFBXProperty(model, "Lcl Scaling", s, 3);
+	getFBXProperty(model, "PreRotation", pre, 3);
+	getFBXProperty(model, "PostRotation", post, 3);
+	translation = glm::vec3((float)t[0], (float)t[1], (float)t[2]);
+	rotation = glm::normalize(getFBXEulerRotation(pre) * getFBXEulerRotation(r) * glm::inverse(getFBXEulerRotation(post)));
+	scale = glm::vec3((float)s[0], (float)s[1], (float)s[2]);
+}
@@ -0,0 +1,62 @@
+#ifndef FBXLOADER_HPP
+#define FBXLOADER_HPP
+
+// Binary FBX reader (version 7.x, what the FBX SDK and Blender write): the file's node tree as it is, compressed
+// arrays inflated with imageloader.hpp's zlibInflate, and the lookups the importers share: objects by id, the
+// connections between them and Properties70 values. ASCII FBX files are not read.
+//
+// Scene objects are the children of the top-level "Objects" node: property 0 is the id, property 1 "Name\0\1Class",
+// property 2 the subclass ("Mesh", "LimbNode", ...). "Connections" links them, child to parent: "OO" for an object
+// under another, "OP" for an object driving one of the parent's properties (an animation curve node and "Lcl Rotation").
+
+#define FBX_TIME_SECOND 46186158000LL		// FBX time units (KTime) per second
+
+// One property of a node. Numbers are widened: integers (Y C I L) are in integer and number, reals (F D) in number,
+// strings and raw bytes (S R) in string, integer arrays (b i l) in integers and real arrays (f d) in numbers.
+struct FBXProperty {
+	char type;
+	long long integer;
+	double number;
+	std::string string;
+	std::vector<long long> integers;
+	std::vector<double> numbers;
+};
+
+struct FBXNode {
+	std::string name;
+	std::vector<FBXProperty> properties;
+	std::vector<FBXNode> children;
+};
+
+struct FBXConnection {
+	long long child;
+	long long parent;			// 0 = the scene root
+	std::string property;		// Empty for OO connections
+};
+
+// The file's top-level nodes are the children of the returned root, NULL if it can't be read
+FBXNode * loadFBX(const char * path);
+void deleteFBX(FBXNode * root);
+
+// First child named name, NULL if none
+const FBXNode * findFBXChild(const FBXNode * node, const char * name);
+
+// Every child of Objects, and every connection
+void getFBXObjects(const FBXNode * root, std::vector<const FBXNode *> & objects);
+void getFBXConnections(const FBXNode * root, std::vector<FBXConnection> & connections);
+
+long long getFBXObjectID(const FBXNode * object);
+std::string getFBXObjectName(const FBXNode * object);		// Without the "\0\1Class" part
+std::string getFBXObjectClass(const FBXNode * object);		// Property 2 ("Mesh", "LimbNode", "" ...)
+
+// Properties70 entry name of an object: its count numbers (from the entry's 5th property on). False if the object
+// doesn't set it (the FBX default applies then).
+bool getFBXProperty(const FBXNode * object, const char * name, double * values, int count);
+
+// Euler angles in degrees, in the FBX default order XYZ (X applied first)
+glm::quat getFBXEulerRotation(const double * degrees);
+
+// A Model's local transform as stored: Lcl Translation, PreRotation * Lcl Rotation * inverse PostRotation, Lcl Scaling
+void getFBXLocalTransform(const FBXNode * model, glm::vec3 & translation, glm::quat & rotation, glm::vec3 & scale);
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include "timer.hpp"
+#include "imageencoder.hpp"
+#include "framecapture.hpp"
+#include "profiler.hpp"
+
+struct CapturedFrame {
+	int index;							// 1 based, frame_00001 is the first
+	std::vector<unsigned char> pixels;	// RGBA, bottom row first
+	std::vector<unsigned char> encoded;
+};
+
+struct FrameCapture {
+	int width, height, format;
+	std::string directory;
+
+	// Readback ring: slot next is written this frame, the others are in flight from oldest (next + 1) to newest
+	std::vector<GLuint> buffers;
+	std::vector<GLsync> fences;
+	std::vector<int> frameIndex;
+	int next;
+
+	// Encoder pool: frames are taken from queue, their memory comes back to spare once written
+	std::vector<std::thread> encoders;
+	std::mutex mutex;
+	std::condition_variable work;		// A frame was queued, or the pool is stopping
+	std::condition_variable written;	// A frame was written
+	std::deque<CapturedFrame *> queue;
+	std::vector<CapturedFrame *> spare;
+	int pending;						// Queued or being encoded
+	int maxQueued;
+	bool stopping;
+	double encodeSeconds;
+
+	// Y4M: frames finish out of order, the first thread to see the next one in order writes it and its successors
+	FILE * stream;
+	std::mutex streamMutex;
+	std::map<int, CapturedFrame *> finished;
+	int nextWrite;
+
+	FrameCaptureStats stats;
+};
+
+
+
+static void encodeFrame(FrameCapture * capture, CapturedFrame * frame){
+	PROFILE_ZONE("Encode frame");
+	if (capture->format == CAPTURE_Y4M){
+		encodeY4MFrame(&frame->pixels[0], capture->width, capture->height, true, frame->encoded);
+		return;
+	}
+
+	if (capture->format == CAPTURE_PNG)
+		encodePNG(&frame->pixels[0], capture->width, capture->height, true, frame->encoded);
+	else
+		encodeQOI(&frame->pixels[0], capture->width, capture->height, true, frame->encoded);
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/frame_%05d.%s", capture->directory.c_str(), frame->index, capture->format == CAPTURE_PNG ? "png" : "qoi");
+	FILE * file = fopen(path, "wb");
+	if (file == NULL){
+		printf("[WARNING] Can't write %s.\n", path);
+		return;
+	}
+	fwrite(&frame->encoded[0], 1, frame->encoded.size(), file);
+	fclose(file);
+}
+
+// Frames written: back to the spare list, wake a renderer waiting for queue space
+static void releaseFrames(FrameCapture * capture, const std::vector<CapturedFrame *> & frames, double seconds){
+	std::lock_guard<std::mutex> lock(capture->mutex);
+	for (size_t i = 0; i < frames.size(); i++)
+		capture->spare.push_back(frames[i]);
+	capture->pending -= (int)frames.size();
+	capture->stats.written += (int)frames.size();
+	capture->encodeSeconds += seconds;
+	capture->written.notify_all();
+}
+
+static void encoderLoop(FrameCapture * capture){
+	PROFILE_THREAD("Frame encoder");
+	for (;;){
+		CapturedFrame * frame;
+		{
+			std::unique_lock<std::mutex> lock(capture->mutex);
+			capture->work.wait(lock, [capture](){ return !capture->queue.empty() || capture->stopping; });
+			if (capture->queue.empty())
+				return;
+			frame = capture->queue.front();
+			capture->queue.pop_front();
+		}
+
+		double start = getTime();
+		encodeFrame(capture, frame);
+
+		std::vector<CapturedFrame *> done;
+		if (capture->format == CAPTURE_Y4M){
+			std::lock_guard<std::mutex> lock(capture->streamMutex);
+			capture->finished[frame->index] = frame;
+			std::map<int, CapturedFrame *>::iterator it;
+			while ((it = capture->finished.find(capture->nextWrite)) != capture->finished.end()){
+				if (capture->stream != NULL)
+					fwrite(&it->second->encoded[0], 1, it->second->encoded.size(), capture->stream);
+				done.push_back(it->second);
+				capture->finished.erase(it);
+				capture->nextWrite++;
+			}
+		} else {
+			done.push_back(frame);
+		}
+		releaseFrames(capture, done, getTime() - start);
+	}
+}
+
+FrameCapture * createFrameCapture(int width, int height, int format, const char * directory, int frameRate,
+	int ring, int encoders, int maxQueued){
+	FrameCapture * capture = new FrameCapture;
+	capture->width = width;
+	capture->height = height;
+	capture->format = format;
+	capture->directory = directory;
+	capture->next = 0;
+	capture->pending = 0;
+	capture->maxQueued = maxQueued > 0 ? maxQueued : 1;
+	capture->stopping = false;
+	capture->encodeSeconds = 0.0;
+	capture->stream = NULL;
+	capture->nextWrite = 1;
+	memset(&capture->stats, 0, sizeof(capture->stats));
+
+	if (ring < 2)
+		ring = 2;
+	capture->buffers.resize(ring);
+	capture->fences.assign(ring, (GLsync)0);
+	capture->frameIndex.assign(ring, 0);
+	glGenBuffers(ring, &capture->buffers[0]);
+	for (int i = 0; i < ring; i++){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (format == CAPTURE_Y4M){
+		std::string path = capture->directory + "/frames.y4m";
+		capture->stream = fopen(path.c_str(), "wb");
+		if (capture->stream == NULL){
+			printf("[WARNING] Can't write %s.\n", path.c_str());
+		} else {
+			std::vector<unsigned char> header;
+			encodeY4MHeader(width, height, frameRate, header);
+			fwrite(&header[0], 1, header.size(), capture->stream);
+		}
+	}
+
+	if (encoders <= 0)
+		encoders = (int)std::thread::hardware_concurrency();
+	if (encoders <= 0)
+		encoders = 1;
+	for (int i = 0; i < encoders; i++)
+		capture->encoders.push_back(std::thread(encoderLoop, capture));
+	return capture;
+}
+
+// Map a readback (waiting for its fence if asked to), copy it into a frame and queue it for the encoders.
+// Returns false if it isn't signaled yet and wait is off.
+static bool collectReadback(FrameCapture * capture, int slot, bool wait){
+	GLenum status = glClientWaitSync(capture->fences[slot], 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+		if (!wait)
+			return false;
+		capture->stats.stalls++;
+		do {
+			status = glClientWaitSync(capture->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);	// 1 s
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(capture->fences[slot]);
+	capture->fences[slot] = 0;
+
+	// A spare frame, waiting for the encoders if maxQueued frames are already pending
+	CapturedFrame * frame;
+	{
+		std::unique_lock<std::mutex> lock(capture->mutex);
+		if (capture->pending >= capture->maxQueued){
+			capture->stats.stalls++;
+			capture->written.wait(lock, [capture](){ return capture->pending < capture->maxQueued; });
+		}
+		if (capture->spare.empty()){
+			frame = new CapturedFrame;
+		} else {
+			frame = capture->spare.back();
+			capture->spare.pop_back();
+		}
+	}
+
+	size_t size = (size_t)capture->width * capture->height * 4;
+	frame->index = capture->frameIndex[slot];
+	frame->pixels.resize(size);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+	const void * pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (pixels != NULL){
+		memcpy(&frame->pixels[0], pixels, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	{
+		std::lock_guard<std::mutex> lock(capture->mutex);
+		capture->queue.push_back(frame);
+		capture->pending++;
+		if (capture->pending > capture->stats.maxQueueDepth)
+			capture->stats.maxQueueDepth = capture->pending;
+	}
+	capture->work.notify_one();
+	return true;
+}
+
+void captureFrame(FrameCapture * capture){
+	PROFILE_ZONE("captureFrame");
+	double start = getTime();
+	int ring = (int)capture->buffers.size();
+
+	// The slot comes round again: its readback from ring frames ago has to be collected first
+	int slot = capture->next;
+	if (capture->fences[slot] != 0)
+		collectReadback(capture, slot, true);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffers[slot]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	capture->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	capture->frameIndex[slot] = ++capture->stats.captured;
+	capture->next = (slot + 1) % ring;
+
+	// Older readbacks the GPU is done with, oldest first so frames reach the encoders in order
+	for (int i = 1; i < ring; i++){
+		int older = (slot + i) % ring;
+		if (capture->fences[older] != 0 && !collectReadback(capture, older, false))
+			break;
+	}
+	capture->stats.captureMilliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+void finishFrameCapture(FrameCapture * capture){
+	int ring = (int)capture->buffers.size();
+	for (int i = 0; i < ring; i++){
+		int slot = (capture->next + i) % ring;
+		if (capture->fences[slot] != 0)
+			collectReadback(capture, slot, true);
+	}
+	std::unique_lock<std::mutex> lock(capture->mutex);
+	capture->written.wait(lock, [capture](){ return capture->pending == 0; });
+}
+
+void deleteFrameCapture(FrameCapture * capture){
+	if (capture == NULL)
+		return;
+	finishFrameCapture(capture);
+	{
+		std::lock_guard<std::mutex> lock(capture->mutex);
+		capture->stopping = true;
+	}
+	capture->work.notify_all();
+	for (size_t i = 0; i < capture->encoders.size(); i++)
+		capture->encoders[i].join();
+
+	glDeleteBuffers((GLsizei)capture->buffers.size(), &capture->buffers[0]);
+	if (capture->stream != NULL)
+		fclose(capture->stream);
+	for (size_t i = 0; i < capture->spare.size(); i++)
+		delete capture->spare[i];
+	delete capture;
+}
+
+FrameCaptureStats getFrameCaptureStats(FrameCapture * capture){
+	std::lock_guard<std::mutex> lock(capture->mutex);
+	FrameCaptureStats stats = capture->stats;
+	stats.queueDepth = capture->pending;
+	stats.encodeMilliseconds = stats.written > 0 ? (float)(capture->encodeSeconds * 1000.0 / stats.written) : 0.0f;
+	return stats;
+}
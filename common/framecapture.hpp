@@ -0,0 +1,44 @@
+#ifndef FRAMECAPTURE_HPP
+#define FRAMECAPTURE_HPP
+
+// Frame capture without stalling the renderer: each frame is read with glReadPixels into the next pixel pack buffer
+// of a ring, behind a fence, and only mapped once the GPU has signaled it (at the latest when its buffer comes round
+// again, ring frames later). The pixels are copied out and queued for a pool of encoder threads that write PNG or
+// QOI files (frame_00001.png, ...) or append to one Y4M stream in frame order.
+// When the encoders fall behind, the queue holds at most maxQueued frames, then the renderer waits for a free slot
+// (counted in stalls): every frame is written, the queue depth shows whether the encoders keep up.
+
+enum {
+	CAPTURE_PNG,
+	CAPTURE_QOI,
+	CAPTURE_Y4M
+};
+
+struct FrameCaptureStats {
+	int captured;				// Frames read back
+	int written;				// Frames encoded and written
+	int queueDepth;				// Frames waiting for an encoder or being encoded
+	int maxQueueDepth;
+	int stalls;					// Frames the renderer waited for (readback not signaled or encode queue full)
+	float captureMilliseconds;	// Renderer time of the last captureFrame (readback, map, copy)
+	float encodeMilliseconds;	// Mean encode and write time per frame, on an encoder thread
+};
+
+struct FrameCapture;
+
+// ring pixel pack buffers (2 or more), encoders threads (0 = one per core), frameRate only goes into the Y4M header
+FrameCapture * createFrameCapture(int width, int height, int format, const char * directory, int frameRate,
+	int ring, int encoders, int maxQueued);
+
+// Wait for every frame in flight to be written, then stop the encoders (needs the GL context)
+void deleteFrameCapture(FrameCapture * capture);
+
+// Read the bound read framebuffer (width x height from the bottom left) and collect the finished readbacks
+void captureFrame(FrameCapture * capture);
+
+// Collect every readback and wait until the encoders have written them
+void finishFrameCapture(FrameCapture * capture);
+
+FrameCaptureStats getFrameCaptureStats(FrameCapture * capture);
+
+#endif
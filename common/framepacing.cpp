@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <chrono>
+
+#include <GLFW/glfw3.h>
+
+#include "timer.hpp"
+#include "framepacing.hpp"
+
+#define FRAME_PACING_HISTORY	120		// Frames the mean, deviation and worst frame time are taken over
+#define FRAME_SPIN_SECONDS		0.002	// Initial spin margin before a deadline, grows to the worst sleep overshoot seen
+
+struct FramePacer {
+	double period;				// 0 = no limit
+	double deadline;			// Start time of the next frame
+	double frameStart;
+	double inputTime;
+	double spinSeconds;
+	int vsync;
+
+	float frameMilliseconds[FRAME_PACING_HISTORY];
+	float latencyMilliseconds[FRAME_PACING_HISTORY];
+	int frames;					// Started so far
+	int latencies;				// Submitted so far
+	FramePacingStats stats;
+};
+
+
+
+FramePacer * createFramePacer(double targetRate){
+	FramePacer * pacer = new FramePacer;
+	memset(pacer, 0, sizeof(FramePacer));
+	pacer->spinSeconds = FRAME_SPIN_SECONDS;
+	pacer->vsync = VSYNC_OFF;
+	pacer->stats.vsync = VSYNC_OFF;
+	setFramePacerTarget(pacer, targetRate);
+	return pacer;
+}
+
+void deleteFramePacer(FramePacer * pacer){
+	delete pacer;
+}
+
+void setFramePacerTarget(FramePacer * pacer, double targetRate){
+	pacer->period = targetRate > 0.0 ? 1.0 / targetRate : 0.0;
+	pacer->deadline = 0.0;		// Restart the schedule at the next frame
+	pacer->stats.targetMilliseconds = (float)(pacer->period * 1000.0);
+}
+
+int setSwapInterval(FramePacer * pacer, int vsync){
+	if (vsync == VSYNC_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")){
+		printf("[WARNING] Adaptive vsync is not supported, using vsync instead.\n");
+		vsync = VSYNC_ON;
+	}
+	glfwSwapInterval(vsync == VSYNC_ADAPTIVE ? -1 : vsync == VSYNC_ON ? 1 : 0);
+	pacer->vsync = vsync;
+	pacer->stats.vsync = vsync;
+	return vsync;
+}
+
+// Sleep while the deadline is further than the spin margin, then spin. The margin grows to the worst overshoot a
+// sleep has had, so a coarse OS timer costs some spinning but never a late frame.
+static void waitUntil(FramePacer * pacer, double deadline){
+	double now = getTime();
+	while (deadline - now > pacer->spinSeconds){
+		double sleepSeconds = deadline - now - pacer->spinSeconds;
+		std::this_thread::sleep_for(std::chrono::duration<double>(sleepSeconds));
+		double woke = getTime();
+		double overshoot = (woke - now) - sleepSeconds;
+		if (overshoot > pacer->spinSeconds)
+			pacer->spinSeconds = overshoot < pacer->period ? overshoot : pacer->period;
+		now = woke;
+	}
+	while (now < deadline){
+		std::this_thread::yield();
+		now = getTime();
+	}
+}
+
+static void updateHistoryStats(const float * history, int count, float & mean, float & deviation, float & worst){
+	int n = count < FRAME_PACING_HISTORY ? count : FRAME_PACING_HISTORY;
+	mean = deviation = worst = 0.0f;
+	if (n == 0)
+		return;
+	double sum = 0.0, squares = 0.0;
+	for (int i = 0; i < n; i++){
+		sum += history[i];
+		squares += (double)history[i] * history[i];
+		if (history[i] > worst)
+			worst = history[i];
+	}
+	double average = sum / n;
+	mean = (float)average;
+	deviation = (float)sqrt(fmax(squares / n - average * average, 0.0));
+}
+
+void waitForNextFrame(FramePacer * pacer){
+	double waitStart = getTime();
+	if (pacer->period > 0.0){
+		if (pacer->deadline == 0.0 || waitStart - pacer->deadline > pacer->period){
+			// First frame, or more than a period late: start over from now rather than catch up
+			if (pacer->deadline != 0.0)
+				pacer->stats.missedFrames++;
+			pacer->deadline = waitStart;
+		}
+		waitUntil(pacer, pacer->deadline);
+		pacer->deadline += pacer->period;
+	}
+
+	double now = getTime();
+	pacer->stats.waitMilliseconds = (float)((now - waitStart) * 1000.0);
+	if (pacer->frames > 0){
+		float milliseconds = (float)((now - pacer->frameStart) * 1000.0);
+		pacer->frameMilliseconds[(pacer->frames - 1) % FRAME_PACING_HISTORY] = milliseconds;
+		pacer->stats.lastFrameMilliseconds = milliseconds;
+		updateHistoryStats(pacer->frameMilliseconds, pacer->frames, pacer->stats.meanFrameMilliseconds,
+			pacer->stats.frameDeviationMilliseconds, pacer->stats.worstFrameMilliseconds);
+	}
+	pacer->frameStart = now;
+	pacer->frames++;
+}
+
+void markInputSampled(FramePacer * pacer){
+	pacer->inputTime = getTime();
+}
+
+void markFrameSubmitted(FramePacer * pacer){
+	float milliseconds = (float)((getTime() - pacer->inputTime) * 1000.0);
+	pacer->latencyMilliseconds[pacer->latencies % FRAME_PACING_HISTORY] = milliseconds;
+	pacer->latencies++;
+	pacer->stats.lastLatencyMilliseconds = milliseconds;
+
+	float deviation, worst;
+	updateHistoryStats(pacer->latencyMilliseconds, pacer->latencies, pacer->stats.meanLatencyMilliseconds, deviation, worst);
+}
+
+FramePacingStats getFramePacingStats(FramePacer * pacer){
+	return pacer->stats;
+}
@@ -0,0 +1,51 @@
+#ifndef FRAMEPACING_HPP
+#define FRAMEPACING_HPP
+
+// Frame pacing: frames start on a fixed schedule (the target rate) instead of as fast as the swap lets them. The wait
+// sleeps while the deadline is further away than the sleep overshoot measured so far, then spins the rest, so the
+// frame starts within a few microseconds of its deadline without burning a core. A frame that misses its deadline
+// by more than a whole period restarts the schedule rather than rushing the next ones.
+// Input is meant to be sampled as late as possible (just before the draws that use it are submitted): the time from
+// that sample to the end of the submission is the input latency the stats report.
+// Needs the GLFW window's context current for setSwapInterval.
+
+enum {
+	VSYNC_OFF,
+	VSYNC_ON,
+	VSYNC_ADAPTIVE		// Sync when on time, tear instead of waiting a whole refresh when late (swap interval -1)
+};
+
+// Over the last FRAME_PACING_HISTORY frames, except the last* values
+struct FramePacingStats {
+	float targetMilliseconds;		// 0 = no frame limit
+	float lastFrameMilliseconds;	// Start to start
+	float meanFrameMilliseconds;
+	float frameDeviationMilliseconds;	// Standard deviation of the frame time
+	float worstFrameMilliseconds;
+	float waitMilliseconds;			// Slept and spun before the last frame
+	float lastLatencyMilliseconds;	// Input sampled to draws submitted
+	float meanLatencyMilliseconds;
+	int missedFrames;				// Frames that started more than a period late
+	int vsync;						// VSYNC_ mode in effect (VSYNC_ON when adaptive isn't supported)
+};
+
+struct FramePacer;
+
+// targetRate in frames per second, 0 = no limit
+FramePacer * createFramePacer(double targetRate);
+void deleteFramePacer(FramePacer * pacer);
+void setFramePacerTarget(FramePacer * pacer, double targetRate);
+
+// Swap interval of the current context, returns the mode in effect
+int setSwapInterval(FramePacer * pacer, int vsync);
+
+// Wait until the next frame is due (sleep, then spin), then start it
+void waitForNextFrame(FramePacer * pacer);
+
+// Input sampled (call right after reading it), then the frame's draws submitted
+void markInputSampled(FramePacer * pacer);
+void markFrameSubmitted(FramePacer * pacer);
+
+FramePacingStats getFramePacingStats(FramePacer * pacer);
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "geometryarena.hpp"
+#include "uniformbuffer.hpp"	// DRAW_ID_LOCATION
+#include "glstate.hpp"
+
+// Free ranges of one buffer, in elements (vertices or indices), sorted by offset and never touching each other
+struct ArenaRange {
+	GLuint offset;
+	GLuint size;
+};
+
+struct ArenaAllocator {
+	std::vector<ArenaRange> freeRanges;
+	GLuint capacity;
+};
+
+struct GeometryArena {
+	GLuint vertexArray;				// The ArenaVertex layout and the index buffer (core profiles have no default vertex array)
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	ArenaAllocator vertices;
+	ArenaAllocator indices;
+
+	ArenaDrawPath path;
+	GLuint commandBuffer;			// GL_DRAW_INDIRECT_BUFFER, rewritten by every multiDrawArena
+	GLuint drawIDBuffer;			// 0, 1, 2, ... read through baseInstance as the per-draw draw ID
+	GLuint drawIDCapacity;
+
+	// glMultiDrawElementsBaseVertex arguments
+	std::vector<GLsizei> counts;
+	std::vector<void *> offsets;
+	std::vector<GLint> baseVertices;
+};
+
+
+
+// First fit, returns the offset or -1 when no free range is big enough
+static long long allocateRange(ArenaAllocator & allocator, GLuint size){
+	for (size_t i = 0; i < allocator.freeRanges.size(); i++){
+		ArenaRange & range = allocator.freeRanges[i];
+		if (range.size < size)
+			continue;
+		GLuint offset = range.offset;
+		range.offset += size;
+		range.size -= size;
+		if (range.size == 0)
+			allocator.freeRanges.erase(allocator.freeRanges.begin() + i);
+		return offset;
+	}
+	return -1;
+}
+
+// Give a range back, merged with the free ranges right before and after it
+static void freeRange(ArenaAllocator & allocator, GLuint offset, GLuint size){
+	if (size == 0)
+		return;
+	std::vector<ArenaRange> & ranges = allocator.freeRanges;
+	size_t i = 0;
+	while (i < ranges.size() && ranges[i].offset < offset)
+		i++;
+
+	bool mergePrevious = i > 0 && ranges[i - 1].offset + ranges[i - 1].size == offset;
+	bool mergeNext = i < ranges.size() && offset + size == ranges[i].offset;
+	if (mergePrevious && mergeNext){
+		ranges[i - 1].size += size + ranges[i].size;
+		ranges.erase(ranges.begin() + i);
+	} else if (mergePrevious){
+		ranges[i - 1].size += size;
+	} else if (mergeNext){
+		ranges[i].offset = offset;
+		ranges[i].size += size;
+	} else {
+		ArenaRange range = { offset, size };
+		ranges.insert(ranges.begin() + i, range);
+	}
+}
+
+// Double the buffer (at least enough for size more elements) and copy the old contents over, on the GPU
+static void growBuffer(ArenaAllocator & allocator, GLuint & buffer, GLenum target, GLsizeiptr elementSize, GLuint size){
+	GLuint capacity = allocator.capacity * 2;
+	if (capacity < allocator.capacity + size)
+		capacity = allocator.capacity + size;
+
+	GLuint grown;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * elementSize, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, allocator.capacity * elementSize);
+	glDeleteBuffers(1, &buffer);
+	buffer = grown;
+	cachedBindBuffer(target, buffer);
+
+	freeRange(allocator, allocator.capacity, capacity - allocator.capacity);
+	allocator.capacity = capacity;
+}
+
+static GLuint createBuffer(GLenum target, GLsizeiptr size){
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	cachedBindBuffer(target, buffer);
+	glBufferData(target, size, NULL, GL_STATIC_DRAW);
+	return buffer;
+}
+
+GeometryArena * createGeometryArena(int vertexCapacity, int indexCapacity){
+	GeometryArena * arena = new GeometryArena;
+	if (vertexCapacity < 1)
+		vertexCapacity = 1;
+	if (indexCapacity < 1)
+		indexCapacity = 1;
+
+	// The index buffer binding belongs to the vertex array, so it's bound before the buffers are created
+	glGenVertexArrays(1, &arena->vertexArray);
+	cachedBindVertexArray(arena->vertexArray);
+	arena->vertexBuffer = createBuffer(GL_ARRAY_BUFFER, vertexCapacity * sizeof(ArenaVertex));
+	arena->indexBuffer = createBuffer(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned short));
+	arena->vertices.capacity = 0;
+	arena->indices.capacity = 0;
+	freeRange(arena->vertices, 0, vertexCapacity);
+	freeRange(arena->indices, 0, indexCapacity);
+	arena->vertices.capacity = vertexCapacity;
+	arena->indices.capacity = indexCapacity;
+
+	// baseInstance is ignored without GL 4.2 / ARB_base_instance, and the draw ID needs it
+	if (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance))
+		arena->path = ARENA_MULTI_DRAW_INDIRECT;
+	else if (GLEW_ARB_shader_draw_parameters)
+		arena->path = ARENA_MULTI_DRAW_BASE_VERTEX;
+	else
+		arena->path = ARENA_DRAW_LOOP;
+
+	arena->commandBuffer = 0;
+	arena->drawIDBuffer = 0;
+	arena->drawIDCapacity = 0;
+	if (arena->path == ARENA_MULTI_DRAW_INDIRECT)
+		glGenBuffers(1, &arena->commandBuffer);
+
+	return arena;
+}
+
+void deleteGeometryArena(GeometryArena * arena){
+	if (arena == NULL)
+		return;
+	glDeleteBuffers(1, &arena->vertexBuffer);
+	glDeleteBuffers(1, &arena->indexBuffer);
+	if (arena->commandBuffer)
+		glDeleteBuffers(1, &arena->commandBuffer);
+	if (arena->drawIDBuffer)
+		glDeleteBuffers(1, &arena->drawIDBuffer);
+	glDeleteVertexArrays(1, &arena->vertexArray);
+	delete arena;
+}
+
+ArenaMesh allocateArenaMesh(GeometryArena * arena, const ArenaVertex * vertices, int vertexCount, const unsigned short * indices, int indexCount){
+	cachedBindVertexArray(arena->vertexArray);	// A grown index buffer is bound to it
+	long long baseVertex = allocateRange(arena->vertices, vertexCount);
+	if (baseVertex < 0){
+		growBuffer(arena->vertices, arena->vertexBuffer, GL_ARRAY_BUFFER, sizeof(ArenaVertex), vertexCount);
+		baseVertex = allocateRange(arena->vertices, vertexCount);
+	}
+	long long firstIndex = allocateRange(arena->indices, indexCount);
+	if (firstIndex < 0){
+		growBuffer(arena->indices, arena->indexBuffer, GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short), indexCount);
+		firstIndex = allocateRange(arena->indices, indexCount);
+	}
+
+	cachedBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(ArenaVertex), vertexCount * sizeof(ArenaVertex), vertices);
+	cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->indexBuffer);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, firstIndex * sizeof(unsigned short), indexCount * sizeof(unsigned short), indices);
+
+	ArenaMesh mesh = { (GLint)baseVertex, (GLuint)vertexCount, (GLuint)firstIndex, (GLuint)indexCount };
+	return mesh;
+}
+
+void freeArenaMesh(GeometryArena * arena, const ArenaMesh & mesh){
+	freeRange(arena->vertices, mesh.baseVertex, mesh.vertexCount);
+	freeRange(arena->indices, mesh.firstIndex, mesh.indexCount);
+}
+
+void bindGeometryArena(GeometryArena * arena){
+	cachedBindVertexArray(arena->vertexArray);
+	cachedBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+	cachedEnableVertexAttribArray(0);
+	cachedVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), offsetof(ArenaVertex, position));
+	cachedEnableVertexAttribArray(1);
+	cachedVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), offsetof(ArenaVertex, uv));
+	cachedEnableVertexAttribArray(2);
+	cachedVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ArenaVertex), offsetof(ArenaVertex, normal));
+	cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->indexBuffer);
+}
+
+void getGeometryArenaBuffers(GeometryArena * arena, GLuint & vertexBuffer, GLuint & indexBuffer){
+	vertexBuffer = arena->vertexBuffer;
+	indexBuffer = arena->indexBuffer;
+}
+
+ArenaDrawPath getArenaDrawPath(GeometryArena * arena){
+	return arena->path;
+}
+
+ArenaDrawCommand arenaDrawCommand(const ArenaMesh & mesh, int drawID){
+	ArenaDrawCommand command = { mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, (GLuint)drawID };
+	return command;
+}
+
+// Point the draw ID attribute at 0, 1, 2, ... with a divisor of 1, so each indirect draw reads its own baseInstance
+static void bindDrawIDs(GeometryArena * arena, GLuint count){
+	if (count > arena->drawIDCapacity){
+		std::vector<GLint> ids(count);
+		for (GLuint i = 0; i < count; i++)
+			ids[i] = i;
+		if (arena->drawIDBuffer == 0)
+			glGenBuffers(1, &arena->drawIDBuffer);
+		cachedBindBuffer(GL_ARRAY_BUFFER, arena->drawIDBuffer);
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(GLint), &ids[0], GL_STATIC_DRAW);
+		arena->drawIDCapacity = count;
+	}
+	cachedBindBuffer(GL_ARRAY_BUFFER, arena->drawIDBuffer);
+	cachedEnableVertexAttribArray(DRAW_ID_LOCATION);
+	cachedVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_INT, 0, 0);
+	glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+}
+
+// Back to a constant draw ID attribute (glVertexAttribI1i) for the other draws
+static void unbindDrawIDs(GeometryArena * arena){
+	glVertexAttribDivisor(DRAW_ID_LOCATION, 0);
+	cachedDisableVertexAttribArray(DRAW_ID_LOCATION);
+	cachedBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+}
+
+int multiDrawArena(GeometryArena * arena, const ArenaDrawCommand * commands, int count){
+	if (count <= 0)
+		return 0;
+
+	if (arena->path == ARENA_MULTI_DRAW_INDIRECT){
+		GLuint maxDrawID = 0;
+		for (int i = 0; i < count; i++)
+			if (commands[i].baseInstance > maxDrawID)
+				maxDrawID = commands[i].baseInstance;
+		bindDrawIDs(arena, maxDrawID + 1);
+
+		cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena->commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(ArenaDrawCommand), commands, GL_STREAM_DRAW);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, count, 0);
+
+		unbindDrawIDs(arena);
+		return 1;
+	}
+
+	if (arena->path == ARENA_MULTI_DRAW_BASE_VERTEX){
+		// The shader adds gl_DrawIDARB (0, 1, 2, ... within one call) to the constant draw ID attribute,
+		// so each call covers a run of consecutive draw IDs
+		int calls = 0;
+		for (int first = 0; first < count; ){
+			int last = first + 1;
+			while (last < count && commands[last].baseInstance == commands[last - 1].baseInstance + 1)
+				last++;
+
+			int runLength = last - first;
+			arena->counts.resize(runLength);
+			arena->offsets.resize(runLength);
+			arena->baseVertices.resize(runLength);
+			for (int i = 0; i < runLength; i++){
+				const ArenaDrawCommand & command = commands[first + i];
+				arena->counts[i] = command.count;
+				arena->offsets[i] = (void *)(command.firstIndex * sizeof(unsigned short));
+				arena->baseVertices[i] = command.baseVertex;
+			}
+			cachedVertexAttribI1i(DRAW_ID_LOCATION, commands[first].baseInstance);
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, &arena->counts[0], GL_UNSIGNED_SHORT, &arena->offsets[0], runLength, &arena->baseVertices[0]);
+			calls++;
+			first = last;
+		}
+		return calls;
+	}
+
+	for (int i = 0; i < count; i++){
+		const ArenaDrawCommand & command = commands[i];
+		cachedVertexAttribI1i(DRAW_ID_LOCATION, command.baseInstance);
+		glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_SHORT, (void *)(command.firstIndex * sizeof(unsigned short)), command.baseVertex);
+	}
+	return count;
+}
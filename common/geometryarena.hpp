@@ -0,0 +1,62 @@
+#ifndef GEOMETRYARENA_HPP
+#define GEOMETRYARENA_HPP
+
+// Geometry arena: every mesh lives in one shared vertex buffer and one shared index buffer, sub-allocated with a
+// first-fit free list (freed ranges merge with their neighbours, the buffers double when full). A mesh is then just
+// a base vertex and a first index, so draws of different meshes need no buffer switches and go out together:
+// - glMultiDrawElementsIndirect from a command buffer built on the CPU (GL 4.3 / ARB_multi_draw_indirect)
+// - else glMultiDrawElementsBaseVertex, with gl_DrawIDARB giving the draw ID (ARB_shader_draw_parameters)
+// - else one glDrawElementsBaseVertex per draw
+
+// Interleaved vertex, attributes 0 (position), 1 (UV) and 2 (normal)
+struct ArenaVertex {
+	glm::vec3 position;
+	glm::vec2 uv;
+	glm::vec3 normal;
+};
+
+// Where a mesh lives in the arena
+struct ArenaMesh {
+	GLint baseVertex;
+	GLuint vertexCount;
+	GLuint firstIndex;
+	GLuint indexCount;
+};
+
+// One draw, laid out like GL's DrawElementsIndirectCommand
+struct ArenaDrawCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;	// The draw ID (location 7 of vertex.glsl)
+};
+
+// How multiDrawArena submits
+enum ArenaDrawPath {
+	ARENA_MULTI_DRAW_INDIRECT,		// One glMultiDrawElementsIndirect per call
+	ARENA_MULTI_DRAW_BASE_VERTEX,	// One glMultiDrawElementsBaseVertex per run of consecutive draw IDs, shaders need SHADER_DRAW_PARAMETERS
+	ARENA_DRAW_LOOP					// One glDrawElementsBaseVertex per draw
+};
+
+struct GeometryArena;
+
+// Create the arena with room for this many vertices / 16 bit indices (it grows when needed)
+GeometryArena * createGeometryArena(int vertexCapacity, int indexCapacity);
+void deleteGeometryArena(GeometryArena * arena);
+
+// Copy a mesh into the arena. Indices are relative to the mesh's first vertex.
+ArenaMesh allocateArenaMesh(GeometryArena * arena, const ArenaVertex * vertices, int vertexCount, const unsigned short * indices, int indexCount);
+void freeArenaMesh(GeometryArena * arena, const ArenaMesh & mesh);
+
+// Bind the arena's vertex array and shared buffers and point attributes 0, 1, 2 at them
+void bindGeometryArena(GeometryArena * arena);
+void getGeometryArenaBuffers(GeometryArena * arena, GLuint & vertexBuffer, GLuint & indexBuffer);
+
+ArenaDrawPath getArenaDrawPath(GeometryArena * arena);
+ArenaDrawCommand arenaDrawCommand(const ArenaMesh & mesh, int drawID);
+
+// Draw every command with the bound program and textures (bindGeometryArena first). Returns the GL draw calls issued.
+int multiDrawArena(GeometryArena * arena, const ArenaDrawCommand * commands, int count);
+
+#endif
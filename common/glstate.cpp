@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+#include <GL/glew.h>
+
+#include "glstate.hpp"
+
+#define GLSTATE_MAX_TEXTURE_UNITS	32
+#define GLSTATE_MAX_ATTRIBUTES		16
+#define GLSTATE_UNKNOWN				0xFFFFFFFF		// Never a GL name, so the next bind goes through
+
+// Buffer targets the cache tracks, others go straight to GL
+static const GLenum bufferTargets[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+	GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+#define GLSTATE_BUFFER_TARGETS		(sizeof(bufferTargets) / sizeof(bufferTargets[0]))
+
+struct AttributeState {
+	GLuint enabled;			// 0, 1 or GLSTATE_UNKNOWN
+	GLuint buffer;			// Pointer source, GLSTATE_UNKNOWN if unknown
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLboolean integer;
+	GLsizei stride;
+	size_t offset;
+	GLint constant;			// glVertexAttribI1i value
+	bool constantKnown;
+};
+
+struct TextureState {
+	GLenum target;
+	GLuint texture;
+};
+
+// A uniform's last value, as raw bytes (up to a mat4)
+struct UniformValue {
+	GLfloat data[16];
+};
+
+struct GLState {
+	GLuint program;
+	GLuint vertexArray;
+	GLuint buffers[GLSTATE_BUFFER_TARGETS];
+	GLuint activeUnit;
+	TextureState textures[GLSTATE_MAX_TEXTURE_UNITS];
+	GLuint samplers[GLSTATE_MAX_TEXTURE_UNITS];
+	AttributeState attributes[GLSTATE_MAX_ATTRIBUTES];
+	std::map<unsigned long long, UniformValue> uniforms;	// (program << 32) | location
+	GLStateStats stats;
+};
+
+static GLState & getState(){
+	static GLState * state = NULL;
+	if (state == NULL){
+		state = new GLState;
+		memset(&state->stats, 0, sizeof(state->stats));
+		invalidateGLState();
+	}
+	return *state;
+}
+
+
+
+static int bufferTargetIndex(GLenum target){
+	for (int i = 0; i < (int)GLSTATE_BUFFER_TARGETS; i++)
+		if (bufferTargets[i] == target)
+			return i;
+	return -1;
+}
+
+// The vertex attributes and the element buffer binding are part of the bound vertex array
+static void forgetVertexArrayState(GLState & state){
+	for (int i = 0; i < GLSTATE_MAX_ATTRIBUTES; i++){
+		state.attributes[i].enabled = GLSTATE_UNKNOWN;
+		state.attributes[i].buffer = GLSTATE_UNKNOWN;
+		state.attributes[i].constantKnown = false;
+	}
+	state.buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = GLSTATE_UNKNOWN;
+}
+
+void invalidateGLState(){
+	GLState & state = getState();
+	state.program = GLSTATE_UNKNOWN;
+	state.vertexArray = GLSTATE_UNKNOWN;
+	for (int i = 0; i < (int)GLSTATE_BUFFER_TARGETS; i++)
+		state.buffers[i] = GLSTATE_UNKNOWN;
+	state.activeUnit = GLSTATE_UNKNOWN;
+	for (int i = 0; i < GLSTATE_MAX_TEXTURE_UNITS; i++){
+		state.textures[i].target = GL_NONE;
+		state.textures[i].texture = GLSTATE_UNKNOWN;
+		state.samplers[i] = GLSTATE_UNKNOWN;
+	}
+	forgetVertexArrayState(state);
+}
+
+void forgetProgramUniforms(GLuint program){
+	GLState & state = getState();
+	unsigned long long first = (unsigned long long)program << 32;
+	state.uniforms.erase(state.uniforms.lower_bound(first), state.uniforms.lower_bound(first + 0x100000000ULL));
+	if (state.program == program)
+		state.program = GLSTATE_UNKNOWN;
+}
+
+void cachedUseProgram(GLuint program){
+	GLState & state = getState();
+	if (state.program == program){
+		state.stats.programs++;
+		return;
+	}
+	glUseProgram(program);
+	state.program = program;
+	state.stats.issued++;
+}
+
+void cachedBindVertexArray(GLuint vertexArray){
+	GLState & state = getState();
+	if (state.vertexArray == vertexArray){
+		state.stats.vertexArrays++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	state.vertexArray = vertexArray;
+	forgetVertexArrayState(state);
+	state.stats.issued++;
+}
+
+void cachedBindBuffer(GLenum target, GLuint buffer){
+	GLState & state = getState();
+	int index = bufferTargetIndex(target);
+	if (index >= 0 && state.buffers[index] == buffer){
+		state.stats.buffers++;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (index >= 0)
+		state.buffers[index] = buffer;
+	state.stats.issued++;
+}
+
+static void activeTexture(GLState & state, GLuint unit){
+	if (state.activeUnit == unit){
+		state.stats.textures++;
+		return;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	state.activeUnit = unit;
+	state.stats.issued++;
+}
+
+void cachedBindTexture(GLuint unit, GLenum target, GLuint texture){
+	GLState & state = getState();
+	if (unit >= GLSTATE_MAX_TEXTURE_UNITS){
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		state.activeUnit = unit;
+		state.stats.issued += 2;
+		return;
+	}
+
+	TextureState & bound = state.textures[unit];
+	if (bound.target == target && bound.texture == texture){
+		state.stats.textures += 2;		// Neither glActiveTexture nor glBindTexture
+		return;
+	}
+	activeTexture(state, unit);
+	glBindTexture(target, texture);
+	bound.target = target;
+	bound.texture = texture;
+	state.stats.issued++;
+}
+
+void cachedBindSampler(GLuint unit, GLuint sampler){
+	GLState & state = getState();
+	if (unit < GLSTATE_MAX_TEXTURE_UNITS && state.samplers[unit] == sampler){
+		state.stats.samplers++;
+		return;
+	}
+	glBindSampler(unit, sampler);
+	if (unit < GLSTATE_MAX_TEXTURE_UNITS)
+		state.samplers[unit] = sampler;
+	state.stats.issued++;
+}
+
+void cachedEnableVertexAttribArray(GLuint index){
+	GLState & state = getState();
+	if (index < GLSTATE_MAX_ATTRIBUTES && state.attributes[index].enabled == 1){
+		state.stats.vertexAttributes++;
+		return;
+	}
+	glEnableVertexAttribArray(index);
+	if (index < GLSTATE_MAX_ATTRIBUTES){
+		state.attributes[index].enabled = 1;
+		state.attributes[index].constantKnown = false;	// Draws from the array may leave the current value undefined
+	}
+	state.stats.issued++;
+}
+
+void cachedDisableVertexAttribArray(GLuint index){
+	GLState & state = getState();
+	if (index < GLSTATE_MAX_ATTRIBUTES && state.attributes[index].enabled == 0){
+		state.stats.vertexAttributes++;
+		return;
+	}
+	glDisableVertexAttribArray(index);
+	if (index < GLSTATE_MAX_ATTRIBUTES)
+		state.attributes[index].enabled = 0;
+	state.stats.issued++;
+}
+
+// Whether the attribute already points at this layout of the bound GL_ARRAY_BUFFER, else remember it
+static bool samePointer(GLState & state, GLuint index, GLint size, GLenum type, GLboolean normalized, GLboolean integer, GLsizei stride, size_t offset){
+	GLuint buffer = state.buffers[bufferTargetIndex(GL_ARRAY_BUFFER)];
+	if (index >= GLSTATE_MAX_ATTRIBUTES || buffer == GLSTATE_UNKNOWN)
+		return false;
+
+	AttributeState & attribute = state.attributes[index];
+	if (attribute.buffer == buffer && attribute.size == size && attribute.type == type && attribute.normalized == normalized &&
+		attribute.integer == integer && attribute.stride == stride && attribute.offset == offset)
+		return true;
+
+	attribute.buffer = buffer;
+	attribute.size = size;
+	attribute.type = type;
+	attribute.normalized = normalized;
+	attribute.integer = integer;
+	attribute.stride = stride;
+	attribute.offset = offset;
+	return false;
+}
+
+void cachedVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset){
+	GLState & state = getState();
+	if (samePointer(state, index, size, type, normalized, GL_FALSE, stride, offset)){
+		state.stats.vertexAttributes++;
+		return;
+	}
+	glVertexAttribPointer(index, size, type, normalized, stride, (const void *)offset);
+	state.stats.issued++;
+}
+
+void cachedVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, size_t offset){
+	GLState & state = getState();
+	if (samePointer(state, index, size, type, GL_FALSE, GL_TRUE, stride, offset)){
+		state.stats.vertexAttributes++;
+		return;
+	}
+	glVertexAttribIPointer(index, size, type, stride, (const void *)offset);
+	state.stats.issued++;
+}
+
+void cachedVertexAttribI1i(GLuint index, GLint value){
+	GLState & state = getState();
+	if (index < GLSTATE_MAX_ATTRIBUTES && state.attributes[index].constantKnown && state.attributes[index].constant == value){
+		state.stats.vertexAttributes++;
+		return;
+	}
+	glVertexAttribI1i(index, value);
+	if (index < GLSTATE_MAX_ATTRIBUTES){
+		state.attributes[index].constant = value;
+		state.attributes[index].constantKnown = true;
+	}
+	state.stats.issued++;
+}
+
+// Whether the bound program's uniform already holds these bytes, else remember them
+static bool sameUniform(GLState & state, GLint location, const void * data, size_t size){
+	if (location < 0 || state.program == GLSTATE_UNKNOWN)
+		return location < 0;	// glUniform ignores location -1, so can we
+
+	unsigned long long key = ((unsigned long long)state.program << 32) | (unsigned int)location;
+	std::map<unsigned long long, UniformValue>::iterator found = state.uniforms.find(key);
+	if (found != state.uniforms.end() && memcmp(found->second.data, data, size) == 0)
+		return true;
+
+	UniformValue & value = state.uniforms[key];
+	memcpy(value.data, data, size);
+	return false;
+}
+
+void cachedUniform1i(GLint location, GLint value){
+	GLState & state = getState();
+	if (sameUniform(state, location, &value, sizeof(value))){
+		state.stats.uniforms++;
+		return;
+	}
+	glUniform1i(location, value);
+	state.stats.issued++;
+}
+
+void cachedUniform1f(GLint location, GLfloat value){
+	GLState & state = getState();
+	if (sameUniform(state, location, &value, sizeof(value))){
+		state.stats.uniforms++;
+		return;
+	}
+	glUniform1f(location, value);
+	state.stats.issued++;
+}
+
+void cachedUniform2f(GLint location, GLfloat x, GLfloat y){
+	GLState & state = getState();
+	GLfloat value[2] = { x, y };
+	if (sameUniform(state, location, value, sizeof(value))){
+		state.stats.uniforms++;
+		return;
+	}
+	glUniform2f(location, x, y);
+	state.stats.issued++;
+}
+
+void cachedUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w){
+	GLState & state = getState();
+	GLfloat value[4] = { x, y, z, w };
+	if (sameUniform(state, location, value, sizeof(value))){
+		state.stats.uniforms++;
+		return;
+	}
+	glUniform4f(location, x, y, z, w);
+	state.stats.issued++;
+}
+
+void cachedUniformMatrix4fv(GLint location, const GLfloat * value){
+	GLState & state = getState();
+	if (sameUniform(state, location, value, 16 * sizeof(GLfloat))){
+		state.stats.uniforms++;
+		return;
+	}
+	glUniformMatrix4fv(location, 1, GL_FALSE, value);
+	state.stats.issued++;
+}
+
+GLStateStats getGLStateStats(){
+	return getState().stats;
+}
+
+int getElidedGLCalls(const GLStateStats & stats){
+	return stats.programs + stats.vertexArrays + stats.buffers + stats.textures + stats.samplers + stats.vertexAttributes + stats.uniforms;
+}
+
+void resetGLStateStats(){
+	memset(&getState().stats, 0, sizeof(GLStateStats));
+}
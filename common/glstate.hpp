@@ -0,0 +1,49 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+// GL state cache: drop-in wrappers for the binds and uniform uploads of the draw path that skip the GL call when
+// the state is already current, and count what they skipped. The cache only knows what went through it, so call
+// invalidateGLState() after code that changes GL state directly (ie. TwDraw, texture uploads, other passes).
+// Binding a vertex array forgets the vertex attribute and element buffer state, which belongs to the VAO.
+
+// Calls skipped (per kind) and passed on to GL since the last resetGLStateStats()
+struct GLStateStats {
+	int programs;			// glUseProgram
+	int vertexArrays;		// glBindVertexArray
+	int buffers;			// glBindBuffer
+	int textures;			// glActiveTexture, glBindTexture
+	int samplers;			// glBindSampler
+	int vertexAttributes;	// glEnable/DisableVertexAttribArray, glVertexAttrib(I)Pointer, glVertexAttribI1i
+	int uniforms;			// glUniform*
+	int issued;				// Calls that reached GL
+};
+
+void cachedUseProgram(GLuint program);
+void cachedBindVertexArray(GLuint vertexArray);
+void cachedBindBuffer(GLenum target, GLuint buffer);
+void cachedBindTexture(GLuint unit, GLenum target, GLuint texture);	// The active unit is only changed if the binding is
+void cachedBindSampler(GLuint unit, GLuint sampler);
+
+void cachedEnableVertexAttribArray(GLuint index);
+void cachedDisableVertexAttribArray(GLuint index);
+void cachedVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset);	// Source is the bound GL_ARRAY_BUFFER
+void cachedVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, size_t offset);
+void cachedVertexAttribI1i(GLuint index, GLint value);
+
+// Uniforms of the program bound with cachedUseProgram, remembered per program and location
+void cachedUniform1i(GLint location, GLint value);
+void cachedUniform1f(GLint location, GLfloat value);
+void cachedUniform2f(GLint location, GLfloat x, GLfloat y);
+void cachedUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void cachedUniformMatrix4fv(GLint location, const GLfloat * value);
+
+// Forget the bindings (the next call of each kind goes through). Uniform values are kept since only glUniform
+// changes them: set a program's uniforms through the cache only, and forget its values when deleting it.
+void invalidateGLState();
+void forgetProgramUniforms(GLuint program);
+
+GLStateStats getGLStateStats();
+int getElidedGLCalls(const GLStateStats & stats);
+void resetGLStateStats();
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef GLEW_EGL
+#error "HEADLESS_EGL needs GLEW_EGL too: glew.c then resolves entry points with eglGetProcAddress on EGL contexts"
+#endif
+#endif
+
+#include "headless.hpp"
+
+struct HeadlessContext {
+	int width, height;
+	GLuint framebuffer;
+	GLuint colorBuffer;
+	GLuint depthBuffer;
+#ifdef HEADLESS_EGL
+	EGLDisplay display;
+	EGLContext context;
+#endif
+};
+
+
+
+#ifdef HEADLESS_EGL
+// Surfaceless platform when available (no display server at all), the default display otherwise
+static EGLDisplay getHeadlessDisplay(){
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const char * clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay != NULL && clientExtensions != NULL && strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != NULL)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	return display;
+}
+
+static bool createEGLContext(HeadlessContext * headless){
+	headless->display = getHeadlessDisplay();
+	EGLint major, minor;
+	if (headless->display == EGL_NO_DISPLAY || !eglInitialize(headless->display, &major, &minor)){
+		printf("[WARNING] Failed to initialize EGL.\n");
+		return false;
+	}
+	const char * extensions = eglQueryString(headless->display, EGL_EXTENSIONS);
+	if (extensions == NULL || strstr(extensions, "EGL_KHR_surfaceless_context") == NULL){
+		printf("[WARNING] EGL %d.%d has no surfaceless contexts (EGL_KHR_surfaceless_context).\n", major, minor);
+		eglTerminate(headless->display);
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs = 0;
+	eglBindAPI(EGL_OPENGL_API);
+	if (!eglChooseConfig(headless->display, configAttributes, &config, 1, &configs) || configs == 0){
+		printf("[WARNING] No EGL config for desktop OpenGL.\n");
+		eglTerminate(headless->display);
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	headless->context = eglCreateContext(headless->display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (headless->context == EGL_NO_CONTEXT || !eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless->context)){
+		printf("[WARNING] Failed to create an OpenGL 3.3 core context through EGL.\n");
+		if (headless->context != EGL_NO_CONTEXT)
+			eglDestroyContext(headless->display, headless->context);
+		eglTerminate(headless->display);
+		return false;
+	}
+	return true;
+}
+#endif
+
+HeadlessContext * createHeadlessContext(int width, int height){
+#ifdef HEADLESS_EGL
+	HeadlessContext * headless = new HeadlessContext;
+	headless->width = width;
+	headless->height = height;
+	if (!createEGLContext(headless)){
+		delete headless;
+		return NULL;
+	}
+
+	// GLEW_EGL: the entry points come from eglGetProcAddress, and no GLX display is needed
+	glewExperimental = true;
+	if (glewInit() != GLEW_OK){
+		printf("[WARNING] Failed to initialize GLEW on the headless context.\n");
+		eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(headless->display, headless->context);
+		eglTerminate(headless->display);
+		delete headless;
+		return NULL;
+	}
+	glGetError();	// GLEW's extension query is invalid in a core profile
+
+	// The frame is drawn into renderbuffers instead of a window's back buffer
+	glGenRenderbuffers(1, &headless->colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless->colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &headless->depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, headless->depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &headless->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless->colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless->depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("[WARNING] Headless framebuffer is incomplete.\n");
+
+	// A context without a surface starts with an empty viewport
+	glViewport(0, 0, width, height);
+
+	printf("Headless: %s (%s), %dx%d\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION), width, height);
+	return headless;
+#else
+	(void)width;
+	(void)height;
+	printf("[WARNING] Headless rendering is not built in (define HEADLESS_EGL and GLEW_EGL, and link EGL).\n");
+	return NULL;
+#endif
+}
+
+void deleteHeadlessContext(HeadlessContext * headless){
+	if (headless == NULL)
+		return;
+	glDeleteFramebuffers(1, &headless->framebuffer);
+	glDeleteRenderbuffers(1, &headless->colorBuffer);
+	glDeleteRenderbuffers(1, &headless->depthBuffer);
+#ifdef HEADLESS_EGL
+	eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(headless->display, headless->context);
+	eglTerminate(headless->display);
+#endif
+	delete headless;
+}
+
+void bindHeadlessFramebuffer(HeadlessContext * headless){
+	glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+	glViewport(0, 0, headless->width, headless->height);
+}
@@ -0,0 +1,20 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+// Headless rendering: an OpenGL 3.3 core context without a window or an X server (surfaceless EGL; Mesa renders
+// with llvmpipe on machines without a GPU), drawing into a framebuffer object of the requested size instead of a
+// window's back buffer. Only built with HEADLESS_EGL defined (link libEGL), otherwise createHeadlessContext fails.
+// GLEW is initialized on the new context, so glew.c has to be built with GLEW_EGL as well (the bundled 1.13 then
+// loads through eglGetProcAddress while an EGL context is current, and GLX windows still work).
+
+struct HeadlessContext;
+
+// Current on the calling thread, with its framebuffer bound and the viewport set. NULL on failure.
+HeadlessContext * createHeadlessContext(int width, int height);
+void deleteHeadlessContext(HeadlessContext * context);
+
+// Rebind the framebuffer (passes that render elsewhere restore framebuffer 0, which a headless context doesn't have).
+// Frames are read back from it by framecapture.hpp.
+void bindHeadlessFramebuffer(HeadlessContext * context);
+
+#endif
@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "timer.hpp"
+#include "imageloader.hpp"
+#include "imageencoder.hpp"
+
+// Row y of the output image in the source (flip: the source's bottom row comes first)
+static const unsigned char * sourceRow(const unsigned char * rgba, int width, int height, int y, bool flip){
+	return rgba + (size_t)(flip ? height - 1 - y : y) * width * 4;
+}
+
+static void writeBE32(std::vector<unsigned char> & out, unsigned int value){
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// QOI
+// -------------------------------------------------------------------------------------------------
+
+#define QOI_OP_INDEX 0x00 // 00xxxxxx
+#define QOI_OP_DIFF  0x40 // 01xxxxxx
+#define QOI_OP_LUMA  0x80 // 10xxxxxx
+#define QOI_OP_RUN   0xc0 // 11xxxxxx
+#define QOI_OP_RGB   0xfe // 11111110
+
+void encodeQOI(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out){
+	out.clear();
+	out.reserve((size_t)width * height * 4 + 22);
+	out.push_back('q'); out.push_back('o'); out.push_back('i'); out.push_back('f');
+	writeBE32(out, width);
+	writeBE32(out, height);
+	out.push_back(3);	// RGB
+	out.push_back(0);	// sRGB with linear alpha
+
+	unsigned char index[64][3];
+	memset(index, 0, sizeof(index));
+	unsigned char previous[3] = { 0, 0, 0 };
+	int run = 0;
+
+	for (int y = 0; y < height; y++){
+		const unsigned char * pixel = sourceRow(rgba, width, height, y, flip);
+		for (int x = 0; x < width; x++, pixel += 4){
+			if (pixel[0] == previous[0] && pixel[1] == previous[1] && pixel[2] == previous[2]){
+				if (++run == 62){
+					out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0){
+				out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+				run = 0;
+			}
+
+			// Alpha is always 255 (255 * 11 % 64 = 53)
+			int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + 53) % 64;
+			if (index[hash][0] == pixel[0] && index[hash][1] == pixel[1] && index[hash][2] == pixel[2]){
+				out.push_back((unsigned char)(QOI_OP_INDEX | hash));
+			} else {
+				memcpy(index[hash], pixel, 3);
+				signed char vr = (signed char)(pixel[0] - previous[0]);
+				signed char vg = (signed char)(pixel[1] - previous[1]);
+				signed char vb = (signed char)(pixel[2] - previous[2]);
+				signed char vgr = (signed char)(vr - vg);
+				signed char vgb = (signed char)(vb - vg);
+				if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2){
+					out.push_back((unsigned char)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+				} else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8){
+					out.push_back((unsigned char)(QOI_OP_LUMA | (vg + 32)));
+					out.push_back((unsigned char)((vgr + 8) << 4 | (vgb + 8)));
+				} else {
+					out.push_back(QOI_OP_RGB);
+					out.push_back(pixel[0]);
+					out.push_back(pixel[1]);
+					out.push_back(pixel[2]);
+				}
+			}
+			memcpy(previous, pixel, 3);
+		}
+	}
+	if (run > 0)
+		out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+
+	static const unsigned char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	out.insert(out.end(), padding, padding + 8);
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// PNG (zlib stream with one fixed Huffman block)
+// -------------------------------------------------------------------------------------------------
+
+#define DEFLATE_HASH_BITS	15
+#define DEFLATE_WINDOW		32768
+#define DEFLATE_MAX_MATCH	258
+
+static const unsigned short LENGTH_BASE[30]  = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258,259 };
+static const unsigned char  LENGTH_EXTRA[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const unsigned short DIST_BASE[31]    = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,32769 };
+static const unsigned char  DIST_EXTRA[30]   = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+// Fixed Huffman codes, bit reversed once so they are written least significant bit first like everything else
+struct FixedCodes {
+	unsigned short literals[288];
+	unsigned char literalLengths[288];
+	unsigned char distances[30];
+	FixedCodes(){
+		for (int symbol = 0; symbol < 288; symbol++){
+			unsigned int code; int length;
+			if (symbol < 144)		{ code = 0x30 + symbol; length = 8; }
+			else if (symbol < 256)	{ code = 0x190 + symbol - 144; length = 9; }
+			else if (symbol < 280)	{ code = symbol - 256; length = 7; }
+			else					{ code = 0xc0 + symbol - 280; length = 8; }
+			literals[symbol] = (unsigned short)reverseBits(code, length);
+			literalLengths[symbol] = (unsigned char)length;
+		}
+		for (int symbol = 0; symbol < 30; symbol++)
+			distances[symbol] = (unsigned char)reverseBits(symbol, 5);
+	}
+	static unsigned int reverseBits(unsigned int code, int n){
+		unsigned int reversed = 0;
+		for (int i = 0; i < n; i++)
+			reversed |= ((code >> i) & 1) << (n - 1 - i);
+		return reversed;
+	}
+};
+
+// Writes into a buffer sized for the worst case (every byte a 9 bit literal)
+struct BitWriter {
+	unsigned char * out;
+	unsigned long long bits;
+	int count;
+};
+
+static void putBits(BitWriter & w, unsigned int value, int n){
+	w.bits |= (unsigned long long)value << w.count;
+	w.count += n;
+	while (w.count >= 8){
+		*w.out++ = (unsigned char)w.bits;
+		w.bits >>= 8;
+		w.count -= 8;
+	}
+}
+
+static void putLiteral(BitWriter & w, const FixedCodes & codes, int symbol){
+	putBits(w, codes.literals[symbol], codes.literalLengths[symbol]);
+}
+
+static void putMatch(BitWriter & w, const FixedCodes & codes, int length, int distance){
+	int l = 0;
+	while (LENGTH_BASE[l + 1] <= length)
+		l++;
+	putLiteral(w, codes, 257 + l);
+	putBits(w, length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+	int d = 0;
+	while (DIST_BASE[d + 1] <= distance)
+		d++;
+	putBits(w, codes.distances[d], 5);
+	putBits(w, distance - DIST_BASE[d], DIST_EXTRA[d]);
+}
+
+static unsigned int hash3(const unsigned char * p){
+	unsigned int v = p[0] | p[1] << 8 | p[2] << 16;
+	return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static void zlibDeflate(const unsigned char * data, size_t size, std::vector<unsigned char> & out){
+	static const FixedCodes codes;
+	size_t start = out.size();
+	out.resize(start + 2 + size * 9 / 8 + 16);
+	out[start] = 0x78;		// Deflate, 32K window
+	out[start + 1] = 0x01;	// Fastest compression, check bits
+
+	BitWriter w = { &out[start + 2], 0, 0 };
+	putBits(w, 1, 1);		// Final block
+	putBits(w, 1, 2);		// Fixed Huffman codes
+
+	std::vector<int> head((size_t)1 << DEFLATE_HASH_BITS, -1);
+	size_t i = 0;
+	while (i + 3 <= size){
+		unsigned int h = hash3(data + i);
+		int candidate = head[h];
+		head[h] = (int)i;
+
+		size_t length = 0;
+		if (candidate >= 0 && i - candidate <= DEFLATE_WINDOW){
+			size_t maxLength = size - i < DEFLATE_MAX_MATCH ? size - i : DEFLATE_MAX_MATCH;
+			const unsigned char * a = data + candidate;
+			const unsigned char * b = data + i;
+			while (length < maxLength && a[length] == b[length])
+				length++;
+		}
+
+		if (length >= 3){
+			putMatch(w, codes, (int)length, (int)(i - candidate));
+			// Hash the positions the match skips, so later matches can start inside it
+			size_t end = i + length;
+			for (i++; i < end; i++){
+				if (i + 3 <= size)
+					head[hash3(data + i)] = (int)i;
+			}
+		} else {
+			putLiteral(w, codes, data[i]);
+			i++;
+		}
+	}
+	for (; i < size; i++)
+		putLiteral(w, codes, data[i]);
+	putLiteral(w, codes, 256);		// End of block
+	if (w.count > 0)
+		putBits(w, 0, 8 - w.count);
+	out.resize(w.out - &out[0]);
+
+	unsigned int a = 1, b = 0;
+	for (size_t k = 0; k < size; ){
+		size_t end = k + 5552 < size ? k + 5552 : size;	// Largest run before the sums can overflow
+		for (; k < end; k++){
+			a += data[k];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	writeBE32(out, b << 16 | a);
+}
+
+struct CRCTable {
+	unsigned int entries[256];
+	CRCTable(){
+		for (unsigned int n = 0; n < 256; n++){
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static unsigned int crc32(const unsigned char * data, size_t size){
+	static const CRCTable table;	// Built once, on the first encoder thread to get here
+	unsigned int c = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+		c = table.entries[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+static void writeChunk(std::vector<unsigned char> & out, const char * type, const unsigned char * data, size_t size){
+	writeBE32(out, (unsigned int)size);
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	if (size > 0)
+		out.insert(out.end(), data, data + size);
+	writeBE32(out, crc32(&out[start], size + 4));
+}
+
+static unsigned char paeth(int a, int b, int c){
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return (unsigned char)a;
+	if (pb <= pc) return (unsigned char)b;
+	return (unsigned char)c;
+}
+
+void encodePNG(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out){
+	size_t rowBytes = (size_t)width * 3;
+	std::vector<unsigned char> filtered((rowBytes + 1) * height);
+	std::vector<unsigned char> rows(rowBytes * 2, 0);	// Current and prior row, RGB (the prior of the first row is 0)
+	std::vector<unsigned char> candidates(rowBytes * 5);
+
+	for (int y = 0; y < height; y++){
+		unsigned char * row = &rows[(y & 1) * rowBytes];
+		const unsigned char * prior = &rows[((y + 1) & 1) * rowBytes];
+		const unsigned char * pixel = sourceRow(rgba, width, height, y, flip);
+		for (int x = 0; x < width; x++){
+			row[x * 3 + 0] = pixel[x * 4 + 0];
+			row[x * 3 + 1] = pixel[x * 4 + 1];
+			row[x * 3 + 2] = pixel[x * 4 + 2];
+		}
+
+		// Every filter type, keep the one with the smallest sum of residuals (as signed bytes)
+		unsigned char * candidate[5];
+		for (int filter = 0; filter < 5; filter++)
+			candidate[filter] = &candidates[filter * rowBytes];
+		for (size_t i = 0; i < rowBytes; i++){
+			int left = i >= 3 ? row[i - 3] : 0;
+			int up = prior[i];
+			int upLeft = i >= 3 ? prior[i - 3] : 0;
+			candidate[0][i] = row[i];
+			candidate[1][i] = (unsigned char)(row[i] - left);
+			candidate[2][i] = (unsigned char)(row[i] - up);
+			candidate[3][i] = (unsigned char)(row[i] - ((left + up) >> 1));
+			candidate[4][i] = (unsigned char)(row[i] - paeth(left, up, upLeft));
+		}
+		int best = 0;
+		unsigned int bestSum = 0xFFFFFFFFu;
+		for (int filter = 0; filter < 5; filter++){
+			unsigned int sum = 0;
+			for (size_t i = 0; i < rowBytes; i++)
+				sum += abs((int)(signed char)candidate[filter][i]);
+			if (sum < bestSum){
+				bestSum = sum;
+				best = filter;
+			}
+		}
+		unsigned char * target = &filtered[y * (rowBytes + 1)];
+		target[0] = (unsigned char)best;
+		memcpy(target + 1, candidate[best], rowBytes);
+	}
+
+	static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.assign(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+
+	unsigned char header[13];
+	header[0] = (unsigned char)(width >> 24); header[1] = (unsigned char)(width >> 16); header[2] = (unsigned char)(width >> 8); header[3] = (unsigned char)width;
+	header[4] = (unsigned char)(height >> 24); header[5] = (unsigned char)(height >> 16); header[6] = (unsigned char)(height >> 8); header[7] = (unsigned char)height;
+	header[8] = 8;		// Bits per channel
+	header[9] = 2;		// RGB
+	header[10] = 0;		// Deflate
+	header[11] = 0;		// Adaptive filtering
+	header[12] = 0;		// Not interlaced
+	writeChunk(out, "IHDR", header, 13);
+
+	std::vector<unsigned char> compressed;
+	compressed.reserve(filtered.size() / 2);
+	zlibDeflate(&filtered[0], filtered.size(), compressed);
+	writeChunk(out, "IDAT", &compressed[0], compressed.size());
+	writeChunk(out, "IEND", NULL, 0);
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Y4M
+// -------------------------------------------------------------------------------------------------
+
+void encodeY4MHeader(int width, int height, int frameRate, std::vector<unsigned char> & out){
+	char header[128];
+	int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, frameRate);
+	out.assign(header, header + length);
+}
+
+static unsigned char clampByte(int value){
+	return (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+void encodeY4MFrame(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out){
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+	static const char FRAME_HEADER[] = "FRAME\n";
+	out.resize(6 + lumaSize + chromaSize * 2);
+	memcpy(&out[0], FRAME_HEADER, 6);
+	unsigned char * luma = &out[6];
+	unsigned char * cb = luma + lumaSize;
+	unsigned char * cr = cb + chromaSize;
+
+	// Y = 0.299 R + 0.587 G + 0.114 B in 8.8 fixed point
+	for (int y = 0; y < height; y++){
+		const unsigned char * pixel = sourceRow(rgba, width, height, y, flip);
+		unsigned char * target = luma + (size_t)y * width;
+		for (int x = 0; x < width; x++, pixel += 4)
+			target[x] = (unsigned char)((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+	}
+
+	// Cb and Cr of each 2x2 block's average colour (edge blocks repeat the last row / column)
+	for (int cy = 0; cy < chromaHeight; cy++){
+		const unsigned char * row0 = sourceRow(rgba, width, height, cy * 2, flip);
+		const unsigned char * row1 = sourceRow(rgba, width, height, cy * 2 + 1 < height ? cy * 2 + 1 : cy * 2, flip);
+		for (int cx = 0; cx < chromaWidth; cx++){
+			int x0 = cx * 2 * 4;
+			int x1 = cx * 2 + 1 < width ? x0 + 4 : x0;
+			int r = row0[x0 + 0] + row0[x1 + 0] + row1[x0 + 0] + row1[x1 + 0];
+			int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+			int b = row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2];
+			// Sums of 4 pixels: the weights are scaled down by 4 more (>> 10)
+			cb[(size_t)cy * chromaWidth + cx] = clampByte((-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10);
+			cr[(size_t)cy * chromaWidth + cx] = clampByte((128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10);
+		}
+	}
+}
+
+
+
+void benchmarkImageEncoders(const char * imagepath, int iterations){
+	FILE * file = fopen(imagepath, "rb");
+	if (!file){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+		return;
+	}
+	std::vector<unsigned char> data;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	data.resize(size > 0 ? size : 0);
+	size_t read = size > 0 ? fread(&data[0], 1, size, file) : 0;
+	fclose(file);
+
+	ImageInfo info;
+	if (read != data.size() || data.empty() || !readImageInfo(&data[0], data.size(), info))
+		return;
+	std::vector<unsigned char> pixels((size_t)info.width * info.height * info.channels);
+	bool decoded = memcmp(&data[0], "qoif", 4) == 0 ? decodeQOI(&data[0], data.size(), &pixels[0], false) : decodePNG(&data[0], data.size(), &pixels[0], false);
+	if (!decoded)
+		return;
+
+	// Captured frames are RGBA
+	std::vector<unsigned char> rgba((size_t)info.width * info.height * 4);
+	for (size_t i = 0; i < (size_t)info.width * info.height; i++){
+		rgba[i * 4 + 0] = pixels[i * info.channels + 0];
+		rgba[i * 4 + 1] = pixels[i * info.channels + 1];
+		rgba[i * 4 + 2] = pixels[i * info.channels + 2];
+		rgba[i * 4 + 3] = 255;
+	}
+
+	const char * names[3] = { "PNG", "QOI", "Y4M" };
+	std::vector<unsigned char> out;
+	for (int e = 0; e < 3; e++){
+		double start = getTime();
+		for (int i = 0; i < iterations; i++){
+			if (e == 0)			encodePNG(&rgba[0], info.width, info.height, true, out);
+			else if (e == 1)	encodeQOI(&rgba[0], info.width, info.height, true, out);
+			else				encodeY4MFrame(&rgba[0], info.width, info.height, true, out);
+		}
+		double seconds = getTime() - start;
+		double megabytes = (double)info.width * info.height * 3 * iterations / (1024.0 * 1024.0);
+		printf("[DEBUG] %s encoder: %d x %d, %.3f ms/frame, %.1f MB/s, %.1f%% of the raw size\n", names[e], info.width, info.height,
+			seconds * 1000.0 / iterations, seconds > 0.0 ? megabytes / seconds : 0.0, out.size() * 100.0 / ((double)info.width * info.height * 3));
+	}
+}
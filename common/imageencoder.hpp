@@ -0,0 +1,20 @@
+#ifndef IMAGEENCODER_HPP
+#define IMAGEENCODER_HPP
+
+// Encoders for captured frames: RGBA pixels in (the alpha is dropped, frames are opaque), file bytes out. Rows are
+// top first, or bottom first with flip (as glReadPixels returns them). The PNG encoder is built for speed: one
+// filter per row picked by the smallest sum of residuals, fixed Huffman codes and one match candidate per hash.
+
+// Replace out with a .QOI / .PNG file of the image
+void encodeQOI(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out);
+void encodePNG(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out);
+
+// YUV4MPEG2 stream: the header once, then one frame after another (FRAME line, Y plane, then Cb and Cr planes at half
+// resolution rounded up, full range BT.601 as in JPEG). The header says XCOLORRANGE=FULL, readers assume studio range without it.
+void encodeY4MHeader(int width, int height, int frameRate, std::vector<unsigned char> & out);
+void encodeY4MFrame(const unsigned char * rgba, int width, int height, bool flip, std::vector<unsigned char> & out);
+
+// Print encode time and output size of each format for a .QOI or .PNG image
+void benchmarkImageEncoders(const char * imagepath, int iterations);
+
+#endif
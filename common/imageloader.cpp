@@ -0,0 +1,788 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "timer.hpp"
+#include "texture.hpp"
+#include "imageloader.hpp"
+#include "jobsystem.hpp"
+
+// Small QOI and PNG decoders.
+// - QOI is a single pass over the file with a 64 entry colour cache, so it decodes close to memcpy speed.
+// - PNG needs an inflate (zlib) pass and per-row filter reconstruction. Both are serial within one image
+//   (every row depends on the one above it), so loadImages() parallelizes across images instead.
+// - Only 8 bits per channel, non-interlaced PNGs are handled. Everything else is rejected like the BMP loader does.
+
+
+static bool readFile(const char * path, std::vector<unsigned char> & out){
+	FILE * file = fopen(path, "rb");
+	if (!file){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", path);
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	out.resize(size > 0 ? size : 0);
+	size_t read = size > 0 ? fread(&out[0], 1, size, file) : 0;
+	fclose(file);
+	return read == out.size() && !out.empty();
+}
+
+static unsigned int readBE32(const unsigned char * p){
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+#define IMAGE_MAX_DIMENSION 16384		// Larger headers are rejected before anything is allocated for them
+
+static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+static bool isQOI(const unsigned char * data, size_t size){
+	return size >= 14 && memcmp(data, "qoif", 4) == 0;
+}
+
+static bool isPNG(const unsigned char * data, size_t size){
+	return size >= 33 && memcmp(data, PNG_SIGNATURE, 8) == 0;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// QOI
+// -------------------------------------------------------------------------------------------------
+
+#define QOI_OP_INDEX 0x00 // 00xxxxxx
+#define QOI_OP_DIFF  0x40 // 01xxxxxx
+#define QOI_OP_LUMA  0x80 // 10xxxxxx
+#define QOI_OP_RUN   0xc0 // 11xxxxxx
+#define QOI_OP_RGB   0xfe // 11111110
+#define QOI_OP_RGBA  0xff // 11111111
+#define QOI_MASK_2   0xc0 // 11000000
+#define QOI_MAX_RUN  62   // Pixels of the longest QOI_OP_RUN, the most one byte of the stream can give
+
+static bool readQOIInfo(const unsigned char * data, size_t size, ImageInfo & info){
+	if (!isQOI(data, size))
+		return false;
+	info.width    = readBE32(data + 4);
+	info.height   = readBE32(data + 8);
+	info.channels = data[12];
+	if (info.width == 0 || info.height == 0 || (info.channels != 3 && info.channels != 4))
+		return false;
+	if (info.width > IMAGE_MAX_DIMENSION || info.height > IMAGE_MAX_DIMENSION)
+		return false;
+
+	// Even all runs (after the 14 byte header, before the 8 byte end marker) can't fill more pixels than this
+	return size >= 22 && (unsigned long long)info.width * info.height <= (unsigned long long)(size - 22) * QOI_MAX_RUN;
+}
+
+bool decodeQOI(const unsigned char * data, size_t size, unsigned char * out, bool flip){
+	ImageInfo info;
+	if (!readQOIInfo(data, size, info)){
+		printf("Not a correct QOI file\n");
+		return false;
+	}
+
+	const unsigned int channels = info.channels;
+	const size_t stride = (size_t)info.width * channels;
+	const unsigned char * p   = data + 14;
+	const unsigned char * end = data + size - 8; // 8 byte end marker
+
+	unsigned char index[64][4];
+	memset(index, 0, sizeof(index));
+	unsigned char px[4] = { 0, 0, 0, 255 };
+	unsigned int run = 0;
+
+	for (unsigned int y = 0; y < info.height; y++){
+		unsigned char * row = out + (flip ? (info.height - 1 - y) : y) * stride;
+		unsigned char * rowEnd = row + stride;
+
+		for (unsigned char * o = row; o < rowEnd; o += channels){
+			if (run > 0){
+				run--;
+			}else if (p < end){
+				unsigned char b1 = *p++;
+
+				if (b1 == QOI_OP_RGB){
+					px[0] = p[0]; px[1] = p[1]; px[2] = p[2];
+					p += 3;
+				}else if (b1 == QOI_OP_RGBA){
+					px[0] = p[0]; px[1] = p[1]; px[2] = p[2]; px[3] = p[3];
+					p += 4;
+				}else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX){
+					memcpy(px, index[b1], 4);
+				}else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF){
+					px[0] += ((b1 >> 4) & 0x03) - 2;
+					px[1] += ((b1 >> 2) & 0x03) - 2;
+					px[2] += ( b1       & 0x03) - 2;
+				}else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA){
+					unsigned char b2 = *p++;
+					int vg = (b1 & 0x3f) - 32;
+					px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+					px[1] += vg;
+					px[2] += vg - 8 +  (b2       & 0x0f);
+				}else{ // QOI_OP_RUN
+					run = (b1 & 0x3f);
+				}
+
+				memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+			}
+
+			o[0] = px[0];
+			o[1] = px[1];
+			o[2] = px[2];
+			if (channels == 4)
+				o[3] = px[3];
+		}
+	}
+
+	return true;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Inflate (RFC 1950 zlib stream around RFC 1951 deflate blocks)
+// -------------------------------------------------------------------------------------------------
+
+#define HUFFMAN_FAST_BITS 9
+#define HUFFMAN_FAST_MASK ((1 << HUFFMAN_FAST_BITS) - 1)
+
+// Canonical Huffman table with a direct lookup for codes up to HUFFMAN_FAST_BITS long
+struct Huffman {
+	unsigned short fast[1 << HUFFMAN_FAST_BITS];	// (code length << 9) | symbol, 0 = use the slow path
+	unsigned short firstCode[16];
+	unsigned short firstSymbol[16];
+	unsigned int   maxCode[17];
+	unsigned char  size[288];
+	unsigned short value[288];
+};
+
+struct Inflater {
+	const unsigned char * in;
+	const unsigned char * inEnd;
+	unsigned int bitBuffer;
+	int bitCount;
+	unsigned char * out;
+	unsigned char * outStart;
+	unsigned char * outEnd;
+	Huffman length;
+	Huffman distance;
+};
+
+static int bitReverse(int code, int bits){
+	int result = 0;
+	for (int i = 0; i < bits; i++){
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+static bool buildHuffman(Huffman & h, const unsigned char * codeLengths, int count){
+	int sizes[17] = { 0 };
+	int nextCode[16];
+
+	memset(h.fast, 0, sizeof(h.fast));
+	for (int i = 0; i < count; i++)
+		sizes[codeLengths[i]]++;
+	sizes[0] = 0;
+
+	int code = 0, k = 0;
+	for (int i = 1; i < 16; i++){
+		nextCode[i]      = code;
+		h.firstCode[i]   = (unsigned short)code;
+		h.firstSymbol[i] = (unsigned short)k;
+		code += sizes[i];
+		if (sizes[i] && code - 1 >= (1 << i))
+			return false; // Over-subscribed code lengths
+		h.maxCode[i] = code << (16 - i); // Left-aligned so the slow path can compare 16 bit codes
+		code <<= 1;
+		k += sizes[i];
+	}
+	h.maxCode[16] = 0x10000;
+
+	for (int i = 0; i < count; i++){
+		int s = codeLengths[i];
+		if (!s)
+			continue;
+		int c = nextCode[s] - h.firstCode[s] + h.firstSymbol[s];
+		h.size[c]  = (unsigned char)s;
+		h.value[c] = (unsigned short)i;
+		if (s <= HUFFMAN_FAST_BITS){
+			// Deflate reads codes LSB first, so every bit-reversed suffix maps to the same entry
+			for (int j = bitReverse(nextCode[s], s); j < (1 << HUFFMAN_FAST_BITS); j += (1 << s))
+				h.fast[j] = (unsigned short)((s << 9) | i);
+		}
+		nextCode[s]++;
+	}
+	return true;
+}
+
+static void fillBits(Inflater & z){
+	while (z.bitCount <= 24){
+		unsigned int byte = (z.in < z.inEnd) ? *z.in++ : 0;
+		z.bitBuffer |= byte << z.bitCount;
+		z.bitCount += 8;
+	}
+}
+
+static unsigned int getBits(Inflater & z, int n){
+	if (z.bitCount < n)
+		fillBits(z);
+	unsigned int bits = z.bitBuffer & ((1u << n) - 1);
+	z.bitBuffer >>= n;
+	z.bitCount -= n;
+	return bits;
+}
+
+static int decodeSymbol(Inflater & z, const Huffman & h){
+	if (z.bitCount < 16)
+		fillBits(z);
+
+	int fast = h.fast[z.bitBuffer & HUFFMAN_FAST_MASK];
+	if (fast){
+		int s = fast >> 9;
+		z.bitBuffer >>= s;
+		z.bitCount -= s;
+		return fast & 511;
+	}
+
+	// Slow path: codes longer than HUFFMAN_FAST_BITS
+	unsigned int k = bitReverse(z.bitBuffer & 0xffff, 16);
+	int s;
+	for (s = HUFFMAN_FAST_BITS + 1; ; s++)
+		if (k < h.maxCode[s])
+			break;
+	if (s >= 16)
+		return -1;
+	int b = (k >> (16 - s)) - h.firstCode[s] + h.firstSymbol[s];
+	if (b >= 288 || h.size[b] != s)
+		return -1;
+	z.bitBuffer >>= s;
+	z.bitCount -= s;
+	return h.value[b];
+}
+
+static const unsigned short LENGTH_BASE[31]  = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258,0,0 };
+static const unsigned char  LENGTH_EXTRA[31] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+static const unsigned short DIST_BASE[32]    = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0 };
+static const unsigned char  DIST_EXTRA[32]   = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13,0,0 };
+
+static bool inflateHuffmanBlock(Inflater & z){
+	for (;;){
+		int symbol = decodeSymbol(z, z.length);
+		if (symbol < 0)
+			return false;
+
+		if (symbol < 256){
+			if (z.out >= z.outEnd)
+				return false;
+			*z.out++ = (unsigned char)symbol;
+			continue;
+		}
+		if (symbol == 256)
+			return true; // End of block
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		int length = LENGTH_BASE[symbol] + getBits(z, LENGTH_EXTRA[symbol]);
+
+		symbol = decodeSymbol(z, z.distance);
+		if (symbol < 0 || symbol >= 30)
+			return false;
+		int dist = DIST_BASE[symbol] + getBits(z, DIST_EXTRA[symbol]);
+
+		if (z.out - z.outStart < dist || z.outEnd - z.out < length)
+			return false;
+
+		unsigned char * src = z.out - dist;
+		if (dist >= length){
+			memcpy(z.out, src, length);
+			z.out += length;
+		}else{
+			// Overlapping copy (run of a repeated pattern), must go byte by byte
+			while (length--)
+				*z.out++ = *src++;
+		}
+	}
+}
+
+static bool inflateStoredBlock(Inflater & z){
+	// Drop the bits up to the byte boundary, then return whole unused bytes to the input
+	getBits(z, z.bitCount & 7);
+	unsigned char header[4];
+	for (int i = 0; i < 4; i++)
+		header[i] = (unsigned char)getBits(z, 8);
+	z.in -= z.bitCount / 8;
+	z.bitBuffer = 0;
+	z.bitCount = 0;
+
+	unsigned int len  = header[0] | (header[1] << 8);
+	unsigned int nlen = header[2] | (header[3] << 8);
+	if (len != (~nlen & 0xffff) || (size_t)(z.inEnd - z.in) < len || (size_t)(z.outEnd - z.out) < len)
+		return false;
+	memcpy(z.out, z.in, len);
+	z.in  += len;
+	z.out += len;
+	return true;
+}
+
+static bool buildFixedTables(Inflater & z){
+	unsigned char lengths[288];
+	int i;
+	for (i = 0;   i < 144; i++) lengths[i] = 8;
+	for (;        i < 256; i++) lengths[i] = 9;
+	for (;        i < 280; i++) lengths[i] = 7;
+	for (;        i < 288; i++) lengths[i] = 8;
+	if (!buildHuffman(z.length, lengths, 288))
+		return false;
+	for (i = 0; i < 30; i++) lengths[i] = 5;
+	return buildHuffman(z.distance, lengths, 30);
+}
+
+static bool buildDynamicTables(Inflater & z){
+	static const unsigned char ORDER[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+
+	int hlit  = getBits(z, 5) + 257;
+	int hdist = getBits(z, 5) + 1;
+	int hclen = getBits(z, 4) + 4;
+	if (hlit > 286 || hdist > 30)		// The 5 bit counts can say 288 and 32, which RFC 1951 doesn't allow
+		return false;
+
+	unsigned char codeLengthSizes[19] = { 0 };
+	for (int i = 0; i < hclen; i++)
+		codeLengthSizes[ORDER[i]] = (unsigned char)getBits(z, 3);
+
+	Huffman codeLength;
+	if (!buildHuffman(codeLength, codeLengthSizes, 19))
+		return false;
+
+	unsigned char lengths[286 + 32];
+	int n = 0;
+	while (n < hlit + hdist){
+		int c = decodeSymbol(z, codeLength);
+		if (c < 0 || c >= 19)
+			return false;
+		if (c < 16){
+			lengths[n++] = (unsigned char)c;
+			continue;
+		}
+
+		unsigned char fill = 0;
+		int repeat;
+		if (c == 16){
+			if (n == 0)
+				return false;
+			repeat = getBits(z, 2) + 3;
+			fill = lengths[n - 1];
+		}else if (c == 17){
+			repeat = getBits(z, 3) + 3;
+		}else{
+			repeat = getBits(z, 7) + 11;
+		}
+		if (n + repeat > hlit + hdist)
+			return false;
+		memset(lengths + n, fill, repeat);
+		n += repeat;
+	}
+
+	return buildHuffman(z.length, lengths, hlit) && buildHuffman(z.distance, lengths + hlit, hdist);
+}
+
+bool zlibInflate(const unsigned char * in, size_t inSize, unsigned char * out, size_t outSize, size_t & written){
+	if (inSize < 2)
+		return false;
+	unsigned int cmf = in[0], flg = in[1];
+	if ((cmf * 256 + flg) % 31 != 0 || (cmf & 15) != 8 || (flg & 32) != 0)
+		return false; // Bad header, not deflate, or preset dictionary
+
+	Inflater z;
+	z.in        = in + 2;
+	z.inEnd     = in + inSize;
+	z.bitBuffer = 0;
+	z.bitCount  = 0;
+	z.out       = out;
+	z.outStart  = out;
+	z.outEnd    = out + outSize;
+
+	bool last;
+	do{
+		last = getBits(z, 1) != 0;
+		unsigned int type = getBits(z, 2);
+
+		bool ok;
+		if (type == 0)
+			ok = inflateStoredBlock(z);
+		else if (type == 1)
+			ok = buildFixedTables(z) && inflateHuffmanBlock(z);
+		else if (type == 2)
+			ok = buildDynamicTables(z) && inflateHuffmanBlock(z);
+		else
+			ok = false;
+
+		if (!ok)
+			return false;
+	}while (!last);
+
+	written = z.out - z.outStart;
+	return true;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// PNG
+// -------------------------------------------------------------------------------------------------
+
+struct PNGHeader {
+	ImageInfo info;
+	unsigned int colorType;
+	unsigned int sourceChannels;	// Channels stored in the file (1 = grey or palette index)
+	unsigned char palette[256][4];
+	bool hasTransparency;
+};
+
+static bool readPNGHeader(const unsigned char * data, size_t size, PNGHeader & png){
+	if (!isPNG(data, size) || memcmp(data + 12, "IHDR", 4) != 0)
+		return false;
+
+	const unsigned char * ihdr = data + 16;
+	png.info.width  = readBE32(ihdr);
+	png.info.height = readBE32(ihdr + 4);
+	unsigned int bitDepth  = ihdr[8];
+	png.colorType          = ihdr[9];
+	unsigned int interlace = ihdr[12];
+	png.hasTransparency = false;
+
+	if (png.info.width == 0 || png.info.height == 0 || bitDepth != 8 || interlace != 0)
+		return false;
+	if (png.info.width > IMAGE_MAX_DIMENSION || png.info.height > IMAGE_MAX_DIMENSION)
+		return false;
+
+	switch (png.colorType){
+	case 0: png.sourceChannels = 1; png.info.channels = 3; break; // Grey, expanded to RGB
+	case 2: png.sourceChannels = 3; png.info.channels = 3; break; // RGB
+	case 3: png.sourceChannels = 1; png.info.channels = 3; break; // Palette, RGBA if it has a tRNS chunk
+	case 4: png.sourceChannels = 2; png.info.channels = 4; break; // Grey + alpha, expanded to RGBA
+	case 6: png.sourceChannels = 4; png.info.channels = 4; break; // RGBA
+	default: return false;
+	}
+
+	// Palette images need tRNS to know their final channel count
+	if (png.colorType == 3){
+		const unsigned char * p = data + 8;
+		const unsigned char * end = data + size;
+		while (end - p >= 12){
+			unsigned int length = readBE32(p);
+			if ((size_t)(end - p - 12) < length)
+				break;
+			if (memcmp(p + 4, "tRNS", 4) == 0){
+				png.hasTransparency = true;
+				png.info.channels = 4;
+			}else if (memcmp(p + 4, "IDAT", 4) == 0){
+				break;
+			}
+			p += 12 + length;
+		}
+	}
+	return true;
+}
+
+static unsigned char paeth(int a, int b, int c){
+	int p  = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return (unsigned char)a;
+	if (pb <= pc) return (unsigned char)b;
+	return (unsigned char)c;
+}
+
+// Undo one row's filter in place. prior is the reconstructed row above (all zero for the first row).
+static bool unfilterRow(unsigned int filter, unsigned char * row, const unsigned char * prior, size_t rowBytes, unsigned int bpp){
+	size_t i;
+	switch (filter){
+	case 0: // None
+		break;
+	case 1: // Sub
+		for (i = bpp; i < rowBytes; i++)
+			row[i] += row[i - bpp];
+		break;
+	case 2: // Up
+		for (i = 0; i < rowBytes; i++)
+			row[i] += prior[i];
+		break;
+	case 3: // Average
+		for (i = 0; i < bpp; i++)
+			row[i] += prior[i] >> 1;
+		for (; i < rowBytes; i++)
+			row[i] += (unsigned char)((row[i - bpp] + prior[i]) >> 1);
+		break;
+	case 4: // Paeth
+		for (i = 0; i < bpp; i++)
+			row[i] += prior[i];
+		for (; i < rowBytes; i++)
+			row[i] += paeth(row[i - bpp], prior[i], prior[i - bpp]);
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+bool decodePNG(const unsigned char * data, size_t size, unsigned char * out, bool flip){
+	PNGHeader png;
+	if (!readPNGHeader(data, size, png)){
+		printf("Not a supported PNG file (8 bits per channel, non-interlaced only)\n");
+		return false;
+	}
+
+	// Gather the palette and the (possibly split) compressed image data
+	std::vector<unsigned char> compressed;
+	memset(png.palette, 255, sizeof(png.palette));
+	const unsigned char * p = data + 8;
+	const unsigned char * end = data + size;
+	while (end - p >= 12){
+		unsigned int length = readBE32(p);
+		const unsigned char * chunk = p + 8;
+		if ((size_t)(end - chunk - 4) < length)
+			return false;
+
+		if (memcmp(p + 4, "PLTE", 4) == 0){
+			for (unsigned int i = 0; i < length / 3 && i < 256; i++){
+				png.palette[i][0] = chunk[i * 3];
+				png.palette[i][1] = chunk[i * 3 + 1];
+				png.palette[i][2] = chunk[i * 3 + 2];
+			}
+		}else if (memcmp(p + 4, "tRNS", 4) == 0 && png.colorType == 3){
+			for (unsigned int i = 0; i < length && i < 256; i++)
+				png.palette[i][3] = chunk[i];
+		}else if (memcmp(p + 4, "IDAT", 4) == 0){
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}else if (memcmp(p + 4, "IEND", 4) == 0){
+			break;
+		}
+		p = chunk + length + 4; // Skip the CRC
+	}
+
+	// Every row is prefixed by its filter type byte
+	const unsigned int width = png.info.width;
+	const unsigned int height = png.info.height;
+	const unsigned int bpp = png.sourceChannels;
+	const size_t rowBytes = (size_t)width * bpp;
+	const size_t filteredSize = (rowBytes + 1) * height;
+	std::vector<unsigned char> filtered(filteredSize);
+	size_t written = 0;
+	if (compressed.empty() || !zlibInflate(&compressed[0], compressed.size(), &filtered[0], filteredSize, written) || written != filteredSize){
+		printf("Corrupt PNG image data\n");
+		return false;
+	}
+
+	const unsigned int channels = png.info.channels;
+	const size_t stride = (size_t)width * channels;
+	std::vector<unsigned char> zeroRow(rowBytes, 0);
+	const unsigned char * prior = &zeroRow[0];
+
+	for (unsigned int y = 0; y < height; y++){
+		unsigned char * line = &filtered[y * (rowBytes + 1)];
+		unsigned char * row = line + 1;
+		if (!unfilterRow(line[0], row, prior, rowBytes, bpp)){
+			printf("Corrupt PNG row filter\n");
+			return false;
+		}
+		prior = row;
+
+		unsigned char * dst = out + (flip ? (height - 1 - y) : y) * stride;
+		unsigned int x;
+		switch (png.colorType){
+		case 2:
+		case 6:
+			memcpy(dst, row, stride);
+			break;
+		case 0:
+			for (x = 0; x < width; x++, dst += 3)
+				dst[0] = dst[1] = dst[2] = row[x];
+			break;
+		case 4:
+			for (x = 0; x < width; x++, dst += 4){
+				dst[0] = dst[1] = dst[2] = row[x * 2];
+				dst[3] = row[x * 2 + 1];
+			}
+			break;
+		case 3:
+			for (x = 0; x < width; x++, dst += channels)
+				memcpy(dst, png.palette[row[x]], channels);
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Texture creation
+// -------------------------------------------------------------------------------------------------
+
+bool readImageInfo(const unsigned char * data, size_t size, ImageInfo & info){
+	if (isQOI(data, size))
+		return readQOIInfo(data, size, info);
+
+	PNGHeader png;
+	if (readPNGHeader(data, size, png)){
+		info = png.info;
+		return true;
+	}
+	return false;
+}
+
+static bool decodeImage(const unsigned char * data, size_t size, unsigned char * out){
+	if (isQOI(data, size))
+		return decodeQOI(data, size, out, true);
+	return decodePNG(data, size, out, true);
+}
+
+// Create a texture the same way loadBMP_custom does. pixels may be an offset into a bound unpack buffer.
+static GLuint createTexture(const ImageInfo & info, const void * pixels){
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// Rows are tightly packed; the caller's unpack alignment is put back afterwards
+	GLenum format = (info.channels == 4) ? GL_RGBA : GL_RGB;
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, info.width, info.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	return textureID;
+}
+
+GLuint loadImage(const char * imagepath){
+
+	printf("Reading image %s\n", imagepath);
+
+	std::vector<unsigned char> file;
+	if (!readFile(imagepath, file))
+		return 0;
+
+	ImageInfo info;
+	if (!readImageInfo(&file[0], file.size(), info)){
+		printf("%s is not a supported QOI or PNG file\n", imagepath);
+		return 0;
+	}
+
+	std::vector<unsigned char> pixels((size_t)info.width * info.height * info.channels);
+	if (!decodeImage(&file[0], file.size(), &pixels[0]))
+		return 0;
+
+	return createTexture(info, &pixels[0]);
+}
+
+#define STAGING_ALIGNMENT 64	// Keep every image on its own cache line so workers never share one
+
+void loadImages(const char ** imagepaths, int count, GLuint * out_textureIDs){
+	if (count <= 0)
+		return;
+
+	// Read every file and its header up front, then lay the decoded images out back to back
+	std::vector< std::vector<unsigned char> > files(count);
+	std::vector<ImageInfo> infos(count);
+	std::vector<size_t> offsets(count);
+	std::vector<bool> valid(count, false);
+	size_t totalSize = 0;
+
+	for (int i = 0; i < count; i++){
+		printf("Reading image %s\n", imagepaths[i]);
+		out_textureIDs[i] = 0;
+		if (!readFile(imagepaths[i], files[i]))
+			continue;
+		if (!readImageInfo(&files[i][0], files[i].size(), infos[i])){
+			printf("%s is not a supported QOI or PNG file\n", imagepaths[i]);
+			continue;
+		}
+		valid[i] = true;
+		offsets[i] = totalSize;
+		totalSize += ((size_t)infos[i].width * infos[i].height * infos[i].channels + STAGING_ALIGNMENT - 1) & ~(size_t)(STAGING_ALIGNMENT - 1);
+	}
+	if (totalSize == 0)
+		return;
+
+	// Decode straight into a mapped pixel unpack buffer. If mapping fails, fall back to an aligned staging arena.
+	GLuint pbo;
+	glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+	unsigned char * staging = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	std::vector<unsigned char> arena;
+	if (staging == NULL){
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pbo);
+		pbo = 0;
+		arena.resize(totalSize + STAGING_ALIGNMENT);
+		staging = (unsigned char *)(((size_t)&arena[0] + STAGING_ALIGNMENT - 1) & ~(size_t)(STAGING_ALIGNMENT - 1));
+	}
+
+	// One job per image on the job system's threads. No GL calls happen in the jobs.
+	std::vector<char> decoded(count, 0);
+	parallelFor(count, 1, [&](int begin, int end){
+		for (int i = begin; i < end; i++){
+			if (valid[i])
+				decoded[i] = decodeImage(&files[i][0], files[i].size(), staging + offsets[i]) ? 1 : 0;
+		}
+	});
+
+	// Upload on this thread (the one owning the GL context)
+	if (pbo)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	for (int i = 0; i < count; i++){
+		if (!decoded[i])
+			continue;
+		const void * pixels = pbo ? (const void *)offsets[i] : (const void *)(staging + offsets[i]);
+		out_textureIDs[i] = createTexture(infos[i], pixels);
+	}
+
+	if (pbo){
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &pbo);
+	}
+}
+
+void benchmarkImageLoaders(const char * bmppath, const char * qoipath, const char * pngpath, int iterations){
+	const char * names[3] = { "BMP", "QOI", "PNG" };
+	const char * paths[3] = { bmppath, qoipath, pngpath };
+
+	for (int l = 0; l < 3; l++){
+		GLint width = 0, height = 0;
+		glFinish();
+		double start = getTime();
+		for (int i = 0; i < iterations; i++){
+			GLuint textureID = (l == 0) ? loadBMP_custom(paths[l]) : loadImage(paths[l]);
+			if (textureID == 0)
+				break;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glDeleteTextures(1, &textureID);
+		}
+		glFinish();
+		double seconds = getTime() - start;
+
+		double megabytes = (double)width * height * 3 * iterations / (1024.0 * 1024.0);
+		printf("[DEBUG] %s loader: %d x %d, %.3f ms/image, %.1f MB/s\n", names[l], width, height,
+			seconds * 1000.0 / iterations, seconds > 0.0 ? megabytes / seconds : 0.0);
+	}
+}
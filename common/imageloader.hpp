@@ -0,0 +1,33 @@
+#ifndef IMAGELOADER_HPP
+#define IMAGELOADER_HPP
+
+// Size and layout of a decoded image. Pixels are tightly packed, 8 bits per channel.
+struct ImageInfo {
+	unsigned int width;
+	unsigned int height;
+	unsigned int channels;	// 3 = RGB, 4 = RGBA
+};
+
+// Read the header of a .QOI or .PNG file already in memory (no pixel decoding)
+bool readImageInfo(const unsigned char * data, size_t size, ImageInfo & info);
+
+// Decode a .QOI / .PNG file already in memory into out (width * height * channels bytes).
+// With flip, the bottom row is written first so the result matches glTexImage2D / the BMP loader.
+bool decodeQOI(const unsigned char * data, size_t size, unsigned char * out, bool flip);
+bool decodePNG(const unsigned char * data, size_t size, unsigned char * out, bool flip);
+
+// Inflate a zlib stream (PNG's, also FBX's compressed arrays) into out, which must be large enough for the whole
+// result; written is the size of the result
+bool zlibInflate(const unsigned char * in, size_t inSize, unsigned char * out, size_t outSize, size_t & written);
+
+// Load a .QOI or .PNG file into a new mipmapped texture (format picked from the file signature)
+GLuint loadImage(const char * imagepath);
+
+// Load several .QOI / .PNG files at once: every image is decoded in a job (see jobsystem.hpp) straight
+// into one mapped pixel unpack buffer, then uploaded from it on the calling (GL) thread.
+void loadImages(const char ** imagepaths, int count, GLuint * out_textureIDs);
+
+// Print load throughput (MB/s of pixels) of the BMP, QOI and PNG loaders for the same image
+void benchmarkImageLoaders(const char * bmppath, const char * qoipath, const char * pngpath, int iterations);
+
+#endif
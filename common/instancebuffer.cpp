@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "instancebuffer.hpp"
+#include "glstate.hpp"
+
+GLuint createInstanceBuffer(const InstanceData * instances, int count){
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), instances, GL_STATIC_DRAW);
+	return buffer;
+}
+
+void updateInstanceBuffer(GLuint buffer, const InstanceData * instances, int count, int capacity){
+	cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	if (count > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), instances);
+}
+
+void bindInstanceAttributes(GLuint buffer){
+	cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// A mat4 attribute is four vec4 columns on consecutive locations
+	for (int column = 0; column < 4; column++){
+		GLuint location = INSTANCE_MODEL_LOCATION + column;
+		cachedEnableVertexAttribArray(location);
+		cachedVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), column * sizeof(glm::vec4));
+		glVertexAttribDivisor(location, 1);
+	}
+
+	cachedEnableVertexAttribArray(INSTANCE_ANIMATION_LOCATION);
+	cachedVertexAttribPointer(INSTANCE_ANIMATION_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), sizeof(glm::mat4));
+	glVertexAttribDivisor(INSTANCE_ANIMATION_LOCATION, 1);
+}
+
+void unbindInstanceAttributes(){
+	for (GLuint location = INSTANCE_MODEL_LOCATION; location <= INSTANCE_ANIMATION_LOCATION; location++){
+		glVertexAttribDivisor(location, 0);
+		cachedDisableVertexAttribArray(location);
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef INSTANCEBUFFER_HPP
+#define INSTANCEBUFFER_HPP
+
+// Instanced rendering: one glDrawElementsInstanced draws every copy of a mesh, each with its own base transform
+// and animation parameters read from a per-instance vertex buffer. The INSTANCED permutation of vertex.glsl
+// animates the instances itself from the frame time, so the buffer is written once and never touched again.
+
+#define INSTANCE_MODEL_LOCATION		8	// mat4 instanceModel takes locations 8 to 11
+#define INSTANCE_ANIMATION_LOCATION	12	// vec4 instanceAnimation
+
+// One instance, matches the per-instance attributes of vertex.glsl
+struct InstanceData {
+	glm::mat4 model;		// Base transform (position and size)
+	glm::vec4 animation;	// Rotation speed (rad/s, around Y), scaling speed, translation speed (0 = off), phase (s)
+};
+
+// Upload count instances into a new GL_STATIC_DRAW buffer
+GLuint createInstanceBuffer(const InstanceData * instances, int count);
+
+// Replace the contents of a buffer that changes every frame (ie. the instances left after culling). The old
+// storage is orphaned so the draws still reading it don't stall the upload.
+void updateInstanceBuffer(GLuint buffer, const InstanceData * instances, int count, int capacity);
+
+// Point the per-instance attributes (divisor 1) at buffer, and turn them off again after the instanced draws
+void bindInstanceAttributes(GLuint buffer);
+void unbindInstanceAttributes();
+
+#endif
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "timer.hpp"
+#include "jobsystem.hpp"
+#include "profiler.hpp"
+
+#define JOB_POOL_SIZE		4096	// Jobs each thread allocates round robin, power of 2
+#define JOB_DEQUE_SIZE		4096	// Power of 2
+#define JOB_SPIN_COUNT		64		// Failed steal rounds before an idle worker sleeps
+
+struct Job {
+	JobFunction function;
+	ParallelForFunction rangeFunction;	// parallelFor jobs split in two until at most batch items are left
+	void * data;
+	int begin, end, batch;
+	Job * parent;
+	std::atomic<int> unfinished;		// The job itself and its unfinished children
+};
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, thieves take from the top. Only the last job can be
+// contended, by the owner's pop and a steal, and the compare-exchange on top settles who gets it.
+struct JobDeque {
+	std::atomic<long long> top;
+	std::atomic<long long> bottom;
+	std::atomic<Job *> jobs[JOB_DEQUE_SIZE];
+};
+
+struct JobThread {
+	JobDeque deque;
+	Job * pool;
+	unsigned int allocated;
+	unsigned int random;				// Steal victim sequence
+	std::atomic<int> executed;
+	std::atomic<int> steals;
+	char padding[64];					// Keeps the next thread's deque indices off this thread's cache line
+};
+
+static JobThread * jobThreads = NULL;
+static unsigned int jobThreadCount = 0;
+static std::vector<std::thread> workers;
+static std::atomic<bool> running(false);
+static std::atomic<int> queuedJobs(0);
+static std::atomic<int> sleepingWorkers(0);
+static std::mutex sleepMutex;
+static std::condition_variable wakeUp;
+static thread_local int threadIndex = -1;
+
+
+
+// False if the deque is full (JOB_DEQUE_SIZE jobs queued and not yet popped or stolen)
+static bool pushJob(JobDeque & deque, Job * job){
+	long long bottom = deque.bottom.load();
+	if (bottom - deque.top.load() >= JOB_DEQUE_SIZE)
+		return false;
+	deque.jobs[bottom & (JOB_DEQUE_SIZE - 1)].store(job);
+	deque.bottom.store(bottom + 1);
+	return true;
+}
+
+static Job * popJob(JobDeque & deque){
+	long long bottom = deque.bottom.load() - 1;
+	deque.bottom.store(bottom);
+	long long top = deque.top.load();
+	if (top > bottom){
+		deque.bottom.store(bottom + 1);
+		return NULL;
+	}
+
+	Job * job = deque.jobs[bottom & (JOB_DEQUE_SIZE - 1)].load();
+	if (top == bottom){
+		// Last job: a thief may be taking it right now
+		if (!deque.top.compare_exchange_strong(top, top + 1))
+			job = NULL;
+		deque.bottom.store(bottom + 1);
+	}
+	return job;
+}
+
+static Job * stealJob(JobDeque & deque){
+	long long top = deque.top.load();
+	long long bottom = deque.bottom.load();
+	if (top >= bottom)
+		return NULL;
+
+	Job * job = deque.jobs[top & (JOB_DEQUE_SIZE - 1)].load();
+	if (!deque.top.compare_exchange_strong(top, top + 1))
+		return NULL;	// Another thief or the owner got it
+	return job;
+}
+
+// Own deque first, then one steal attempt on every other thread starting at a random one
+static Job * getJob(){
+	JobThread & self = jobThreads[threadIndex];
+	Job * job = popJob(self.deque);
+	if (job == NULL && jobThreadCount > 1){
+		self.random = self.random * 1664525u + 1013904223u;
+		unsigned int first = (self.random >> 16) % jobThreadCount;
+		for (unsigned int i = 0; i < jobThreadCount && job == NULL; i++){
+			unsigned int victim = (first + i) % jobThreadCount;
+			if (victim != (unsigned int)threadIndex)
+				job = stealJob(jobThreads[victim].deque);
+		}
+		if (job != NULL)
+			self.steals++;
+	}
+	if (job != NULL)
+		queuedJobs--;
+	return job;
+}
+
+static void finishJob(Job * job){
+	Job * parent = job->parent;		// Once unfinished reaches 0 the owner thread may reuse the job
+	if (--job->unfinished == 0 && parent != NULL)
+		finishJob(parent);
+}
+
+static void executeJob(Job * job);
+
+static Job * allocateJob(JobFunction function, void * data, Job * parent){
+	// Next finished job of the ring (parents of running jobs are still unfinished and skipped)
+	JobThread & self = jobThreads[threadIndex];
+	Job * job = &self.pool[self.allocated++ & (JOB_POOL_SIZE - 1)];
+	for (unsigned int tried = 1; job->unfinished.load() != 0; tried++){
+		if (tried % JOB_POOL_SIZE == 0){
+			// A whole lap without a finished job: run queued jobs until one of ours finishes. Only jobs created and
+			// never run can't finish this way, so say so (once) instead of spinning silently.
+			static std::atomic<bool> warned(false);
+			if (!warned.exchange(true))
+				printf("[WARNING] Job pool full: %d unfinished jobs on one thread, waiting for some to finish.\n", JOB_POOL_SIZE);
+			Job * next = getJob();
+			if (next != NULL)
+				executeJob(next);
+			else
+				std::this_thread::yield();
+		}
+		job = &self.pool[self.allocated++ & (JOB_POOL_SIZE - 1)];
+	}
+	job->function = function;
+	job->rangeFunction = NULL;
+	job->data = data;
+	job->begin = job->end = job->batch = 0;
+	job->parent = parent;
+	job->unfinished.store(1);
+	if (parent != NULL)
+		parent->unfinished++;
+	return job;
+}
+
+static void executeJob(Job * job){
+	if (job->rangeFunction != NULL && job->end - job->begin > job->batch){
+		// Split the range, the halves are stolen and split further by idle threads
+		int middle = job->begin + (job->end - job->begin) / 2;
+		for (int half = 0; half < 2; half++){
+			Job * child = allocateJob(NULL, job->data, job);
+			child->rangeFunction = job->rangeFunction;
+			child->begin = half == 0 ? job->begin : middle;
+			child->end = half == 0 ? middle : job->end;
+			child->batch = job->batch;
+			runJob(child);
+		}
+	} else if (job->rangeFunction != NULL){
+		job->rangeFunction(job->begin, job->end, job->data);
+	} else if (job->function != NULL){
+		job->function(job->data);
+	}
+	jobThreads[threadIndex].executed++;
+	finishJob(job);
+}
+
+static void workerLoop(int index){
+	PROFILE_THREAD("Job worker");
+	threadIndex = index;
+	int idleRounds = 0;
+	while (running.load()){
+		Job * job = getJob();
+		if (job != NULL){
+			executeJob(job);
+			idleRounds = 0;
+		} else if (++idleRounds < JOB_SPIN_COUNT){
+			std::this_thread::yield();
+		} else {
+			// Sleep until jobs are pushed (the timeout covers a push racing with falling asleep)
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers++;
+			wakeUp.wait_for(lock, std::chrono::milliseconds(1), [](){ return queuedJobs.load() > 0 || !running.load(); });
+			sleepingWorkers--;
+			idleRounds = 0;
+		}
+	}
+}
+
+void initJobSystem(unsigned int threads){
+	if (running.load())
+		shutdownJobSystem();
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+
+	jobThreadCount = threads;
+	jobThreads = new JobThread[threads];
+	for (unsigned int t = 0; t < threads; t++){
+		JobThread & thread = jobThreads[t];
+		thread.deque.top.store(0);
+		thread.deque.bottom.store(0);
+		thread.pool = new Job[JOB_POOL_SIZE];
+		for (int j = 0; j < JOB_POOL_SIZE; j++)
+			thread.pool[j].unfinished.store(0);
+		thread.allocated = 0;
+		thread.random = t * 2654435761u + 1;
+		thread.executed.store(0);
+		thread.steals.store(0);
+	}
+
+	threadIndex = 0;
+	queuedJobs.store(0);
+	running.store(true);
+	for (unsigned int t = 1; t < threads; t++)
+		workers.push_back(std::thread(workerLoop, (int)t));
+}
+
+void shutdownJobSystem(){
+	if (!running.load())
+		return;
+	running.store(false);
+	wakeUp.notify_all();
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+	workers.clear();
+
+	for (unsigned int t = 0; t < jobThreadCount; t++)
+		delete[] jobThreads[t].pool;
+	delete[] jobThreads;
+	jobThreads = NULL;
+	jobThreadCount = 0;
+	threadIndex = -1;
+}
+
+unsigned int getJobThreadCount(){
+	return running.load() ? jobThreadCount : 1;
+}
+
+Job * createJob(JobFunction function, void * data){
+	return allocateJob(function, data, NULL);
+}
+
+Job * createChildJob(Job * parent, JobFunction function, void * data){
+	return allocateJob(function, data, parent);
+}
+
+void runJob(Job * job){
+	// A full deque runs the job right away instead of overwriting the oldest queued one
+	if (!pushJob(jobThreads[threadIndex].deque, job)){
+		executeJob(job);
+		return;
+	}
+	queuedJobs++;
+	if (sleepingWorkers.load() > 0)
+		wakeUp.notify_one();
+}
+
+void waitForJob(Job * job){
+	while (job->unfinished.load() > 0){
+		Job * next = getJob();
+		if (next != NULL)
+			executeJob(next);
+		else
+			std::this_thread::yield();
+	}
+}
+
+bool isJobFinished(const Job * job){
+	return job->unfinished.load() == 0;
+}
+
+void parallelFor(int count, int batch, ParallelForFunction function, void * data){
+	if (count <= 0)
+		return;
+	if (batch < 1)
+		batch = 1;
+	if (!running.load() || threadIndex < 0 || jobThreadCount == 1 || count <= batch){
+		function(0, count, data);
+		return;
+	}
+
+	Job * job = allocateJob(NULL, data, NULL);
+	job->rangeFunction = function;
+	job->end = count;
+	job->batch = batch;
+	runJob(job);
+	waitForJob(job);
+}
+
+JobSystemStats getJobSystemStats(){
+	JobSystemStats stats = { (int)getJobThreadCount(), 0, 0 };
+	for (unsigned int t = 0; t < jobThreadCount; t++){
+		stats.jobs += jobThreads[t].executed.load();
+		stats.steals += jobThreads[t].steals.load();
+	}
+	return stats;
+}
+
+void resetJobSystemStats(){
+	for (unsigned int t = 0; t < jobThreadCount; t++){
+		jobThreads[t].executed.store(0);
+		jobThreads[t].steals.store(0);
+	}
+}
+
+// About a microsecond of arithmetic per item
+static void benchmarkWork(int begin, int end, void * data){
+	float * results = (float *)data;
+	for (int i = begin; i < end; i++){
+		float x = (float)i;
+		for (int k = 0; k < 200; k++)
+			x = sqrtf(x * 1.0001f + 1.0f);
+		results[i] = x;
+	}
+}
+
+static void emptyJob(void *){
+}
+
+void benchmarkJobSystem(int items, int iterations){
+	unsigned int previousThreads = running.load() ? jobThreadCount : 0;
+	unsigned int cores = std::thread::hardware_concurrency();
+	if (cores == 0) cores = 1;
+
+	std::vector<float> results(items);
+	double baseSeconds = 0.0;
+	for (unsigned int threads = 1; ; threads = threads * 2 < cores ? threads * 2 : cores){
+		initJobSystem(threads);
+		parallelFor(items, 64, benchmarkWork, &results[0]);	// Warm up the workers
+		resetJobSystemStats();
+
+		double start = getTime();
+		for (int it = 0; it < iterations; it++)
+			parallelFor(items, 64, benchmarkWork, &results[0]);
+		double seconds = (getTime() - start) / iterations;
+		if (threads == 1)
+			baseSeconds = seconds;
+
+		JobSystemStats stats = getJobSystemStats();
+		double speedup = seconds > 0.0 ? baseSeconds / seconds : 0.0;
+		printf("[DEBUG] Job system (%u threads): %d items in %.3f ms, %.2fx speedup, %.0f%% efficiency, %d jobs, %d steals per run\n",
+			threads, items, seconds * 1000.0, speedup, speedup * 100.0 / threads, stats.jobs / iterations, stats.steals / iterations);
+		if (threads == cores)
+			break;
+	}
+
+	// Create, run and finish empty jobs under one parent, in batches the job ring can hold
+	int jobs = 0;
+	double start = getTime();
+	for (int it = 0; it < iterations; it++){
+		Job * parent = createJob(NULL, NULL);
+		for (int j = 0; j < JOB_POOL_SIZE / 2; j++)
+			runJob(createChildJob(parent, emptyJob, NULL));
+		runJob(parent);
+		waitForJob(parent);
+		jobs += JOB_POOL_SIZE / 2 + 1;
+	}
+	printf("[DEBUG] Job system (%u threads): %.0f ns per empty job\n", jobThreadCount, (getTime() - start) * 1e9 / jobs);
+
+	shutdownJobSystem();
+	if (previousThreads > 0)
+		initJobSystem(previousThreads);
+}
@@ -0,0 +1,61 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+// Job system: one worker thread per core besides the main thread, each with its own work-stealing deque (Chase-Lev).
+// A thread pushes and pops jobs at the bottom of its deque, idle threads steal from the top of the others'. A job
+// created as another's child keeps the parent unfinished until it is done, so waiting on one parent waits on a
+// whole tree of jobs. Waiting threads run other jobs in the meantime.
+//
+// Jobs are created and run from the main thread or from inside jobs. GL calls stay on the main thread: jobs only
+// compute, the main thread uploads and draws once it has waited for them. Each thread allocates its jobs from a
+// ring of 4096 that skips unfinished ones: at most 4096 unfinished jobs per thread (past that, creating one runs
+// queued jobs until one finishes), and a finished job's handle stays valid until its thread has created about 4096
+// more. A thread with 4096 jobs queued runs the next one it is given right away.
+
+struct Job;
+
+typedef void (*JobFunction)(void * data);
+typedef void (*ParallelForFunction)(int begin, int end, void * data);
+
+// Since the last resetJobSystemStats()
+struct JobSystemStats {
+	int threads;
+	int jobs;			// Executed
+	int steals;			// Taken from another thread's deque
+};
+
+// threads 0 = one per core. The calling thread becomes the main thread and counts as one.
+void initJobSystem(unsigned int threads);
+void shutdownJobSystem();
+unsigned int getJobThreadCount();		// 1 when the job system isn't running
+
+// function may be NULL (a job only grouping its children)
+Job * createJob(JobFunction function, void * data);
+Job * createChildJob(Job * parent, JobFunction function, void * data);
+void runJob(Job * job);
+void waitForJob(Job * job);
+bool isJobFinished(const Job * job);
+
+// Run function over [0, count) split in ranges of at most batch items, on every thread, and wait for them.
+// Without the job system the whole range runs on the calling thread.
+void parallelFor(int count, int batch, ParallelForFunction function, void * data);
+
+// Same with a lambda or functor: body(begin, end)
+template <typename Body>
+void parallelForBody(int begin, int end, void * body){
+	(*(const Body *)body)(begin, end);
+}
+
+template <typename Body>
+void parallelFor(int count, int batch, const Body & body){
+	parallelFor(count, batch, parallelForBody<Body>, (void *)&body);
+}
+
+JobSystemStats getJobSystemStats();
+void resetJobSystemStats();
+
+// Print the time of a fixed workload split in jobs, from 1 thread up to one per core (speedup and efficiency),
+// and the overhead of an empty job
+void benchmarkJobSystem(int items, int iterations);
+
+#endif
@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "objloader.hpp"
+#include "profiler.hpp"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide : 
@@ -23,6 +24,7 @@ bool loadOBJ(
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
+	PROFILE_ZONE("loadOBJ");
 	printf("Loading OBJ file %s...\n", path);
 
 	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "timer.hpp"
+#include "culling.hpp"
+#include "occlusion.hpp"
+#include "jobsystem.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2
+#endif
+
+#define OCCLUSION_TILE_WIDTH	32		// Multiple of 4 (one SSE register of pixels)
+#define OCCLUSION_TILE_HEIGHT	16
+#define OCCLUSION_BOXES_PER_JOB	1024
+
+// Screen space triangle set up for rasterization
+struct OccluderTriangle {
+	float edgeA[3], edgeB[3], edgeC[3];		// Edge functions A x + B y + C, >= 0 inside (one per vertex, opposite it)
+	float depthA, depthB, depthC;			// Depth plane A x + B y + C
+	int minX, minY, maxX, maxY;				// Pixels (centers) covered by the bounds, inclusive
+};
+
+struct OcclusionBuffer {
+	int width, height;
+	int tilesX, tilesY;
+
+	std::vector<OccluderTriangle> triangles;
+	std::vector<std::vector<int> > bins;		// Triangles overlapping each tile
+
+	// Level 0 is the depth buffer (0 near - 1 far), each next level holds the farthest depth of 2x2 texels
+	std::vector<std::vector<float> > levels;
+	std::vector<int> levelWidth, levelHeight;
+
+	std::vector<unsigned char> occludedFlags;	// Scratch of cullOccludedObjects
+	OcclusionStats stats;
+};
+
+
+
+OcclusionBuffer * createOcclusionBuffer(int width, int height){
+	OcclusionBuffer * buffer = new OcclusionBuffer;
+	buffer->tilesX = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	buffer->tilesY = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+	buffer->width = buffer->tilesX * OCCLUSION_TILE_WIDTH;
+	buffer->height = buffer->tilesY * OCCLUSION_TILE_HEIGHT;
+	buffer->bins.resize(buffer->tilesX * buffer->tilesY);
+
+	int w = buffer->width, h = buffer->height;
+	for (;;){
+		buffer->levels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+		buffer->levelWidth.push_back(w);
+		buffer->levelHeight.push_back(h);
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+
+	memset(&buffer->stats, 0, sizeof(buffer->stats));
+	return buffer;
+}
+
+void deleteOcclusionBuffer(OcclusionBuffer * buffer){
+	delete buffer;
+}
+
+static float triangleArea(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c){
+	return glm::length(glm::cross(b - a, c - a)) * 0.5f;
+}
+
+void buildOccluderMesh(const glm::vec3 * positions, const unsigned short * indices, int indexCount, float areaFraction,
+	std::vector<glm::vec3> & occluder){
+
+	int triangleCount = indexCount / 3;
+	std::vector<std::pair<float, int> > areas(triangleCount);
+	float total = 0.0f;
+	for (int t = 0; t < triangleCount; t++){
+		float area = triangleArea(positions[indices[t * 3]], positions[indices[t * 3 + 1]], positions[indices[t * 3 + 2]]);
+		areas[t] = std::make_pair(area, t);
+		total += area;
+	}
+	std::sort(areas.begin(), areas.end(), std::greater<std::pair<float, int> >());
+
+	occluder.clear();
+	float covered = 0.0f;
+	for (int i = 0; i < triangleCount && covered < total * areaFraction; i++){
+		int t = areas[i].second;
+		for (int v = 0; v < 3; v++)
+			occluder.push_back(positions[indices[t * 3 + v]]);
+		covered += areas[i].first;
+	}
+}
+
+void beginOcclusionFrame(OcclusionBuffer * buffer){
+	buffer->triangles.clear();
+	for (size_t i = 0; i < buffer->bins.size(); i++)
+		buffer->bins[i].clear();
+	std::fill(buffer->levels[0].begin(), buffer->levels[0].end(), 1.0f);
+}
+
+void addOccluder(OcclusionBuffer * buffer, const glm::vec3 * triangles, int vertexCount, const glm::mat4 & MVP){
+	float width = (float)buffer->width, height = (float)buffer->height;
+
+	for (int t = 0; t + 2 < vertexCount; t += 3){
+		// Pixel coordinates and depth. Triangles reaching behind the near plane are dropped rather than clipped,
+		// which only makes them hide less.
+		glm::vec3 v[3];
+		bool nearClipped = false;
+		for (int i = 0; i < 3; i++){
+			glm::vec4 clip = MVP * glm::vec4(triangles[t + i], 1.0f);
+			if (clip.w <= 1e-6f || clip.z < -clip.w){
+				nearClipped = true;
+				break;
+			}
+			float invW = 1.0f / clip.w;
+			v[i] = glm::vec3((clip.x * invW * 0.5f + 0.5f) * width, (clip.y * invW * 0.5f + 0.5f) * height, clip.z * invW * 0.5f + 0.5f);
+		}
+		if (nearClipped)
+			continue;
+
+		// Both windings are occluders, make the edge functions positive inside
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (fabsf(area) < 1e-8f)
+			continue;
+		if (area < 0.0f){
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		OccluderTriangle tri;
+		float minX = std::min(v[0].x, std::min(v[1].x, v[2].x)), maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+		float minY = std::min(v[0].y, std::min(v[1].y, v[2].y)), maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+		tri.minX = std::max(0, (int)ceilf(minX - 0.5f));
+		tri.minY = std::max(0, (int)ceilf(minY - 0.5f));
+		tri.maxX = std::min(buffer->width - 1, (int)floorf(maxX - 0.5f));
+		tri.maxY = std::min(buffer->height - 1, (int)floorf(maxY - 0.5f));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+			continue;
+
+		tri.depthA = tri.depthB = tri.depthC = 0.0f;
+		for (int i = 0; i < 3; i++){
+			const glm::vec3 & a = v[(i + 1) % 3];
+			const glm::vec3 & b = v[(i + 2) % 3];
+			tri.edgeA[i] = a.y - b.y;
+			tri.edgeB[i] = b.x - a.x;
+			tri.edgeC[i] = -(tri.edgeA[i] * a.x + tri.edgeB[i] * a.y);
+
+			// Depth is linear in screen space: the edge functions over the area are the barycentric weights
+			tri.depthA += tri.edgeA[i] * v[i].z / area;
+			tri.depthB += tri.edgeB[i] * v[i].z / area;
+			tri.depthC += tri.edgeC[i] * v[i].z / area;
+		}
+
+		// Conservative at this resolution: a pixel counts as covered only if the triangle covers all of it, and
+		// gets the farthest depth the triangle has inside it
+		for (int i = 0; i < 3; i++)
+			tri.edgeC[i] -= 0.5f * (fabsf(tri.edgeA[i]) + fabsf(tri.edgeB[i]));
+		tri.depthC += 0.5f * (fabsf(tri.depthA) + fabsf(tri.depthB));
+
+		int index = (int)buffer->triangles.size();
+		buffer->triangles.push_back(tri);
+		for (int ty = tri.minY / OCCLUSION_TILE_HEIGHT; ty <= tri.maxY / OCCLUSION_TILE_HEIGHT; ty++)
+			for (int tx = tri.minX / OCCLUSION_TILE_WIDTH; tx <= tri.maxX / OCCLUSION_TILE_WIDTH; tx++)
+				buffer->bins[ty * buffer->tilesX + tx].push_back(index);
+	}
+}
+
+// Keep the closest depth of every pixel of the tile covered by its triangles
+static void rasterizeTile(OcclusionBuffer * buffer, int tile){
+	int tileX = (tile % buffer->tilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY = (tile / buffer->tilesX) * OCCLUSION_TILE_HEIGHT;
+	float * depth = &buffer->levels[0][0];
+	const std::vector<int> & bin = buffer->bins[tile];
+
+	for (size_t b = 0; b < bin.size(); b++){
+		const OccluderTriangle & tri = buffer->triangles[bin[b]];
+		int x0 = std::max(tri.minX, tileX) & ~3;	// Tiles start on a multiple of 4
+		int x1 = std::min(tri.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+		int y0 = std::max(tri.minY, tileY);
+		int y1 = std::min(tri.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+
+		for (int y = y0; y <= y1; y++){
+			float px = x0 + 0.5f, py = y + 0.5f;
+			float * row = depth + (size_t)y * buffer->width;
+#ifdef OCCLUSION_SSE2
+			__m128 offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+			__m128 edge[3], edgeStep[3];
+			for (int i = 0; i < 3; i++){
+				edge[i] = _mm_add_ps(_mm_set1_ps(tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i]), _mm_mul_ps(offsets, _mm_set1_ps(tri.edgeA[i])));
+				edgeStep[i] = _mm_set1_ps(tri.edgeA[i] * 4.0f);
+			}
+			__m128 z = _mm_add_ps(_mm_set1_ps(tri.depthA * px + tri.depthB * py + tri.depthC), _mm_mul_ps(offsets, _mm_set1_ps(tri.depthA)));
+			__m128 zStep = _mm_set1_ps(tri.depthA * 4.0f);
+			__m128 zero = _mm_setzero_ps();
+
+			for (int x = x0; x <= x1; x += 4){
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+				if (_mm_movemask_ps(inside)){
+					__m128 old = _mm_loadu_ps(row + x);
+					__m128 closest = _mm_min_ps(old, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, old)));
+				}
+				for (int i = 0; i < 3; i++)
+					edge[i] = _mm_add_ps(edge[i], edgeStep[i]);
+				z = _mm_add_ps(z, zStep);
+			}
+#else
+			for (int x = x0; x <= x1; x++, px += 1.0f){
+				bool inside = true;
+				for (int i = 0; i < 3; i++)
+					inside = inside && tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i] >= 0.0f;
+				float z = tri.depthA * px + tri.depthB * py + tri.depthC;
+				if (inside && z < row[x])
+					row[x] = z;
+			}
+#endif
+		}
+	}
+}
+
+static void buildHiZ(OcclusionBuffer * buffer){
+	for (size_t level = 1; level < buffer->levels.size(); level++){
+		const float * source = &buffer->levels[level - 1][0];
+		float * target = &buffer->levels[level][0];
+		int sourceWidth = buffer->levelWidth[level - 1], sourceHeight = buffer->levelHeight[level - 1];
+		int width = buffer->levelWidth[level], height = buffer->levelHeight[level];
+
+		for (int y = 0; y < height; y++){
+			const float * row0 = source + (size_t)(y * 2) * sourceWidth;
+			const float * row1 = source + (size_t)std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth;
+			for (int x = 0; x < width; x++){
+				int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				target[y * width + x] = std::max(std::max(row0[x * 2], row0[x1]), std::max(row1[x * 2], row1[x1]));
+			}
+		}
+	}
+}
+
+void rasterizeOccluders(OcclusionBuffer * buffer){
+	double start = getTime();
+	parallelFor((int)buffer->bins.size(), 1, [buffer](int begin, int end){
+		for (int tile = begin; tile < end; tile++)
+			rasterizeTile(buffer, tile);
+	});
+	buildHiZ(buffer);
+
+	buffer->stats.occluderTriangles = (int)buffer->triangles.size();
+	buffer->stats.threads = getJobThreadCount();
+	buffer->stats.rasterMilliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+bool isBoxOccluded(const OcclusionBuffer * buffer, const BoundingBox & box, const glm::mat4 & viewProjection){
+	// Screen rectangle and closest depth of the corners. Boxes reaching behind the near plane are never occluded.
+	// The corners are the first one plus the box's edges transformed once.
+	glm::vec3 size = box.max - box.min;
+	glm::vec4 first = viewProjection * glm::vec4(box.min, 1.0f);
+	glm::vec4 edgeX = viewProjection[0] * size.x, edgeY = viewProjection[1] * size.y, edgeZ = viewProjection[2] * size.z;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (int c = 0; c < 8; c++){
+		glm::vec4 clip = first;
+		if (c & 1) clip += edgeX;
+		if (c & 2) clip += edgeY;
+		if (c & 4) clip += edgeZ;
+		if (clip.w <= 1e-6f || clip.z < -clip.w)
+			return false;
+		float invW = 1.0f / clip.w;
+		float x = clip.x * invW, y = clip.y * invW;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+		return false;	// Off screen, that's for frustum culling
+
+	// Every pixel the rectangle touches
+	int x0 = std::max(0, (int)floorf((minX * 0.5f + 0.5f) * buffer->width));
+	int x1 = std::min(buffer->width - 1, (int)floorf((maxX * 0.5f + 0.5f) * buffer->width));
+	int y0 = std::max(0, (int)floorf((minY * 0.5f + 0.5f) * buffer->height));
+	int y1 = std::min(buffer->height - 1, (int)floorf((maxY * 0.5f + 0.5f) * buffer->height));
+	float depth = minZ * 0.5f + 0.5f;
+
+	// Coarsest level where the rectangle spans at most 2x2 texels
+	int level = 0;
+	while (level + 1 < (int)buffer->levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+
+	const float * hiZ = &buffer->levels[level][0];
+	int width = buffer->levelWidth[level];
+	for (int y = y0 >> level; y <= y1 >> level; y++)
+		for (int x = x0 >> level; x <= x1 >> level; x++)
+			if (depth <= hiZ[y * width + x])
+				return false;
+	return true;
+}
+
+void cullOccludedObjects(OcclusionBuffer * buffer, const BoundingBox * boxes, int boxCount, const glm::mat4 & viewProjection,
+	std::vector<int> & objects){
+
+	double start = getTime();
+	int count = (int)objects.size();
+	std::vector<unsigned char> & occluded = buffer->occludedFlags;
+	occluded.assign(count, 0);
+
+	const int * ids = count > 0 ? &objects[0] : NULL;
+	parallelFor(count, OCCLUSION_BOXES_PER_JOB, [&](int begin, int end){
+		for (int i = begin; i < end; i++)
+			if (ids[i] < boxCount)
+				occluded[i] = isBoxOccluded(buffer, boxes[ids[i]], viewProjection);
+	});
+
+	int tested = 0, kept = 0;
+	for (int i = 0; i < count; i++){
+		tested += objects[i] < boxCount;
+		if (!occluded[i])
+			objects[kept++] = objects[i];
+	}
+	objects.resize(kept);
+
+	buffer->stats.tested = tested;
+	buffer->stats.occluded = count - kept;
+	buffer->stats.testMilliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+OcclusionStats getOcclusionStats(OcclusionBuffer * buffer){
+	return buffer->stats;
+}
+
+static float randomRange(float low, float high){
+	return low + (high - low) * (float)rand() / RAND_MAX;
+}
+
+void benchmarkOcclusion(int occluders, int boxes, int iterations){
+	// Camera of the scene (glm::perspective(0.75f, 1.25f, 0.1f, 100.0f) looking down -Z), occluder quads 5 to 10
+	// units away, unit boxes on a wall 20 to 60 units away
+	glm::mat4 projection = glm::mat4(0.0f);
+	float f = 1.0f / tanf(0.75f * 0.5f);
+	projection[0][0] = f / 1.25f;
+	projection[1][1] = f;
+	projection[2][2] = -(100.0f + 0.1f) / (100.0f - 0.1f);
+	projection[2][3] = -1.0f;
+	projection[3][2] = -(2.0f * 100.0f * 0.1f) / (100.0f - 0.1f);
+
+	srand(1);
+	std::vector<glm::vec3> quads;
+	for (int i = 0; i < occluders; i++){
+		float z = randomRange(-10.0f, -5.0f);
+		glm::vec3 center(randomRange(-0.4f, 0.4f) * -z, randomRange(-0.3f, 0.3f) * -z, z);
+		float size = randomRange(0.5f, 1.5f);
+		glm::vec3 a = center + glm::vec3(-size, -size, 0.0f), b = center + glm::vec3(size, -size, 0.0f);
+		glm::vec3 c = center + glm::vec3(size, size, 0.0f), d = center + glm::vec3(-size, size, 0.0f);
+		glm::vec3 quad[6] = { a, b, c, a, c, d };
+		quads.insert(quads.end(), quad, quad + 6);
+	}
+	std::vector<BoundingBox> wall(boxes);
+	std::vector<int> all(boxes);
+	for (int i = 0; i < boxes; i++){
+		float z = randomRange(-60.0f, -20.0f);
+		glm::vec3 center(randomRange(-0.4f, 0.4f) * -z, randomRange(-0.3f, 0.3f) * -z, z);
+		wall[i].min = center - glm::vec3(0.5f);
+		wall[i].max = center + glm::vec3(0.5f);
+		all[i] = i;
+	}
+
+	OcclusionBuffer * buffer = createOcclusionBuffer(256, 192);
+	std::vector<int> visible;
+	double rasterSeconds = 0.0, testSeconds = 0.0;
+	for (int it = 0; it < iterations; it++){
+		double start = getTime();
+		beginOcclusionFrame(buffer);
+		addOccluder(buffer, &quads[0], (int)quads.size(), projection);
+		rasterizeOccluders(buffer);
+		double rasterized = getTime();
+		visible = all;
+		cullOccludedObjects(buffer, &wall[0], boxes, projection, visible);
+		testSeconds += getTime() - rasterized;
+		rasterSeconds += rasterized - start;
+	}
+
+	OcclusionStats stats = getOcclusionStats(buffer);
+	printf("[DEBUG] Occlusion culling (%d threads, %dx%d): %d occluder triangles in %.3f ms, %d boxes tested in %.3f ms, %d occluded\n",
+		stats.threads, buffer->width, buffer->height, stats.occluderTriangles, rasterSeconds * 1000.0 / iterations, stats.tested,
+		testSeconds * 1000.0 / iterations, stats.occluded);
+	deleteOcclusionBuffer(buffer);
+}
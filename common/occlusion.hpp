@@ -0,0 +1,54 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+// Software occlusion culling: occluder triangles are rasterized on the CPU into a small depth buffer (closest depth
+// per pixel), split into tiles that the job system's threads fill in parallel, 4 pixels at a time with SSE. A
+// hierarchical Z pyramid (farthest depth of each 2x2 block per level) is then built so a box is tested against a few
+// texels whatever its screen size: it is occluded if its closest point is behind the farthest occluder depth over
+// its screen rectangle.
+// No GL is involved, so it runs before any draw is submitted. Needs culling.hpp (BoundingBox) included first.
+//
+// Occluders have to be inside the object they stand for, or visible objects get culled: use the object's own
+// triangles (buildOccluderMesh keeps only the largest), never a bounding hull.
+
+// Last frame
+struct OcclusionStats {
+	int occluderTriangles;		// Binned (in front of the near plane, on screen)
+	int tested;
+	int occluded;
+	int threads;
+	float rasterMilliseconds;	// Rasterization and Hi-Z pyramid
+	float testMilliseconds;
+};
+
+struct OcclusionBuffer;
+
+// width and height are rounded up to whole tiles
+OcclusionBuffer * createOcclusionBuffer(int width, int height);
+void deleteOcclusionBuffer(OcclusionBuffer * buffer);
+
+// Triangle list (3 positions per triangle) of the largest triangles of an indexed mesh, covering areaFraction
+// (0 - 1) of its surface: thin and small triangles cost as much to rasterize and hide next to nothing
+void buildOccluderMesh(const glm::vec3 * positions, const unsigned short * indices, int indexCount, float areaFraction,
+	std::vector<glm::vec3> & occluder);
+
+// Clear the depth buffer, then add the frame's occluders (transformed by their MVP and binned into tiles)
+void beginOcclusionFrame(OcclusionBuffer * buffer);
+void addOccluder(OcclusionBuffer * buffer, const glm::vec3 * triangles, int vertexCount, const glm::mat4 & MVP);
+
+// Rasterize the binned occluders on every thread and build the Hi-Z pyramid
+void rasterizeOccluders(OcclusionBuffer * buffer);
+
+bool isBoxOccluded(const OcclusionBuffer * buffer, const BoundingBox & box, const glm::mat4 & viewProjection);
+
+// Remove the occluded IDs from objects (boxes[id] is object id's world box, tested on every thread). Objects
+// without a box (id >= boxCount) are kept.
+void cullOccludedObjects(OcclusionBuffer * buffer, const BoundingBox * boxes, int boxCount, const glm::mat4 & viewProjection,
+	std::vector<int> & objects);
+
+OcclusionStats getOcclusionStats(OcclusionBuffer * buffer);
+
+// Print rasterization and box test time on the job system's threads, for a wall of random boxes behind occluders
+void benchmarkOcclusion(int occluders, int boxes, int iterations);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include <GL/glew.h>
+
+#include "timer.hpp"
+#include "profiler.hpp"
+
+#define PROFILER_RING_SIZE		16384		// Zones a thread can finish between two flushes, power of 2
+#define PROFILER_MAX_EVENTS		4000000		// Zones kept for the trace, later ones are counted as dropped
+
+bool profilerRecording = false;
+
+#ifdef PROFILER
+struct ProfileEvent {
+	const char * name;
+	double start, end;
+};
+
+// One writer (its thread), one reader (flushProfiler). The writer fills the slot at head, then publishes it by
+// advancing head; a reader more than PROFILER_RING_SIZE behind has lost the oldest zones.
+struct ThreadRing {
+	ProfileEvent events[PROFILER_RING_SIZE];
+	std::atomic<unsigned long long> head;
+	unsigned long long tail;				// Reader only
+	int thread;								// Trace thread id
+	const char * name;
+};
+
+struct TraceEvent {
+	const char * name;
+	double start, end;
+	int thread;								// 0 = GPU
+};
+
+struct PendingGPUZone {
+	const char * name;
+	GLuint begin, end;
+};
+
+static std::mutex ringsMutex;				// Guards the list, not the rings
+static std::vector<ThreadRing *> rings;
+static thread_local ThreadRing * threadRing = NULL;
+
+static std::vector<TraceEvent> trace;
+static int droppedZones = 0;
+static double profilerStart = 0.0;
+
+static std::vector<GLuint> freeQueries;
+static std::vector<GLuint> allQueries;
+static std::deque<PendingGPUZone> pendingGPUZones;	// In the order they ended, which is the order they complete
+static double gpuClockOffset = 0.0;					// CPU time (seconds) of GPU timestamp 0
+#endif
+
+
+
+double getProfilerTime(){
+	return getTime();
+}
+
+#ifdef PROFILER
+static ThreadRing * getThreadRing(){
+	if (threadRing == NULL){
+		threadRing = new ThreadRing;
+		threadRing->head.store(0);
+		threadRing->tail = 0;
+		threadRing->name = NULL;
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		threadRing->thread = (int)rings.size() + 1;
+		rings.push_back(threadRing);
+	}
+	return threadRing;
+}
+#endif
+
+#ifdef PROFILER
+void recordProfileZone(const char * name, double start, double end){
+	ThreadRing * ring = getThreadRing();
+	unsigned long long head = ring->head.load(std::memory_order_relaxed);
+	ProfileEvent & event = ring->events[head & (PROFILER_RING_SIZE - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+#else
+void recordProfileZone(const char *, double, double){
+}
+#endif
+
+#ifdef PROFILER
+void setProfilerThreadName(const char * name){
+	if (profilerRecording)
+		getThreadRing()->name = name;
+}
+#else
+void setProfilerThreadName(const char *){
+}
+#endif
+
+#ifdef PROFILER
+static GLuint takeQuery(){
+	if (freeQueries.empty()){
+		GLuint queries[32];
+		glGenQueries(32, queries);
+		for (int i = 0; i < 32; i++){
+			freeQueries.push_back(queries[i]);
+			allQueries.push_back(queries[i]);
+		}
+	}
+	GLuint query = freeQueries.back();
+	freeQueries.pop_back();
+	return query;
+}
+
+static void addTraceEvent(const char * name, double start, double end, int thread){
+	if (trace.size() >= PROFILER_MAX_EVENTS){
+		droppedZones++;
+		return;
+	}
+	TraceEvent event = { name, start, end, thread };
+	trace.push_back(event);
+}
+
+// Resolve the GPU zones whose queries are available (all of them if wait), oldest first
+static void collectGPUZones(bool wait){
+	while (!pendingGPUZones.empty()){
+		PendingGPUZone & zone = pendingGPUZones.front();
+		if (!wait){
+			GLuint available = 0;
+			glGetQueryObjectuiv(zone.end, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return;
+		}
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+		addTraceEvent(zone.name, gpuClockOffset + begin * 1e-9, gpuClockOffset + end * 1e-9, 0);
+		freeQueries.push_back(zone.begin);
+		freeQueries.push_back(zone.end);
+		pendingGPUZones.pop_front();
+	}
+}
+#endif
+
+unsigned int beginGPUProfileZone(){
+#ifdef PROFILER
+	GLuint query = takeQuery();
+	glQueryCounter(query, GL_TIMESTAMP);
+	return query;
+#else
+	return 0;
+#endif
+}
+
+#ifdef PROFILER
+void endGPUProfileZone(const char * name, unsigned int zone){
+	PendingGPUZone pending = { name, zone, takeQuery() };
+	glQueryCounter(pending.end, GL_TIMESTAMP);
+	pendingGPUZones.push_back(pending);
+}
+#else
+void endGPUProfileZone(const char *, unsigned int){
+}
+#endif
+
+void startProfiler(){
+#ifdef PROFILER
+	if (profilerRecording)
+		return;
+	trace.clear();
+	droppedZones = 0;
+
+	// Anything recorded while stopped (benchmarkProfiler) is not part of the trace
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (size_t i = 0; i < rings.size(); i++)
+			rings[i]->tail = rings[i]->head.load(std::memory_order_acquire);
+	}
+
+	// Line the GPU clock up with ours: the current GPU timestamp, read synchronously, is now
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	profilerStart = getTime();
+	gpuClockOffset = profilerStart - gpuNow * 1e-9;
+
+	profilerRecording = true;
+	setProfilerThreadName("Main");
+#else
+	printf("[WARNING] The profiler is not built in (define PROFILER).\n");
+#endif
+}
+
+void stopProfiler(){
+#ifdef PROFILER
+	if (!profilerRecording)
+		return;
+	profilerRecording = false;
+	if (!allQueries.empty())
+		glDeleteQueries((GLsizei)allQueries.size(), &allQueries[0]);
+	allQueries.clear();
+	freeQueries.clear();
+	pendingGPUZones.clear();
+	trace.clear();
+#endif
+}
+
+void flushProfiler(){
+#ifdef PROFILER
+	if (!profilerRecording)
+		return;
+	std::lock_guard<std::mutex> lock(ringsMutex);
+	for (size_t r = 0; r < rings.size(); r++){
+		ThreadRing * ring = rings[r];
+		unsigned long long head = ring->head.load(std::memory_order_acquire);
+		unsigned long long first = ring->tail;
+		if (head - first > PROFILER_RING_SIZE)
+			first = head - PROFILER_RING_SIZE;
+
+		size_t copied = trace.size();
+		for (unsigned long long i = first; i < head; i++){
+			const ProfileEvent & event = ring->events[i & (PROFILER_RING_SIZE - 1)];
+			addTraceEvent(event.name, event.start, event.end, ring->thread);
+		}
+
+		// Zones the writer may have wrapped round onto while they were copied (it can be filling the slot after its head)
+		// are dropped too, like the ones lost before
+		unsigned long long written = ring->head.load(std::memory_order_acquire) + 1;
+		if (written > PROFILER_RING_SIZE && written - PROFILER_RING_SIZE > first){
+			size_t lost = (size_t)(std::min(written - PROFILER_RING_SIZE, head) - first);
+			lost = std::min(lost, trace.size() - copied);
+			trace.erase(trace.begin() + copied, trace.begin() + copied + lost);
+			droppedZones += (int)lost;
+		}
+		droppedZones += (int)(first - ring->tail);
+		ring->tail = head;
+	}
+	collectGPUZones(false);
+#endif
+}
+
+#ifdef PROFILER
+bool writeProfilerTrace(const char * path){
+	if (!profilerRecording)
+		return false;
+	flushProfiler();
+	collectGPUZones(true);
+
+	FILE * file = fopen(path, "w");
+	if (file == NULL){
+		printf("[WARNING] Can't write %s.\n", path);
+		return false;
+	}
+
+	// Complete events (ph X) in microseconds since startProfiler, one track per thread plus one for the GPU
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"GPU\"}}");
+	int gpuZones = 0;
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (size_t r = 0; r < rings.size(); r++){
+			char name[32];
+			if (rings[r]->name == NULL)
+				sprintf(name, "Thread %d", rings[r]->thread);
+			fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+				rings[r]->thread, rings[r]->name ? rings[r]->name : name);
+		}
+	}
+	for (size_t i = 0; i < trace.size(); i++){
+		const TraceEvent & event = trace[i];
+		fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}", event.name,
+			(event.start - profilerStart) * 1e6, (event.end - event.start) * 1e6, event.thread);
+		if (event.thread == 0)
+			gpuZones++;
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("Profiler: %d CPU zones, %d GPU zones, %d dropped, trace written to %s\n", (int)trace.size() - gpuZones, gpuZones, droppedZones, path);
+	return true;
+}
+#else
+bool writeProfilerTrace(const char *){
+	return false;
+}
+#endif
+
+#ifdef PROFILER
+void benchmarkProfiler(int zones){
+	if (profilerRecording || zones <= 0)
+		return;
+
+	// Stopped: the zone only tests the recording flag
+	double start = getTime();
+	for (int i = 0; i < zones; i++){
+		PROFILE_ZONE("Benchmark");
+	}
+	double stopped = getTime() - start;
+
+	// Recording: what a recording zone does, into this thread's ring (startProfiler discards it)
+	start = getTime();
+	for (int i = 0; i < zones; i++){
+		double zoneStart = getProfilerTime();
+		recordProfileZone("Benchmark", zoneStart, getProfilerTime());
+	}
+	double recording = getTime() - start;
+
+	printf("[DEBUG] Profiler: %.1f ns per zone recording, %.2f ns stopped (%d zones)\n", recording * 1e9 / zones, stopped * 1e9 / zones, zones);
+}
+#else
+void benchmarkProfiler(int){
+}
+#endif
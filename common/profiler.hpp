@@ -0,0 +1,63 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// Scoped zone profiler, exported as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+// CPU zones are RAII objects (PROFILE_ZONE) timed on entry and exit; each thread writes its finished zones into its
+// own ring buffer with no lock (one writer, the read position is only advanced by flushProfiler on the main thread).
+// GPU zones (PROFILE_GPU_ZONE, GL thread only) put a GL_TIMESTAMP query on each side of the GL calls in their scope;
+// the queries come from a pool and are read back once available, a few frames later, so they never stall the GPU.
+// GPU times are moved onto the CPU clock with the GL_TIMESTAMP taken when the profiler starts.
+// Only built with PROFILER defined: otherwise the macros expand to nothing and startProfiler reports it isn't built.
+// Zone names must outlive the profiler (string literals).
+
+#ifdef PROFILER
+#define PROFILE_CONCAT_(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)		ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name)	GPUProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#define PROFILE_THREAD(name)	setProfilerThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_THREAD(name)
+#endif
+
+// Needs the GL context (GPU zones). Zones outside startProfiler/stopProfiler aren't recorded. The recording flag is
+// read unsynchronized by every zone: start before the profiled threads are created, stop after they are joined.
+void startProfiler();
+void stopProfiler();
+
+// Once per frame on the GL thread: move the finished zones of every thread and the available GPU zones to the trace
+void flushProfiler();
+
+// Flush, wait for the GPU zones in flight and write the trace. False if it can't be written.
+bool writeProfilerTrace(const char * path);
+
+// Name of the calling thread in the trace, ignored unless recording (an unprofiled thread gets no ring)
+void setProfilerThreadName(const char * name);
+
+// Cost of a CPU zone with the profiler recording and with it stopped (run it before startProfiler)
+void benchmarkProfiler(int zones);
+
+// Recording state and clock of the zones, for the inline constructors below
+extern bool profilerRecording;
+double getProfilerTime();
+void recordProfileZone(const char * name, double start, double end);
+unsigned int beginGPUProfileZone();
+void endGPUProfileZone(const char * name, unsigned int zone);
+
+struct ProfileZone {
+	const char * name;
+	double start;
+	ProfileZone(const char * zoneName) : name(zoneName), start(profilerRecording ? getProfilerTime() : -1.0) {}
+	~ProfileZone() { if (start >= 0.0) recordProfileZone(name, start, getProfilerTime()); }
+};
+
+struct GPUProfileZone {
+	const char * name;
+	unsigned int zone;		// 0 = not recording
+	GPUProfileZone(const char * zoneName) : name(zoneName), zone(profilerRecording ? beginGPUProfileZone() : 0) {}
+	~GPUProfileZone() { if (zone != 0) endGPUProfileZone(name, zone); }
+};
+
+#endif
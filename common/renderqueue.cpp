@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "timer.hpp"
+#include "renderqueue.hpp"
+#include "jobsystem.hpp"
+
+#define RADIX_PARALLEL_PACKETS	16384	// Smaller queues sort faster on one thread
+#define RADIX_CHUNK_PACKETS		4096	// Packets counted and scattered by one job
+
+struct RenderQueue {
+	std::vector<RenderPacket> packets;
+	std::vector<RenderPacket> scratch;		// Other half of the radix sort ping-pong
+	std::vector<unsigned int> chunkHistograms;
+	RenderQueueStats stats;
+};
+
+
+
+// LSD radix sort on 8 bit digits. The histograms of all 8 digits are built in one pass, and digits every key
+// shares (ie. the pass, or the shader in a scene with one shader) are skipped without moving anything.
+static void radixSort(std::vector<RenderPacket> & packets, std::vector<RenderPacket> & scratch){
+	size_t count = packets.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	unsigned int histograms[8][256] = {};		// 8 KB on the stack, so queues can be sorted on several threads at once
+	for (size_t i = 0; i < count; i++){
+		unsigned long long key = packets[i].key;
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	RenderPacket * source = &packets[0];
+	RenderPacket * destination = &scratch[0];
+	for (int digit = 0; digit < 8; digit++){
+		unsigned int * histogram = histograms[digit];
+		if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count)
+			continue;
+
+		// Histogram -> first output slot of each digit value
+		unsigned int offset = 0;
+		for (int value = 0; value < 256; value++){
+			unsigned int size = histogram[value];
+			histogram[value] = offset;
+			offset += size;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			destination[histogram[(source[i].key >> (digit * 8)) & 0xFF]++] = source[i];
+		std::swap(source, destination);
+	}
+
+	if (source != &packets[0])
+		packets.swap(scratch);
+}
+
+// Same sort on the job system's threads: each pass, every chunk of packets counts its digits, the chunks' output
+// ranges are laid out one after the other per digit value, then every chunk scatters its packets in order (stable)
+static void parallelRadixSort(std::vector<RenderPacket> & packets, std::vector<RenderPacket> & scratch, std::vector<unsigned int> & chunkHistograms){
+	int count = (int)packets.size();
+	int chunks = (count + RADIX_CHUNK_PACKETS - 1) / RADIX_CHUNK_PACKETS;
+	scratch.resize(count);
+	chunkHistograms.resize(chunks * 256);
+
+	// Which digits every key shares, from one pass over the keys
+	std::vector<unsigned long long> differs(chunks, 0);
+	parallelFor(chunks, 1, [&](int begin, int end){
+		for (int c = begin; c < end; c++){
+			unsigned long long first = packets[c * RADIX_CHUNK_PACKETS].key, bits = 0;
+			for (int i = c * RADIX_CHUNK_PACKETS; i < std::min(count, (c + 1) * RADIX_CHUNK_PACKETS); i++)
+				bits |= packets[i].key ^ first;
+			differs[c] = bits | (first ^ packets[0].key);
+		}
+	});
+	unsigned long long differentBits = 0;
+	for (int c = 0; c < chunks; c++)
+		differentBits |= differs[c];
+
+	RenderPacket * source = &packets[0];
+	RenderPacket * destination = &scratch[0];
+	for (int digit = 0; digit < 8; digit++){
+		int shift = digit * 8;
+		if (((differentBits >> shift) & 0xFF) == 0)
+			continue;
+
+		parallelFor(chunks, 1, [&](int begin, int end){
+			for (int c = begin; c < end; c++){
+				unsigned int * histogram = &chunkHistograms[c * 256];
+				memset(histogram, 0, 256 * sizeof(unsigned int));
+				for (int i = c * RADIX_CHUNK_PACKETS; i < std::min(count, (c + 1) * RADIX_CHUNK_PACKETS); i++)
+					histogram[(source[i].key >> shift) & 0xFF]++;
+			}
+		});
+
+		// Histograms -> first output slot of each chunk's digit values
+		unsigned int offset = 0;
+		for (int value = 0; value < 256; value++){
+			for (int c = 0; c < chunks; c++){
+				unsigned int size = chunkHistograms[c * 256 + value];
+				chunkHistograms[c * 256 + value] = offset;
+				offset += size;
+			}
+		}
+
+		parallelFor(chunks, 1, [&](int begin, int end){
+			for (int c = begin; c < end; c++){
+				unsigned int * histogram = &chunkHistograms[c * 256];
+				for (int i = c * RADIX_CHUNK_PACKETS; i < std::min(count, (c + 1) * RADIX_CHUNK_PACKETS); i++)
+					destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+			}
+		});
+		std::swap(source, destination);
+	}
+
+	if (source != &packets[0])
+		packets.swap(scratch);
+}
+
+static void sortPackets(std::vector<RenderPacket> & packets, std::vector<RenderPacket> & scratch, std::vector<unsigned int> & chunkHistograms){
+	if (packets.size() >= RADIX_PARALLEL_PACKETS && getJobThreadCount() > 1)
+		parallelRadixSort(packets, scratch, chunkHistograms);
+	else
+		radixSort(packets, scratch);
+}
+
+RenderQueue * createRenderQueue(){
+	RenderQueue * queue = new RenderQueue;
+	memset(&queue->stats, 0, sizeof(queue->stats));
+	return queue;
+}
+
+void deleteRenderQueue(RenderQueue * queue){
+	delete queue;
+}
+
+unsigned long long makeSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth){
+	if (depth < 0.0f)
+		depth = 0.0f;
+	if (depth > 1.0f)
+		depth = 1.0f;
+	unsigned int quantizedDepth = (unsigned int)(depth * 0xFFFFFF);
+	if (pass == RENDER_PASS_TRANSPARENT)
+		quantizedDepth = 0xFFFFFF - quantizedDepth;
+
+	return ((unsigned long long)(pass & 0xF) << 60) |
+		((unsigned long long)(shader & 0xFF) << 52) |
+		((unsigned long long)(material & 0xFFF) << 40) |
+		((unsigned long long)(mesh & 0xFFFF) << 24) |
+		quantizedDepth;
+}
+
+void submitRenderPacket(RenderQueue * queue, unsigned long long key, unsigned int data){
+	RenderPacket packet = { key, data };
+	queue->packets.push_back(packet);
+}
+
+void executeRenderQueue(RenderQueue * queue, const RenderQueueBackend & backend){
+	RenderQueueStats & stats = queue->stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.packets = (int)queue->packets.size();
+
+	double start = getTime();
+	sortPackets(queue->packets, queue->scratch, queue->chunkHistograms);
+	stats.sortMilliseconds = (float)((getTime() - start) * 1000.0);
+
+	unsigned int shader = 0xFFFFFFFF;
+	unsigned int material = 0xFFFFFFFF;
+	unsigned int mesh = 0xFFFFFFFF;
+	bool pending = false;
+	for (size_t i = 0; i < queue->packets.size(); i++){
+		const RenderPacket & packet = queue->packets[i];
+
+		if (backend.bindShader){
+			if (SORT_KEY_SHADER(packet.key) != shader){
+				if (pending && backend.flush)
+					backend.flush();
+				pending = false;
+				shader = SORT_KEY_SHADER(packet.key);
+				backend.bindShader(shader);
+				stats.shaderChanges++;
+			} else {
+				stats.elidedBinds++;
+			}
+		}
+		if (backend.bindMaterial){
+			if (SORT_KEY_MATERIAL(packet.key) != material){
+				if (pending && backend.flush)
+					backend.flush();
+				pending = false;
+				material = SORT_KEY_MATERIAL(packet.key);
+				backend.bindMaterial(material);
+				stats.materialChanges++;
+			} else {
+				stats.elidedBinds++;
+			}
+		}
+		if (backend.bindMesh){
+			if (SORT_KEY_MESH(packet.key) != mesh){
+				if (pending && backend.flush)
+					backend.flush();
+				pending = false;
+				mesh = SORT_KEY_MESH(packet.key);
+				backend.bindMesh(mesh);
+				stats.meshChanges++;
+			} else {
+				stats.elidedBinds++;
+			}
+		}
+
+		backend.draw(packet);
+		pending = true;
+	}
+	if (pending && backend.flush)
+		backend.flush();
+
+	queue->packets.clear();
+}
+
+RenderQueueStats getRenderQueueStats(RenderQueue * queue){
+	return queue->stats;
+}
+
+// Shader, material and mesh changes when drawing the packets in this order
+static int countStateChanges(const std::vector<RenderPacket> & packets){
+	int changes = 0;
+	for (size_t i = 0; i < packets.size(); i++){
+		unsigned long long key = packets[i].key;
+		unsigned long long previous = i > 0 ? packets[i - 1].key : ~key;
+		changes += SORT_KEY_SHADER(key) != SORT_KEY_SHADER(previous);
+		changes += SORT_KEY_MATERIAL(key) != SORT_KEY_MATERIAL(previous);
+		changes += SORT_KEY_MESH(key) != SORT_KEY_MESH(previous);
+	}
+	return changes;
+}
+
+static bool packetLess(const RenderPacket & a, const RenderPacket & b){
+	return a.key < b.key;
+}
+
+void benchmarkRenderQueue(int packets, int iterations){
+	// Random scene: 8 shaders, 64 materials, 256 meshes, random depths, submitted in random order
+	std::vector<RenderPacket> submitted(packets);
+	srand(1);
+	for (int i = 0; i < packets; i++){
+		float depth = (float)rand() / RAND_MAX;
+		submitted[i].key = makeSortKey(RENDER_PASS_OPAQUE, rand() % 8, rand() % 64, rand() % 256, depth);
+		submitted[i].data = i;
+	}
+
+	std::vector<RenderPacket> sorted;
+	std::vector<RenderPacket> scratch;
+	std::vector<unsigned int> chunkHistograms;
+	double start = getTime();
+	for (int i = 0; i < iterations; i++){
+		sorted = submitted;
+		sortPackets(sorted, scratch, chunkHistograms);
+	}
+	double radixSeconds = getTime() - start;
+
+	std::vector<RenderPacket> reference;
+	start = getTime();
+	for (int i = 0; i < iterations; i++){
+		reference = submitted;
+		std::sort(reference.begin(), reference.end(), packetLess);
+	}
+	double stdSeconds = getTime() - start;
+
+	bool same = true;
+	for (int i = 0; i < packets; i++)
+		same = same && sorted[i].key == reference[i].key;
+
+	printf("[DEBUG] Render queue (%d packets): radix sort %.3f ms (%u threads), std::sort %.3f ms%s\n", packets,
+		radixSeconds * 1000.0 / iterations, packets >= RADIX_PARALLEL_PACKETS ? getJobThreadCount() : 1,
+		stdSeconds * 1000.0 / iterations, same ? "" : " (ORDER MISMATCH)");
+	printf("[DEBUG] Render queue (%d packets): %d state changes unsorted, %d sorted\n", packets,
+		countStateChanges(submitted), countStateChanges(sorted));
+}
@@ -0,0 +1,63 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+// Render queue: draws are submitted during the frame as packets with a 64 bit sort key, radix sorted once all
+// are in, then executed in key order so draws sharing a shader, material and mesh end up next to each other and
+// each state is bound once per run. Opaque draws are sorted front to back inside a run to cut overdraw.
+//
+// Key layout, most significant first:
+//	pass (4 bits) | shader (8 bits) | material (12 bits) | mesh (16 bits) | depth (24 bits)
+
+#define RENDER_PASS_OPAQUE			0	// Front to back
+#define RENDER_PASS_TRANSPARENT		1	// Back to front
+#define RENDER_PASS_OVERLAY			2	// Front to back, after everything else
+
+#define SORT_KEY_SHADER(key)		((unsigned int)((key) >> 52) & 0xFF)
+#define SORT_KEY_MATERIAL(key)		((unsigned int)((key) >> 40) & 0xFFF)
+#define SORT_KEY_MESH(key)			((unsigned int)((key) >> 24) & 0xFFFF)
+
+struct RenderPacket {
+	unsigned long long key;
+	unsigned int data;		// Caller's payload, ie. index of the draw's transforms
+};
+
+// Called by executeRenderQueue. A NULL bind callback means that state is not part of the execution (its
+// changes are neither bound nor counted). flush() (may be NULL) runs before a bind that follows draws and
+// after the last draw, so a backend that batches the draws of a run (ie. into one multi-draw) can submit them.
+struct RenderQueueBackend {
+	void (*bindShader)(unsigned int shader);
+	void (*bindMaterial)(unsigned int material);
+	void (*bindMesh)(unsigned int mesh);
+	void (*draw)(const RenderPacket & packet);
+	void (*flush)(void);
+};
+
+// Last executed frame
+struct RenderQueueStats {
+	int packets;
+	int shaderChanges;
+	int materialChanges;
+	int meshChanges;
+	int elidedBinds;			// Binds skipped because the state was already current
+	float sortMilliseconds;
+};
+
+struct RenderQueue;
+
+RenderQueue * createRenderQueue();
+void deleteRenderQueue(RenderQueue * queue);
+
+// Depth is the view depth mapped to 0 (near) - 1 (far), it is flipped for RENDER_PASS_TRANSPARENT
+unsigned long long makeSortKey(unsigned int pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth);
+
+void submitRenderPacket(RenderQueue * queue, unsigned long long key, unsigned int data);
+
+// Sort the frame's packets, bind and draw them through the backend, then empty the queue
+void executeRenderQueue(RenderQueue * queue, const RenderQueueBackend & backend);
+
+RenderQueueStats getRenderQueueStats(RenderQueue * queue);
+
+// Print radix sort vs std::sort time and the state changes of unsorted vs sorted packets, for random draws
+void benchmarkRenderQueue(int packets, int iterations);
+
+#endif
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "timer.hpp"
+#include "transforms.hpp"
+#include "scenegraph.hpp"
+
+struct SceneGraph {
+	// One entry per node, in index order
+	std::vector<int> parents;
+	TransformArray * transforms;			// Local TRS, structure of arrays
+	std::vector<glm::mat4> localMatrices;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<unsigned char> dirty;		// Local transform changed since the last update
+	std::vector<unsigned char> updated;		// World matrix recomputed by the current update (read by the children)
+	int firstDirty;							// Lowest dirty node, nodes before it are all up to date
+
+	SceneGraphStats stats;
+};
+
+
+
+SceneGraph * createSceneGraph(){
+	SceneGraph * graph = new SceneGraph;
+	graph->transforms = createTransformArray();
+	graph->firstDirty = 0;
+	memset(&graph->stats, 0, sizeof(graph->stats));
+	return graph;
+}
+
+void deleteSceneGraph(SceneGraph * graph){
+	if (graph == NULL)
+		return;
+	deleteTransformArray(graph->transforms);
+	delete graph;
+}
+
+int addSceneNode(SceneGraph * graph, int parent){
+	int node = (int)graph->parents.size();
+	if (parent >= node){
+		printf("[WARNING] Scene node %d added under node %d, which doesn't exist yet; made a root.\n", node, parent);
+		parent = -1;
+	}
+	graph->parents.push_back(parent);
+	addTransform(graph->transforms, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+	graph->localMatrices.push_back(glm::mat4(1.0f));
+	graph->worldMatrices.push_back(glm::mat4(1.0f));
+	graph->dirty.push_back(1);
+	graph->updated.push_back(0);
+	if (node < graph->firstDirty)
+		graph->firstDirty = node;
+	return node;
+}
+
+int getSceneNodeCount(SceneGraph * graph){
+	return (int)graph->parents.size();
+}
+
+void setSceneNodeTransform(SceneGraph * graph, int node, const glm::vec3 & position, const glm::quat & orientation, const glm::vec3 & scale){
+	TransformStreams s = getTransformStreams(graph->transforms);
+	float values[10] = { position.x, position.y, position.z, orientation.x, orientation.y, orientation.z, orientation.w, scale.x, scale.y, scale.z };
+	float * components[10] = { s.px, s.py, s.pz, s.qx, s.qy, s.qz, s.qw, s.sx, s.sy, s.sz };
+	bool changed = false;
+	for (int c = 0; c < 10; c++){
+		changed = changed || components[c][node] != values[c];
+		components[c][node] = values[c];
+	}
+	if (!changed)
+		return;
+	graph->dirty[node] = 1;
+	if (node < graph->firstDirty)
+		graph->firstDirty = node;
+}
+
+void updateSceneGraph(SceneGraph * graph){
+	double start = getTime();
+	int count = (int)graph->parents.size();
+	int dirtyNodes = 0, updatedNodes = 0;
+
+	// Local matrices of the dirty nodes, each run of consecutive ones composed in one SIMD batch
+	const int * parents = count > 0 ? &graph->parents[0] : NULL;
+	unsigned char * dirty = count > 0 ? &graph->dirty[0] : NULL;
+	unsigned char * updated = count > 0 ? &graph->updated[0] : NULL;
+	TransformStreams streams = getTransformStreams(graph->transforms);
+	for (int i = graph->firstDirty; i < count; ){
+		if (!dirty[i]){
+			i++;
+			continue;
+		}
+		int first = i;
+		while (i < count && dirty[i])
+			i++;
+		composeTransforms(offsetTransformStreams(streams, first), i - first, NULL, NULL, &graph->localMatrices[first], NULL);
+		dirtyNodes += i - first;
+	}
+
+	// Parents come first: by the time a node is reached, its parent's world matrix is final and flagged if it changed
+	for (int i = graph->firstDirty; i < count; i++){
+		int parent = parents[i];
+		bool parentUpdated = parent >= 0 && updated[parent];
+		if (!dirty[i] && !parentUpdated)
+			continue;
+		dirty[i] = 0;
+		graph->worldMatrices[i] = parent >= 0 ? graph->worldMatrices[parent] * graph->localMatrices[i] : graph->localMatrices[i];
+		updated[i] = 1;
+		updatedNodes++;
+	}
+
+	// Clear the flags this update raised, so the next one starts clean below firstDirty too
+	for (int i = graph->firstDirty; i < count; i++)
+		updated[i] = 0;
+	graph->firstDirty = count;
+
+	graph->stats.nodes = count;
+	graph->stats.dirtyNodes = dirtyNodes;
+	graph->stats.updatedNodes = updatedNodes;
+	graph->stats.milliseconds = (float)((getTime() - start) * 1000.0);
+}
+
+const glm::mat4 * getWorldMatrices(SceneGraph * graph){
+	return graph->worldMatrices.empty() ? NULL : &graph->worldMatrices[0];
+}
+
+SceneGraphStats getSceneGraphStats(SceneGraph * graph){
+	return graph->stats;
+}
+
+void benchmarkSceneGraph(int nodes, int iterations){
+	// Random tree: each node hangs under one of the 64 nodes before it, or starts a new tree one time in 16 (deep chains)
+	SceneGraph * graph = createSceneGraph();
+	srand(1);
+	for (int i = 0; i < nodes; i++){
+		int parent = i == 0 || rand() % 16 == 0 ? -1 : i - 1 - rand() % (i < 64 ? i : 64);
+		addSceneNode(graph, parent);
+		glm::vec3 position((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+		setSceneNodeTransform(graph, i, position, glm::angleAxis((float)rand() / RAND_MAX, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f));
+	}
+	updateSceneGraph(graph);
+
+	// 1% of the nodes move every iteration
+	double dirtySeconds = 0.0;
+	int updatedNodes = 0;
+	for (int it = 0; it < iterations; it++){
+		for (int i = it % 100; i < nodes; i += 100)
+			setSceneNodeTransform(graph, i, glm::vec3(sinf((float)(it + i)), 0.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+		double start = getTime();
+		updateSceneGraph(graph);
+		dirtySeconds += getTime() - start;
+		updatedNodes += getSceneGraphStats(graph).updatedNodes;
+	}
+
+	// Reference: every node's local and world matrix rebuilt, as drawing each object from its TRS did
+	std::vector<glm::mat4> world(nodes);
+	TransformStreams s = getTransformStreams(graph->transforms);
+	double start = getTime();
+	for (int it = 0; it < iterations; it++){
+		for (int i = 0; i < nodes; i++){
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(s.px[i], s.py[i], s.pz[i])) * glm::mat4_cast(glm::quat(s.qw[i], s.qx[i], s.qy[i], s.qz[i]))
+				* glm::scale(glm::mat4(1.0f), glm::vec3(s.sx[i], s.sy[i], s.sz[i]));
+			world[i] = graph->parents[i] >= 0 ? world[graph->parents[i]] * local : local;
+		}
+	}
+	double fullSeconds = getTime() - start;
+
+	// Both must agree on every world matrix
+	float error = 0.0f;
+	const glm::mat4 * matrices = getWorldMatrices(graph);
+	for (int i = 0; i < nodes; i++){
+		for (int c = 0; c < 4; c++){
+			glm::vec4 difference = glm::abs(matrices[i][c] - world[i][c]);
+			error = glm::max(error, glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)));
+		}
+	}
+
+	printf("[DEBUG] Scene graph (%d nodes, 1%% moving): dirty update %.3f ms (%d world matrices), full rebuild %.3f ms%s\n",
+		nodes, dirtySeconds * 1000.0 / iterations, updatedNodes / (iterations > 0 ? iterations : 1), fullSeconds * 1000.0 / iterations,
+		error < 1e-3f ? "" : " (MISMATCH)");
+	deleteSceneGraph(graph);
+}
@@ -0,0 +1,42 @@
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+
+// Scene graph: nodes with a parent and a local transform kept as translation, rotation and scale. Setting a transform
+// that differs from the stored one marks the node dirty; updateSceneGraph then recomputes the world matrix of the
+// dirty nodes and of everything below them, and leaves the rest of the tree alone. Nodes are stored in the order
+// they are added (a parent always before its children), so one pass in index order visits every parent first and
+// the world matrices sit in one contiguous array, ready to upload as is. Local transforms are kept as structure of
+// arrays (transforms.hpp), so runs of dirty nodes are composed into matrices with SIMD.
+
+// Last update
+struct SceneGraphStats {
+	int nodes;
+	int dirtyNodes;			// Nodes whose local transform changed
+	int updatedNodes;		// World matrices recomputed (the dirty nodes and their descendants)
+	float milliseconds;
+};
+
+struct SceneGraph;
+
+SceneGraph * createSceneGraph();
+void deleteSceneGraph(SceneGraph * graph);
+
+// Returns the node's index (0, 1, 2, ... in the order they are added), parent -1 for a root. Starts as identity.
+int addSceneNode(SceneGraph * graph, int parent);
+int getSceneNodeCount(SceneGraph * graph);
+
+// Local transform relative to the parent: translate(position) * rotate(orientation) * scale(scale)
+void setSceneNodeTransform(SceneGraph * graph, int node, const glm::vec3 & position, const glm::quat & orientation, const glm::vec3 & scale);
+
+// Recompute the world matrices of the dirty subtrees
+void updateSceneGraph(SceneGraph * graph);
+
+// Node i's world matrix is element i, valid until nodes are added
+const glm::mat4 * getWorldMatrices(SceneGraph * graph);
+
+SceneGraphStats getSceneGraphStats(SceneGraph * graph);
+
+// Print the update time with 1% of the nodes moving against recomputing every world matrix, for a random tree
+void benchmarkSceneGraph(int nodes, int iterations);
+
+#endif
@@ -5,106 +5,461 @@
 #include <fstream>
 #include <algorithm>
 #include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
 using namespace std;
 
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
 #include <GL/glew.h>
 
 #include "shader.hpp"
+#include "profiler.hpp"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+// Program binary cache: linked programs are saved with glGetProgramBinary and reloaded with glProgramBinary
+// on the next launch, skipping the GLSL compile. The key covers both sources, the defines, and the driver's
+// vendor / renderer / version strings, so a driver update or an edited shader simply misses the cache.
+static std::string shaderCacheDirectory = "shadercache";
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+#define SHADER_CACHE_MAGIC 0x50425331 // "1SBP"
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
+struct ShaderCacheHeader {
+	unsigned int magic;
+	unsigned int binaryFormat;
+	unsigned int binaryLength;
+	float compileMilliseconds;	// What the cache saves on every hit
+};
+
+void setShaderCacheDirectory(const char * directory){
+	shaderCacheDirectory = directory ? directory : "";
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 64 bit FNV-1a
+static unsigned long long hashString(const std::string & text, unsigned long long hash = 14695981039346656037ULL){
+	for (size_t i = 0; i < text.size(); i++){
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static bool programBinariesSupported(){
+	if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+static std::string shaderCachePath(const std::string & VertexShaderCode, const std::string & FragmentShaderCode, const std::string & Defines){
+	std::string key;
+	key += (const char *)glGetString(GL_VENDOR);   key += '\n';
+	key += (const char *)glGetString(GL_RENDERER); key += '\n';
+	key += (const char *)glGetString(GL_VERSION);  key += '\n';
+	key += Defines;
+	unsigned long long hash = hashString(FragmentShaderCode, hashString(VertexShaderCode, hashString(key)));
+
+	char name[32];
+	sprintf(name, "%016llx.bin", hash);
+	return shaderCacheDirectory + "/" + name;
+}
+
+// Returns 0 if there is no usable entry (missing, corrupt, or rejected by the driver)
+static GLuint loadCachedProgram(const std::string & path, float & compileMilliseconds){
+	std::ifstream CacheStream(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!CacheStream.is_open())
+		return 0;
+	std::streamoff FileSize = CacheStream.tellg();
+	CacheStream.seekg(0, std::ios::beg);
+
+	// The binary must fill the rest of the file exactly, the length is not trusted before that
+	ShaderCacheHeader Header;
+	if (!CacheStream.read((char *)&Header, sizeof(Header)) || Header.magic != SHADER_CACHE_MAGIC ||
+		Header.binaryLength == 0 || (std::streamoff)sizeof(Header) + Header.binaryLength != FileSize)
+		return 0;
+	std::vector<char> Binary(Header.binaryLength);
+	if (!CacheStream.read(&Binary[0], Binary.size()))
+		return 0;
+
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, Header.binaryFormat, &Binary[0], Header.binaryLength);
+
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
 		return 0;
 	}
+	compileMilliseconds = Header.compileMilliseconds;
+	return ProgramID;
+}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+static void saveCachedProgram(const std::string & path, GLuint ProgramID, float compileMilliseconds){
+	GLint Length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &Length);
+	if (Length <= 0)
+		return;
+
+	ShaderCacheHeader Header;
+	std::vector<char> Binary(Length);
+	GLenum Format = 0;
+	glGetProgramBinary(ProgramID, Length, NULL, &Format, &Binary[0]);
+	Header.magic = SHADER_CACHE_MAGIC;
+	Header.binaryFormat = Format;
+	Header.binaryLength = Length;
+	Header.compileMilliseconds = compileMilliseconds;
+
+	makeDirectory(shaderCacheDirectory.c_str());
+	std::ofstream CacheStream(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!CacheStream.is_open())
+		return;
+	CacheStream.write((const char *)&Header, sizeof(Header));
+	CacheStream.write(&Binary[0], Binary.size());
+}
+
+// One distinct set of #defines, i.e. one program
+struct ShaderVariant {
+	std::string Defines;
+	std::string CachePath;
+	GLuint ProgramID;
+	GLuint VertexShaderID;
+	GLuint FragmentShaderID;
+};
+
+// #define injected for each feature bit (see SHADER_NORMAL_MAP... in shader.hpp)
+static const char * shaderFeatureNames[] = { "NORMAL_MAP", "SPECULAR_MAP", "VIRTUAL_TEXTURE", "QUANTIZED_VERTICES", "INSTANCED", "DRAW_PARAMETERS" };
+
+// Shared contexts for compiling in parallel when the driver has no GL_ARB/KHR_parallel_shader_compile
+static std::vector<void *> compileContexts;
+static void (*compileMakeCurrent)(void * context) = NULL;
+
+void setShaderCompileContexts(void ** contexts, int count, void (*makeCurrent)(void * context)){
+	compileContexts.assign(contexts, contexts + count);
+	compileMakeCurrent = makeCurrent;
+}
+
+static bool readShaderFile(const char * path, std::string & code){
+	std::ifstream ShaderStream(path, std::ios::in);
+	if (!ShaderStream.is_open())
+		return false;
+	std::stringstream sstr;
+	sstr << ShaderStream.rdbuf();
+	code = sstr.str();
+	return true;
+}
+
+// Feature bits as #defines. Bits whose name the sources never mention are dropped, so they can't make a duplicate program.
+static std::string featureDefines(unsigned int features, const std::string & VertexShaderCode, const std::string & FragmentShaderCode){
+	std::string defines;
+	for (int i = 0; i < (int)(sizeof(shaderFeatureNames) / sizeof(shaderFeatureNames[0])); i++){
+		const char * name = shaderFeatureNames[i];
+		if ((features & (1u << i)) && (VertexShaderCode.find(name) != std::string::npos || FragmentShaderCode.find(name) != std::string::npos))
+			defines += std::string("#define ") + name + "\n";
 	}
+	unsigned int lights = (features >> 8) & 0xF;
+	if (lights > 1 && (VertexShaderCode.find("LIGHT_COUNT") != std::string::npos || FragmentShaderCode.find("LIGHT_COUNT") != std::string::npos)){
+		char line[32];
+		sprintf(line, "#define LIGHT_COUNT %u\n", lights);
+		defines += line;
+	}
+	return defines;
+}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+// Insert the defines after the #version line (which has to come first), #line keeps compiler messages on the file's line numbers
+static std::string injectDefines(const std::string & code, const std::string & defines){
+	if (defines.empty())
+		return code;
+	size_t version = code.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return defines + "#line 1\n" + code;
+	char line[32];
+	sprintf(line, "#line %d\n", (int)std::count(code.begin(), code.begin() + lineEnd, '\n') + 2);
+	return code.substr(0, lineEnd + 1) + defines + line + code.substr(lineEnd + 1);
+}
+
+// Creates the shaders and the program and starts compiling / linking them. The results are checked by
+// finishProgram(), so with GL_ARB/KHR_parallel_shader_compile the driver can work on several programs at once.
+static void startProgram(ShaderVariant & Variant, const std::string & VertexShaderCode, const std::string & FragmentShaderCode,
+	const char * vertex_file_path, const char * fragment_file_path, bool retrievable){
 
+	// Create the shaders
+	Variant.VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	Variant.FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
+	std::string VertexSource = injectDefines(VertexShaderCode, Variant.Defines);
+	char const * VertexSourcePointer = VertexSource.c_str();
+	glShaderSource(Variant.VertexShaderID, 1, &VertexSourcePointer , NULL);
+	glCompileShader(Variant.VertexShaderID);
+
+	// Compile Fragment Shader
+	printf("Compiling shader : %s\n", fragment_file_path);
+	std::string FragmentSource = injectDefines(FragmentShaderCode, Variant.Defines);
+	char const * FragmentSourcePointer = FragmentSource.c_str();
+	glShaderSource(Variant.FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	glCompileShader(Variant.FragmentShaderID);
+
+	// Link the program
+	Variant.ProgramID = glCreateProgram();
+	glAttachShader(Variant.ProgramID, Variant.VertexShaderID);
+	glAttachShader(Variant.ProgramID, Variant.FragmentShaderID);
+	if (retrievable)
+		glProgramParameteri(Variant.ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(Variant.ProgramID);
+}
+
+// Waits for startProgram()'s work, prints the logs and releases the shaders. Returns true if the program linked.
+static bool finishProgram(ShaderVariant & Variant){
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 
 	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(Variant.VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
 		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+		glGetShaderInfoLog(Variant.VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
 		printf("%s\n", &VertexShaderErrorMessage[0]);
 	}
 
-
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
 	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(Variant.FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
 		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+		glGetShaderInfoLog(Variant.FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
 		printf("%s\n", &FragmentShaderErrorMessage[0]);
 	}
 
-
-
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
 	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetProgramiv(Variant.ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(Variant.ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
 		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(Variant.ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
 
-	
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
-	
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
 
+	glDetachShader(Variant.ProgramID, Variant.VertexShaderID);
+	glDetachShader(Variant.ProgramID, Variant.FragmentShaderID);
+
+	glDeleteShader(Variant.VertexShaderID);
+	glDeleteShader(Variant.FragmentShaderID);
+
+	return Result == GL_TRUE;
+}
+
+// GL_KHR_parallel_shader_compile is newer than the bundled GLEW, it's only used when the headers know it.
+// Both share GL_COMPLETION_STATUS (0x91B1).
+bool isParallelShaderCompileSupported(){
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile)
+		return true;
+#endif
+	return GLEW_ARB_parallel_shader_compile != 0;
+}
+
+static void setMaxShaderCompilerThreads(){
+#ifdef GL_KHR_parallel_shader_compile
+	if (GLEW_KHR_parallel_shader_compile){
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		return;
+	}
+#endif
+	glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+struct ShaderBatch {
+	std::string VertexPath;
+	std::string FragmentPath;
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	std::vector<ShaderVariant> Variants;
+	std::vector<int> VariantOf;				// Variant of each permutation
+	std::vector<ShaderVariant *> Compile;	// Cache misses
+	bool UseCache;
+	bool Started;							// Compiles already issued to the driver's threads
+	double LoadMilliseconds;
+	double SavedMilliseconds;
+	std::chrono::steady_clock::time_point CompileStart;
+};
+
+ShaderBatch * beginShaderPermutations(const char * vertex_file_path, const char * fragment_file_path, const char * defines,
+	const unsigned int * features, int count){
+	PROFILE_ZONE("beginShaderPermutations");
+
+	ShaderBatch * Batch = new ShaderBatch;
+	Batch->VertexPath = vertex_file_path;
+	Batch->FragmentPath = fragment_file_path;
+
+	// Read the Vertex Shader code from the file
+	if (!readShaderFile(vertex_file_path, Batch->VertexShaderCode)){
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
+		getchar();
+		delete Batch;
+		return NULL;
+	}
+
+	// Read the Fragment Shader code from the file
+	readShaderFile(fragment_file_path, Batch->FragmentShaderCode);
+	const std::string & VertexShaderCode = Batch->VertexShaderCode;
+	const std::string & FragmentShaderCode = Batch->FragmentShaderCode;
+
+	// One variant per distinct set of #defines
+	std::vector<ShaderVariant> & Variants = Batch->Variants;
+	Batch->VariantOf.resize(count);
+	for (int i = 0; i < count; i++){
+		std::string Defines = (defines ? defines : "") + featureDefines(features[i], VertexShaderCode, FragmentShaderCode);
+		int v = 0;
+		while (v < (int)Variants.size() && Variants[v].Defines != Defines)
+			v++;
+		if (v == (int)Variants.size()){
+			ShaderVariant Variant;
+			Variant.Defines = Defines;
+			Variant.ProgramID = 0;
+			Variants.push_back(Variant);
+		}
+		Batch->VariantOf[i] = v;
+	}
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	// Try the program binary cache first
+	Batch->UseCache = !shaderCacheDirectory.empty() && programBinariesSupported();
+	Batch->SavedMilliseconds = 0.0;
+	for (size_t v = 0; v < Variants.size(); v++){
+		if (Batch->UseCache){
+			float CompileMilliseconds = 0.0f;
+			Variants[v].CachePath = shaderCachePath(VertexShaderCode, FragmentShaderCode, Variants[v].Defines);
+			Variants[v].ProgramID = loadCachedProgram(Variants[v].CachePath, CompileMilliseconds);
+			if (Variants[v].ProgramID){
+				Batch->SavedMilliseconds += CompileMilliseconds;
+				continue;
+			}
+		}
+		// Cache miss (or a binary the driver no longer accepts): compile from source and refresh the entry
+		Batch->Compile.push_back(&Variants[v]);
+	}
+	Batch->LoadMilliseconds = millisecondsSince(Start);
+
+	// Issue every compile and link now and return without checking any of them: the driver's threads work
+	// through the batch while the caller gets on with something else
+	Batch->Started = !Batch->Compile.empty() && isParallelShaderCompileSupported();
+	Batch->CompileStart = std::chrono::steady_clock::now();
+	if (Batch->Started){
+		setMaxShaderCompilerThreads();
+		for (size_t v = 0; v < Batch->Compile.size(); v++)
+			startProgram(*Batch->Compile[v], VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path, Batch->UseCache);
+	}
+	return Batch;
+}
+
+int finishShaderPermutations(ShaderBatch * Batch, GLuint * programs){
+	PROFILE_ZONE("finishShaderPermutations");
+	if (Batch == NULL)
+		return 0;
+
+	std::vector<ShaderVariant *> & Compile = Batch->Compile;
+	const std::string & VertexShaderCode = Batch->VertexShaderCode;
+	const std::string & FragmentShaderCode = Batch->FragmentShaderCode;
+	const char * vertex_file_path = Batch->VertexPath.c_str();
+	const char * fragment_file_path = Batch->FragmentPath.c_str();
+	bool UseCache = Batch->UseCache;
+
+	const char * CompileMode = "the main thread";
+	if (Batch->Started){
+		// Only query a program once the driver reports it complete, a status query before that would wait for it
+		std::vector<ShaderVariant *> Pending = Compile;
+		while (!Pending.empty()){
+			for (size_t v = 0; v < Pending.size(); ){
+				GLint Done = GL_FALSE;
+				glGetProgramiv(Pending[v]->ProgramID, GL_COMPLETION_STATUS_ARB, &Done);
+				if (Done == GL_TRUE){
+					finishProgram(*Pending[v]);
+					Pending.erase(Pending.begin() + v);
+				}
+				else
+					v++;
+			}
+			if (!Pending.empty())
+				std::this_thread::yield();
+		}
+		CompileMode = "driver compiler threads";
+	}
+	else if (compileContexts.size() > 0 && Compile.size() > 1){
+		// One thread per shared context, programs are shared objects so they're usable here once glFinish returns
+		std::atomic<int> Next(0);
+		std::vector<std::thread> Workers;
+		for (size_t c = 0; c < compileContexts.size() && c < Compile.size(); c++)
+			Workers.push_back(std::thread([&, c](){
+				compileMakeCurrent(compileContexts[c]);
+				for (int v = Next++; v < (int)Compile.size(); v = Next++){
+					startProgram(*Compile[v], VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path, UseCache);
+					finishProgram(*Compile[v]);
+				}
+				glFinish();
+				compileMakeCurrent(NULL);
+			}));
+		for (size_t w = 0; w < Workers.size(); w++)
+			Workers[w].join();
+		CompileMode = "shared contexts";
+	}
+	else {
+		for (size_t v = 0; v < Compile.size(); v++){
+			startProgram(*Compile[v], VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path, UseCache);
+			finishProgram(*Compile[v]);
+		}
+	}
+	// With the driver's threads this includes whatever the caller did between begin and finish
+	double CompileMilliseconds = millisecondsSince(Batch->CompileStart);
+
+	// Store what was compiled, with its share of the compile time (what the cache will save next launch)
+	for (size_t v = 0; v < Compile.size(); v++){
+		GLint Result = GL_FALSE;
+		glGetProgramiv(Compile[v]->ProgramID, GL_LINK_STATUS, &Result);
+		if (UseCache && Result == GL_TRUE)
+			saveCachedProgram(Compile[v]->CachePath, Compile[v]->ProgramID, (float)(CompileMilliseconds / Compile.size()));
+	}
+
+	int count = (int)Batch->VariantOf.size();
+	int variants = (int)Batch->Variants.size();
+	printf("%d permutation(s) of %s + %s -> %d program(s): %d from the binary cache in %.2f ms (compiling took %.2f ms), %d compiled on %s in %.2f ms\n",
+		count, vertex_file_path, fragment_file_path, variants,
+		(int)(variants - Compile.size()), Batch->LoadMilliseconds, Batch->SavedMilliseconds, (int)Compile.size(), CompileMode, CompileMilliseconds);
+
+	for (int i = 0; i < count; i++)
+		programs[i] = Batch->Variants[Batch->VariantOf[i]].ProgramID;
+	delete Batch;
+	return variants;
+}
+
+int LoadShaderPermutations(const char * vertex_file_path, const char * fragment_file_path, const char * defines,
+	const unsigned int * features, int count, GLuint * programs){
+	PROFILE_ZONE("LoadShaderPermutations");
+	return finishShaderPermutations(beginShaderPermutations(vertex_file_path, fragment_file_path, defines, features, count), programs);
+}
+
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	PROFILE_ZONE("LoadShaders");
+	unsigned int Features = 0;
+	GLuint ProgramID = 0;
+	LoadShaderPermutations(vertex_file_path, fragment_file_path, NULL, &Features, 1, &ProgramID);
 	return ProgramID;
 }
 
@@ -3,4 +3,42 @@
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// Shader permutations: each feature bit becomes a #define injected after the #version line of both sources
+#define SHADER_NORMAL_MAP			0x01		// #define NORMAL_MAP
+#define SHADER_SPECULAR_MAP			0x02		// #define SPECULAR_MAP
+#define SHADER_VIRTUAL_TEXTURE		0x04		// #define VIRTUAL_TEXTURE
+#define SHADER_QUANTIZED_VERTICES	0x08		// #define QUANTIZED_VERTICES
+#define SHADER_INSTANCED			0x10		// #define INSTANCED
+#define SHADER_DRAW_PARAMETERS		0x20		// #define DRAW_PARAMETERS
+#define SHADER_LIGHT_COUNT(n)		((n) << 8)	// #define LIGHT_COUNT n (2 to 15, the shaders default to 1)
+
+// Compile one program per entry of features[] into programs[], with defines (may be NULL) added to every variant.
+// Entries that end up with the same #defines share one program (bits the sources never mention are dropped),
+// so delete each distinct program once. Variants are compiled in parallel with GL_ARB/KHR_parallel_shader_compile,
+// else on the contexts given to setShaderCompileContexts(), else one after the other, and go through the binary cache.
+// Returns the number of distinct programs, 0 if the vertex shader can't be read.
+int LoadShaderPermutations(const char * vertex_file_path, const char * fragment_file_path, const char * defines,
+	const unsigned int * features, int count, GLuint * programs);
+
+// LoadShaderPermutations in two halves, on the thread owning the context. With parallel shader compile, begin issues
+// every compile and link and returns at once, so the caller can do other work while the driver's threads compile;
+// finish then collects each program as the driver reports it complete, fills programs[] and deletes the batch.
+// Without the extension begin only reads the sources and the cache, and finish compiles. begin returns NULL (and
+// finish 0) if the vertex shader can't be read.
+struct ShaderBatch;
+ShaderBatch * beginShaderPermutations(const char * vertex_file_path, const char * fragment_file_path, const char * defines,
+	const unsigned int * features, int count);
+int finishShaderPermutations(ShaderBatch * batch, GLuint * programs);
+
+// True if the driver compiles programs on its own threads (GL_ARB_parallel_shader_compile, or the KHR one when
+// the GLEW headers know it)
+bool isParallelShaderCompileSupported();
+
+// Contexts sharing objects with the main one (e.g. hidden GLFW windows) that LoadShaderPermutations can compile on,
+// one worker thread each. makeCurrent(context) binds a context to the calling thread, makeCurrent(NULL) releases it.
+void setShaderCompileContexts(void ** contexts, int count, void (*makeCurrent)(void * context));
+
+// Directory of the program binary cache used by LoadShaders ("shadercache" by default, NULL disables it)
+void setShaderCacheDirectory(const char * directory);
+
 #endif
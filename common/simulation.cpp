@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "timer.hpp"
+#include "simulation.hpp"
+#include "profiler.hpp"
+
+#define SIMULATION_MAX_CATCH_UP		4		// Ticks run back to back when late, the rest is dropped
+
+struct Simulation {
+	double tickSeconds;
+	size_t snapshotSize;
+	SimulationTick tick;
+	void * user;
+
+	// Three snapshot buffers: the previous and current published ones, and the one the next tick writes
+	std::vector<unsigned char> buffers[3];
+	double stamps[3];			// Wall clock time each snapshot stands for
+	int previous, current, back;
+	std::mutex publishMutex;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	bool stepped;				// Driven by stepSimulation, not the thread
+	SimulationStats stats;		// Written under publishMutex
+};
+
+
+
+// Run one tick into the back buffer and publish it as the current snapshot
+static void runTick(Simulation * simulation, double time, double stamp){
+	PROFILE_ZONE("Simulation tick");
+	double start = getTime();
+	simulation->tick(&simulation->buffers[simulation->back][0], time, simulation->tickSeconds, simulation->user);
+	float milliseconds = (float)((getTime() - start) * 1000.0);
+
+	std::lock_guard<std::mutex> lock(simulation->publishMutex);
+	simulation->stamps[simulation->back] = stamp;
+	int oldPrevious = simulation->previous;
+	simulation->previous = simulation->current;
+	simulation->current = simulation->back;
+	simulation->back = oldPrevious;
+	simulation->stats.ticks++;
+	simulation->stats.tickMilliseconds = milliseconds;
+	simulation->stats.time = time;
+}
+
+static void simulationLoop(Simulation * simulation){
+	PROFILE_THREAD("Simulation");
+	double tickSeconds = simulation->tickSeconds;
+	double time = simulation->stats.time;
+	double next = simulation->stamps[simulation->current] + tickSeconds;
+
+	while (simulation->running.load()){
+		double now = getTime();
+		if (now < next){
+			std::this_thread::sleep_for(std::chrono::duration<double>(next - now));
+			continue;
+		}
+
+		for (int caughtUp = 0; next <= now && caughtUp < SIMULATION_MAX_CATCH_UP; caughtUp++){
+			time += tickSeconds;
+			runTick(simulation, time, next);
+			next += tickSeconds;
+		}
+		if (next <= now){
+			// Still behind: drop the ticks that didn't fit rather than fall further back
+			int dropped = (int)((now - next) / tickSeconds) + 1;
+			next += dropped * tickSeconds;
+			std::lock_guard<std::mutex> lock(simulation->publishMutex);
+			simulation->stats.droppedTicks += dropped;
+		}
+	}
+}
+
+Simulation * createSimulation(double tickSeconds, size_t snapshotSize, SimulationTick tick, void * user){
+	Simulation * simulation = new Simulation;
+	simulation->tickSeconds = tickSeconds;
+	simulation->snapshotSize = snapshotSize;
+	simulation->tick = tick;
+	simulation->user = user;
+	for (int i = 0; i < 3; i++){
+		simulation->buffers[i].assign(snapshotSize, 0);
+		simulation->stamps[i] = 0.0;
+	}
+	simulation->previous = 0;
+	simulation->current = 1;
+	simulation->back = 2;
+	simulation->running.store(false);
+	simulation->stepped = false;
+	memset(&simulation->stats, 0, sizeof(simulation->stats));
+	return simulation;
+}
+
+void deleteSimulation(Simulation * simulation){
+	if (simulation == NULL)
+		return;
+	stopSimulation(simulation);
+	delete simulation;
+}
+
+void startSimulation(Simulation * simulation){
+	if (simulation->running.load())
+		return;
+
+	// Tick 0 at time 0, published as both snapshots
+	double now = getTime();
+	runTick(simulation, 0.0, now);
+	simulation->buffers[simulation->previous] = simulation->buffers[simulation->current];
+	simulation->stamps[simulation->previous] = now - simulation->tickSeconds;
+
+	simulation->running.store(true);
+	simulation->thread = std::thread(simulationLoop, simulation);
+}
+
+void stepSimulation(Simulation * simulation){
+	if (!simulation->stepped){
+		runTick(simulation, 0.0, 0.0);
+		simulation->buffers[simulation->previous] = simulation->buffers[simulation->current];
+		simulation->stepped = true;
+		return;
+	}
+	runTick(simulation, simulation->stats.time + simulation->tickSeconds, 0.0);
+}
+
+void stopSimulation(Simulation * simulation){
+	if (!simulation->running.load())
+		return;
+	simulation->running.store(false);
+	simulation->thread.join();
+}
+
+float getSimulationSnapshots(Simulation * simulation, void * previous, void * current){
+	// Render one tick behind the newest snapshot, so there are snapshots on both sides of the render time
+	double renderTime = getTime() - simulation->tickSeconds;
+
+	std::lock_guard<std::mutex> lock(simulation->publishMutex);
+	memcpy(previous, &simulation->buffers[simulation->previous][0], simulation->snapshotSize);
+	memcpy(current, &simulation->buffers[simulation->current][0], simulation->snapshotSize);
+
+	if (simulation->stepped)
+		return 1.0f;
+	double from = simulation->stamps[simulation->previous];
+	double to = simulation->stamps[simulation->current];
+	if (to <= from)
+		return 1.0f;
+	return (float)glm::clamp((renderTime - from) / (to - from), 0.0, 1.0);
+}
+
+SimulationStats getSimulationStats(Simulation * simulation){
+	std::lock_guard<std::mutex> lock(simulation->publishMutex);
+	return simulation->stats;
+}
+
+SimulationTransform blendTransform(const SimulationTransform & previous, const SimulationTransform & current, float blend){
+	SimulationTransform transform;
+	transform.position = glm::mix(previous.position, current.position, blend);
+	transform.orientation = glm::slerp(previous.orientation, current.orientation, blend);
+	transform.scale = glm::mix(previous.scale, current.scale, blend);
+	return transform;
+}
+
+glm::mat4 interpolateTransform(const SimulationTransform & previous, const SimulationTransform & current, float blend){
+	SimulationTransform transform = blendTransform(previous, current, blend);
+	return glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(transform.orientation) * glm::scale(glm::mat4(1.0f), transform.scale);
+}
@@ -0,0 +1,52 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+// Fixed timestep simulation on its own thread: the tick function advances the caller's state by exactly one tick
+// and writes a snapshot of it, tick after tick on the wall clock whatever the render rate. Snapshots are published
+// double buffered (the newest two, plus the one being written), and the renderer blends the two around
+// now - one tick, so motion stays smooth at any frame rate and the simulation always steps the same way.
+// If ticks take longer than the tick itself, at most a few are caught up per wake and the rest is dropped (the
+// simulation slows down instead of spiralling).
+
+// Called on the simulation thread: advance by tickSeconds to time (seconds since start) and write the snapshot
+typedef void (*SimulationTick)(void * snapshot, double time, double tickSeconds, void * user);
+
+struct SimulationStats {
+	int ticks;					// Since start
+	int droppedTicks;
+	float tickMilliseconds;		// Cost of the last tick
+	double time;				// Simulation time of the newest snapshot
+};
+
+// Scene transform as the simulation publishes it, blended with interpolateTransform
+struct SimulationTransform {
+	glm::vec3 position;
+	glm::quat orientation;
+	glm::vec3 scale;
+};
+
+struct Simulation;
+
+Simulation * createSimulation(double tickSeconds, size_t snapshotSize, SimulationTick tick, void * user);
+void deleteSimulation(Simulation * simulation);		// Stops it first
+
+// The first tick runs on the calling thread, so there is a snapshot as soon as this returns
+void startSimulation(Simulation * simulation);
+void stopSimulation(Simulation * simulation);
+
+// Deterministic stepping instead of the thread (benchmarks): exactly one tick on the calling thread per call, and
+// getSimulationSnapshots returns the newest snapshot unblended. Not to be mixed with startSimulation.
+void stepSimulation(Simulation * simulation);
+
+// Copy the newest two snapshots and return the blend factor between them (0 = previous, 1 = current) for now
+float getSimulationSnapshots(Simulation * simulation, void * previous, void * current);
+
+SimulationStats getSimulationStats(Simulation * simulation);
+
+// Transform between two transforms, the orientation is slerped
+SimulationTransform blendTransform(const SimulationTransform & previous, const SimulationTransform & current, float blend);
+
+// Model matrix (translation * rotation * scale) of blendTransform
+glm::mat4 interpolateTransform(const SimulationTransform & previous, const SimulationTransform & current, float blend);
+
+#endif
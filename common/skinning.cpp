@@ -0,0 +1,974 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "timer.hpp"
+#include "jobsystem.hpp"
+#include "glstate.hpp"
+#include "transforms.hpp"
+#include "fbxloader.hpp"
+#include "animationclip.hpp"
+#include "profiler.hpp"
+#include "skinning.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SKINNING_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SKINNING_SSE2
+#endif
+
+#define SKINNING_CHAIN_JOINTS	4		// Joints of the chain rigging a mesh that has no skin
+
+struct Skeleton {
+	std::vector<SkeletonJoint> joints;
+	std::vector<glm::mat4> inverseBind;
+};
+
+// Structure of arrays: component c of vertex i is positions[c][i], its k-th joint influences[k][i]
+struct SkinnedMesh {
+	int count;
+	int joints;
+	std::vector<float> positions[3];
+	std::vector<float> normals[3];
+	std::vector<int> influences[SKINNING_INFLUENCES];
+	std::vector<float> weights[SKINNING_INFLUENCES];
+};
+
+
+
+static glm::mat4 localMatrix(const glm::vec3 & position, const glm::quat & orientation, const glm::vec3 & scale){
+	glm::mat4 matrix = glm::mat4_cast(orientation);
+	matrix[0] *= scale.x;
+	matrix[1] *= scale.y;
+	matrix[2] *= scale.z;
+	matrix[3] = glm::vec4(position, 1.0f);
+	return matrix;
+}
+
+Skeleton * createSkeleton(const SkeletonJoint * joints, int count){
+	if (count <= 0 || count > SKINNING_MAX_JOINTS){
+		printf("[WARNING] Skeletons have 1 to %d joints, not %d.\n", SKINNING_MAX_JOINTS, count);
+		return NULL;
+	}
+	Skeleton * skeleton = new Skeleton;
+	skeleton->joints.assign(joints, joints + count);
+	std::vector<glm::mat4> bind(count);
+	for (int j = 0; j < count; j++){
+		int parent = joints[j].parent;
+		if (parent >= j){
+			printf("[WARNING] Joint %s comes before its parent.\n", joints[j].name.c_str());
+			delete skeleton;
+			return NULL;
+		}
+		glm::mat4 local = localMatrix(joints[j].position, joints[j].orientation, joints[j].scale);
+		bind[j] = parent >= 0 ? bind[parent] * local : local;
+		skeleton->inverseBind.push_back(glm::inverse(bind[j]));
+	}
+	return skeleton;
+}
+
+void deleteSkeleton(Skeleton * skeleton){
+	delete skeleton;
+}
+
+int getSkeletonJointCount(const Skeleton * skeleton){
+	return (int)skeleton->joints.size();
+}
+
+const SkeletonJoint * getSkeletonJoint(const Skeleton * skeleton, int joint){
+	return joint >= 0 && joint < (int)skeleton->joints.size() ? &skeleton->joints[joint] : NULL;
+}
+
+int getSkinningPaletteFloats(SkinningMethod method){
+	return method == SKINNING_LINEAR_BLEND ? 12 : 8;
+}
+
+void evaluateSkeletonPose(const Skeleton * skeleton, const TransformStreams & pose, SkinningMethod method, float * palette){
+	glm::mat4 world[SKINNING_MAX_JOINTS];
+	int floats = getSkinningPaletteFloats(method);
+	for (int j = 0; j < (int)skeleton->joints.size(); j++){
+		glm::mat4 local = localMatrix(glm::vec3(pose.px[j], pose.py[j], pose.pz[j]), glm::quat(pose.qw[j], pose.qx[j], pose.qy[j], pose.qz[j]),
+			glm::vec3(pose.sx[j], pose.sy[j], pose.sz[j]));
+		int parent = skeleton->joints[j].parent;
+		world[j] = parent >= 0 ? world[parent] * local : local;
+		glm::mat4 skin = world[j] * skeleton->inverseBind[j];
+
+		float * out = palette + j * floats;
+		if (method == SKINNING_LINEAR_BLEND){
+			for (int row = 0; row < 3; row++){
+				for (int column = 0; column < 4; column++)
+					out[row * 4 + column] = skin[column][row];
+			}
+		} else {
+			glm::dualquat dual(glm::normalize(glm::quat_cast(glm::mat3(skin))), glm::vec3(skin[3]));
+			out[0] = dual.real.x;
+			out[1] = dual.real.y;
+			out[2] = dual.real.z;
+			out[3] = dual.real.w;
+			out[4] = dual.dual.x;
+			out[5] = dual.dual.y;
+			out[6] = dual.dual.z;
+			out[7] = dual.dual.w;
+		}
+	}
+}
+
+SkinnedMesh * createSkinnedMesh(const Skeleton * skeleton, const glm::vec3 * positions, const glm::vec3 * normals,
+	const glm::ivec4 * joints, const glm::vec4 * weights, int count){
+	SkinnedMesh * mesh = new SkinnedMesh;
+	mesh->count = count > 0 ? count : 0;
+	mesh->joints = getSkeletonJointCount(skeleton);
+	for (int c = 0; c < 3; c++){
+		mesh->positions[c].resize(mesh->count);
+		mesh->normals[c].resize(mesh->count);
+	}
+	for (int k = 0; k < SKINNING_INFLUENCES; k++){
+		mesh->influences[k].resize(mesh->count);
+		mesh->weights[k].resize(mesh->count);
+	}
+	int dropped = 0;
+	for (int i = 0; i < mesh->count; i++){
+		for (int c = 0; c < 3; c++){
+			mesh->positions[c][i] = positions[i][c];
+			mesh->normals[c][i] = normals[i][c];
+		}
+		float vertexWeights[SKINNING_INFLUENCES];
+		float total = 0.0f;
+		for (int k = 0; k < SKINNING_INFLUENCES; k++){
+			bool valid = joints[i][k] >= 0 && joints[i][k] < mesh->joints;
+			dropped += !valid && weights[i][k] > 0.0f ? 1 : 0;
+			mesh->influences[k][i] = valid ? joints[i][k] : 0;
+			vertexWeights[k] = valid ? glm::max(weights[i][k], 0.0f) : 0.0f;
+			total += vertexWeights[k];
+		}
+		for (int k = 0; k < SKINNING_INFLUENCES; k++)
+			mesh->weights[k][i] = total > 0.0f ? vertexWeights[k] / total : (k == 0 ? 1.0f : 0.0f);
+	}
+	if (dropped > 0)
+		printf("[WARNING] %d vertex influences name joints the skeleton doesn't have.\n", dropped);
+	return mesh;
+}
+
+void deleteSkinnedMesh(SkinnedMesh * mesh){
+	delete mesh;
+}
+
+int getSkinnedMeshVertexCount(const SkinnedMesh * mesh){
+	return mesh->count;
+}
+
+// glm: the weighted sum of the joints' matrices, or of their dual quaternions on the hemisphere of the first one
+static void skinScalar(const SkinnedMesh * mesh, const float * palette, SkinningMethod method, int first, float * out){
+	for (int i = first; i < mesh->count; i++){
+		glm::vec3 position(mesh->positions[0][i], mesh->positions[1][i], mesh->positions[2][i]);
+		glm::vec3 normal(mesh->normals[0][i], mesh->normals[1][i], mesh->normals[2][i]);
+		if (method == SKINNING_LINEAR_BLEND){
+			glm::mat4 sum(0.0f);
+			for (int k = 0; k < SKINNING_INFLUENCES; k++){
+				float weight = mesh->weights[k][i];
+				if (weight == 0.0f)
+					continue;
+				const float * rows = palette + mesh->influences[k][i] * 12;
+				glm::mat4 joint(1.0f);
+				for (int row = 0; row < 3; row++){
+					for (int column = 0; column < 4; column++)
+						joint[column][row] = rows[row * 4 + column];
+				}
+				sum += joint * weight;
+			}
+			position = glm::vec3(sum * glm::vec4(position, 1.0f));
+			normal = glm::normalize(glm::mat3(sum) * normal);
+		} else {
+			const float * q = palette + mesh->influences[0][i] * 8;
+			glm::quat firstReal(q[3], q[0], q[1], q[2]);
+			glm::dualquat sum(glm::quat(0.0f, 0.0f, 0.0f, 0.0f), glm::quat(0.0f, 0.0f, 0.0f, 0.0f));
+			for (int k = 0; k < SKINNING_INFLUENCES; k++){
+				float weight = mesh->weights[k][i];
+				if (weight == 0.0f)
+					continue;
+				q = palette + mesh->influences[k][i] * 8;
+				glm::dualquat joint(glm::quat(q[3], q[0], q[1], q[2]), glm::quat(q[7], q[4], q[5], q[6]));
+				sum = sum + joint * (glm::dot(joint.real, firstReal) < 0.0f ? -weight : weight);
+			}
+			sum = glm::normalize(sum);
+			position = sum * position;
+			normal = sum.real * normal;
+		}
+		float * vertex = out + i * SKINNED_VERTEX_FLOATS;
+		vertex[0] = position.x;
+		vertex[1] = position.y;
+		vertex[2] = position.z;
+		vertex[3] = normal.x;
+		vertex[4] = normal.y;
+		vertex[5] = normal.z;
+	}
+}
+
+#if defined(SKINNING_SSE2) || defined(SKINNING_AVX2)
+// Row row (4 floats) of 4 vertices' joints, transposed to the row's 4 components of the 4
+static inline void loadRowsSSE2(const float * palette, int stride, const int * joints, int row, __m128 (&c)[4]){
+	__m128 r0 = _mm_loadu_ps(palette + joints[0] * stride + row * 4), r1 = _mm_loadu_ps(palette + joints[1] * stride + row * 4);
+	__m128 r2 = _mm_loadu_ps(palette + joints[2] * stride + row * 4), r3 = _mm_loadu_ps(palette + joints[3] * stride + row * 4);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	c[0] = r0;
+	c[1] = r1;
+	c[2] = r2;
+	c[3] = r3;
+}
+
+// Interleave 4 vertices (position, normal) into out
+static inline void storeVerticesSSE2(float * out, __m128 x, __m128 y, __m128 z, __m128 nx, __m128 ny, __m128 nz){
+	__m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(x, y, z, nx);
+	_MM_TRANSPOSE4_PS(ny, nz, a, b);
+	_mm_storeu_ps(out, x);
+	_mm_storel_pi((__m64 *)(out + 4), ny);
+	_mm_storeu_ps(out + 6, y);
+	_mm_storel_pi((__m64 *)(out + 10), nz);
+	_mm_storeu_ps(out + 12, z);
+	_mm_storel_pi((__m64 *)(out + 16), a);
+	_mm_storeu_ps(out + 18, nx);
+	_mm_storel_pi((__m64 *)(out + 22), b);
+}
+#endif
+
+#ifdef SKINNING_SSE2
+static int skinLinearSSE2(const SkinnedMesh * mesh, const float * palette, float * out){
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), tiny = _mm_set1_ps(1e-30f);
+	int i = 0;
+	for (; i + 4 <= mesh->count; i += 4){
+		// Weighted sum of the joints' rows, influences no vertex of the 4 has skipped
+		__m128 m[12];
+		for (int e = 0; e < 12; e++)
+			m[e] = zero;
+		for (int k = 0; k < SKINNING_INFLUENCES; k++){
+			__m128 w = _mm_loadu_ps(&mesh->weights[k][i]);
+			if (_mm_movemask_ps(_mm_cmpneq_ps(w, zero)) == 0)
+				continue;
+			for (int row = 0; row < 3; row++){
+				__m128 c[4];
+				loadRowsSSE2(palette, 12, &mesh->influences[k][i], row, c);
+				for (int e = 0; e < 4; e++)
+					m[row * 4 + e] = _mm_add_ps(m[row * 4 + e], _mm_mul_ps(w, c[e]));
+			}
+		}
+
+		__m128 x = _mm_loadu_ps(&mesh->positions[0][i]), y = _mm_loadu_ps(&mesh->positions[1][i]), z = _mm_loadu_ps(&mesh->positions[2][i]);
+		__m128 nx = _mm_loadu_ps(&mesh->normals[0][i]), ny = _mm_loadu_ps(&mesh->normals[1][i]), nz = _mm_loadu_ps(&mesh->normals[2][i]);
+		__m128 p[3], n[3];
+		for (int row = 0; row < 3; row++){
+			const __m128 * r = m + row * 4;
+			p[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], x), _mm_mul_ps(r[1], y)), _mm_add_ps(_mm_mul_ps(r[2], z), r[3]));
+			n[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], nx), _mm_mul_ps(r[1], ny)), _mm_mul_ps(r[2], nz));
+		}
+		__m128 squared = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2])), tiny);
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(squared));
+		storeVerticesSSE2(out + i * SKINNED_VERTEX_FLOATS, p[0], p[1], p[2], _mm_mul_ps(n[0], inverse), _mm_mul_ps(n[1], inverse), _mm_mul_ps(n[2], inverse));
+	}
+	return i;
+}
+
+// v + 2 r x (r x v + w v): v rotated by the unit quaternion r
+static inline void rotateSSE2(const __m128 (&r)[4], __m128 x, __m128 y, __m128 z, __m128 & ox, __m128 & oy, __m128 & oz){
+	__m128 tx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[1], z), _mm_mul_ps(r[2], y)), _mm_mul_ps(r[3], x));
+	__m128 ty = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[2], x), _mm_mul_ps(r[0], z)), _mm_mul_ps(r[3], y));
+	__m128 tz = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[0], y), _mm_mul_ps(r[1], x)), _mm_mul_ps(r[3], z));
+	__m128 two = _mm_set1_ps(2.0f);
+	ox = _mm_add_ps(x, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(r[1], tz), _mm_mul_ps(r[2], ty))));
+	oy = _mm_add_ps(y, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(r[2], tx), _mm_mul_ps(r[0], tz))));
+	oz = _mm_add_ps(z, _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(r[0], ty), _mm_mul_ps(r[1], tx))));
+}
+
+static int skinDualQuaternionSSE2(const SkinnedMesh * mesh, const float * palette, float * out){
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), tiny = _mm_set1_ps(1e-30f), sign = _mm_set1_ps(-0.0f);
+	int i = 0;
+	for (; i + 4 <= mesh->count; i += 4){
+		// Weighted sum of the dual quaternions, each flipped onto the first influence's hemisphere
+		__m128 first[4], r[4], d[4];
+		loadRowsSSE2(palette, 8, &mesh->influences[0][i], 0, first);
+		for (int e = 0; e < 4; e++)
+			r[e] = d[e] = zero;
+		for (int k = 0; k < SKINNING_INFLUENCES; k++){
+			__m128 w = _mm_loadu_ps(&mesh->weights[k][i]);
+			if (_mm_movemask_ps(_mm_cmpneq_ps(w, zero)) == 0)
+				continue;
+			__m128 real[4], dual[4];
+			loadRowsSSE2(palette, 8, &mesh->influences[k][i], 0, real);
+			loadRowsSSE2(palette, 8, &mesh->influences[k][i], 1, dual);
+			__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(real[0], first[0]), _mm_mul_ps(real[1], first[1])),
+				_mm_add_ps(_mm_mul_ps(real[2], first[2]), _mm_mul_ps(real[3], first[3])));
+			w = _mm_xor_ps(w, _mm_and_ps(dot, sign));
+			for (int e = 0; e < 4; e++){
+				r[e] = _mm_add_ps(r[e], _mm_mul_ps(w, real[e]));
+				d[e] = _mm_add_ps(d[e], _mm_mul_ps(w, dual[e]));
+			}
+		}
+		__m128 squared = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])),
+			_mm_add_ps(_mm_mul_ps(r[2], r[2]), _mm_mul_ps(r[3], r[3]))), tiny);
+		__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(squared));
+		for (int e = 0; e < 4; e++){
+			r[e] = _mm_mul_ps(r[e], inverse);
+			d[e] = _mm_mul_ps(d[e], inverse);
+		}
+
+		// Rotate, then translate by 2 (w d - dw r + r x d)
+		__m128 x, y, z, nx, ny, nz;
+		rotateSSE2(r, _mm_loadu_ps(&mesh->positions[0][i]), _mm_loadu_ps(&mesh->positions[1][i]), _mm_loadu_ps(&mesh->positions[2][i]), x, y, z);
+		rotateSSE2(r, _mm_loadu_ps(&mesh->normals[0][i]), _mm_loadu_ps(&mesh->normals[1][i]), _mm_loadu_ps(&mesh->normals[2][i]), nx, ny, nz);
+		__m128 tx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[3], d[0]), _mm_mul_ps(d[3], r[0])), _mm_sub_ps(_mm_mul_ps(r[1], d[2]), _mm_mul_ps(r[2], d[1])));
+		__m128 ty = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[3], d[1]), _mm_mul_ps(d[3], r[1])), _mm_sub_ps(_mm_mul_ps(r[2], d[0]), _mm_mul_ps(r[0], d[2])));
+		__m128 tz = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r[3], d[2]), _mm_mul_ps(d[3], r[2])), _mm_sub_ps(_mm_mul_ps(r[0], d[1]), _mm_mul_ps(r[1], d[0])));
+		x = _mm_add_ps(x, _mm_mul_ps(two, tx));
+		y = _mm_add_ps(y, _mm_mul_ps(two, ty));
+		z = _mm_add_ps(z, _mm_mul_ps(two, tz));
+		storeVerticesSSE2(out + i * SKINNED_VERTEX_FLOATS, x, y, z, nx, ny, nz);
+	}
+	return i;
+}
+#endif
+
+#ifdef SKINNING_AVX2
+#ifdef __FMA__
+#define SKINNING_MADD(a, b, c)	_mm256_fmadd_ps(a, b, c)
+#else
+#define SKINNING_MADD(a, b, c)	_mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+
+// As loadRowsSSE2 for 8 vertices: vertices 0-3 in the low 128-bit half and 4-7 in the high one, transposed per half
+static inline void loadRowsAVX2(const float * palette, int stride, const int * joints, int row, __m256 (&c)[4]){
+	__m256 r[4];
+	for (int j = 0; j < 4; j++)
+		r[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(palette + joints[j] * stride + row * 4)),
+			_mm_loadu_ps(palette + joints[j + 4] * stride + row * 4), 1);
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	c[0] = _mm256_shuffle_ps(t0, t2, 0x44);
+	c[1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+	c[2] = _mm256_shuffle_ps(t1, t3, 0x44);
+	c[3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+}
+
+static inline void storeVerticesAVX2(float * out, __m256 x, __m256 y, __m256 z, __m256 nx, __m256 ny, __m256 nz){
+	storeVerticesSSE2(out, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z),
+		_mm256_castps256_ps128(nx), _mm256_castps256_ps128(ny), _mm256_castps256_ps128(nz));
+	storeVerticesSSE2(out + 4 * SKINNED_VERTEX_FLOATS, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1),
+		_mm256_extractf128_ps(nx, 1), _mm256_extractf128_ps(ny, 1), _mm256_extractf128_ps(nz, 1));
+}
+
+static int skinLinearAVX2(const SkinnedMesh * mesh, const float * palette, float * out){
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), tiny = _mm256_set1_ps(1e-30f);
+	int i = 0;
+	for (; i + 8 <= mesh->count; i += 8){
+		__m256 m[12];
+		for (int e = 0; e < 12; e++)
+			m[e] = zero;
+		for (int k = 0; k < SKINNING_INFLUENCES; k++){
+			__m256 w = _mm256_loadu_ps(&mesh->weights[k][i]);
+			if (_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_NEQ_UQ)) == 0)
+				continue;
+			for (int row = 0; row < 3; row++){
+				__m256 c[4];
+				loadRowsAVX2(palette, 12, &mesh->influences[k][i], row, c);
+				for (int e = 0; e < 4; e++)
+					m[row * 4 + e] = SKINNING_MADD(w, c[e], m[row * 4 + e]);
+			}
+		}
+
+		__m256 x = _mm256_loadu_ps(&mesh->positions[0][i]), y = _mm256_loadu_ps(&mesh->positions[1][i]), z = _mm256_loadu_ps(&mesh->positions[2][i]);
+		__m256 nx = _mm256_loadu_ps(&mesh->normals[0][i]), ny = _mm256_loadu_ps(&mesh->normals[1][i]), nz = _mm256_loadu_ps(&mesh->normals[2][i]);
+		__m256 p[3], n[3];
+		for (int row = 0; row < 3; row++){
+			const __m256 * r = m + row * 4;
+			p[row] = SKINNING_MADD(r[0], x, SKINNING_MADD(r[1], y, SKINNING_MADD(r[2], z, r[3])));
+			n[row] = SKINNING_MADD(r[0], nx, SKINNING_MADD(r[1], ny, _mm256_mul_ps(r[2], nz)));
+		}
+		__m256 squared = _mm256_max_ps(SKINNING_MADD(n[0], n[0], SKINNING_MADD(n[1], n[1], _mm256_mul_ps(n[2], n[2]))), tiny);
+		__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(squared));
+		storeVerticesAVX2(out + i * SKINNED_VERTEX_FLOATS, p[0], p[1], p[2], _mm256_mul_ps(n[0], inverse), _mm256_mul_ps(n[1], inverse), _mm256_mul_ps(n[2], inverse));
+	}
+	return i;
+}
+
+static inline void rotateAVX2(const __m256 (&r)[4], __m256 x, __m256 y, __m256 z, __m256 & ox, __m256 & oy, __m256 & oz){
+	__m256 tx = SKINNING_MADD(r[3], x, _mm256_sub_ps(_mm256_mul_ps(r[1], z), _mm256_mul_ps(r[2], y)));
+	__m256 ty = SKINNING_MADD(r[3], y, _mm256_sub_ps(_mm256_mul_ps(r[2], x), _mm256_mul_ps(r[0], z)));
+	__m256 tz = SKINNING_MADD(r[3], z, _mm256_sub_ps(_mm256_mul_ps(r[0], y), _mm256_mul_ps(r[1], x)));
+	__m256 two = _mm256_set1_ps(2.0f);
+	ox = SKINNING_MADD(two, _mm256_sub_ps(_mm256_mul_ps(r[1], tz), _mm256_mul_ps(r[2], ty)), x);
+	oy = SKINNING_MADD(two, _mm256_sub_ps(_mm256_mul_ps(r[2], tx), _mm256_mul_ps(r[0], tz)), y);
+	oz = SKINNING_MADD(two, _mm256_sub_ps(_mm256_mul_ps(r[0], ty), _mm256_mul_ps(r[1], tx)), z);
+}
+
+static int skinDualQuaternionAVX2(const SkinnedMesh * mesh, const float * palette, float * out){
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), tiny = _mm256_set1_ps(1e-30f), sign = _mm256_set1_ps(-0.0f);
+	int i = 0;
+	for (; i + 8 <= mesh->count; i += 8){
+		__m256 first[4], r[4], d[4];
+		loadRowsAVX2(palette, 8, &mesh->influences[0][i], 0, first);
+		for (int e = 0; e < 4; e++)
+			r[e] = d[e] = zero;
+		for (int k = 0; k < SKINNING_INFLUENCES; k++){
+			__m256 w = _mm256_loadu_ps(&mesh->weights[k][i]);
+			if (_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_NEQ_UQ)) == 0)
+				continue;
+			__m256 real[4], dual[4];
+			loadRowsAVX2(palette, 8, &mesh->influences[k][i], 0, real);
+			loadRowsAVX2(palette, 8, &mesh->influences[k][i], 1, dual);
+			__m256 dot = SKINNING_MADD(real[0], first[0], SKINNING_MADD(real[1], first[1], SKINNING_MADD(real[2], first[2], _mm256_mul_ps(real[3], first[3]))));
+			w = _mm256_xor_ps(w, _mm256_and_ps(dot, sign));
+			for (int e = 0; e < 4; e++){
+				r[e] = SKINNING_MADD(w, real[e], r[e]);
+				d[e] = SKINNING_MADD(w, dual[e], d[e]);
+			}
+		}
+		__m256 squared = _mm256_max_ps(SKINNING_MADD(r[0], r[0], SKINNING_MADD(r[1], r[1], SKINNING_MADD(r[2], r[2], _mm256_mul_ps(r[3], r[3])))), tiny);
+		__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(squared));
+		for (int e = 0; e < 4; e++){
+			r[e] = _mm256_mul_ps(r[e], inverse);
+			d[e] = _mm256_mul_ps(d[e], inverse);
+		}
+
+		__m256 x, y, z, nx, ny, nz;
+		rotateAVX2(r, _mm256_loadu_ps(&mesh->positions[0][i]), _mm256_loadu_ps(&mesh->positions[1][i]), _mm256_loadu_ps(&mesh->positions[2][i]), x, y, z);
+		rotateAVX2(r, _mm256_loadu_ps(&mesh->normals[0][i]), _mm256_loadu_ps(&mesh->normals[1][i]), _mm256_loadu_ps(&mesh->normals[2][i]), nx, ny, nz);
+		__m256 tx = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r[3], d[0]), _mm256_mul_ps(d[3], r[0])), _mm256_sub_ps(_mm256_mul_ps(r[1], d[2]), _mm256_mul_ps(r[2], d[1])));
+		__m256 ty = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r[3], d[1]), _mm256_mul_ps(d[3], r[1])), _mm256_sub_ps(_mm256_mul_ps(r[2], d[0]), _mm256_mul_ps(r[0], d[2])));
+		__m256 tz = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r[3], d[2]), _mm256_mul_ps(d[3], r[2])), _mm256_sub_ps(_mm256_mul_ps(r[0], d[1]), _mm256_mul_ps(r[1], d[0])));
+		storeVerticesAVX2(out + i * SKINNED_VERTEX_FLOATS, SKINNING_MADD(two, tx, x), SKINNING_MADD(two, ty, y), SKINNING_MADD(two, tz, z), nx, ny, nz);
+	}
+	return i;
+}
+#endif
+
+void skinVertices(const SkinnedMesh * mesh, const float * palette, SkinningMethod method, float * out){
+	int done = 0;
+#if defined(SKINNING_AVX2)
+	done = method == SKINNING_LINEAR_BLEND ? skinLinearAVX2(mesh, palette, out) : skinDualQuaternionAVX2(mesh, palette, out);
+#elif defined(SKINNING_SSE2)
+	done = method == SKINNING_LINEAR_BLEND ? skinLinearSSE2(mesh, palette, out) : skinDualQuaternionSSE2(mesh, palette, out);
+#endif
+	skinScalar(mesh, palette, method, done, out);
+}
+
+void skinVerticesReference(const SkinnedMesh * mesh, const float * palette, SkinningMethod method, float * out){
+	skinScalar(mesh, palette, method, 0, out);
+}
+
+void skinCharacters(const SkinnedMesh * mesh, const float * palettes, int characters, SkinningMethod method, float * out){
+	int paletteFloats = mesh->joints * getSkinningPaletteFloats(method);
+	int vertexFloats = mesh->count * SKINNED_VERTEX_FLOATS;
+	parallelFor(characters, 1, [&](int begin, int end){
+		for (int c = begin; c < end; c++)
+			skinVertices(mesh, palettes + (size_t)c * paletteFloats, method, out + (size_t)c * vertexFloats);
+	});
+}
+
+const char * getSkinningKernel(){
+#if defined(SKINNING_AVX2)
+	return "AVX2";
+#elif defined(SKINNING_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// Control point normals: the layer's normals by control point, or averaged over the polygon vertices using each one
+static void readFBXNormals(const FBXNode * geometry, const std::vector<long long> & polygonVertices, std::vector<glm::vec3> & normals){
+	const FBXNode * layer = findFBXChild(geometry, "LayerElementNormal");
+	const FBXNode * data = findFBXChild(layer, "Normals");
+	const FBXNode * mapping = findFBXChild(layer, "MappingInformationType");
+	const FBXNode * reference = findFBXChild(layer, "ReferenceInformationType");
+	const FBXNode * index = findFBXChild(layer, "NormalsIndex");
+	if (data && !data->properties.empty()){
+		const std::vector<double> & values = data->properties[0].numbers;
+		bool byPolygonVertex = mapping && !mapping->properties.empty() && mapping->properties[0].string == "ByPolygonVertex";
+		bool indexed = reference && !reference->properties.empty() && reference->properties[0].string == "IndexToDirect" && index && !index->properties.empty();
+		size_t elements = byPolygonVertex ? polygonVertices.size() : normals.size();
+		for (size_t e = 0; e < elements; e++){
+			long long point = byPolygonVertex ? polygonVertices[e] : (long long)e;
+			if (point < 0)
+				point = ~point;
+			long long source = indexed ? (e < index->properties[0].integers.size() ? index->properties[0].integers[e] : -1) : (long long)e;
+			if (point >= (long long)normals.size() || source < 0 || (size_t)source * 3 + 2 >= values.size())
+				continue;
+			normals[point] += glm::vec3((float)values[source * 3], (float)values[source * 3 + 1], (float)values[source * 3 + 2]);
+		}
+	}
+	for (size_t i = 0; i < normals.size(); i++)
+		normals[i] = glm::dot(normals[i], normals[i]) > 0.0f ? glm::normalize(normals[i]) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// A chain of SKINNING_CHAIN_JOINTS joints from one end of the longest side of the bounds to the other, each vertex
+// blended between the two joints it lies between
+static void rigChain(const std::vector<glm::vec3> & positions, std::vector<SkeletonJoint> & joints, std::vector<glm::ivec4> & influences,
+	std::vector<glm::vec4> & weights){
+	glm::vec3 low(positions[0]), high(positions[0]);
+	for (size_t i = 1; i < positions.size(); i++){
+		low = glm::min(low, positions[i]);
+		high = glm::max(high, positions[i]);
+	}
+	glm::vec3 size = high - low;
+	int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+	float spacing = glm::max(size[axis], 1e-6f) / (SKINNING_CHAIN_JOINTS - 1);
+
+	for (int j = 0; j < SKINNING_CHAIN_JOINTS; j++){
+		SkeletonJoint joint;
+		char name[32];
+		sprintf(name, "chain%d", j);
+		joint.name = name;
+		joint.parent = j - 1;
+		joint.position = glm::vec3(0.0f);
+		if (j == 0){
+			joint.position = (low + high) * 0.5f;
+			joint.position[axis] = low[axis];
+		} else {
+			joint.position[axis] = spacing;
+		}
+		joint.orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		joint.scale = glm::vec3(1.0f);
+		joints.push_back(joint);
+	}
+	for (size_t i = 0; i < positions.size(); i++){
+		float along = (positions[i][axis] - low[axis]) / spacing;
+		int j = glm::clamp((int)along, 0, SKINNING_CHAIN_JOINTS - 2);
+		float f = glm::clamp(along - j, 0.0f, 1.0f);
+		f = f * f * (3.0f - 2.0f * f);
+		influences.push_back(glm::ivec4(j, j + 1, 0, 0));
+		weights.push_back(glm::vec4(1.0f - f, f, 0.0f, 0.0f));
+	}
+}
+
+bool loadFBXCharacter(const char * path, Skeleton ** skeleton, SkinnedMesh ** mesh, std::vector<unsigned int> * triangles){
+	*skeleton = NULL;
+	*mesh = NULL;
+	FBXNode * root = loadFBX(path);
+	if (root == NULL)
+		return false;
+	std::vector<const FBXNode *> objects;
+	std::vector<FBXConnection> connections;
+	getFBXObjects(root, objects);
+	getFBXConnections(root, connections);
+	std::map<long long, const FBXNode *> byID;
+	for (size_t i = 0; i < objects.size(); i++)
+		byID[getFBXObjectID(objects[i])] = objects[i];
+
+	// Skins by geometry, clusters by skin, the joint of each cluster and the parent of each model
+	std::map<long long, long long> skins, clusterJoints, modelParents;
+	std::map<long long, std::vector<long long> > clusters;
+	for (size_t i = 0; i < connections.size(); i++){
+		const FBXConnection & c = connections[i];
+		std::map<long long, const FBXNode *>::const_iterator child = byID.find(c.child), parent = byID.find(c.parent);
+		if (!c.property.empty() || child == byID.end() || parent == byID.end())
+			continue;
+		const std::string & childKind = child->second->name, & parentKind = parent->second->name;
+		std::string childClass = getFBXObjectClass(child->second), parentClass = getFBXObjectClass(parent->second);
+		if (childKind == "Deformer" && childClass == "Skin" && parentKind == "Geometry")
+			skins[c.parent] = c.child;
+		else if (childKind == "Deformer" && childClass == "Cluster" && parentKind == "Deformer")
+			clusters[c.parent].push_back(c.child);
+		else if (childKind == "Model" && parentKind == "Deformer" && parentClass == "Cluster")
+			clusterJoints[c.parent] = c.child;
+		else if (childKind == "Model" && parentKind == "Model")
+			modelParents[c.child] = c.parent;
+	}
+
+	// The first skinned mesh, or the first mesh
+	const FBXNode * geometry = NULL;
+	long long skin = 0;
+	for (size_t i = 0; i < objects.size(); i++){
+		if (objects[i]->name != "Geometry" || getFBXObjectClass(objects[i]) != "Mesh")
+			continue;
+		std::map<long long, long long>::const_iterator found = skins.find(getFBXObjectID(objects[i]));
+		if (geometry == NULL || (skin == 0 && found != skins.end())){
+			geometry = objects[i];
+			skin = found != skins.end() ? found->second : 0;
+		}
+	}
+	const FBXNode * vertices = findFBXChild(geometry, "Vertices");
+	const FBXNode * polygons = findFBXChild(geometry, "PolygonVertexIndex");
+	if (vertices == NULL || vertices->properties.empty() || vertices->properties[0].numbers.size() < 3){
+		printf("[WARNING] %s has no mesh.\n", path);
+		deleteFBX(root);
+		return false;
+	}
+	const std::vector<double> & points = vertices->properties[0].numbers;
+	std::vector<glm::vec3> positions(points.size() / 3), normals(points.size() / 3, glm::vec3(0.0f));
+	for (size_t i = 0; i < positions.size(); i++)
+		positions[i] = glm::vec3((float)points[i * 3], (float)points[i * 3 + 1], (float)points[i * 3 + 2]);
+	const std::vector<long long> & polygonVertices = polygons && !polygons->properties.empty() ? polygons->properties[0].integers : std::vector<long long>();
+	readFBXNormals(geometry, polygonVertices, normals);
+
+	// Every polygon as a fan, its last control point is stored as ~index; polygons with a point out of the mesh are left out
+	if (triangles){
+		triangles->clear();
+		size_t first = 0;
+		for (size_t i = 0; i < polygonVertices.size(); i++){
+			if (polygonVertices[i] >= 0)
+				continue;
+			bool valid = true;
+			for (size_t k = first; k <= i; k++){
+				long long point = polygonVertices[k] < 0 ? ~polygonVertices[k] : polygonVertices[k];
+				valid = valid && point < (long long)positions.size();
+			}
+			for (size_t k = first + 1; valid && k < i; k++){
+				triangles->push_back((unsigned int)polygonVertices[first]);
+				triangles->push_back((unsigned int)polygonVertices[k]);
+				triangles->push_back((unsigned int)(polygonVertices[k + 1] < 0 ? ~polygonVertices[k + 1] : polygonVertices[k + 1]));
+			}
+			first = i + 1;
+		}
+	}
+
+	std::vector<SkeletonJoint> joints;
+	std::vector<glm::ivec4> influences;
+	std::vector<glm::vec4> weights;
+	const std::vector<long long> & skinClusters = clusters[skin];
+	if (skin == 0 || skinClusters.empty()){
+		printf("[WARNING] %s has no skin deformer: rigged with a chain of %d joints along its longest side.\n", path, SKINNING_CHAIN_JOINTS);
+		rigChain(positions, joints, influences, weights);
+	} else {
+		// The clusters' joints and their parents, parents first (by depth)
+		std::map<long long, int> depths;
+		for (size_t c = 0; c < skinClusters.size(); c++){
+			std::map<long long, long long>::const_iterator joint = clusterJoints.find(skinClusters[c]);
+			for (long long id = joint == clusterJoints.end() ? 0 : joint->second; id != 0 && !depths.count(id); ){
+				depths[id] = 0;
+				std::map<long long, long long>::const_iterator parent = modelParents.find(id);
+				id = parent == modelParents.end() ? 0 : parent->second;
+			}
+		}
+		std::vector<std::pair<int, long long> > order;
+		for (std::map<long long, int>::iterator d = depths.begin(); d != depths.end(); ++d){
+			int depth = 0;
+			for (std::map<long long, long long>::const_iterator parent = modelParents.find(d->first); parent != modelParents.end() && depths.count(parent->second);
+				parent = modelParents.find(parent->second))
+				depth++;
+			order.push_back(std::make_pair(depth, d->first));
+		}
+		std::sort(order.begin(), order.end());
+		std::map<long long, int> indices;
+		for (size_t j = 0; j < order.size(); j++){
+			const FBXNode * model = byID[order[j].second];
+			SkeletonJoint joint;
+			joint.name = getFBXObjectName(model);
+			std::map<long long, long long>::const_iterator parent = modelParents.find(order[j].second);
+			joint.parent = parent != modelParents.end() && indices.count(parent->second) ? indices[parent->second] : -1;
+			getFBXLocalTransform(model, joint.position, joint.orientation, joint.scale);
+			indices[order[j].second] = (int)j;
+			joints.push_back(joint);
+		}
+
+		// Every control point's influences, the 4 largest kept
+		std::vector<std::vector<std::pair<float, int> > > pointInfluences(positions.size());
+		for (size_t c = 0; c < skinClusters.size(); c++){
+			std::map<long long, long long>::const_iterator joint = clusterJoints.find(skinClusters[c]);
+			const FBXNode * cluster = byID[skinClusters[c]];
+			const FBXNode * indexes = findFBXChild(cluster, "Indexes");
+			const FBXNode * values = findFBXChild(cluster, "Weights");
+			if (joint == clusterJoints.end() || indexes == NULL || values == NULL || indexes->properties.empty() || values->properties.empty())
+				continue;
+			const std::vector<long long> & points = indexes->properties[0].integers;
+			const std::vector<double> & pointWeights = values->properties[0].numbers;
+			for (size_t k = 0; k < points.size() && k < pointWeights.size(); k++){
+				if (points[k] >= 0 && points[k] < (long long)positions.size())
+					pointInfluences[points[k]].push_back(std::make_pair((float)pointWeights[k], indices[joint->second]));
+			}
+		}
+		for (size_t i = 0; i < positions.size(); i++){
+			std::vector<std::pair<float, int> > & list = pointInfluences[i];
+			std::sort(list.begin(), list.end(), std::greater<std::pair<float, int> >());
+			glm::ivec4 joint(0);
+			glm::vec4 weight(0.0f);
+			for (int k = 0; k < SKINNING_INFLUENCES && k < (int)list.size(); k++){
+				joint[k] = list[k].second;
+				weight[k] = list[k].first;
+			}
+			influences.push_back(joint);
+			weights.push_back(weight);
+		}
+	}
+	deleteFBX(root);
+
+	*skeleton = createSkeleton(&joints[0], (int)joints.size());
+	if (*skeleton == NULL)
+		return false;
+	*mesh = createSkinnedMesh(*skeleton, &positions[0], &normals[0], &influences[0], &weights[0], (int)positions.size());
+	return true;
+}
+
+GLuint createSkinnedVertexBuffer(const SkinnedMesh * mesh, int characters){
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)characters * mesh->count * SKINNED_VERTEX_FLOATS * sizeof(float), NULL, GL_STREAM_DRAW);
+	return buffer;
+}
+
+void updateSkinnedVertexBuffer(GLuint buffer, const SkinnedMesh * mesh, const float * palettes, int characters, SkinningMethod method){
+	GLsizeiptr size = (GLsizeiptr)characters * mesh->count * SKINNED_VERTEX_FLOATS * sizeof(float);
+	cachedBindBuffer(GL_ARRAY_BUFFER, buffer);
+	float * vertices = (float *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (vertices == NULL){
+		printf("[WARNING] Skinned vertex buffer %u could not be mapped.\n", buffer);
+		return;
+	}
+	skinCharacters(mesh, palettes, characters, method, vertices);
+	if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+		printf("[WARNING] Skinned vertex buffer %u was lost while mapped, it is rewritten next update.\n", buffer);
+}
+
+// Every joint bends round an axis across the chain (or the bind pose's X), in a wave along the skeleton
+static AnimationClip * bakeBendClip(const Skeleton * skeleton, float duration){
+	int joints = getSkeletonJointCount(skeleton);
+	int frames = (int)(duration * 60.0f) + 1;
+	std::vector<AnimationTrackKeys> tracks(joints);
+	for (int j = 0; j < joints; j++){
+		const SkeletonJoint * joint = getSkeletonJoint(skeleton, j);
+		glm::vec3 offset = joint->position;
+		glm::vec3 axis = glm::dot(offset, offset) > 0.0f ? glm::cross(glm::normalize(offset), glm::vec3(0.0f, 0.0f, 1.0f)) : glm::vec3(0.0f);
+		axis = glm::dot(axis, axis) > 1e-6f ? glm::normalize(axis) : glm::vec3(1.0f, 0.0f, 0.0f);
+		AnimationTrackKeys & track = tracks[j];
+		track.name = joint->name;
+		track.translationTimes.push_back(0.0f);
+		track.translations.push_back(joint->position);
+		track.scaleTimes.push_back(0.0f);
+		track.scales.push_back(joint->scale);
+		for (int f = 0; f < frames; f++){
+			float time = duration * f / (frames - 1);
+			float angle = 0.5f * sinf(6.28318530717958647692f * time / duration - 0.8f * j);
+			track.rotationTimes.push_back(time);
+			track.rotations.push_back(joint->orientation * glm::angleAxis(j == 0 ? 0.0f : angle, axis));
+		}
+	}
+	AnimationClipTolerances tolerances = { 0.001f, 0.001f, 0.001f };
+	return createAnimationClip(&tracks[0], joints, duration, tolerances);
+}
+
+struct SkinnedCrowd {
+	Skeleton * skeleton;
+	SkinnedMesh * mesh;
+	AnimationClip * clip;
+	SkinningMethod method;
+	int characters;
+	std::vector<float> startTimes;
+	std::vector<AnimationSample> samples;
+	std::vector<float> poseStreams;
+	TransformStreams pose;
+	std::vector<float> palettes;
+
+	GLuint vertexBuffer;		// createSkinnedVertexBuffer, character c's vertices follow character c - 1's
+	GLuint indexBuffer;
+	GLuint vertexArray;
+	GLsizei indexCount;
+	glm::vec3 low, high;
+};
+
+SkinnedCrowd * createSkinnedCrowd(const char * fbxpath, int characters, SkinningMethod method){
+	if (characters <= 0)
+		return NULL;
+	SkinnedCrowd * crowd = new SkinnedCrowd;
+	std::vector<unsigned int> triangles;
+	if (!loadFBXCharacter(fbxpath, &crowd->skeleton, &crowd->mesh, &triangles) || triangles.empty()){
+		if (triangles.empty())
+			printf("[WARNING] %s has no polygons to draw.\n", fbxpath);
+		delete crowd;
+		return NULL;
+	}
+	crowd->clip = bakeBendClip(crowd->skeleton, 2.0f);
+	crowd->method = method;
+	crowd->characters = characters;
+
+	// Out of step with each other, the same way every run
+	srand(1);
+	crowd->startTimes.resize(characters);
+	for (int c = 0; c < characters; c++)
+		crowd->startTimes[c] = 2.0f * rand() / RAND_MAX;
+	int joints = getSkeletonJointCount(crowd->skeleton), poseCount = characters * joints;
+	crowd->samples.resize(poseCount);
+	crowd->poseStreams.resize(10 * poseCount);
+	float * streams = &crowd->poseStreams[0];
+	TransformStreams pose = { streams, streams + poseCount, streams + 2 * poseCount, streams + 3 * poseCount, streams + 4 * poseCount,
+		streams + 5 * poseCount, streams + 6 * poseCount, streams + 7 * poseCount, streams + 8 * poseCount, streams + 9 * poseCount };
+	crowd->pose = pose;
+	crowd->palettes.resize(poseCount * getSkinningPaletteFloats(method));
+
+	const SkinnedMesh * mesh = crowd->mesh;
+	crowd->low = crowd->high = glm::vec3(mesh->positions[0][0], mesh->positions[1][0], mesh->positions[2][0]);
+	for (int i = 1; i < mesh->count; i++){
+		glm::vec3 position(mesh->positions[0][i], mesh->positions[1][i], mesh->positions[2][i]);
+		crowd->low = glm::min(crowd->low, position);
+		crowd->high = glm::max(crowd->high, position);
+	}
+
+	glGenVertexArrays(1, &crowd->vertexArray);
+	cachedBindVertexArray(crowd->vertexArray);
+	crowd->vertexBuffer = createSkinnedVertexBuffer(mesh, characters);
+	cachedEnableVertexAttribArray(0);
+	cachedVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SKINNED_VERTEX_FLOATS * sizeof(float), 0);
+	cachedEnableVertexAttribArray(2);
+	cachedVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, SKINNED_VERTEX_FLOATS * sizeof(float), 3 * sizeof(float));
+	glGenBuffers(1, &crowd->indexBuffer);
+	cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, crowd->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(unsigned int), &triangles[0], GL_STATIC_DRAW);
+	crowd->indexCount = (GLsizei)triangles.size();
+	return crowd;
+}
+
+void deleteSkinnedCrowd(SkinnedCrowd * crowd){
+	if (crowd == NULL)
+		return;
+	glDeleteVertexArrays(1, &crowd->vertexArray);
+	glDeleteBuffers(1, &crowd->vertexBuffer);
+	glDeleteBuffers(1, &crowd->indexBuffer);
+	invalidateGLState();
+	deleteAnimationClip(crowd->clip);
+	deleteSkinnedMesh(crowd->mesh);
+	deleteSkeleton(crowd->skeleton);
+	delete crowd;
+}
+
+void updateSkinnedCrowd(SkinnedCrowd * crowd, double time){
+	PROFILE_ZONE("updateSkinnedCrowd");
+	int joints = getSkeletonJointCount(crowd->skeleton), paletteFloats = getSkinningPaletteFloats(crowd->method);
+	for (int c = 0; c < crowd->characters; c++){
+		for (int j = 0; j < joints; j++){
+			AnimationSample sample = { crowd->clip, j, (float)(crowd->startTimes[c] + time) };
+			crowd->samples[c * joints + j] = sample;
+		}
+	}
+	sampleAnimationClips(&crowd->samples[0], (int)crowd->samples.size(), crowd->pose);
+	parallelFor(crowd->characters, 16, [&](int begin, int end){
+		for (int c = begin; c < end; c++)
+			evaluateSkeletonPose(crowd->skeleton, offsetTransformStreams(crowd->pose, c * joints), crowd->method, &crowd->palettes[c * joints * paletteFloats]);
+	});
+	updateSkinnedVertexBuffer(crowd->vertexBuffer, crowd->mesh, &crowd->palettes[0], crowd->characters, crowd->method);
+}
+
+void bindSkinnedCrowd(const SkinnedCrowd * crowd){
+	cachedBindVertexArray(crowd->vertexArray);
+}
+
+void drawSkinnedCharacter(const SkinnedCrowd * crowd, int character){
+	glDrawElementsBaseVertex(GL_TRIANGLES, crowd->indexCount, GL_UNSIGNED_INT, 0, character * crowd->mesh->count);
+}
+
+void getSkinnedCrowdBounds(const SkinnedCrowd * crowd, glm::vec3 & low, glm::vec3 & high){
+	low = crowd->low;
+	high = crowd->high;
+}
+
+static float largestDifference(const std::vector<float> & a, const std::vector<float> & b){
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+		difference = glm::max(difference, fabsf(a[i] - b[i]));
+	return difference;
+}
+
+void benchmarkSkinning(const char * fbxpath, int characters, int iterations, bool vertexBuffers){
+	Skeleton * skeleton;
+	SkinnedMesh * mesh;
+	if (!loadFBXCharacter(fbxpath, &skeleton, &mesh, NULL))
+		return;
+	if (characters <= 0 || iterations <= 0){
+		deleteSkinnedMesh(mesh);
+		deleteSkeleton(skeleton);
+		return;
+	}
+	int joints = getSkeletonJointCount(skeleton), vertices = getSkinnedMeshVertexCount(mesh);
+	const float duration = 2.0f;
+	AnimationClip * clip = bakeBendClip(skeleton, duration);
+
+	// Every character plays the clip from its own time: pose, both palettes, both kernels
+	std::vector<AnimationSample> samples(characters * joints);
+	std::vector<float> startTimes(characters);
+	srand(1);
+	for (int c = 0; c < characters; c++)
+		startTimes[c] = duration * rand() / RAND_MAX;
+	int poseCount = characters * joints;
+	std::vector<float> poseStreams(10 * poseCount);
+	TransformStreams pose = { &poseStreams[0], &poseStreams[poseCount], &poseStreams[2 * poseCount], &poseStreams[3 * poseCount],
+		&poseStreams[4 * poseCount], &poseStreams[5 * poseCount], &poseStreams[6 * poseCount], &poseStreams[7 * poseCount],
+		&poseStreams[8 * poseCount], &poseStreams[9 * poseCount] };
+	std::vector<float> linearPalettes(poseCount * 12), dualPalettes(poseCount * 8);
+	std::vector<float> linear(characters * vertices * SKINNED_VERTEX_FLOATS), dual(linear.size()), reference(linear.size());
+
+	double poseSeconds = 0.0, linearSeconds = 0.0, dualSeconds = 0.0;
+	for (int it = 0; it < iterations; it++){
+		for (int c = 0; c < characters; c++){
+			for (int j = 0; j < joints; j++){
+				AnimationSample sample = { clip, j, startTimes[c] + it / 60.0f };
+				samples[c * joints + j] = sample;
+			}
+		}
+		double start = getTime();
+		sampleAnimationClips(&samples[0], poseCount, pose);
+		parallelFor(characters, 16, [&](int begin, int end){
+			for (int c = begin; c < end; c++){
+				TransformStreams character = offsetTransformStreams(pose, c * joints);
+				evaluateSkeletonPose(skeleton, character, SKINNING_LINEAR_BLEND, &linearPalettes[c * joints * 12]);
+				evaluateSkeletonPose(skeleton, character, SKINNING_DUAL_QUATERNION, &dualPalettes[c * joints * 8]);
+			}
+		});
+		poseSeconds += getTime() - start;
+
+		start = getTime();
+		skinCharacters(mesh, &linearPalettes[0], characters, SKINNING_LINEAR_BLEND, &linear[0]);
+		linearSeconds += getTime() - start;
+
+		start = getTime();
+		skinCharacters(mesh, &dualPalettes[0], characters, SKINNING_DUAL_QUATERNION, &dual[0]);
+		dualSeconds += getTime() - start;
+	}
+
+	// glm one vertex at a time on one thread, the last frame's palettes, and how far the kernels are from it
+	double start = getTime();
+	for (int c = 0; c < characters; c++)
+		skinVerticesReference(mesh, &linearPalettes[c * joints * 12], SKINNING_LINEAR_BLEND, &reference[c * vertices * SKINNED_VERTEX_FLOATS]);
+	double linearReferenceSeconds = getTime() - start;
+	float difference = largestDifference(linear, reference);
+	start = getTime();
+	for (int c = 0; c < characters; c++)
+		skinVerticesReference(mesh, &dualPalettes[c * joints * 8], SKINNING_DUAL_QUATERNION, &reference[c * vertices * SKINNED_VERTEX_FLOATS]);
+	double dualReferenceSeconds = getTime() - start;
+	difference = glm::max(difference, largestDifference(dual, reference));
+
+	// Straight into a mapped vertex buffer
+	double bufferSeconds = 0.0;
+	if (vertexBuffers){
+		GLuint buffer = createSkinnedVertexBuffer(mesh, characters);
+		start = getTime();
+		for (int it = 0; it < iterations; it++)
+			updateSkinnedVertexBuffer(buffer, mesh, &linearPalettes[0], characters, SKINNING_LINEAR_BLEND);
+		bufferSeconds = getTime() - start;
+		glDeleteBuffers(1, &buffer);
+	}
+
+	double skinned = (double)characters * vertices * iterations, threads = (double)getJobThreadCount();
+	char buffered[64] = "";
+	if (vertexBuffers)
+		sprintf(buffered, ", into a mapped buffer %.1f M/s", skinned / bufferSeconds / threads / 1e6);
+	printf("[DEBUG] Skinning (%d characters of %d vertices and %d joints, %u threads, %s): pose %.3f ms, per core linear blend %.1f M vertices/s "
+		"(glm %.1f M/s)%s, dual quaternion %.1f M vertices/s (glm %.1f M/s), largest difference %.2g%s\n", characters, vertices, joints,
+		getJobThreadCount(), getSkinningKernel(), poseSeconds * 1000.0 / iterations, skinned / linearSeconds / threads / 1e6,
+		characters * vertices / linearReferenceSeconds / 1e6, buffered, skinned / dualSeconds / threads / 1e6,
+		characters * vertices / dualReferenceSeconds / 1e6, difference, difference < 1e-3f ? "" : " (MISMATCH)");
+
+	deleteAnimationClip(clip);
+	deleteSkinnedMesh(mesh);
+	deleteSkeleton(skeleton);
+}
@@ -0,0 +1,107 @@
+#ifndef SKINNING_HPP
+#define SKINNING_HPP
+
+// Skeletal animation on the CPU: a skeleton is a hierarchy of joints with a bind pose, a pose is the local
+// transform of every joint (transforms.hpp streams, what sampleAnimationClips writes), and evaluating it gives a
+// palette with one skinning transform per joint (world * inverse bind). The kernels then move every vertex of a mesh
+// by up to 4 joints:
+// - Linear blend (LBS): the weighted sum of the joints' matrices. Cheap, handles scale, collapses volume at twisted joints.
+// - Dual quaternion (DQS, glm/gtx/dual_quaternion): the weighted sum of the joints' unit dual quaternions, normalized.
+//   Keeps volume, rigid joints only (a joint's scale is ignored).
+// Vertices are stored as structure of arrays and skinned 4 (SSE2) or 8 (AVX2) at a time, with the SIMD selection of
+// composeTransforms; the output is interleaved (position, normal), the layout of the skinned vertex buffers, and is
+// written straight into them while they are mapped. skinCharacters runs one character per job.
+
+#define SKINNING_INFLUENCES		4		// Joints per vertex
+#define SKINNING_MAX_JOINTS		256		// Per skeleton
+#define SKINNED_VERTEX_FLOATS	6		// Skinned vertex: position x y z, normal x y z
+
+enum SkinningMethod {
+	SKINNING_LINEAR_BLEND,
+	SKINNING_DUAL_QUATERNION
+};
+
+// A joint of the bind pose, relative to its parent (-1 = a root). Parents come before their children.
+struct SkeletonJoint {
+	std::string name;
+	int parent;
+	glm::vec3 position;
+	glm::quat orientation;
+	glm::vec3 scale;
+};
+
+struct Skeleton;
+
+// NULL if a parent comes after its child or there are more than SKINNING_MAX_JOINTS joints
+Skeleton * createSkeleton(const SkeletonJoint * joints, int count);
+void deleteSkeleton(Skeleton * skeleton);
+
+int getSkeletonJointCount(const Skeleton * skeleton);
+const SkeletonJoint * getSkeletonJoint(const Skeleton * skeleton, int joint);
+
+// Palette floats per joint: 12 for linear blend (rows of the 3x4 skinning matrix), 8 for dual quaternions
+// (real x y z w, dual x y z w)
+int getSkinningPaletteFloats(SkinningMethod method);
+
+// Joint j's local transform is element j of pose; the palette gets getSkinningPaletteFloats(method) floats per joint
+void evaluateSkeletonPose(const Skeleton * skeleton, const TransformStreams & pose, SkinningMethod method, float * palette);
+
+struct SkinnedMesh;
+
+// Bind pose vertices of a skeleton's mesh. Weights are normalized (all zero = joint 0), joints out of the skeleton
+// are left out with a warning.
+SkinnedMesh * createSkinnedMesh(const Skeleton * skeleton, const glm::vec3 * positions, const glm::vec3 * normals,
+	const glm::ivec4 * joints, const glm::vec4 * weights, int count);
+void deleteSkinnedMesh(SkinnedMesh * mesh);
+
+int getSkinnedMeshVertexCount(const SkinnedMesh * mesh);
+
+// The mesh deformed by one palette: SKINNED_VERTEX_FLOATS floats per vertex into out
+void skinVertices(const SkinnedMesh * mesh, const float * palette, SkinningMethod method, float * out);
+
+// The same with glm, one vertex at a time (glm::mat4 sums, glm::dualquat blends), to check skinVertices against
+void skinVerticesReference(const SkinnedMesh * mesh, const float * palette, SkinningMethod method, float * out);
+
+// characters copies of the mesh, each with its own palette (palettes one after the other), into consecutive ranges of
+// out, one character per job. Run from the main thread or a job to be parallel.
+void skinCharacters(const SkinnedMesh * mesh, const float * palettes, int characters, SkinningMethod method, float * out);
+
+// "AVX2", "SSE2" or "scalar"
+const char * getSkinningKernel();
+
+// The Model of a binary FBX file's first skinned Geometry: the LimbNode joints its clusters are linked to (and their
+// parents) with their Lcl transforms as the bind pose, and its control points with their 4 largest weights (normals
+// averaged per control point). A mesh without a skin deformer is rigged with a chain of joints along its longest side,
+// weighted by how far along it each vertex is. triangles (if not NULL) gets the polygons as triangle fans of control
+// point indices, the vertices of the mesh. False if the file has no mesh.
+bool loadFBXCharacter(const char * path, Skeleton ** skeleton, SkinnedMesh ** mesh, std::vector<unsigned int> * triangles);
+
+// A GL_STREAM_DRAW vertex buffer for characters copies of the skinned mesh, and skinCharacters straight into it
+// while it is mapped (the old contents are invalidated, draws still reading them don't stall the mapping)
+GLuint createSkinnedVertexBuffer(const SkinnedMesh * mesh, int characters);
+void updateSkinnedVertexBuffer(GLuint buffer, const SkinnedMesh * mesh, const float * palettes, int characters, SkinningMethod method);
+
+// characters copies of the fbxpath character in the scene, each playing a bend clip from its own start time: posed and
+// skinned straight into one skinned vertex buffer every frame, then drawn one character at a time from their own
+// range of it through a vertex array with the mesh's triangles (attribute 0 = position, 2 = normal, no UVs). The
+// caller binds the program and each character's transforms. NULL if the character can't be loaded.
+struct SkinnedCrowd;
+SkinnedCrowd * createSkinnedCrowd(const char * fbxpath, int characters, SkinningMethod method);
+void deleteSkinnedCrowd(SkinnedCrowd * crowd);
+
+// Pose every character at time (seconds) and skin them into the vertex buffer
+void updateSkinnedCrowd(SkinnedCrowd * crowd, double time);
+
+// Bind the vertex array, then draw character 0 to characters - 1 (one glDrawElementsBaseVertex each)
+void bindSkinnedCrowd(const SkinnedCrowd * crowd);
+void drawSkinnedCharacter(const SkinnedCrowd * crowd, int character);
+
+// Bounds of the bind pose mesh (the bend keeps it close to them)
+void getSkinnedCrowdBounds(const SkinnedCrowd * crowd, glm::vec3 & low, glm::vec3 & high);
+
+// Print skinned vertices per second per core of both kernels against glm for characters copies of the fbxpath
+// character playing a clip, the pose evaluation time and the largest difference from glm. vertexBuffers (needs a
+// GL context) also times skinning into a mapped vertex buffer.
+void benchmarkSkinning(const char * fbxpath, int characters, int iterations, bool vertexBuffers);
+
+#endif
@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "timer.hpp"
+#include "splinepath.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPLINEPATH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPLINEPATH_SSE2
+#endif
+
+#define SPLINEPATH_CHORDS		64		// Chords per segment measuring its length
+#define SPLINEPATH_TABLE		32		// Arc-length table entries per segment
+
+struct SplinePath {
+	int segments;
+	bool closed;
+	float length;
+
+	// 16 floats per segment, rows a, b, c, d of P(t) = ((a t + b) t + c) t + d, each x y z 0 (one SIMD load per row)
+	std::vector<float> coefficients;
+	std::vector<glm::vec3> controlPoints;	// 4 per segment, for the pow() reference of the benchmark
+
+	// Curve parameter u (segment + t) at distances 0, length / (entries - 1), ... length, and its derivative per entry,
+	// interpolated as a cubic Hermite so the speed has no steps at the entries. The last entry is repeated so the entry
+	// after any lookup exists.
+	std::vector<float> table;
+	std::vector<float> slopes;
+	float tableScale;						// (entries - 1) / length: distance to table position
+};
+
+
+
+// Position and unnormalized tangent of one segment
+static void evaluateSegment(const float * c, float t, float position[3], float tangent[3]){
+	for (int i = 0; i < 3; i++){
+		position[i] = ((c[i] * t + c[4 + i]) * t + c[8 + i]) * t + c[12 + i];
+		tangent[i] = (3.0f * c[i] * t + 2.0f * c[4 + i]) * t + c[8 + i];
+	}
+}
+
+static SplinePath * createPath(const std::vector<glm::vec3> & controlPoints, bool closed){
+	SplinePath * path = new SplinePath;
+	path->segments = (int)controlPoints.size() / 4;
+	path->closed = closed;
+	path->controlPoints = controlPoints;
+
+	// Bernstein basis to power basis
+	path->coefficients.resize(path->segments * 16, 0.0f);
+	for (int s = 0; s < path->segments; s++){
+		const glm::vec3 * p = &controlPoints[s * 4];
+		glm::vec3 rows[4] = {
+			-p[0] + 3.0f * p[1] - 3.0f * p[2] + p[3],
+			3.0f * p[0] - 6.0f * p[1] + 3.0f * p[2],
+			-3.0f * p[0] + 3.0f * p[1],
+			p[0]
+		};
+		for (int r = 0; r < 4; r++)
+			for (int i = 0; i < 3; i++)
+				path->coefficients[s * 16 + r * 4 + i] = rows[r][i];
+	}
+
+	// Length along the chords, at every chord end
+	int chords = path->segments * SPLINEPATH_CHORDS;
+	std::vector<double> arc(chords + 1, 0.0);
+	float previous[3], tangent[3];
+	evaluateSegment(&path->coefficients[0], 0.0f, previous, tangent);
+	for (int j = 1; j <= chords; j++){
+		int segment = (j - 1) / SPLINEPATH_CHORDS;
+		float point[3];
+		evaluateSegment(&path->coefficients[segment * 16], (float)(j - segment * SPLINEPATH_CHORDS) / SPLINEPATH_CHORDS, point, tangent);
+		double dx = point[0] - previous[0], dy = point[1] - previous[1], dz = point[2] - previous[2];
+		arc[j] = arc[j - 1] + sqrt(dx * dx + dy * dy + dz * dz);
+		memcpy(previous, point, sizeof(previous));
+	}
+	path->length = (float)arc[chords];
+
+	// Invert it at evenly spaced distances
+	int entries = path->segments * SPLINEPATH_TABLE + 1;
+	path->table.resize(entries + 1);
+	int j = 0;
+	for (int k = 0; k < entries; k++){
+		double distance = arc[chords] * k / (entries - 1);
+		while (j < chords - 1 && arc[j + 1] < distance)
+			j++;
+		double chord = arc[j + 1] - arc[j];
+		double along = chord > 0.0 ? glm::clamp((distance - arc[j]) / chord, 0.0, 1.0) : 0.0;
+		path->table[k] = (float)((j + along) / SPLINEPATH_CHORDS);
+	}
+	path->table[entries] = path->table[entries - 1];
+	path->tableScale = path->length > 0.0f ? (entries - 1) / path->length : 0.0f;
+
+	// du per entry is the entry spacing over the speed there, limited to 3 times the neighbouring steps so u never
+	// turns back (near cusps the speed goes to 0)
+	path->slopes.resize(entries + 1, 0.0f);
+	float spacing = path->length / (entries - 1);
+	for (int k = 0; k < entries; k++){
+		float u = path->table[k];
+		int segment = glm::min((int)u, path->segments - 1);
+		float point[3];
+		evaluateSegment(&path->coefficients[segment * 16], u - segment, point, tangent);
+		float speed = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+		float slope = speed > 0.0f ? spacing / speed : 0.0f;
+		if (k > 0)
+			slope = glm::min(slope, 3.0f * (path->table[k] - path->table[k - 1]));
+		if (k < entries - 1)
+			slope = glm::min(slope, 3.0f * (path->table[k + 1] - path->table[k]));
+		path->slopes[k] = slope;
+	}
+	return path;
+}
+
+SplinePath * createBezierPath(const glm::vec3 * points, int count, bool closed){
+	int segments = closed ? count / 3 : (count - 1) / 3;
+	if (segments < 1 || count != (closed ? segments * 3 : segments * 3 + 1)){
+		printf("[WARNING] %d control points don't make a chain of cubic Bezier segments (3n%s).\n", count, closed ? "" : " + 1");
+		return NULL;
+	}
+	std::vector<glm::vec3> controlPoints;
+	for (int s = 0; s < segments; s++){
+		for (int i = 0; i < 4; i++)
+			controlPoints.push_back(points[(s * 3 + i) % count]);
+	}
+	return createPath(controlPoints, closed);
+}
+
+SplinePath * createCatmullRomPath(const glm::vec3 * points, int count, bool closed){
+	if (count < 2){
+		printf("[WARNING] A Catmull-Rom path needs at least 2 points, not %d.\n", count);
+		return NULL;
+	}
+
+	// Segment i from point i to i + 1, the Bezier handles a sixth of the neighbours' difference away
+	int segments = closed ? count : count - 1;
+	std::vector<glm::vec3> controlPoints;
+	for (int i = 0; i < segments; i++){
+		int previous = closed ? (i + count - 1) % count : glm::max(i - 1, 0);
+		int next = (i + 1) % count;
+		int after = closed ? (i + 2) % count : glm::min(i + 2, count - 1);
+		controlPoints.push_back(points[i]);
+		controlPoints.push_back(points[i] + (points[next] - points[previous]) / 6.0f);
+		controlPoints.push_back(points[next] - (points[after] - points[i]) / 6.0f);
+		controlPoints.push_back(points[next]);
+	}
+	return createPath(controlPoints, closed);
+}
+
+void deleteSplinePath(SplinePath * path){
+	delete path;
+}
+
+float getSplinePathLength(const SplinePath * path){
+	return path->length;
+}
+
+bool isSplinePathClosed(const SplinePath * path){
+	return path->closed;
+}
+
+glm::vec3 evaluateSplinePathParameter(const SplinePath * path, float u){
+	int segment = glm::clamp((int)floorf(u), 0, path->segments - 1);
+	float position[3], tangent[3];
+	evaluateSegment(&path->coefficients[segment * 16], u - segment, position, tangent);
+	return glm::vec3(position[0], position[1], position[2]);
+}
+
+// Distance within [0, length]: round a closed path, back and forth along an open one
+static float foldDistance(const SplinePath * path, float distance){
+	float period = path->closed ? path->length : 2.0f * path->length;
+	if (period <= 0.0f)
+		return 0.0f;
+	float d = distance - period * floorf(distance / period);
+	if (!path->closed)
+		d = glm::min(d, period - d);
+	return glm::clamp(d, 0.0f, path->length);
+}
+
+// The scalar kernel, for the followers the SIMD loops leave over
+static void evaluateScalar(const SplinePath * path, const float * distances, int first, int count, float * px, float * py, float * pz,
+	float * tx, float * ty, float * tz){
+	const float * table = &path->table[0];
+	const float * slopes = &path->slopes[0];
+	for (int i = first; i < count; i++){
+		float f = foldDistance(path, distances[i]) * path->tableScale;
+		int k = (int)f;
+		float x = f - (float)k, x2 = x * x, x3 = x2 * x;
+		float u = table[k] + (table[k + 1] - table[k]) * (3.0f * x2 - 2.0f * x3) + slopes[k] * (x3 - 2.0f * x2 + x) + slopes[k + 1] * (x3 - x2);
+		float segment = glm::min((float)(int)u, (float)(path->segments - 1));
+		float position[3], tangent[3];
+		evaluateSegment(&path->coefficients[(int)segment * 16], u - segment, position, tangent);
+		px[i] = position[0];
+		py[i] = position[1];
+		pz[i] = position[2];
+		if (tx){
+			float inverse = 1.0f / sqrtf(glm::max(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2], 1e-30f));
+			tx[i] = tangent[0] * inverse;
+			ty[i] = tangent[1] * inverse;
+			tz[i] = tangent[2] * inverse;
+		}
+	}
+}
+
+#ifdef SPLINEPATH_SSE2
+static inline __m128 floorSSE2(__m128 x){
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+// Rows (x y z 0) of 4 followers' segments, transposed to x, y, z of the 4
+static inline void loadRowsSSE2(const float * coefficients, const int (&segments)[4], int row, __m128 & x, __m128 & y, __m128 & z){
+	__m128 r0 = _mm_loadu_ps(coefficients + segments[0] * 16 + row * 4), r1 = _mm_loadu_ps(coefficients + segments[1] * 16 + row * 4);
+	__m128 r2 = _mm_loadu_ps(coefficients + segments[2] * 16 + row * 4), r3 = _mm_loadu_ps(coefficients + segments[3] * 16 + row * 4);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	x = r0;
+	y = r1;
+	z = r2;
+}
+
+static int evaluateSSE2(const SplinePath * path, const float * distances, int count, float * px, float * py, float * pz,
+	float * tx, float * ty, float * tz){
+	const float * table = &path->table[0];
+	const float * slopes = &path->slopes[0];
+	const float * coefficients = &path->coefficients[0];
+	float periodLength = path->closed ? path->length : 2.0f * path->length;
+	__m128 period = _mm_set1_ps(periodLength), inversePeriod = _mm_set1_ps(periodLength > 0.0f ? 1.0f / periodLength : 0.0f);
+	__m128 length = _mm_set1_ps(path->length), scale = _mm_set1_ps(path->tableScale), lastSegment = _mm_set1_ps((float)(path->segments - 1));
+	__m128 zero = _mm_setzero_ps(), two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f), tiny = _mm_set1_ps(1e-30f), one = _mm_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4){
+		// Fold the distances, then the table position and its entry
+		__m128 d = _mm_loadu_ps(distances + i);
+		d = _mm_sub_ps(d, _mm_mul_ps(period, floorSSE2(_mm_mul_ps(d, inversePeriod))));
+		if (!path->closed)
+			d = _mm_min_ps(d, _mm_sub_ps(period, d));
+		__m128 f = _mm_mul_ps(_mm_min_ps(_mm_max_ps(d, zero), length), scale);
+		__m128i k = _mm_cvttps_epi32(f);
+		int entries[4];
+		_mm_storeu_si128((__m128i *)entries, k);
+		__m128 u0 = _mm_set_ps(table[entries[3]], table[entries[2]], table[entries[1]], table[entries[0]]);
+		__m128 u1 = _mm_set_ps(table[entries[3] + 1], table[entries[2] + 1], table[entries[1] + 1], table[entries[0] + 1]);
+		__m128 m0 = _mm_set_ps(slopes[entries[3]], slopes[entries[2]], slopes[entries[1]], slopes[entries[0]]);
+		__m128 m1 = _mm_set_ps(slopes[entries[3] + 1], slopes[entries[2] + 1], slopes[entries[1] + 1], slopes[entries[0] + 1]);
+		__m128 x = _mm_sub_ps(f, _mm_cvtepi32_ps(k)), x2 = _mm_mul_ps(x, x), x3 = _mm_mul_ps(x2, x);
+		__m128 u = _mm_add_ps(u0, _mm_mul_ps(_mm_sub_ps(u1, u0), _mm_sub_ps(_mm_mul_ps(three, x2), _mm_mul_ps(two, x3))));
+		u = _mm_add_ps(u, _mm_mul_ps(m0, _mm_add_ps(_mm_sub_ps(x3, _mm_mul_ps(two, x2)), x)));
+		u = _mm_add_ps(u, _mm_mul_ps(m1, _mm_sub_ps(x3, x2)));
+
+		// Segment and t within it
+		__m128 segment = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(u)), lastSegment);
+		__m128 t = _mm_sub_ps(u, segment);
+		int segments[4];
+		_mm_storeu_si128((__m128i *)segments, _mm_cvttps_epi32(segment));
+
+		__m128 ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz;
+		loadRowsSSE2(coefficients, segments, 0, ax, ay, az);
+		loadRowsSSE2(coefficients, segments, 1, bx, by, bz);
+		loadRowsSSE2(coefficients, segments, 2, cx, cy, cz);
+		loadRowsSSE2(coefficients, segments, 3, dx, dy, dz);
+
+		_mm_storeu_ps(px + i, _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ax, t), bx), t), cx), t), dx));
+		_mm_storeu_ps(py + i, _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ay, t), by), t), cy), t), dy));
+		_mm_storeu_ps(pz + i, _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(az, t), bz), t), cz), t), dz));
+		if (tx){
+			__m128 x = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(three, ax), t), _mm_mul_ps(two, bx)), t), cx);
+			__m128 y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(three, ay), t), _mm_mul_ps(two, by)), t), cy);
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(three, az), t), _mm_mul_ps(two, bz)), t), cz);
+			__m128 squared = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), tiny);
+			__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(squared));
+			_mm_storeu_ps(tx + i, _mm_mul_ps(x, inverse));
+			_mm_storeu_ps(ty + i, _mm_mul_ps(y, inverse));
+			_mm_storeu_ps(tz + i, _mm_mul_ps(z, inverse));
+		}
+	}
+	return i;
+}
+#endif
+
+#ifdef SPLINEPATH_AVX2
+#ifdef __FMA__
+#define SPLINEPATH_MADD(a, b, c)	_mm256_fmadd_ps(a, b, c)
+#else
+#define SPLINEPATH_MADD(a, b, c)	_mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+
+// As loadRowsSSE2 for 8 followers: followers 0-3 in the low 128-bit half and 4-7 in the high one, transposed per half
+static inline void loadRowsAVX2(const float * coefficients, const int (&segments)[8], int row, __m256 & x, __m256 & y, __m256 & z){
+	__m256 r[4];
+	for (int j = 0; j < 4; j++)
+		r[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(coefficients + segments[j] * 16 + row * 4)),
+			_mm_loadu_ps(coefficients + segments[j + 4] * 16 + row * 4), 1);
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	x = _mm256_shuffle_ps(t0, t2, 0x44);
+	y = _mm256_shuffle_ps(t0, t2, 0xEE);
+	z = _mm256_shuffle_ps(t1, t3, 0x44);
+}
+
+static int evaluateAVX2(const SplinePath * path, const float * distances, int count, float * px, float * py, float * pz,
+	float * tx, float * ty, float * tz){
+	const float * table = &path->table[0];
+	const float * slopes = &path->slopes[0];
+	const float * coefficients = &path->coefficients[0];
+	float periodLength = path->closed ? path->length : 2.0f * path->length;
+	__m256 period = _mm256_set1_ps(periodLength), inversePeriod = _mm256_set1_ps(periodLength > 0.0f ? 1.0f / periodLength : 0.0f);
+	__m256 length = _mm256_set1_ps(path->length), scale = _mm256_set1_ps(path->tableScale), lastSegment = _mm256_set1_ps((float)(path->segments - 1));
+	__m256 zero = _mm256_setzero_ps(), two = _mm256_set1_ps(2.0f), three = _mm256_set1_ps(3.0f), tiny = _mm256_set1_ps(1e-30f), one = _mm256_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8){
+		// Fold the distances, then the table position and its entry (gathered)
+		__m256 d = _mm256_loadu_ps(distances + i);
+		d = _mm256_sub_ps(d, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_mul_ps(d, inversePeriod))));
+		if (!path->closed)
+			d = _mm256_min_ps(d, _mm256_sub_ps(period, d));
+		__m256 f = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(d, zero), length), scale);
+		__m256i k = _mm256_cvttps_epi32(f);
+		__m256 u0 = _mm256_i32gather_ps(table, k, 4), u1 = _mm256_i32gather_ps(table + 1, k, 4);
+		__m256 m0 = _mm256_i32gather_ps(slopes, k, 4), m1 = _mm256_i32gather_ps(slopes + 1, k, 4);
+		__m256 x = _mm256_sub_ps(f, _mm256_cvtepi32_ps(k)), x2 = _mm256_mul_ps(x, x), x3 = _mm256_mul_ps(x2, x);
+		__m256 u = SPLINEPATH_MADD(_mm256_sub_ps(u1, u0), _mm256_sub_ps(_mm256_mul_ps(three, x2), _mm256_mul_ps(two, x3)), u0);
+		u = SPLINEPATH_MADD(m0, _mm256_add_ps(_mm256_sub_ps(x3, _mm256_mul_ps(two, x2)), x), u);
+		u = SPLINEPATH_MADD(m1, _mm256_sub_ps(x3, x2), u);
+
+		// Segment and t within it
+		__m256 segment = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(u)), lastSegment);
+		__m256 t = _mm256_sub_ps(u, segment);
+		int segments[8];
+		_mm256_storeu_si256((__m256i *)segments, _mm256_cvttps_epi32(segment));
+
+		__m256 ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz;
+		loadRowsAVX2(coefficients, segments, 0, ax, ay, az);
+		loadRowsAVX2(coefficients, segments, 1, bx, by, bz);
+		loadRowsAVX2(coefficients, segments, 2, cx, cy, cz);
+		loadRowsAVX2(coefficients, segments, 3, dx, dy, dz);
+
+		_mm256_storeu_ps(px + i, SPLINEPATH_MADD(SPLINEPATH_MADD(SPLINEPATH_MADD(ax, t, bx), t, cx), t, dx));
+		_mm256_storeu_ps(py + i, SPLINEPATH_MADD(SPLINEPATH_MADD(SPLINEPATH_MADD(ay, t, by), t, cy), t, dy));
+		_mm256_storeu_ps(pz + i, SPLINEPATH_MADD(SPLINEPATH_MADD(SPLINEPATH_MADD(az, t, bz), t, cz), t, dz));
+		if (tx){
+			__m256 x = SPLINEPATH_MADD(SPLINEPATH_MADD(_mm256_mul_ps(three, ax), t, _mm256_mul_ps(two, bx)), t, cx);
+			__m256 y = SPLINEPATH_MADD(SPLINEPATH_MADD(_mm256_mul_ps(three, ay), t, _mm256_mul_ps(two, by)), t, cy);
+			__m256 z = SPLINEPATH_MADD(SPLINEPATH_MADD(_mm256_mul_ps(three, az), t, _mm256_mul_ps(two, bz)), t, cz);
+			__m256 squared = _mm256_max_ps(SPLINEPATH_MADD(x, x, SPLINEPATH_MADD(y, y, _mm256_mul_ps(z, z))), tiny);
+			__m256 inverse = _mm256_div_ps(one, _mm256_sqrt_ps(squared));
+			_mm256_storeu_ps(tx + i, _mm256_mul_ps(x, inverse));
+			_mm256_storeu_ps(ty + i, _mm256_mul_ps(y, inverse));
+			_mm256_storeu_ps(tz + i, _mm256_mul_ps(z, inverse));
+		}
+	}
+	return i;
+}
+#endif
+
+void evaluateSplinePathBatch(const SplinePath * path, const float * distances, int count, float * px, float * py, float * pz,
+	float * tx, float * ty, float * tz){
+	int done = 0;
+#if defined(SPLINEPATH_AVX2)
+	done = evaluateAVX2(path, distances, count, px, py, pz, tx, ty, tz);
+#elif defined(SPLINEPATH_SSE2)
+	done = evaluateSSE2(path, distances, count, px, py, pz, tx, ty, tz);
+#endif
+	evaluateScalar(path, distances, done, count, px, py, pz, tx, ty, tz);
+}
+
+void evaluateSplinePath(const SplinePath * path, float distance, glm::vec3 & position, glm::vec3 & tangent){
+	evaluateScalar(path, &distance, 0, 1, &position.x, &position.y, &position.z, &tangent.x, &tangent.y, &tangent.z);
+}
+
+const char * getSplinePathKernel(){
+#if defined(SPLINEPATH_AVX2)
+	return "AVX2";
+#elif defined(SPLINEPATH_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// Largest step between consecutive points relative to the mean step, in percent
+static float stepDeviation(const std::vector<glm::vec3> & points){
+	std::vector<float> steps;
+	float mean = 0.0f;
+	for (size_t i = 1; i < points.size(); i++){
+		steps.push_back(glm::length(points[i] - points[i - 1]));
+		mean += steps.back();
+	}
+	mean /= steps.size();
+	float deviation = 0.0f;
+	for (size_t i = 0; i < steps.size(); i++)
+		deviation = glm::max(deviation, fabsf(steps[i] - mean) / mean);
+	return deviation * 100.0f;
+}
+
+void benchmarkSplinePaths(int followers, int iterations){
+	if (followers <= 0 || iterations <= 0)
+		return;
+
+	// A closed Catmull-Rom loop through 24 unevenly spaced points, followers spread along it and past its length
+	glm::vec3 points[24];
+	srand(1);
+	for (int i = 0; i < 24; i++){
+		float angle = 6.2831853f * (i + 0.6f * (float)rand() / RAND_MAX) / 24.0f;
+		points[i] = glm::vec3(cosf(angle) * (8.0f + (float)rand() / RAND_MAX * 4.0f), (float)rand() / RAND_MAX * 2.0f, sinf(angle) * 8.0f);
+	}
+	SplinePath * path = createCatmullRomPath(points, 24, true);
+	float length = getSplinePathLength(path);
+	std::vector<float> distances(followers);
+	for (int i = 0; i < followers; i++)
+		distances[i] = length * 3.0f * i / followers;
+
+	std::vector<float> px(followers), py(followers), pz(followers), tx(followers), ty(followers), tz(followers);
+	double start = getTime();
+	for (int it = 0; it < iterations; it++)
+		evaluateSplinePathBatch(path, &distances[0], followers, &px[0], &py[0], &pz[0], &tx[0], &ty[0], &tz[0]);
+	double batchSeconds = getTime() - start;
+
+	// One at a time, the same lookup and polynomials
+	std::vector<glm::vec3> positions(followers), tangents(followers);
+	start = getTime();
+	for (int it = 0; it < iterations; it++){
+		for (int i = 0; i < followers; i++)
+			evaluateSplinePath(path, distances[i], positions[i], tangents[i]);
+	}
+	double scalarSeconds = getTime() - start;
+
+	// How the man's path was evaluated: six pow() per axis by curve parameter, no arc length (and no tangent)
+	std::vector<glm::vec3> powPositions(followers);
+	start = getTime();
+	for (int it = 0; it < iterations; it++){
+		for (int i = 0; i < followers; i++){
+			float u = distances[i] / length * path->segments;
+			u -= path->segments * floorf(u / path->segments);
+			int segment = glm::min((int)u, path->segments - 1);
+			float t = u - segment;
+			const glm::vec3 * p = &path->controlPoints[segment * 4];
+			powPositions[i] = (float)pow(1 - t, 3) * p[0] + (float)pow(1 - t, 2) * 3.0f * t * p[1] + (float)pow(t, 2) * 3.0f * (1 - t) * p[2]
+				+ (float)pow(t, 3) * p[3];
+		}
+	}
+	double powSeconds = getTime() - start;
+
+	// Batch and one at a time must agree
+	float error = 0.0f;
+	for (int i = 0; i < followers; i++){
+		error = glm::max(error, glm::length(glm::vec3(px[i], py[i], pz[i]) - positions[i]));
+		error = glm::max(error, glm::length(glm::vec3(tx[i], ty[i], tz[i]) - tangents[i]));
+	}
+
+	// Even steps by distance against even steps by curve parameter
+	const int samples = 2000;
+	std::vector<float> sampleDistances(samples + 1);
+	std::vector<float> sx(samples + 1), sy(samples + 1), sz(samples + 1);
+	for (int i = 0; i <= samples; i++)
+		sampleDistances[i] = length * i / samples;
+	evaluateSplinePathBatch(path, &sampleDistances[0], samples + 1, &sx[0], &sy[0], &sz[0], NULL, NULL, NULL);
+	std::vector<glm::vec3> byDistance(samples + 1), byParameter(samples + 1);
+	for (int i = 0; i <= samples; i++){
+		byDistance[i] = glm::vec3(sx[i], sy[i], sz[i]);
+		byParameter[i] = evaluateSplinePathParameter(path, (float)path->segments * i / samples);
+	}
+
+	double evaluations = (double)followers * iterations;
+	printf("[DEBUG] Spline paths (%d followers, %d segments): %s batch %.1f M/s, one at a time %.1f M/s, pow() by parameter %.1f M/s, "
+		"speed within %.2f%% (by parameter %.1f%%), largest difference %.2g%s\n",
+		followers, path->segments, getSplinePathKernel(), evaluations / batchSeconds / 1e6, evaluations / scalarSeconds / 1e6,
+		evaluations / powSeconds / 1e6, stepDeviation(byDistance), stepDeviation(byParameter), error, error < 1e-3f ? "" : " (MISMATCH)");
+	deleteSplinePath(path);
+}
@@ -0,0 +1,44 @@
+#ifndef SPLINEPATH_HPP
+#define SPLINEPATH_HPP
+
+// Spline paths: chains of cubic segments, given as Bezier control points or as points for a Catmull-Rom spline to
+// pass through, kept as one polynomial per segment (P(t) = ((a t + b) t + c) t + d, evaluated Horner style). Each
+// path has an arc-length table: the curve parameter at evenly spaced distances along it, so followers given a
+// distance move at constant speed whatever the spacing of the control points. evaluateSplinePathBatch places many
+// followers on the same path at once, 4 (SSE2) or 8 (AVX2) per loop: table lookup, Horner evaluation of position
+// and tangent, structure-of-arrays output (transforms.hpp) with the same SIMD selection as composeTransforms.
+
+struct SplinePath;
+
+// Open: count = 3 * segments + 1, each segment's last point is the next one's first. Closed: count = 3 * segments,
+// the last segment ends on points[0].
+SplinePath * createBezierPath(const glm::vec3 * points, int count, bool closed);
+
+// Uniform Catmull-Rom through every point (at least 2): one segment between each pair, plus the last point back to
+// the first when closed. An open path's ends repeat their point for the missing neighbour.
+SplinePath * createCatmullRomPath(const glm::vec3 * points, int count, bool closed);
+
+void deleteSplinePath(SplinePath * path);
+
+float getSplinePathLength(const SplinePath * path);
+bool isSplinePathClosed(const SplinePath * path);
+
+// Position at curve parameter u = segment + t (t from 0 to 1 within the segment), at the curves' own uneven speed
+glm::vec3 evaluateSplinePathParameter(const SplinePath * path, float u);
+
+// Position and unit tangent (in the direction of the path) at distance along it. Distances wrap round a closed path,
+// an open one is travelled back and forth (length + x is x back from the end), so followers can keep counting.
+void evaluateSplinePath(const SplinePath * path, float distance, glm::vec3 & position, glm::vec3 & tangent);
+
+// The same for count followers: distances[i] gives (px, py, pz)[i] and (tx, ty, tz)[i]. tx, ty, tz may be NULL (no tangents).
+void evaluateSplinePathBatch(const SplinePath * path, const float * distances, int count, float * px, float * py, float * pz,
+	float * tx, float * ty, float * tz);
+
+// "AVX2", "SSE2" or "scalar"
+const char * getSplinePathKernel();
+
+// Print batched followers per second against one at a time and against a pow() Bernstein evaluation, and how even
+// the speed is by distance and by curve parameter
+void benchmarkSplinePaths(int followers, int iterations);
+
+#endif
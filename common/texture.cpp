@@ -6,6 +6,8 @@
 
 #include <GLFW/glfw3.h>
 
+#include "dxtdecoder.hpp"
+
 
 GLuint loadBMP_custom(const char * imagepath){
 
@@ -120,11 +122,8 @@ GLuint loadBMP_custom(const char * imagepath){
 
 
 
-#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
-#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
-#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
-
-GLuint loadDDS(const char * imagepath){
+unsigned char * readDDS(const char * imagepath, unsigned int & width, unsigned int & height,
+	unsigned int & mipMapCount, unsigned int & fourCC, unsigned int & bufsize){
 
 	unsigned char header[124];
 
@@ -134,7 +133,7 @@ GLuint loadDDS(const char * imagepath){
 	fp = fopen(imagepath, "rb"); 
 	if (fp == NULL){
 		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
-		return 0;
+		return NULL;
 	}
    
 	/* verify the type of file */ 
@@ -142,28 +141,39 @@ GLuint loadDDS(const char * imagepath){
 	fread(filecode, 1, 4, fp); 
 	if (strncmp(filecode, "DDS ", 4) != 0) { 
 		fclose(fp); 
-		return 0; 
+		return NULL; 
 	}
 	
 	/* get the surface desc */ 
 	fread(&header, 124, 1, fp); 
 
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
+	height                   = *(unsigned int*)&(header[8 ]);
+	width	                 = *(unsigned int*)&(header[12]);
 	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
+	mipMapCount              = *(unsigned int*)&(header[24]);
+	fourCC                   = *(unsigned int*)&(header[80]);
 
+	// Files written without the DDSD_MIPMAPCOUNT flag leave the count at 0, they still hold the base level
+	if (mipMapCount == 0) mipMapCount = 1;
  
 	unsigned char * buffer;
-	unsigned int bufsize;
 	/* how big is it going to be including all mipmaps? */ 
 	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
 	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
+	bufsize = fread(buffer, 1, bufsize, fp); 
 	/* close the file pointer */ 
 	fclose(fp);
 
+	return buffer;
+}
+
+GLuint loadDDS(const char * imagepath){
+
+	unsigned int width, height, mipMapCount, fourCC, bufsize;
+	unsigned char * buffer = readDDS(imagepath, width, height, mipMapCount, fourCC, bufsize);
+	if (buffer == NULL)
+		return 0;
+
 	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
 	unsigned int format;
 	switch(fourCC) 
@@ -182,6 +192,13 @@ GLuint loadDDS(const char * imagepath){
 		return 0; 
 	}
 
+	// Some software drivers list S3TC but can't upload it, decode the blocks on the CPU instead
+	if (!isS3TCSupported()){
+		GLuint textureID = createTextureFromDXT(fourCC, width, height, mipMapCount, buffer, bufsize);
+		free(buffer);
+		return textureID;
+	}
+
 	// Create one OpenGL texture
 	GLuint textureID;
 	glGenTextures(1, &textureID);
@@ -194,9 +211,12 @@ GLuint loadDDS(const char * imagepath){
 	unsigned int offset = 0;
 
 	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
+	unsigned int level;
+	for (level = 0; level < mipMapCount && (width || height); ++level) 
 	{ 
 		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
+		if (offset + size > bufsize)
+			break;
 		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
 			0, size, buffer + offset); 
 	 
@@ -210,6 +230,9 @@ GLuint loadDDS(const char * imagepath){
 
 	} 
 
+	// Only sample the levels uploaded: a truncated file stops early, and the texture would be incomplete past them
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level > 0 ? level - 1 : 0);
+
 	free(buffer); 
 
 	return textureID;
@@ -12,5 +12,9 @@ GLuint loadBMP_custom(const char * imagepath);
 // Load a .DDS file using GLFW's own loader
 GLuint loadDDS(const char * imagepath);
 
+// Read the header and the compressed payload (all mipmaps) of a .DDS file. Returns a malloc'd buffer, NULL on failure.
+unsigned char * readDDS(const char * imagepath, unsigned int & width, unsigned int & height,
+	unsigned int & mipMapCount, unsigned int & fourCC, unsigned int & bufsize);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include <chrono>
+
+#include "timer.hpp"
+
+double getTime(){
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,8 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+// Seconds since the first call, on a steady high resolution clock. Unlike glfwGetTime it works without glfwInit, so
+// the same timing code runs in a window and headless (where GLFW can't initialize without a display).
+double getTime();
+
+#endif
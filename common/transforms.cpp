@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "timer.hpp"
+#include "transforms.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORMS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORMS_SSE2
+#endif
+
+struct TransformArray {
+	std::vector<float> components[10];		// px py pz qx qy qz qw sx sy sz
+};
+
+
+
+TransformStreams offsetTransformStreams(const TransformStreams & streams, int first){
+	TransformStreams offset = {
+		streams.px + first, streams.py + first, streams.pz + first,
+		streams.qx + first, streams.qy + first, streams.qz + first, streams.qw + first,
+		streams.sx + first, streams.sy + first, streams.sz + first
+	};
+	return offset;
+}
+
+// Columns 0 to 2 of the local matrix are the rotation's columns times the scale, column 3 is the position
+static void composeScalar(const TransformStreams & s, int first, int count, const glm::mat4 * parent, const glm::mat4 * combined,
+	glm::mat4 * world, glm::mat4 * mvp){
+	for (int i = first; i < count; i++){
+		float x = s.qx[i], y = s.qy[i], z = s.qz[i], w = s.qw[i];
+		glm::mat4 local;
+		local[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * s.sx[i], 2.0f * (x * y + w * z) * s.sx[i], 2.0f * (x * z - w * y) * s.sx[i], 0.0f);
+		local[1] = glm::vec4(2.0f * (x * y - w * z) * s.sy[i], (1.0f - 2.0f * (x * x + z * z)) * s.sy[i], 2.0f * (y * z + w * x) * s.sy[i], 0.0f);
+		local[2] = glm::vec4(2.0f * (x * z + w * y) * s.sz[i], 2.0f * (y * z - w * x) * s.sz[i], (1.0f - 2.0f * (x * x + y * y)) * s.sz[i], 0.0f);
+		local[3] = glm::vec4(s.px[i], s.py[i], s.pz[i], 1.0f);
+		if (world)
+			world[i] = parent ? *parent * local : local;
+		if (mvp)
+			mvp[i] = combined ? *combined * local : local;
+	}
+}
+
+#ifdef TRANSFORMS_SSE2
+// Rows r of output column c for 4 objects: matrix * local column c, where local[c][3] is 0 for c < 3 and 1 for c = 3
+static void storeProductSSE2(const __m128 (&m)[4][4], const __m128 (&local)[4][3], glm::mat4 * out){
+	for (int c = 0; c < 4; c++){
+		__m128 rows[4];
+		for (int r = 0; r < 4; r++){
+			__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], local[c][0]), _mm_mul_ps(m[1][r], local[c][1])), _mm_mul_ps(m[2][r], local[c][2]));
+			rows[r] = c == 3 ? _mm_add_ps(v, m[3][r]) : v;
+		}
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);		// rows[j] = column c of object j
+		for (int j = 0; j < 4; j++)
+			_mm_storeu_ps(&out[j][c][0], rows[j]);
+	}
+}
+
+static void loadMatrixSSE2(const glm::mat4 * matrix, __m128 (&m)[4][4]){
+	glm::mat4 identity(1.0f);
+	const glm::mat4 & source = matrix ? *matrix : identity;
+	for (int k = 0; k < 4; k++)
+		for (int r = 0; r < 4; r++)
+			m[k][r] = _mm_set1_ps(source[k][r]);
+}
+
+static int composeSSE2(const TransformStreams & s, int count, const glm::mat4 * parent, const glm::mat4 * combined,
+	glm::mat4 * world, glm::mat4 * mvp){
+	__m128 parentColumns[4][4], combinedColumns[4][4];
+	loadMatrixSSE2(parent, parentColumns);
+	loadMatrixSSE2(combined, combinedColumns);
+	__m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4){
+		__m128 x = _mm_loadu_ps(s.qx + i), y = _mm_loadu_ps(s.qy + i), z = _mm_loadu_ps(s.qz + i), w = _mm_loadu_ps(s.qw + i);
+		__m128 sx = _mm_loadu_ps(s.sx + i), sy = _mm_loadu_ps(s.sy + i), sz = _mm_loadu_ps(s.sz + i);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 local[4][3];
+		local[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		local[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		local[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		local[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		local[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		local[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		local[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		local[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		local[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		local[3][0] = _mm_loadu_ps(s.px + i);
+		local[3][1] = _mm_loadu_ps(s.py + i);
+		local[3][2] = _mm_loadu_ps(s.pz + i);
+
+		if (world)
+			storeProductSSE2(parentColumns, local, world + i);
+		if (mvp)
+			storeProductSSE2(combinedColumns, local, mvp + i);
+	}
+	return i;
+}
+#endif
+
+#ifdef TRANSFORMS_AVX2
+#ifdef __FMA__
+#define TRANSFORMS_MADD(a, b, c)	_mm256_fmadd_ps(a, b, c)
+#else
+#define TRANSFORMS_MADD(a, b, c)	_mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+
+// As storeProductSSE2 for 8 objects: the transpose works within each 128-bit half, objects 0-3 low and 4-7 high
+static void storeProductAVX2(const __m256 (&m)[4][4], const __m256 (&local)[4][3], glm::mat4 * out){
+	for (int c = 0; c < 4; c++){
+		__m256 rows[4];
+		for (int r = 0; r < 4; r++){
+			__m256 v = c == 3 ? m[3][r] : _mm256_setzero_ps();
+			v = TRANSFORMS_MADD(m[0][r], local[c][0], v);
+			v = TRANSFORMS_MADD(m[1][r], local[c][1], v);
+			rows[r] = TRANSFORMS_MADD(m[2][r], local[c][2], v);
+		}
+		__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]), t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+		__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]), t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+		__m256 columns[4] = {
+			_mm256_shuffle_ps(t0, t2, 0x44), _mm256_shuffle_ps(t0, t2, 0xEE),
+			_mm256_shuffle_ps(t1, t3, 0x44), _mm256_shuffle_ps(t1, t3, 0xEE)
+		};
+		for (int j = 0; j < 4; j++){
+			_mm_storeu_ps(&out[j][c][0], _mm256_castps256_ps128(columns[j]));
+			_mm_storeu_ps(&out[j + 4][c][0], _mm256_extractf128_ps(columns[j], 1));
+		}
+	}
+}
+
+static void loadMatrixAVX2(const glm::mat4 * matrix, __m256 (&m)[4][4]){
+	glm::mat4 identity(1.0f);
+	const glm::mat4 & source = matrix ? *matrix : identity;
+	for (int k = 0; k < 4; k++)
+		for (int r = 0; r < 4; r++)
+			m[k][r] = _mm256_set1_ps(source[k][r]);
+}
+
+static int composeAVX2(const TransformStreams & s, int count, const glm::mat4 * parent, const glm::mat4 * combined,
+	glm::mat4 * world, glm::mat4 * mvp){
+	__m256 parentColumns[4][4], combinedColumns[4][4];
+	loadMatrixAVX2(parent, parentColumns);
+	loadMatrixAVX2(combined, combinedColumns);
+	__m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8){
+		__m256 x = _mm256_loadu_ps(s.qx + i), y = _mm256_loadu_ps(s.qy + i), z = _mm256_loadu_ps(s.qz + i), w = _mm256_loadu_ps(s.qw + i);
+		__m256 sx = _mm256_loadu_ps(s.sx + i), sy = _mm256_loadu_ps(s.sy + i), sz = _mm256_loadu_ps(s.sz + i);
+		__m256 x2 = _mm256_mul_ps(two, x), y2 = _mm256_mul_ps(two, y), z2 = _mm256_mul_ps(two, z);
+		__m256 xx = _mm256_mul_ps(x2, x), yy = _mm256_mul_ps(y2, y), zz = _mm256_mul_ps(z2, z);
+		__m256 xy = _mm256_mul_ps(x2, y), xz = _mm256_mul_ps(x2, z), yz = _mm256_mul_ps(y2, z);
+		__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+		__m256 local[4][3];
+		local[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+		local[0][1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+		local[0][2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+		local[1][0] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+		local[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+		local[1][2] = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+		local[2][0] = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+		local[2][1] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+		local[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+		local[3][0] = _mm256_loadu_ps(s.px + i);
+		local[3][1] = _mm256_loadu_ps(s.py + i);
+		local[3][2] = _mm256_loadu_ps(s.pz + i);
+
+		if (world)
+			storeProductAVX2(parentColumns, local, world + i);
+		if (mvp)
+			storeProductAVX2(combinedColumns, local, mvp + i);
+	}
+	return i;
+}
+#endif
+
+void composeTransforms(const TransformStreams & streams, int count, const glm::mat4 * parent, const glm::mat4 * viewProjection,
+	glm::mat4 * world, glm::mat4 * mvp){
+	// MVPs straight from the local transforms: one matrix product per batch instead of one per object
+	glm::mat4 combinedMatrix;
+	const glm::mat4 * combined = parent;
+	if (viewProjection){
+		combinedMatrix = parent ? *viewProjection * *parent : *viewProjection;
+		combined = &combinedMatrix;
+	}
+
+	int done = 0;
+#if defined(TRANSFORMS_AVX2)
+	done = composeAVX2(streams, count, parent, combined, world, mvp);
+#elif defined(TRANSFORMS_SSE2)
+	done = composeSSE2(streams, count, parent, combined, world, mvp);
+#endif
+	composeScalar(streams, done, count, parent, combined, world, mvp);
+}
+
+void composeTransformsReference(const TransformStreams & streams, int count, const glm::mat4 * parent, const glm::mat4 * viewProjection,
+	glm::mat4 * world, glm::mat4 * mvp){
+	for (int i = 0; i < count; i++){
+		glm::quat orientation(streams.qw[i], streams.qx[i], streams.qy[i], streams.qz[i]);
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(streams.px[i], streams.py[i], streams.pz[i])) * glm::mat4_cast(orientation)
+			* glm::scale(glm::mat4(1.0f), glm::vec3(streams.sx[i], streams.sy[i], streams.sz[i]));
+		if (parent)
+			model = *parent * model;
+		if (world)
+			world[i] = model;
+		if (mvp)
+			mvp[i] = viewProjection ? *viewProjection * model : model;
+	}
+}
+
+const char * getTransformKernel(){
+#if defined(TRANSFORMS_AVX2)
+	return "AVX2";
+#elif defined(TRANSFORMS_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+TransformArray * createTransformArray(){
+	return new TransformArray;
+}
+
+void deleteTransformArray(TransformArray * transforms){
+	delete transforms;
+}
+
+int addTransform(TransformArray * transforms, const glm::vec3 & position, const glm::quat & orientation, const glm::vec3 & scale){
+	float values[10] = { position.x, position.y, position.z, orientation.x, orientation.y, orientation.z, orientation.w, scale.x, scale.y, scale.z };
+	for (int c = 0; c < 10; c++)
+		transforms->components[c].push_back(values[c]);
+	return (int)transforms->components[0].size() - 1;
+}
+
+int getTransformCount(TransformArray * transforms){
+	return (int)transforms->components[0].size();
+}
+
+TransformStreams getTransformStreams(TransformArray * transforms){
+	TransformStreams streams;
+	float ** pointers[10] = { &streams.px, &streams.py, &streams.pz, &streams.qx, &streams.qy, &streams.qz, &streams.qw, &streams.sx, &streams.sy, &streams.sz };
+	for (int c = 0; c < 10; c++)
+		*pointers[c] = transforms->components[c].empty() ? NULL : &transforms->components[c][0];
+	return streams;
+}
+
+void benchmarkTransforms(int count, int iterations){
+	// Random positions, orientations and scales under a parent, seen by a camera
+	TransformArray * transforms = createTransformArray();
+	srand(1);
+	for (int i = 0; i < count; i++){
+		glm::vec3 position((float)rand() / RAND_MAX * 20.0f - 10.0f, (float)rand() / RAND_MAX * 20.0f - 10.0f, (float)rand() / RAND_MAX * -20.0f);
+		glm::vec3 axis = glm::normalize(glm::vec3((float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f) + glm::vec3(0.0f, 0.01f, 0.0f));
+		glm::quat orientation = glm::angleAxis((float)rand() / RAND_MAX * 6.28f, axis);
+		addTransform(transforms, position, orientation, glm::vec3(0.5f + (float)rand() / RAND_MAX));
+	}
+	TransformStreams streams = getTransformStreams(transforms);
+	glm::mat4 parent = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, -2.0f)) * glm::mat4_cast(glm::angleAxis(0.3f, glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::mat4 viewProjection = glm::perspective(0.75f, 1.25f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0, 0, 10), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+	std::vector<glm::mat4> world(count), mvp(count), referenceWorld(count), referenceMVP(count);
+	double start = getTime();
+	for (int it = 0; it < iterations; it++)
+		composeTransforms(streams, count, &parent, &viewProjection, &world[0], &mvp[0]);
+	double simdSeconds = getTime() - start;
+
+	start = getTime();
+	for (int it = 0; it < iterations; it++)
+		composeTransformsReference(streams, count, &parent, &viewProjection, &referenceWorld[0], &referenceMVP[0]);
+	double referenceSeconds = getTime() - start;
+
+	// Largest difference relative to the matrix's magnitude
+	float error = 0.0f;
+	for (int i = 0; i < count; i++){
+		for (int c = 0; c < 4; c++){
+			for (int r = 0; r < 4; r++){
+				error = glm::max(error, fabsf(world[i][c][r] - referenceWorld[i][c][r]) / (1.0f + fabsf(referenceWorld[i][c][r])));
+				error = glm::max(error, fabsf(mvp[i][c][r] - referenceMVP[i][c][r]) / (1.0f + fabsf(referenceMVP[i][c][r])));
+			}
+		}
+	}
+
+	double compositions = (double)count * iterations;
+	printf("[DEBUG] Transforms (%d objects, world + MVP): %s %.1f M/s, glm %.1f M/s, %.2fx, largest difference %.2g%s\n",
+		count, getTransformKernel(), compositions / simdSeconds / 1e6, compositions / referenceSeconds / 1e6, referenceSeconds / simdSeconds,
+		error, error < 1e-4f ? "" : " (MISMATCH)");
+	deleteTransformArray(transforms);
+}
@@ -0,0 +1,49 @@
+#ifndef TRANSFORMS_HPP
+#define TRANSFORMS_HPP
+
+// Transforms in structure-of-arrays layout: every component (position x, y, z, quaternion x, y, z, w, scale x, y, z)
+// is its own array, so SIMD registers load the same component of 4 (SSE2) or 8 (AVX2) objects at once.
+// composeTransforms turns them into matrices that many objects at a time: the local translate * rotate * scale is
+// built in registers, multiplied by a matrix shared by the batch (a parent, or projection * view * parent for MVPs)
+// and transposed back into one glm::mat4 per object. AVX2 is used when the build enables it (-mavx2), SSE2 otherwise,
+// plain C++ without either; the last count % lanes objects always take the plain path.
+
+// One pointer per component, element i of each is object i
+struct TransformStreams {
+	float * px, * py, * pz;
+	float * qx, * qy, * qz, * qw;		// Unit quaternion
+	float * sx, * sy, * sz;
+};
+
+// Streams starting at object first
+TransformStreams offsetTransformStreams(const TransformStreams & streams, int first);
+
+// world[i] = parent * TRS(i) and mvp[i] = viewProjection * world[i]. parent and viewProjection may be NULL
+// (identity), world or mvp may be NULL when not needed.
+void composeTransforms(const TransformStreams & streams, int count, const glm::mat4 * parent, const glm::mat4 * viewProjection,
+	glm::mat4 * world, glm::mat4 * mvp);
+
+// The same with glm, one object at a time (translate * mat4_cast * scale), to check composeTransforms against
+void composeTransformsReference(const TransformStreams & streams, int count, const glm::mat4 * parent, const glm::mat4 * viewProjection,
+	glm::mat4 * world, glm::mat4 * mvp);
+
+// "AVX2", "SSE2" or "scalar"
+const char * getTransformKernel();
+
+// Owning storage for the streams
+struct TransformArray;
+
+TransformArray * createTransformArray();
+void deleteTransformArray(TransformArray * transforms);
+
+// Returns the transform's index (0, 1, 2, ... in the order they are added)
+int addTransform(TransformArray * transforms, const glm::vec3 & position, const glm::quat & orientation, const glm::vec3 & scale);
+int getTransformCount(TransformArray * transforms);
+
+// Valid until transforms are added
+TransformStreams getTransformStreams(TransformArray * transforms);
+
+// Print world + MVP compositions per second for the SIMD kernel and for glm, and the largest difference between them
+void benchmarkTransforms(int count, int iterations);
+
+#endif
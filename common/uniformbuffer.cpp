@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "uniformbuffer.hpp"
+#include "glstate.hpp"
+
+struct UniformBuffers {
+	GLuint frameBuffer;
+	GLuint objectBuffer;
+	ObjectUniforms objects[UBO_MAX_OBJECTS];	// CPU copy of this frame's ObjectBlock
+	int objectCount;
+};
+
+UniformBuffers * createUniformBuffers(){
+	UniformBuffers * ubo = new UniformBuffers;
+	ubo->objectCount = 0;
+
+	glGenBuffers(1, &ubo->frameBuffer);
+	cachedBindBuffer(GL_UNIFORM_BUFFER, ubo->frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBO_FRAME_BINDING, ubo->frameBuffer);
+
+	glGenBuffers(1, &ubo->objectBuffer);
+	cachedBindBuffer(GL_UNIFORM_BUFFER, ubo->objectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ubo->objects), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UBO_OBJECT_BINDING, ubo->objectBuffer);
+
+	return ubo;
+}
+
+void deleteUniformBuffers(UniformBuffers * ubo){
+	if (ubo == NULL)
+		return;
+	glDeleteBuffers(1, &ubo->frameBuffer);
+	glDeleteBuffers(1, &ubo->objectBuffer);
+	delete ubo;
+}
+
+void bindUniformBlocks(GLuint program){
+	GLuint frameIndex = glGetUniformBlockIndex(program, "FrameBlock");
+	if (frameIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frameIndex, UBO_FRAME_BINDING);
+
+	GLuint objectIndex = glGetUniformBlockIndex(program, "ObjectBlock");
+	if (objectIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, objectIndex, UBO_OBJECT_BINDING);
+}
+
+void setFrameUniforms(UniformBuffers * ubo, const FrameUniforms & frame){
+	cachedBindBuffer(GL_UNIFORM_BUFFER, ubo->frameBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+}
+
+int addObjectUniforms(UniformBuffers * ubo, const glm::mat4 & MVP, const glm::mat4 & M){
+	if (ubo->objectCount == UBO_MAX_OBJECTS)
+		return -1;
+	ObjectUniforms & object = ubo->objects[ubo->objectCount];
+	object.MVP = MVP;
+	object.M = M;
+	return ubo->objectCount++;
+}
+
+void uploadObjectUniforms(UniformBuffers * ubo){
+	if (ubo->objectCount > 0){
+		cachedBindBuffer(GL_UNIFORM_BUFFER, ubo->objectBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, ubo->objectCount * sizeof(ObjectUniforms), ubo->objects);
+	}
+	ubo->objectCount = 0;
+}
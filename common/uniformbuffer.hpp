@@ -0,0 +1,46 @@
+#ifndef UNIFORMBUFFER_HPP
+#define UNIFORMBUFFER_HPP
+
+// Uniform buffer objects: the shaders read the camera and the lights from FrameBlock (uploaded once per frame)
+// and their transforms from ObjectBlock, an array with one entry per draw of the frame (uploaded in one call),
+// indexed by the draw ID vertex attribute. A draw then only sets its draw ID instead of re-sending its matrices.
+
+#define UBO_FRAME_BINDING	0		// Uniform buffer binding points
+#define UBO_OBJECT_BINDING	1
+#define UBO_MAX_LIGHTS		16		// Must match FrameBlock in the shaders
+#define UBO_MAX_OBJECTS		128		// Must match ObjectBlock in the shaders (128 * 128 bytes = the 16KB every GL guarantees)
+#define DRAW_ID_LOCATION	7		// Vertex attribute holding the draw ID (layout(location = 7) in int drawID)
+
+// std140 layout of FrameBlock
+struct FrameUniforms {
+	glm::mat4 V;
+	glm::mat4 P;
+	glm::vec4 LightPosition_worldspace[UBO_MAX_LIGHTS];	// xyz used
+	glm::vec4 Time;		// x = seconds since start, animates instanced meshes
+};
+
+// std140 layout of one ObjectBlock entry
+struct ObjectUniforms {
+	glm::mat4 MVP;
+	glm::mat4 M;
+};
+
+struct UniformBuffers;
+
+// Create both buffers and bind them to UBO_FRAME_BINDING / UBO_OBJECT_BINDING
+UniformBuffers * createUniformBuffers();
+void deleteUniformBuffers(UniformBuffers * ubo);
+
+// Point a program's FrameBlock and ObjectBlock (if it uses them) at the binding points
+void bindUniformBlocks(GLuint program);
+
+// Upload the per-frame block (one glBufferSubData)
+void setFrameUniforms(UniformBuffers * ubo, const FrameUniforms & frame);
+
+// Queue one object's transforms and return its draw ID, or -1 once UBO_MAX_OBJECTS are queued (upload, draw, then retry)
+int addObjectUniforms(UniformBuffers * ubo, const glm::mat4 & MVP, const glm::mat4 & M);
+
+// Upload every queued object in one glBufferSubData and start over from draw ID 0. Call before the draws that use them.
+void uploadObjectUniforms(UniformBuffers * ubo);
+
+#endif
@@ -0,0 +1,736 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "texture.hpp"
+#include "dxtdecoder.hpp"
+#include "virtualtexture.hpp"
+#include "glstate.hpp"
+#include "profiler.hpp"
+
+#define VT_SLOT_SIZE		(VT_TILE_SIZE + 2 * VT_TILE_BORDER)	// Texels per physical cache slot side
+#define VT_TILE_BYTES		(VT_SLOT_SIZE * VT_SLOT_SIZE * 4)	// One RGBA8 tile, border included
+#define VT_FILE_ALIGNMENT	4096	// Tiles start on a page boundary of the mapped file
+#define VT_MAX_UPLOADS		16		// Tiles uploaded per update, keeps the frame cost bounded
+#define VT_MAX_REQUESTS		64		// New tile requests per update
+#define VT_NO_PAGE			0xffffffffu
+
+// .vtex file header, followed (at dataOffset) by every tile of every level, level by level, row by row
+struct VTexHeader {
+	char magic[4];				// "VTEX"
+	unsigned int width;			// Level 0 size in texels
+	unsigned int height;
+	unsigned int tileSize;		// VT_TILE_SIZE
+	unsigned int border;		// VT_TILE_BORDER
+	unsigned int tilesX;		// Level 0 tile grid, padded to powers of two so every level halves cleanly
+	unsigned int tilesY;
+	unsigned int levelCount;	// Down to a single tile
+	unsigned int dataOffset;
+};
+
+// One queued draw of the feedback pass
+struct VTFeedbackDraw {
+	GLuint vertexBuffer;
+	GLsizei stride;
+	size_t positionOffset;
+	size_t uvOffset;
+	GLuint indexBuffer;
+	GLuint firstIndex;
+	GLsizei indexCount;
+	GLint baseVertex;
+	glm::mat4 MVP;
+};
+
+// A tile copied out of the mapped file by the streaming thread, waiting for upload
+struct VTTile {
+	unsigned int page;
+	std::vector<unsigned char> pixels;
+};
+
+struct VirtualTexture {
+	VTexHeader header;
+	std::vector<unsigned int> levelFirstPage;	// Page id of the first tile of every level (page id = tile index in the file)
+
+	// Memory mapped .vtex file
+	const unsigned char * mapped;
+	size_t mappedSize;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file;
+#endif
+
+	// Page table and LRU physical tile cache
+	GLuint physical;
+	GLuint indirection;
+	int slotsPerSide;
+	std::vector<int> pageSlot;					// Physical slot of every page, -1 if not resident
+	std::vector<unsigned char> pagePending;		// Requested from the streaming thread
+	std::vector<unsigned int> pageSeenFrame;	// Last frame the feedback asked for the page
+	std::vector<unsigned int> slotPage;			// Page held by every slot, VT_NO_PAGE if free
+	std::vector<unsigned int> slotLastUsed;		// Frame the slot's page was last needed
+	std::vector< std::vector<unsigned char> > indirectionLevels;
+	bool indirectionDirty;
+	unsigned int frame;
+	int uploaded;
+
+	// Feedback pass and its asynchronous readback
+	GLuint feedbackProgram;
+	GLuint feedbackMVPID;
+	GLuint feedbackSizeID;
+	GLuint feedbackParamsID;
+	GLuint feedbackBiasID;
+	GLuint feedbackFBO;
+	GLuint feedbackVertexArray;	// Its own attribute pointers into the callers' buffers
+	GLuint feedbackColor;
+	GLuint feedbackDepth;
+	int feedbackWidth;
+	int feedbackHeight;
+	GLuint readbackPBO[2];
+	GLsync readbackFence[2];
+	int readbackIndex;
+	std::vector<VTFeedbackDraw> draws;
+
+	// Streaming thread
+	std::thread streamer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<unsigned int> requests;
+	std::deque<VTTile> finished;
+	bool quit;
+};
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Building the tiled file
+// -------------------------------------------------------------------------------------------------
+
+static unsigned int nextPowerOfTwo(unsigned int v){
+	unsigned int p = 1;
+	while (p < v)
+		p <<= 1;
+	return p;
+}
+
+// Levels down to a single tile, for a tilesX x tilesY base grid
+static unsigned int levelCountFor(unsigned int tilesX, unsigned int tilesY){
+	unsigned int levelCount = 1;
+	while ((tilesX >> (levelCount - 1)) > 1 || (tilesY >> (levelCount - 1)) > 1)
+		levelCount++;
+	return levelCount;
+}
+
+// Halve an RGBA8 image with a 2x2 box filter (odd edges repeat the last texel)
+static void downsample(const std::vector<unsigned char> & src, unsigned int w, unsigned int h, std::vector<unsigned char> & dst){
+	unsigned int dw = w > 1 ? w / 2 : 1;
+	unsigned int dh = h > 1 ? h / 2 : 1;
+	dst.resize((size_t)dw * dh * 4);
+	for (unsigned int y = 0; y < dh; y++){
+		unsigned int y0 = y * 2 < h ? y * 2 : h - 1;
+		unsigned int y1 = y * 2 + 1 < h ? y * 2 + 1 : h - 1;
+		for (unsigned int x = 0; x < dw; x++){
+			unsigned int x0 = x * 2 < w ? x * 2 : w - 1;
+			unsigned int x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+			for (unsigned int c = 0; c < 4; c++){
+				unsigned int sum = src[((size_t)y0 * w + x0) * 4 + c] + src[((size_t)y0 * w + x1) * 4 + c]
+				                 + src[((size_t)y1 * w + x0) * 4 + c] + src[((size_t)y1 * w + x1) * 4 + c];
+				dst[((size_t)y * dw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool isVirtualTextureOutdated(const char * ddspath, const char * vtexpath){
+	struct stat dds, vtex;
+	if (stat(vtexpath, &vtex) != 0)
+		return true;
+	return stat(ddspath, &dds) == 0 && dds.st_mtime > vtex.st_mtime;
+}
+
+bool buildVirtualTexture(const char * ddspath, const char * vtexpath){
+	unsigned int width, height, mipMapCount, fourCC, bufsize;
+	unsigned char * buffer = readDDS(ddspath, width, height, mipMapCount, fourCC, bufsize);
+	if (buffer == NULL)
+		return false;
+	unsigned int blockSize = (fourCC == FOURCC_DXT1) ? 8 : 16;
+	if ((fourCC != FOURCC_DXT1 && fourCC != FOURCC_DXT3 && fourCC != FOURCC_DXT5) || width == 0 || height == 0 ||
+		(size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize > bufsize){
+		printf("%s is not a DXT1/3/5 texture this virtual texture builder can read\n", ddspath);
+		free(buffer);
+		return false;
+	}
+
+	VTexHeader header;
+	memcpy(header.magic, "VTEX", 4);
+	header.width  = width;
+	header.height = height;
+	header.tileSize = VT_TILE_SIZE;
+	header.border   = VT_TILE_BORDER;
+	header.tilesX = nextPowerOfTwo((width  + VT_TILE_SIZE - 1) / VT_TILE_SIZE);
+	header.tilesY = nextPowerOfTwo((height + VT_TILE_SIZE - 1) / VT_TILE_SIZE);
+	header.levelCount = levelCountFor(header.tilesX, header.tilesY);
+	header.dataOffset = VT_FILE_ALIGNMENT;
+
+	FILE * file = fopen(vtexpath, "wb");
+	if (!file){
+		printf("%s could not be written.\n", vtexpath);
+		free(buffer);
+		return false;
+	}
+	std::vector<unsigned char> padding(header.dataOffset, 0);
+	memcpy(&padding[0], &header, sizeof(header));
+	fwrite(&padding[0], 1, padding.size(), file);
+
+	std::vector<unsigned char> tile(VT_TILE_BYTES);
+	std::vector<unsigned char> image((size_t)width * height * 4);
+	std::vector<unsigned char> next;
+	unsigned int w = width, h = height;
+	decodeDXT(fourCC, buffer, width, height, 0, (height + 3) / 4, &image[0]);
+	size_t offset = (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+
+	for (unsigned int level = 0; level < header.levelCount; level++){
+		unsigned int gridX = header.tilesX >> level; if (gridX < 1) gridX = 1;
+		unsigned int gridY = header.tilesY >> level; if (gridY < 1) gridY = 1;
+
+		for (unsigned int ty = 0; ty < gridY; ty++){
+			for (unsigned int tx = 0; tx < gridX; tx++){
+				// Copy the tile plus its border, clamping at the image edges
+				for (int y = 0; y < VT_SLOT_SIZE; y++){
+					int sy = (int)(ty * VT_TILE_SIZE) + y - VT_TILE_BORDER;
+					sy = sy < 0 ? 0 : (sy >= (int)h ? (int)h - 1 : sy);
+					for (int x = 0; x < VT_SLOT_SIZE; x++){
+						int sx = (int)(tx * VT_TILE_SIZE) + x - VT_TILE_BORDER;
+						sx = sx < 0 ? 0 : (sx >= (int)w ? (int)w - 1 : sx);
+						memcpy(&tile[((size_t)y * VT_SLOT_SIZE + x) * 4], &image[((size_t)sy * w + sx) * 4], 4);
+					}
+				}
+				fwrite(&tile[0], 1, tile.size(), file);
+			}
+		}
+
+		if (level + 1 == header.levelCount)
+			break;
+
+		// Decode the next mipmap if the file holds it, past the last one the chain goes on to one tile with a box filter
+		unsigned int nextW = w > 1 ? w / 2 : 1;
+		unsigned int nextH = h > 1 ? h / 2 : 1;
+		size_t size = (size_t)((nextW + 3) / 4) * ((nextH + 3) / 4) * blockSize;
+		if (level + 1 < mipMapCount && offset + size <= bufsize){
+			image.resize((size_t)nextW * nextH * 4);
+			decodeDXT(fourCC, buffer + offset, nextW, nextH, 0, (nextH + 3) / 4, &image[0]);
+			offset += size;
+		}else{
+			mipMapCount = level + 1;	// A truncated mipmap ends the stored chain
+			downsample(image, w, h, next);
+			image.swap(next);
+		}
+		w = nextW;
+		h = nextH;
+	}
+
+	free(buffer);
+	fclose(file);
+	printf("Built virtual texture %s (%u x %u, %u levels)\n", vtexpath, width, height, header.levelCount);
+	return true;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Memory mapping and streaming
+// -------------------------------------------------------------------------------------------------
+
+static bool mapFile(VirtualTexture * vt, const char * path){
+#ifdef _WIN32
+	vt->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (vt->file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	GetFileSizeEx(vt->file, &size);
+	vt->mappedSize = (size_t)size.QuadPart;
+	vt->mapping = CreateFileMappingA(vt->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	vt->mapped = vt->mapping ? (const unsigned char *)MapViewOfFile(vt->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (vt->mapped == NULL){
+		if (vt->mapping) CloseHandle(vt->mapping);
+		CloseHandle(vt->file);
+		return false;
+	}
+#else
+	vt->file = open(path, O_RDONLY);
+	if (vt->file < 0)
+		return false;
+	struct stat st;
+	fstat(vt->file, &st);
+	vt->mappedSize = (size_t)st.st_size;
+	void * p = mmap(NULL, vt->mappedSize, PROT_READ, MAP_PRIVATE, vt->file, 0);
+	if (p == MAP_FAILED){
+		close(vt->file);
+		return false;
+	}
+	vt->mapped = (const unsigned char *)p;
+#endif
+	return true;
+}
+
+static void unmapFile(VirtualTexture * vt){
+#ifdef _WIN32
+	UnmapViewOfFile(vt->mapped);
+	CloseHandle(vt->mapping);
+	CloseHandle(vt->file);
+#else
+	munmap((void *)vt->mapped, vt->mappedSize);
+	close(vt->file);
+#endif
+}
+
+static const unsigned char * tileData(VirtualTexture * vt, unsigned int page){
+	return vt->mapped + vt->header.dataOffset + (size_t)page * VT_TILE_BYTES;
+}
+
+// Streaming thread: copy requested tiles out of the mapping (this is where the page faults land)
+static void streamTiles(VirtualTexture * vt){
+	PROFILE_THREAD("Tile streamer");
+	for (;;){
+		unsigned int page;
+		{
+			std::unique_lock<std::mutex> lock(vt->mutex);
+			vt->wake.wait(lock, [vt](){ return vt->quit || !vt->requests.empty(); });
+			if (vt->quit)
+				return;
+			page = vt->requests.front();
+			vt->requests.pop_front();
+		}
+
+		PROFILE_ZONE("Stream tile");
+		VTTile tile;
+		tile.page = page;
+		const unsigned char * src = tileData(vt, page);
+		tile.pixels.assign(src, src + VT_TILE_BYTES);
+
+		std::lock_guard<std::mutex> lock(vt->mutex);
+		vt->finished.push_back(std::move(tile));
+	}
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Page table
+// -------------------------------------------------------------------------------------------------
+
+static unsigned int levelWidth(const VirtualTexture * vt, unsigned int level){
+	unsigned int w = vt->header.tilesX >> level;
+	return w < 1 ? 1 : w;
+}
+
+static unsigned int levelHeight(const VirtualTexture * vt, unsigned int level){
+	unsigned int h = vt->header.tilesY >> level;
+	return h < 1 ? 1 : h;
+}
+
+static void uploadTile(VirtualTexture * vt, int slot, unsigned int page, const unsigned char * pixels){
+	int sx = slot % vt->slotsPerSide;
+	int sy = slot / vt->slotsPerSide;
+	glBindTexture(GL_TEXTURE_2D, vt->physical);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, sx * VT_SLOT_SIZE, sy * VT_SLOT_SIZE, VT_SLOT_SIZE, VT_SLOT_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	vt->slotPage[slot] = page;
+	vt->slotLastUsed[slot] = vt->frame;
+	vt->pageSlot[page] = slot;
+	vt->indirectionDirty = true;
+}
+
+// A free slot, or the least recently used one not needed this frame. The coarsest level is never evicted.
+static int allocateSlot(VirtualTexture * vt){
+	int best = -1;
+	unsigned int coarsest = vt->levelFirstPage[vt->header.levelCount - 1];
+	for (int slot = 0; slot < (int)vt->slotPage.size(); slot++){
+		unsigned int page = vt->slotPage[slot];
+		if (page == VT_NO_PAGE)
+			return slot;
+		if (page >= coarsest || vt->slotLastUsed[slot] == vt->frame)
+			continue;
+		if (best < 0 || vt->slotLastUsed[slot] < vt->slotLastUsed[best])
+			best = slot;
+	}
+	if (best >= 0)
+		vt->pageSlot[vt->slotPage[best]] = -1;
+	return best;
+}
+
+// Point every page at itself if resident, or at its closest resident ancestor
+static void refreshIndirection(VirtualTexture * vt){
+	for (int level = (int)vt->header.levelCount - 1; level >= 0; level--){
+		unsigned int gw = levelWidth(vt, level);
+		unsigned int gh = levelHeight(vt, level);
+		std::vector<unsigned char> & entries = vt->indirectionLevels[level];
+
+		for (unsigned int y = 0; y < gh; y++){
+			for (unsigned int x = 0; x < gw; x++){
+				unsigned char * e = &entries[(y * gw + x) * 4];
+				int slot = vt->pageSlot[vt->levelFirstPage[level] + y * gw + x];
+				if (slot >= 0){
+					e[0] = (unsigned char)(slot % vt->slotsPerSide);
+					e[1] = (unsigned char)(slot / vt->slotsPerSide);
+					e[2] = (unsigned char)level;
+					e[3] = 255;
+				}else{
+					unsigned int pw = levelWidth(vt, level + 1);
+					unsigned int px = x >> 1 < pw ? x >> 1 : pw - 1;
+					unsigned int py = y >> 1 < levelHeight(vt, level + 1) ? y >> 1 : levelHeight(vt, level + 1) - 1;
+					memcpy(e, &vt->indirectionLevels[level + 1][(py * pw + px) * 4], 4);
+				}
+			}
+		}
+
+		glBindTexture(GL_TEXTURE_2D, vt->indirection);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, gw, gh, GL_RGBA, GL_UNSIGNED_BYTE, &entries[0]);
+	}
+	vt->indirectionDirty = false;
+}
+
+
+
+// -------------------------------------------------------------------------------------------------
+// Public interface
+// -------------------------------------------------------------------------------------------------
+
+VirtualTexture * loadVirtualTexture(const char * vtexpath, int slotsPerSide, int feedbackWidth, int feedbackHeight){
+	VirtualTexture * vt = new VirtualTexture();
+	if (!mapFile(vt, vtexpath)){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", vtexpath);
+		delete vt;
+		return NULL;
+	}
+
+	// The grid must be the power of two one buildVirtualTexture writes, every size below is derived from it
+	bool compatible = vt->mappedSize >= sizeof(VTexHeader);
+	if (compatible)
+		memcpy(&vt->header, vt->mapped, sizeof(VTexHeader));
+	const VTexHeader & h = vt->header;
+	if (!compatible || memcmp(h.magic, "VTEX", 4) != 0 || h.tileSize != VT_TILE_SIZE || h.border != VT_TILE_BORDER ||
+		h.tilesX == 0 || (h.tilesX & (h.tilesX - 1)) != 0 || h.tilesY == 0 || (h.tilesY & (h.tilesY - 1)) != 0 ||
+		h.levelCount != levelCountFor(h.tilesX, h.tilesY)){
+		printf("%s is not a compatible virtual texture file\n", vtexpath);
+		unmapFile(vt);
+		delete vt;
+		return NULL;
+	}
+
+	size_t pageCount = 0;
+	for (unsigned int level = 0; level < vt->header.levelCount; level++)
+		pageCount += (size_t)levelWidth(vt, level) * levelHeight(vt, level);
+	if (vt->header.dataOffset > vt->mappedSize || pageCount > (vt->mappedSize - vt->header.dataOffset) / VT_TILE_BYTES){
+		printf("%s is truncated\n", vtexpath);
+		unmapFile(vt);
+		delete vt;
+		return NULL;
+	}
+
+	// The file holds every page, so the counts below fit the unsigned int page numbers
+	for (unsigned int level = 0, first = 0; level < vt->header.levelCount; level++){
+		vt->levelFirstPage.push_back(first);
+		vt->indirectionLevels.push_back(std::vector<unsigned char>((size_t)levelWidth(vt, level) * levelHeight(vt, level) * 4, 0));
+		first += levelWidth(vt, level) * levelHeight(vt, level);
+	}
+
+	vt->slotsPerSide = slotsPerSide;
+	vt->pageSlot.assign(pageCount, -1);
+	vt->pagePending.assign(pageCount, 0);
+	vt->pageSeenFrame.assign(pageCount, 0);
+	vt->slotPage.assign(slotsPerSide * slotsPerSide, VT_NO_PAGE);
+	vt->slotLastUsed.assign(slotsPerSide * slotsPerSide, 0);
+	vt->frame = 1;
+	vt->uploaded = 0;
+
+	// Physical tile cache, plain bilinear (the page table does the mip selection)
+	glGenTextures(1, &vt->physical);
+	glBindTexture(GL_TEXTURE_2D, vt->physical);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, slotsPerSide * VT_SLOT_SIZE, slotsPerSide * VT_SLOT_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// Indirection texture: one texel per page, one mip level per virtual texture level
+	glGenTextures(1, &vt->indirection);
+	glBindTexture(GL_TEXTURE_2D, vt->indirection);
+	for (unsigned int level = 0; level < vt->header.levelCount; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, levelWidth(vt, level), levelHeight(vt, level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, vt->header.levelCount - 1);
+
+	// The coarsest level is loaded up front and pinned, so every lookup has something to fall back to
+	unsigned int coarsest = vt->levelFirstPage[vt->header.levelCount - 1];
+	for (unsigned int page = coarsest; page < pageCount; page++)
+		uploadTile(vt, allocateSlot(vt), page, tileData(vt, page));
+	refreshIndirection(vt);
+
+	// Feedback target and its two readback buffers
+	vt->feedbackWidth  = feedbackWidth;
+	vt->feedbackHeight = feedbackHeight;
+	glGenTextures(1, &vt->feedbackColor);
+	glBindTexture(GL_TEXTURE_2D, vt->feedbackColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, feedbackWidth, feedbackHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glGenRenderbuffers(1, &vt->feedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, vt->feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+	glGenFramebuffers(1, &vt->feedbackFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, vt->feedbackFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, vt->feedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedbackDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("[WARNING] Virtual texture feedback framebuffer is incomplete.\n");
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, vt->readbackPBO);
+	for (int i = 0; i < 2; i++){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->readbackPBO[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, feedbackWidth * feedbackHeight * 4, NULL, GL_STREAM_READ);
+		vt->readbackFence[i] = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	vt->readbackIndex = 0;
+
+	vt->feedbackProgram  = LoadShaders("shaders/vtFeedbackVertex.glsl", "shaders/vtFeedbackFragment.glsl");
+	vt->feedbackMVPID    = glGetUniformLocation(vt->feedbackProgram, "MVP");
+	vt->feedbackSizeID   = glGetUniformLocation(vt->feedbackProgram, "VTSize");
+	vt->feedbackParamsID = glGetUniformLocation(vt->feedbackProgram, "VTParams");
+	vt->feedbackBiasID   = glGetUniformLocation(vt->feedbackProgram, "VTFeedbackBias");
+	glGenVertexArrays(1, &vt->feedbackVertexArray);
+
+	vt->quit = false;
+	vt->streamer = std::thread(streamTiles, vt);
+	return vt;
+}
+
+void deleteVirtualTexture(VirtualTexture * vt){
+	if (vt == NULL)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(vt->mutex);
+		vt->quit = true;
+	}
+	vt->wake.notify_all();
+	vt->streamer.join();
+
+	for (int i = 0; i < 2; i++)
+		if (vt->readbackFence[i])
+			glDeleteSync(vt->readbackFence[i]);
+	glDeleteBuffers(2, vt->readbackPBO);
+	glDeleteFramebuffers(1, &vt->feedbackFBO);
+	glDeleteRenderbuffers(1, &vt->feedbackDepth);
+	glDeleteTextures(1, &vt->feedbackColor);
+	glDeleteTextures(1, &vt->physical);
+	glDeleteTextures(1, &vt->indirection);
+	glDeleteProgram(vt->feedbackProgram);
+	glDeleteVertexArrays(1, &vt->feedbackVertexArray);
+
+	unmapFile(vt);
+	delete vt;
+}
+
+void addVirtualTextureFeedbackDraw(VirtualTexture * vt, GLuint vertexBuffer, GLsizei stride, size_t positionOffset, size_t uvOffset,
+	GLuint indexBuffer, GLuint firstIndex, GLsizei indexCount, GLint baseVertex, const glm::mat4 & MVP){
+	VTFeedbackDraw draw = { vertexBuffer, stride, positionOffset, uvOffset, indexBuffer, firstIndex, indexCount, baseVertex, MVP };
+	vt->draws.push_back(draw);
+}
+
+static void setLookupUniforms(VirtualTexture * vt, GLint sizeID, GLint paramsID){
+	glUniform2f(sizeID, (float)vt->header.width, (float)vt->header.height);
+	glUniform4f(paramsID, (float)VT_TILE_SIZE, (float)VT_TILE_BORDER, (float)VT_SLOT_SIZE, (float)(vt->header.levelCount - 1));
+}
+
+void renderVirtualTextureFeedback(VirtualTexture * vt){
+	GLint viewport[4];
+	GLfloat clearColor[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, vt->feedbackFBO);
+	glViewport(0, 0, vt->feedbackWidth, vt->feedbackHeight);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f); // Alpha 0 = no request
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// The smaller target has larger UV derivatives, bias the mip selection back to what the window would pick
+	glUseProgram(vt->feedbackProgram);
+	setLookupUniforms(vt, vt->feedbackSizeID, vt->feedbackParamsID);
+	glUniform1f(vt->feedbackBiasID, viewport[2] > 0 ? log2f((float)vt->feedbackWidth / (float)viewport[2]) : 0.0f);
+
+	glBindVertexArray(vt->feedbackVertexArray);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	for (size_t i = 0; i < vt->draws.size(); i++){
+		const VTFeedbackDraw & d = vt->draws[i];
+		glUniformMatrix4fv(vt->feedbackMVPID, 1, GL_FALSE, &d.MVP[0][0]);
+		glBindBuffer(GL_ARRAY_BUFFER, d.vertexBuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, d.stride, (const void *)d.positionOffset);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, d.stride, (const void *)d.uvOffset);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.indexBuffer);
+		glDrawElementsBaseVertex(GL_TRIANGLES, d.indexCount, GL_UNSIGNED_SHORT, (void *)(d.firstIndex * sizeof(unsigned short)), d.baseVertex);
+	}
+	vt->draws.clear();
+
+	// Start the readback now, it is only mapped on a later update so the pipeline doesn't stall
+	int i = vt->readbackIndex;
+	if (vt->readbackFence[i] == 0){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->readbackPBO[i]);
+		glReadPixels(0, 0, vt->feedbackWidth, vt->feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		vt->readbackFence[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		vt->readbackIndex = 1 - i;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+// Keep the closest resident ancestor of a missing page, the one refreshIndirection shows in its place, from eviction
+static void touchFallback(VirtualTexture * vt, unsigned int level, unsigned int x, unsigned int y){
+	for (level++; level < vt->header.levelCount; level++){
+		x = x >> 1 < levelWidth(vt, level) ? x >> 1 : levelWidth(vt, level) - 1;
+		y = y >> 1 < levelHeight(vt, level) ? y >> 1 : levelHeight(vt, level) - 1;
+		int slot = vt->pageSlot[vt->levelFirstPage[level] + y * levelWidth(vt, level) + x];
+		if (slot >= 0){
+			vt->slotLastUsed[slot] = vt->frame;
+			return;
+		}
+	}
+}
+
+// Turn one feedback image into tile requests / LRU touches
+static void processFeedback(VirtualTexture * vt, const unsigned char * pixels){
+	int requested = 0;
+	std::vector<unsigned int> newRequests;
+
+	for (int i = 0; i < vt->feedbackWidth * vt->feedbackHeight; i++, pixels += 4){
+		if (pixels[3] == 0)
+			continue;
+		unsigned int level = pixels[2];
+		if (level >= vt->header.levelCount || pixels[0] >= levelWidth(vt, level) || pixels[1] >= levelHeight(vt, level))
+			continue;
+		unsigned int page = vt->levelFirstPage[level] + pixels[1] * levelWidth(vt, level) + pixels[0];
+		if (vt->pageSeenFrame[page] == vt->frame)
+			continue;
+		vt->pageSeenFrame[page] = vt->frame;
+
+		int slot = vt->pageSlot[page];
+		if (slot >= 0){
+			vt->slotLastUsed[slot] = vt->frame;
+			continue;
+		}
+		touchFallback(vt, level, pixels[0], pixels[1]);
+		if (!vt->pagePending[page] && requested < VT_MAX_REQUESTS){
+			vt->pagePending[page] = 1;
+			newRequests.push_back(page);
+			requested++;
+		}
+	}
+
+	if (!newRequests.empty()){
+		{
+			std::lock_guard<std::mutex> lock(vt->mutex);
+			vt->requests.insert(vt->requests.end(), newRequests.begin(), newRequests.end());
+		}
+		vt->wake.notify_one();
+	}
+}
+
+void updateVirtualTexture(VirtualTexture * vt){
+	vt->frame++;
+	vt->uploaded = 0;
+
+	// Consume the oldest readback if the GPU is done with it
+	int i = vt->readbackIndex;
+	if (vt->readbackFence[i]){
+		GLenum status = glClientWaitSync(vt->readbackFence[i], 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+			glDeleteSync(vt->readbackFence[i]);
+			vt->readbackFence[i] = 0;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->readbackPBO[i]);
+			const unsigned char * pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, vt->feedbackWidth * vt->feedbackHeight * 4, GL_MAP_READ_BIT);
+			if (pixels){
+				processFeedback(vt, pixels);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+	}
+
+	// Upload what the streaming thread has finished, a bounded number per frame
+	std::deque<VTTile> ready;
+	{
+		std::lock_guard<std::mutex> lock(vt->mutex);
+		while (!vt->finished.empty() && (int)ready.size() < VT_MAX_UPLOADS){
+			ready.push_back(std::move(vt->finished.front()));
+			vt->finished.pop_front();
+		}
+	}
+	for (size_t t = 0; t < ready.size(); t++){
+		vt->pagePending[ready[t].page] = 0;
+		int slot = allocateSlot(vt);
+		if (slot < 0)
+			continue; // Cache full of tiles still in use, it'll be requested again
+		uploadTile(vt, slot, ready[t].page, &ready[t].pixels[0]);
+		vt->uploaded++;
+	}
+
+	if (vt->indirectionDirty)
+		refreshIndirection(vt);
+}
+
+void bindVirtualTexture(VirtualTexture * vt, GLuint program, int physicalUnit, int indirectionUnit){
+	cachedBindTexture(physicalUnit, GL_TEXTURE_2D, vt->physical);
+	cachedBindTexture(indirectionUnit, GL_TEXTURE_2D, vt->indirection);
+
+	// Through the state cache: these are the same every frame
+	cachedUniform1i(glGetUniformLocation(program, "VTPhysical"), physicalUnit);
+	cachedUniform1i(glGetUniformLocation(program, "VTIndirection"), indirectionUnit);
+	cachedUniform2f(glGetUniformLocation(program, "VTSize"), (float)vt->header.width, (float)vt->header.height);
+	cachedUniform4f(glGetUniformLocation(program, "VTParams"), (float)VT_TILE_SIZE, (float)VT_TILE_BORDER, (float)VT_SLOT_SIZE, (float)(vt->header.levelCount - 1));
+	cachedUniform1f(glGetUniformLocation(program, "VTPhysicalSize"), (float)(vt->slotsPerSide * VT_SLOT_SIZE));
+}
+
+void getVirtualTextureStats(VirtualTexture * vt, int & resident, int & pending, int & uploaded){
+	resident = 0;
+	for (size_t s = 0; s < vt->slotPage.size(); s++)
+		if (vt->slotPage[s] != VT_NO_PAGE)
+			resident++;
+	pending = 0;
+	for (size_t p = 0; p < vt->pagePending.size(); p++)
+		pending += vt->pagePending[p];
+	uploaded = vt->uploaded;
+}
@@ -0,0 +1,43 @@
+#ifndef VIRTUALTEXTURE_HPP
+#define VIRTUALTEXTURE_HPP
+
+// Virtual texturing: only the 128x128 tiles the camera actually sees are kept in GPU memory.
+// - buildVirtualTexture() converts a .DDS into a tiled .vtex file (RGBA8 tiles with a 1 texel border, full mip chain)
+// - Each frame a low resolution feedback pass writes the tile every pixel needs, it's read back a frame later
+// - Missing tiles are copied out of the memory mapped .vtex file on a streaming thread and uploaded into a
+//   physical tile cache (LRU), and the indirection texture is pointed at the best resident tile
+// - Fragment shaders sample through virtualTexture() (the VIRTUAL_TEXTURE permutation of shaders/fragment.glsl)
+
+#define VT_TILE_SIZE	128	// Texels per tile side, without the border
+#define VT_TILE_BORDER	1	// Border texels on each side so bilinear filtering never reads a neighbouring slot
+
+struct VirtualTexture;
+
+// Convert a .DDS file into a tiled .vtex file. Returns false if the DDS can't be read or the file can't be written.
+bool buildVirtualTexture(const char * ddspath, const char * vtexpath);
+
+// True if vtexpath is missing or older than ddspath, ie. it must be (re)built before loading it
+bool isVirtualTextureOutdated(const char * ddspath, const char * vtexpath);
+
+// Map a .vtex file and create its GPU resources. slotsPerSide^2 tiles stay resident at most.
+// The feedback pass renders at feedbackWidth x feedbackHeight (a fraction of the window is plenty).
+VirtualTexture * loadVirtualTexture(const char * vtexpath, int slotsPerSide, int feedbackWidth, int feedbackHeight);
+void deleteVirtualTexture(VirtualTexture * vt);
+
+// Feedback pass: queue a draw (float positions and UVs at the given offsets of a vertex buffer, stride 0 if tightly
+// packed, and 16 bit indices) during the frame, then render all queued draws into the feedback buffer with renderVirtualTextureFeedback().
+void addVirtualTextureFeedbackDraw(VirtualTexture * vt, GLuint vertexBuffer, GLsizei stride, size_t positionOffset, size_t uvOffset,
+	GLuint indexBuffer, GLuint firstIndex, GLsizei indexCount, GLint baseVertex, const glm::mat4 & MVP);
+void renderVirtualTextureFeedback(VirtualTexture * vt);
+
+// Read last frame's feedback, request missing tiles, upload finished ones and refresh the indirection texture
+void updateVirtualTexture(VirtualTexture * vt);
+
+// Bind the physical cache and the indirection texture and set the virtualTexture() uniforms of program
+// (through the GL state cache, program must be bound with cachedUseProgram)
+void bindVirtualTexture(VirtualTexture * vt, GLuint program, int physicalUnit, int indirectionUnit);
+
+// Resident tiles, tiles waiting to be streamed in, and tiles uploaded by the last update
+void getVirtualTextureStats(VirtualTexture * vt, int & resident, int & pending, int & uploaded);
+
+#endif
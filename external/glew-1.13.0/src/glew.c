@@ -166,6 +166,21 @@ void* NSGLGetProcAddress (const GLubyte *name)
 #endif /* MAC_OS_X_VERSION_10_3 */
 #endif /* __APPLE__ */
 
+#if defined(GLEW_EGL) && !defined(_WIN32) && !defined(__APPLE__)
+#include <EGL/egl.h>
+
+/*
+ * GLEW_EGL: contexts made current through EGL (e.g. surfaceless ones, with no
+ * X server) are resolved with eglGetProcAddress, GLX ones as usual. Link libEGL.
+ */
+static void* eglewGetProcAddress (const GLubyte* name)
+{
+  if (eglGetCurrentContext() != EGL_NO_CONTEXT)
+    return (void*)eglGetProcAddress((const char*)name);
+  return (void*)(*glXGetProcAddressARB)(name);
+}
+#endif
+
 /*
  * Define glewGetProcAddress.
  */
@@ -181,6 +196,8 @@ void* NSGLGetProcAddress (const GLubyte *name)
 #  define glewGetProcAddress(name) NULL /* TODO */
 #elif defined(__native_client__)
 #  define glewGetProcAddress(name) NULL /* TODO */
+#elif defined(GLEW_EGL) && !defined(__APPLE__)
+#  define glewGetProcAddress(name) eglewGetProcAddress(name)
 #else /* __linux */
 #  define glewGetProcAddress(name) (*glXGetProcAddressARB)(name)
 #endif
@@ -13419,6 +13436,10 @@ GLenum GLEWAPIENTRY glewInit (void)
 #if defined(_WIN32)
   return wglewInit();
 #elif !defined(__ANDROID__) && !defined(__native_client__) && !defined(__HAIKU__) && (!defined(__APPLE__) || defined(GLEW_APPLE_GLX)) /* _UNIX */
+#if defined(GLEW_EGL) && !defined(__APPLE__)
+  if (eglGetCurrentContext() != EGL_NO_CONTEXT)
+    return r; /* No GLX display behind an EGL context */
+#endif
   return glxewInit();
 #else
   return r;
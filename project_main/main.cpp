@@ -18,14 +18,40 @@
 *
 * - The logos are rotated, scaled, and translated
 *
-* - The AoL man moves in a bezier spline
+* - The AoL man moves along a bezier spline at constant speed
 *
 * - Adapts some code from CSCI 3090U Labs and Lectures
 *
 * - Adapts some methods and uses several small external libraries from http://www.opengl-tutorial.org/beginners-tutorials/ 
 *	- AntTweakBar			// External library to create a transparent debug window on top to display variable values 
-*	- shader.hpp			// Shader
+*	- shader.hpp			// Shader (permutations compiled in parallel, persistent program binary cache in shadercache/)
 *	- texture.hpp			// Texturer
+*	- imageloader.hpp		// QOI/PNG image loader (multithreaded decode into a pixel unpack buffer)
+*	- dxtdecoder.hpp		// Software DXT1/3/5 decoder, used by loadDDS when the driver can't upload S3TC
+*	- virtualtexture.hpp	// Virtual texturing: feedback pass, tile streaming from a mapped file, LRU tile cache
+*	- uniformbuffer.hpp		// Uniform buffer objects: per-frame block and per-object array indexed by draw ID
+*	- instancebuffer.hpp	// Instanced rendering: per-instance transforms and animation parameters
+*	- geometryarena.hpp		// Every mesh in one shared vertex/index buffer pair, drawn together with multi-draw indirect
+*	- renderqueue.hpp		// Render queue: draws sorted by 64 bit keys (pass, shader, material, mesh, depth)
+*	- glstate.hpp			// GL state cache: skips binds and uniform uploads that match the current state
+*	- culling.hpp			// Frustum culling: mesh bounds, 4-wide BVH refit on movement, SSE plane tests
+*	- occlusion.hpp			// Occlusion culling: occluders rasterized on the CPU into a tiled depth buffer, Hi-Z box tests
+*	- jobsystem.hpp			// Job system: work-stealing worker threads, parent/child jobs, parallel-for (GL stays on the main thread)
+*	- simulation.hpp		// Fixed timestep simulation thread, double buffered snapshots interpolated by the renderer
+*	- scenegraph.hpp		// Scene graph: parent/child nodes, TRS local transforms, dirty subtrees, contiguous world matrices
+*	- transforms.hpp		// Structure-of-arrays transforms composed into world and MVP matrices with SSE2/AVX2
+*	- splinepath.hpp		// Bezier/Catmull-Rom spline paths: arc-length tables, constant speed followers placed in SIMD batches
+*	- fbxloader.hpp			// Binary FBX reader: node tree, compressed arrays, objects, connections and Properties70 values
+*	- animationclip.hpp		// Keyframe animation clips: key reduction, 8 byte quantized keys, batched sampling, FBX import
+*	- skinning.hpp			// Skeletal skinning: joint hierarchy poses, SIMD linear blend and dual quaternion kernels into mapped vertex buffers
+*	- ecs.hpp				// Entity-component storage: archetype chunks of packed components, animation systems run in parallel
+*	- framepacing.hpp		// Frame pacing: frame limiter (sleep then spin), adaptive vsync, input latency and frame time variance
+*	- headless.hpp			// Headless rendering: surfaceless EGL context drawing into a framebuffer object, no window or X server
+*	- framecapture.hpp		// Frame capture: fenced pixel pack buffer ring, encoder thread pool writing PNG/QOI/Y4M
+*	- imageencoder.hpp		// PNG, QOI and Y4M encoders for captured frames
+*	- benchmark.hpp			// Benchmark runs: scripted camera spline, CPU and GPU frame time percentiles and histograms as JSON
+*	- profiler.hpp			// Scoped CPU zones in per-thread rings, GL timestamp query zones, Chrome trace export
+*	- timer.hpp				// Steady clock that works without a window (GLFW's timer needs a display)
 *	- controls.hpp			// User controls camera: mouse to control camera lookAt, arrow keys to control camera position
 *	- objloader.hpp			// OBJ Loader, works with Blender exported models (CSCI 3090U provided objloader did not correctly load Blender exported OBJs)
 *	- vboindexer.hpp		// Vertex Buffer Object Indexer (indexes for OBJ)
@@ -42,6 +68,28 @@
 * - Run the program application (.exe) or compile using the NMake files. Alternatively, use CMake or open the solution in Visual Studio and run (Debug)
 * 
 * - Watch the program interact with objects using multiple effects, then press ESC to exit the program.
+*
+* - Headless (no window, no X server, built with HEADLESS_EGL and GLEW_EGL): --headless [--frames N] [--resolution WIDTHxHEIGHT]
+*	renders N frames offscreen and prints the frames per second.
+*
+* - Recording: --output DIRECTORY [--format png|qoi|y4m] writes every frame there (frame_00001.png, ... or frames.y4m),
+*	with a window or headless. Readback and encoding run behind the renderer.
+*
+* - Benchmark: --benchmark [--warmup N] [--frames N] [--instances N] [--report PATH], with a window or headless:
+*	one simulation tick per frame, the camera flies a fixed path, nothing waits for vsync. After N warm-up frames,
+*	the measured frames' CPU, GPU and submit times and draw counts are written to PATH (benchmark.json) as JSON.
+*
+* - Skinned characters: --characters N puts N bending copies of ../aol/mail.fbx on the ground in front of the scene, skinned on
+*	the CPU (job system, SIMD) straight into a mapped vertex buffer every frame. Combines with any of the above.
+*
+* - Virtual texture: --virtual-texture streams the logos' diffuse map in 128x128 tiles from Logo_Diffuse_Map.vtex, built
+*	from Logo_Diffuse_Map.DDS on the first run and again whenever the DDS is newer. Combines with any of the above.
+*
+* - Profile (built with PROFILER): --profile PATH writes a trace of the whole run to PATH when it exits,
+*	open it in chrome://tracing or ui.perfetto.dev. Combines with any of the above.
+*
+* - Self-test: --self-test runs every module's benchmark and check once after initialization, printed as [DEBUG] lines,
+*	then runs as usual. Add --headless --frames 1 for the tests alone.
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
 
@@ -49,12 +97,13 @@
 #define _USE_MATH_DEFINES	// For Pi (radian <-> degree conversions)
 #include <stdio.h>			// Standard
 #include <stdlib.h>			// Standard
+#include <stddef.h>			// offsetof
 #include <vector>			// Vectors
 #include <string>			// String input/output
 #include <iostream>			// Input/output stream
 #include <fstream>			// File stream
 #include <cmath>			// Math functions
-#include <wtypes.h>			// Get screen resolution to create fullscreen application
+#include <cstring>			// Command line options
 
 // Glew
 #include <GL/glew.h>
@@ -74,8 +123,34 @@ using namespace glm;
 
 // External Libraries
 #include <AntTweakBar.h>				// Tweak parameters on the go UI window
-#include <common/shader.hpp>			// Shader
+#include <common/shader.hpp>			// Shader (permutations compiled in parallel, persistent program binary cache in shadercache/)
 #include <common/texture.hpp>			// Texturer
+#include <common/imageloader.hpp>		// QOI/PNG image loader (multithreaded decode into a pixel unpack buffer)
+#include <common/dxtdecoder.hpp>		// Software DXT1/3/5 decoder, used by loadDDS when the driver can't upload S3TC
+#include <common/virtualtexture.hpp>	// Virtual texturing: feedback pass, tile streaming from a mapped file, LRU tile cache
+#include <common/uniformbuffer.hpp>		// Uniform buffer objects: per-frame block and per-object array indexed by draw ID
+#include <common/instancebuffer.hpp>	// Instanced rendering: per-instance transforms and animation parameters
+#include <common/geometryarena.hpp>		// Every mesh in one shared vertex/index buffer pair, drawn together with multi-draw indirect
+#include <common/renderqueue.hpp>		// Render queue: draws sorted by 64 bit keys (pass, shader, material, mesh, depth)
+#include <common/glstate.hpp>			// GL state cache: skips binds and uniform uploads that match the current state
+#include <common/culling.hpp>			// Frustum culling: mesh bounds, 4-wide BVH refit on movement, SSE plane tests
+#include <common/occlusion.hpp>			// Occlusion culling: occluders rasterized on the CPU into a tiled depth buffer, Hi-Z box tests
+#include <common/jobsystem.hpp>			// Job system: work-stealing worker threads, parent/child jobs, parallel-for (GL stays on the main thread)
+#include <common/simulation.hpp>		// Fixed timestep simulation thread, double buffered snapshots interpolated by the renderer
+#include <common/scenegraph.hpp>		// Scene graph: parent/child nodes, TRS local transforms, dirty subtrees, contiguous world matrices
+#include <common/transforms.hpp>		// Structure-of-arrays transforms composed into world and MVP matrices with SSE2/AVX2
+#include <common/splinepath.hpp>		// Bezier/Catmull-Rom spline paths: arc-length tables, constant speed followers placed in SIMD batches
+#include <common/fbxloader.hpp>			// Binary FBX reader: node tree, compressed arrays, objects, connections and Properties70 values
+#include <common/animationclip.hpp>		// Keyframe animation clips: key reduction, 8 byte quantized keys, batched sampling, FBX import
+#include <common/skinning.hpp>			// Skeletal skinning: joint hierarchy poses, SIMD linear blend and dual quaternion kernels into mapped vertex buffers
+#include <common/ecs.hpp>				// Entity-component storage: archetype chunks of packed components, animation systems run in parallel
+#include <common/framepacing.hpp>		// Frame pacing: frame limiter (sleep then spin), adaptive vsync, input latency and frame time variance
+#include <common/headless.hpp>			// Headless rendering: surfaceless EGL context drawing into a framebuffer object, no window or X server
+#include <common/framecapture.hpp>		// Frame capture: fenced pixel pack buffer ring, encoder thread pool writing PNG/QOI/Y4M
+#include <common/imageencoder.hpp>		// PNG, QOI and Y4M encoders for captured frames
+#include <common/benchmark.hpp>			// Benchmark runs: scripted camera spline, CPU and GPU frame time percentiles and histograms as JSON
+#include <common/profiler.hpp>			// Scoped CPU zones in per-thread rings, GL timestamp query zones, Chrome trace export
+#include <common/timer.hpp>				// Steady clock that works without a window (GLFW's timer needs a display)
 #include <common/controls.hpp>			// User controls camera: mouse to control camera lookAt, arrow keys to control camera position
 #include <common/objloader.hpp>			// OBJ Loader, works with Blender exported models
 #include <common/vboindexer.hpp>		// Vertex Buffer Object Indexer (indexes for OBJ)
@@ -95,12 +170,45 @@ int SCREEN_WIDTH	= 1024;
 int SCREEN_HEIGHT	= 768;
 
 bool DEBUG			= true;		// Print debug diagnostic messages in the console for testing
+bool SELF_TEST		= false;	// Run every module's benchmark and check (selfTests) once before the first frame (--self-test)
+
+bool HEADLESS		= false;	// Render offscreen without a window (--headless), for machines without a display or a GPU
+int HEADLESS_FRAMES	= 300;		// Frames rendered before a headless run exits, measured frames of a benchmark (--frames N)
+
+bool BENCHMARK		= false;	// Deterministic benchmark run (--benchmark): fixed tick per frame, scripted camera, no frame limit
+int BENCHMARK_WARMUP = 60;		// Frames run before the measured ones (--warmup N)
+const char* BENCHMARK_REPORT = "benchmark.json";	// JSON report of the measured frames (--report PATH)
+
+const char* PROFILE_TRACE = NULL;	// Chrome trace of the run is written there (--profile PATH, PROFILER builds only), NULL = not profiled
+
+const char* OUTPUT_DIRECTORY = NULL;	// Every frame is captured there (--output DIRECTORY), NULL = no capture
+int CAPTURE_FORMAT	= CAPTURE_PNG;	// CAPTURE_PNG, CAPTURE_QOI, or CAPTURE_Y4M (--format png|qoi|y4m)
+int CAPTURE_ENCODERS = 0;		// Encoder threads of the capture (0 = one per core)
+
+double TARGET_FPS	= 60.0;		// Frame limiter, frames per second (0 = as fast as the buffer swap allows)
+int VSYNC			= VSYNC_ADAPTIVE;	// VSYNC_OFF, VSYNC_ON, or VSYNC_ADAPTIVE (tears instead of waiting a whole refresh when a frame is late)
+bool CAMERA_CONTROLS = false;	// Mouse and arrow keys move the camera (controls.hpp), otherwise it stays fixed on the scene
+
+int JOB_THREADS		= 0;		// Threads of the job system, including the main thread (0 = one per core)
+
+bool VIRTUAL_TEXTURE = false;	// Stream the logos' diffuse map (Logo_Diffuse_Map.DDS) in tiles through a virtual texture cache (--virtual-texture)
+
+bool LOGO_DETAIL_MAPS = false;	// Normal and specular maps on the logos (they get their own NORMAL_MAP | SPECULAR_MAP shader variant)
+
+int LOGO_INSTANCES	= 0;		// Animated logos on a wall behind the scene, all drawn by one instanced draw call (ie. 100000, --instances N)
+
+int SKINNED_CHARACTERS = 0;		// Bending characters (../aol/mail.fbx) on the ground in front of the scene, skinned on the CPU every frame (--characters N)
+
+bool OCCLUSION_CULLING = true;	// Skip the instanced logos hidden behind the scene's logos and man (tested on the CPU before drawing)
 
 double magnitude	= 1.0f;		// Magnitude of how fast the Logos rotate, scale, and translate
 
+double SIMULATION_HZ = 60.0;	// Simulation ticks per second, the animation steps the same way whatever the frame rate
+
 float LIGHT_X		= 2.5f;		// Light position (X, Y, Z)
 float LIGHT_Y		= 2.5f;
 float LIGHT_Z		= 4.0f;
+float LIGHT_POWER	= 50.0f;	// Light power (compiled into the shaders)
 
 GLclampf BG_RED		= 0.00f;	// Background Colour - Red, Green, Blue (0.00 to 1.00)
 GLclampf BG_GREEN	= 0.25f;
@@ -113,33 +221,62 @@ GLclampf BG_BLUE	= 0.50f;
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
 GLFWwindow* window;
-GLuint programId;
 
-// OBJ vertex buffer objects and textures for Object 1: AoL Logo
-GLuint positions_vbo1;
-GLuint textureCoords_vbo1;
-GLuint normals_vbo1;
-GLuint indexBuffer1;
+// Shader variants: every object draws with the cheapest program that has the features it needs
+GLuint logoProgram;
+GLuint logoInstancedProgram;
+GLuint manProgram;
+int shaderPrograms = 0;
+
+// Uniform buffers: camera and light once per frame, the transforms of every draw in one upload
+UniformBuffers* uniformBuffers = NULL;
+
+// Draws recorded by drawLogo/drawMan into the render queue, sorted and submitted by submitDraws
+enum { QUEUE_SHADER_LOGO, QUEUE_SHADER_MAN };	// Shader field of the sort keys, index of queuePrograms
+GLuint queuePrograms[2];
+RenderQueue* renderQueue = NULL;
+vector<ObjectUniforms> queuedObjects;		// Transforms of the recorded draws, the packets' payload indexes them
+vector<ArenaDrawCommand> arenaCommands;		// Command buffer of one multi-draw, rebuilt by submitDraws
+int queuedMesh = 0;							// Mesh of the packet being executed (1 = AoL Logo, 2 = AoL Man)
+float submitMilliseconds = 0.0f;	// CPU time to record and submit the frame's draws
+int drawCalls = 0;					// GL draw calls of the frame's scene draws
+int stateChanges = 0;				// Shader and material binds of the frame's scene draws
+float sortMilliseconds = 0.0f;		// Render queue sort time
+int elidedGLCalls = 0;				// GL calls of the frame the state cache skipped
+int issuedGLCalls = 0;				// GL calls of the frame that went through the state cache to GL
+
+// Frustum culling: every instanced logo (objects 0 to LOGO_INSTANCES - 1) and every queued draw is a box in the BVH
+CullingBVH* cullingBVH = NULL;
+vector<RenderPacket> pendingPackets;		// Draws recorded this frame, submitted to the render queue if visible
+vector<int> sceneCullingObjects;			// Culling object of each recorded draw, in recording order
+vector<int> visibleObjects;
+vector<unsigned char> objectVisible;
+int visibleObjectCount = 0;
+int culledObjectCount = 0;
+float cullMilliseconds = 0.0f;
+
+// Occlusion culling: the visible scene draws are rasterized as occluders, the instanced logos are tested against them
+OcclusionBuffer* occlusionBuffer = NULL;	// NULL when OCCLUSION_CULLING is off or there are no instances
+vector<glm::vec3> logoOccluder;				// Largest triangles of each mesh
+vector<glm::vec3> manOccluder;
+vector<BoundingBox> logoInstanceBounds;		// World box of each instanced logo (culling objects 0 to LOGO_INSTANCES - 1)
+int occludedObjectCount = 0;
+float occlusionMilliseconds = 0.0f;
+
+// Shared vertex and index buffers holding every OBJ mesh
+GeometryArena* geometryArena = NULL;
+
+// Arena mesh, bounds and textures for Object 1: AoL Logo
+ArenaMesh logoMesh;
+BoundingBox logoBounds;
+BoundingSphere logoSphere;
 GLuint texture1;
-GLuint textureId1;
-vector<unsigned short> indices1;
-
-// OBJ vertex buffer objects and textures for Object 2: AoL Man
-GLuint positions_vbo2;
-GLuint textureCoords_vbo2;
-GLuint normals_vbo2;
-GLuint indexBuffer2;
-GLuint texture2;
-GLuint textureId2;
-vector<unsigned short> indices2;
 
-// Render IDs and handles
-GLuint MatrixID;
-GLuint ViewMatrixID;
-GLuint ModelMatrixID;
-GLuint vertexPosition_modelspaceID;
-GLuint vertexUVID;
-GLuint vertexNormal_modelspaceID;
+// Arena mesh, bounds and textures for Object 2: AoL Man
+ArenaMesh manMesh;
+BoundingBox manBounds;
+BoundingSphere manSphere;
+GLuint texture2;
 
 // Perspective projection
 glm::mat4 projectionMatrix;
@@ -147,8 +284,10 @@ glm::mat4 projectionMatrix;
 // Orient everything around our preferred view
 glm::mat4 viewMatrix;
 
+// projectionMatrix * viewMatrix, once per frame rather than once per draw
+glm::mat4 viewProjectionMatrix;
+
 // Light
-GLuint LightID;
 glm::vec3 lightPos;
 
 // Time (for loop, update)
@@ -156,29 +295,98 @@ double lastTime;
 double lastFrameTime;
 double currentTime;
 double deltaTime;
-double elapsedFrames;
 
-// Rotation, scaling, translation variables to modify in realtime
+// Rotation, scaling, translation variables to modify in realtime (the newest snapshot's values)
 float rotationAngleDegree = 0.0f;
-float rotationX = 0.0f;
 float scalingValue = 0.0f;
 float translationValue = 0.0f;
 
-// Rotation for man model
-float rotationZ = 0.0f;
-
-// Normal mapping
+// Simulation: the scene's logos and man are animated at a fixed tick on their own thread, drawn blended between two snapshots
+#define SCENE_OBJECTS 5
+struct SceneObject {
+	int mesh;					// 1 = AoL Logo, 2 = AoL Man
+	glm::vec3 position;
+	unsigned int animations;	// Animation components of its entity (COMPONENT_SPIN, COMPONENT_PULSE_SCALE, ...)
+};
+const SceneObject sceneObjects[SCENE_OBJECTS] = {
+	{ 1, glm::vec3(-1.0f, 1.0f, 0.0f), 0 },									// [static]		logo in top left
+	{ 1, glm::vec3(2.0f, 1.0f, 0.0f), COMPONENT_SPIN },						// [rotating]	logo in top right
+	{ 1, glm::vec3(-1.0f, -2.0f, 0.0f), COMPONENT_PULSE_SCALE },			// [scaling]		logo in bottom left
+	{ 1, glm::vec3(2.0f, -2.0f, 0.0f), COMPONENT_OSCILLATE_TRANSLATE },		// [translating] logo in bottom right
+	{ 2, glm::vec3(-3.0f, -2.0f, 0.2f), COMPONENT_SPIN | COMPONENT_PATH_FOLLOW },	// [rotating] and [translating] man in bottom right
+};
+
+// Entities of the scene objects, each with its own animation state; only the simulation thread touches them once it runs
+EntityWorld* sceneEntities = NULL;
+int sceneEntityIds[SCENE_OBJECTS];
+struct SceneSnapshot {
+	SimulationTransform objects[SCENE_OBJECTS];
+	float rotationAngleDegree;	// Tweak bar values
+	float scalingValue;
+	float translationValue;
+	double time;				// Simulation time (seconds), animates the instanced logos too
+};
+Simulation* sceneSimulation = NULL;
+int simulationTicks = 0;
+int droppedTicks = 0;
+float tickMilliseconds = 0.0f;
+
+// Scene graph: one root with a node per scene object; only the nodes the simulation moved get a new world matrix
+SceneGraph* sceneGraph = NULL;
+int sceneRootNode = -1;
+int sceneNodes[SCENE_OBJECTS];
+int updatedSceneNodes = 0;
+
+// Frame pacing: the main loop waits for each frame's start, the camera is latched right before the draws are recorded
+FramePacer* framePacer = NULL;
+FramePacingStats framePacing;
+
+// Headless rendering: offscreen context and framebuffer (NULL with a window), and the frames rendered so far
+HeadlessContext* headlessContext = NULL;
+int renderedFrames = 0;
+
+// Frame capture (NULL without OUTPUT_DIRECTORY): frames are read back a few frames late and encoded on other threads
+FrameCapture* frameCapture = NULL;
+FrameCaptureStats frameCaptureStats;
+
+// Benchmark run (NULL unless BENCHMARK), and the camera path it flies once over the warm-up and measured frames
+Benchmark* benchmark = NULL;
+const CameraKey benchmarkCameraPath[] = {
+	{ glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, 0.0f) },		// The default view
+	{ glm::vec3(6.0f, 2.0f, 7.0f), glm::vec3(0.0f, -0.5f, 0.0f) },		// Round the right of the scene
+	{ glm::vec3(2.0f, 5.0f, 4.0f), glm::vec3(0.0f, -1.0f, -2.0f) },		// Above, close up
+	{ glm::vec3(0.0f, 1.0f, 14.0f), glm::vec3(0.0f, 0.0f, -30.0f) },	// Back out, looking through the scene at the instanced wall
+	{ glm::vec3(-6.0f, -1.0f, 7.0f), glm::vec3(0.0f, 0.0f, 0.0f) },		// Round the left
+};
+
+// Per-instance buffer of the instanced logos (LOGO_INSTANCES of them), and of the ones left after culling
+GLuint logoInstanceBuffer;
+GLuint visibleInstanceBuffer;
+vector<InstanceData> logoInstances;
+vector<InstanceData> visibleInstances;
+int visibleLogoInstances = 0;
+
+// Skinned characters (SKINNED_CHARACTERS of them, NULL if none): skinned into a mapped vertex buffer, drawn with the man's program
+SkinnedCrowd* skinnedCrowd = NULL;
+vector<glm::mat4> characterModels;
+float skinningMilliseconds = 0.0f;
+
+// Normal and specular mapping
 GLuint normalTexture;
-GLuint normalTextureId;
+GLuint specularTexture;
+
+// Virtual texture for the logos' diffuse map (NULL when VIRTUAL_TEXTURE is off)
+VirtualTexture* logoVirtualTexture = NULL;
+int vtResidentTiles = 0;
+int vtPendingTiles = 0;
+int vtUploadedTiles = 0;
 
-// Bezier curve control points (for AoL man travel curve)
+// Bezier curve control points (for AoL man travel curve), and the path made of them
 glm::vec3 controlPoint1(-2.00f, -1.50f, 2.00f);
 glm::vec3 controlPoint2(2.50f, 2.50f, -0.50f);
 glm::vec3 controlPoint3(-1.00f, 1.00f, -2.50f);
 glm::vec3 controlPoint4(2.00f, -2.50f, -0.50f);
-float manX = 0.0f;
-float manY = 0.0f; 
-float manZ = 0.0f;
+SplinePath* manPath = NULL;
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
 /*
@@ -189,19 +397,92 @@ float manZ = 0.0f;
 // Get the user's screen resolution to allow fullscreen option
 void getScreenResolution(int& width, int& height)
 {
-	RECT screen;
-	HWND handle = GetDesktopWindow();	// Get handle of destop window
-	GetWindowRect(handle, &screen);		// Get screen
-	width = screen.right;				// Adjust width
-	height = screen.bottom;				// Adjust height
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());	// Current mode of the main monitor
+	if (mode == NULL)
+		return;
+	width = mode->width;				// Adjust width
+	height = mode->height;				// Adjust height
 }
 
-// Move the AoL Man in a bezier curve path over input of time (t = 0 to 1)
-void moveBezierPath(float t)
+// Read the command line options (see HOW TO RUN), false if one isn't recognized
+bool parseCommandLine(int argc, char* argv[])
 {
-	manX = pow(1 - t, 3) * controlPoint1.x + pow(1 - t, 2) * 3 * t * controlPoint2.x + (1 - t) * pow(3 * t, 2) * controlPoint3.x + pow(t, 3) * controlPoint4.x;
-	manY = pow(1 - t, 3) * controlPoint1.y + pow(1 - t, 2) * 3 * t * controlPoint2.y + (1 - t) * pow(3 * t, 2) * controlPoint3.y + pow(t, 3) * controlPoint4.y;
-	manZ = pow(1 - t, 3) * controlPoint1.z + pow(1 - t, 2) * 3 * t * controlPoint2.z + (1 - t) * pow(3 * t, 2) * controlPoint3.z + pow(t, 3) * controlPoint4.z;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			HEADLESS = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			HEADLESS_FRAMES = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &SCREEN_WIDTH, &SCREEN_HEIGHT) != 2)
+				return false;
+		} else if (strcmp(argv[i], "--benchmark") == 0) {
+			BENCHMARK = true;
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			BENCHMARK_WARMUP = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+			BENCHMARK_REPORT = argv[++i];
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			PROFILE_TRACE = argv[++i];
+		} else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+			LOGO_INSTANCES = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--characters") == 0 && i + 1 < argc) {
+			SKINNED_CHARACTERS = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--virtual-texture") == 0) {
+			VIRTUAL_TEXTURE = true;
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			OUTPUT_DIRECTORY = argv[++i];
+		} else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "png") == 0)		CAPTURE_FORMAT = CAPTURE_PNG;
+			else if (strcmp(argv[i], "qoi") == 0)	CAPTURE_FORMAT = CAPTURE_QOI;
+			else if (strcmp(argv[i], "y4m") == 0)	CAPTURE_FORMAT = CAPTURE_Y4M;
+			else return false;
+		} else if (strcmp(argv[i], "--self-test") == 0) {
+			SELF_TEST = true;
+		} else {
+			return false;
+		}
+	}
+	return SCREEN_WIDTH > 0 && SCREEN_HEIGHT > 0;
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Interleave an indexed OBJ mesh and copy it into the geometry arena
+static ArenaMesh addArenaMesh(const vector<glm::vec3>& positions, const vector<glm::vec2>& uvs, const vector<glm::vec3>& normals, const vector<unsigned short>& indices)
+{
+	vector<ArenaVertex> vertices(positions.size());
+	for (size_t i = 0; i < positions.size(); i++) {
+		vertices[i].position = positions[i];
+		vertices[i].uv = uvs[i];
+		vertices[i].normal = normals[i];
+	}
+	return allocateArenaMesh(geometryArena, &vertices[0], vertices.size(), &indices[0], indices.size());
+}
+
+// OBJ mesh read, indexed and measured in a job, then copied into the geometry arena on the main thread
+struct LoadedMesh {
+	const char* path;
+	vector<unsigned short> indices;
+	vector<glm::vec3> positions;
+	vector<glm::vec2> uvs;
+	vector<glm::vec3> normals;
+	BoundingBox bounds;
+	BoundingSphere sphere;
+	vector<glm::vec3> occluder;
+};
+
+static void loadMeshJob(void* data) {
+	LoadedMesh* mesh = (LoadedMesh*)data;
+
+	// Read the OBJ (vertex positions, uv texture positions, and normals) into vectors of vertices
+	vector<glm::vec3> positions;
+	vector<glm::vec2> uvs;
+	vector<glm::vec3> normals;
+	loadOBJ(mesh->path, positions, uvs, normals);
+
+	indexVBO(positions, uvs, normals, mesh->indices, mesh->positions, mesh->uvs, mesh->normals);
+	computeMeshBounds(&mesh->positions[0], mesh->positions.size(), mesh->bounds, mesh->sphere);
+	buildOccluderMesh(&mesh->positions[0], &mesh->indices[0], mesh->indices.size(), 0.9f, mesh->occluder);
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -210,42 +491,33 @@ void moveBezierPath(float t)
 *	CREATE LOGO GEOMETRY - initialize loaded in OBJ geometry
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
-static void createLogoGeometry(void) {
+static void createLogoGeometry(Job* meshLoading, const LoadedMesh& mesh) {
 	// Load the UV texture (DDS file is a compressed image file)
 	texture1 = loadDDS("aol_logo_textured_1.DDS");
-	textureId1  = glGetUniformLocation(programId, "Logo");
 
-	normalTexture = loadBMP_custom("Logo_Norm_Map.bmp");
-	normalTextureId = glGetUniformLocation(programId, "LogoNormal");
- 
-	// Read aol_logo.obj (vertex positions, uv texture positions, and normals) into vector of vertices to load into buffer for display
-	vector<glm::vec3> positions1;
-	vector<glm::vec2> textures1;
-	vector<glm::vec3> normals1;
-	bool load = loadOBJ("aol_logo_textured_1.obj", positions1, textures1, normals1);
- 
-	vector<glm::vec3> indexed_positions1;
-	vector<glm::vec2> indexed_textures1;
-	vector<glm::vec3> indexed_normals1;
-	indexVBO(positions1, textures1, normals1, indices1, indexed_positions1, indexed_textures1, indexed_normals1);
- 
-	// Load into vertex buffer objects to display
-	glGenBuffers(1, &positions_vbo1);
-	glBindBuffer(GL_ARRAY_BUFFER, positions_vbo1);
-	glBufferData(GL_ARRAY_BUFFER, indexed_positions1.size() * sizeof(glm::vec3), &indexed_positions1[0], GL_STATIC_DRAW);
- 
-	glGenBuffers(1, &textureCoords_vbo1);
-	glBindBuffer(GL_ARRAY_BUFFER, textureCoords_vbo1);
-	glBufferData(GL_ARRAY_BUFFER, indexed_textures1.size() * sizeof(glm::vec2), &indexed_textures1[0], GL_STATIC_DRAW);
- 
-	glGenBuffers(1, &normals_vbo1);
-	glBindBuffer(GL_ARRAY_BUFFER, normals_vbo1);
-	glBufferData(GL_ARRAY_BUFFER, indexed_normals1.size() * sizeof(glm::vec3), &indexed_normals1[0], GL_STATIC_DRAW);
+	// Normal and specular maps, only sampled by the detail map shader variant. QOI/PNG maps are decoded in jobs straight
+	// into a pixel unpack buffer, then uploaded from it
+	if (LOGO_DETAIL_MAPS) {
+		const char* imagePaths[] = { "Logo_Norm_Map.qoi" };	// Same pixels as Logo_Norm_Map.bmp, decodes faster
+		loadImages(imagePaths, 1, &normalTexture);
+		specularTexture = loadDDS("Logo_Spec_Map.DDS");
+	}
+
+	// Virtual texture: the tiled file is (re)built from the DDS when it is missing or older, tiles are then streamed from it
+	if (VIRTUAL_TEXTURE) {
+		if (isVirtualTextureOutdated("Logo_Diffuse_Map.DDS", "Logo_Diffuse_Map.vtex"))
+			buildVirtualTexture("Logo_Diffuse_Map.DDS", "Logo_Diffuse_Map.vtex");
+		logoVirtualTexture = loadVirtualTexture("Logo_Diffuse_Map.vtex", 8, SCREEN_WIDTH / 8, SCREEN_HEIGHT / 8);
+	}
+
+	// aol_logo.obj was read and indexed by a job while the textures loaded
+	waitForJob(meshLoading);
  
-	// Generate buffer for indices
-	glGenBuffers(1, &indexBuffer1);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer1);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices1.size() * sizeof(unsigned short), &indices1[0] , GL_STATIC_DRAW);
+	// Load into the shared vertex and index buffers to display
+	logoMesh = addArenaMesh(mesh.positions, mesh.uvs, mesh.normals, mesh.indices);
+	logoBounds = mesh.bounds;
+	logoSphere = mesh.sphere;
+	logoOccluder = mesh.occluder;
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -254,198 +526,403 @@ static void createLogoGeometry(void) {
 *	CREATE MAN GEOMETRY - initialize loaded in OBJ geometry
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
-static void createManGeometry(void) {
+static void createManGeometry(Job* meshLoading, const LoadedMesh& mesh) {
 	// Load the UV texture (DDS file is a compressed image file)
 	texture2 = loadDDS("aol_man_textured_1.DDS");
-	textureId2 = glGetUniformLocation(programId, "Man");
-
-	// Read aol_logo.obj (vertex positions, uv texture positions, and normals) into vector of vertices to load into buffer for display
-	vector<glm::vec3> positions2;
-	vector<glm::vec2> textures2;
-	vector<glm::vec3> normals2;
-	bool load = loadOBJ("aol_man_textured_1.obj", positions2, textures2, normals2);
-
-	vector<glm::vec3> indexed_positions2;
-	vector<glm::vec2> indexed_textures2;
-	vector<glm::vec3> indexed_normals2;
-	indexVBO(positions2, textures2, normals2, indices2, indexed_positions2, indexed_textures2, indexed_normals2);
-
-	// Load into vertex buffer objects to display
-	glGenBuffers(1, &positions_vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, positions_vbo2);
-	glBufferData(GL_ARRAY_BUFFER, indexed_positions2.size() * sizeof(glm::vec3), &indexed_positions2[0], GL_STATIC_DRAW);
-
-	glGenBuffers(1, &textureCoords_vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, textureCoords_vbo2);
-	glBufferData(GL_ARRAY_BUFFER, indexed_textures2.size() * sizeof(glm::vec2), &indexed_textures2[0], GL_STATIC_DRAW);
-
-	glGenBuffers(1, &normals_vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, normals_vbo2);
-	glBufferData(GL_ARRAY_BUFFER, indexed_normals2.size() * sizeof(glm::vec3), &indexed_normals2[0], GL_STATIC_DRAW);
-
-	// Generate buffer for indices
-	glGenBuffers(1, &indexBuffer2);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer2);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices2.size() * sizeof(unsigned short), &indices2[0], GL_STATIC_DRAW);
+
+	// aol_man.obj was read and indexed by a job while the textures loaded
+	waitForJob(meshLoading);
+
+	// Load into the shared vertex and index buffers to display
+	manMesh = addArenaMesh(mesh.positions, mesh.uvs, mesh.normals, mesh.indices);
+	manBounds = mesh.bounds;
+	manSphere = mesh.sphere;
+	manOccluder = mesh.occluder;
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
 /*
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
-*	DRAW LOGO - Draw a copy of the logo (create geometry first), bool to make Logo rotate, scale, or translate over time
+*	SUBMIT DRAWS - draws are recorded into the render queue during the frame, then sorted and submitted in batches sharing state
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
-void drawLogo(glm::vec3 position, bool rotating, bool scaling, bool translating) {
-	
-	float velocity = (float)(magnitude * 0.005f * elapsedFrames);
-
-	// Load texture into buffer
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture1);
-	glUniform1i(textureId1, 0);
-
-	// Load normal map into buffer
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, normalTexture);
-	glUniform1i(normalTextureId, 0);
-
-	// Load vertex positions
-	glBindBuffer(GL_ARRAY_BUFFER, positions_vbo1);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(vertexPosition_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Load UV texture coordinates
-	glBindBuffer(GL_ARRAY_BUFFER, textureCoords_vbo1);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(vertexUVID, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Load normals
-	glBindBuffer(GL_ARRAY_BUFFER, normals_vbo1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(vertexNormal_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-	// Index the buffer and draw the triangles loaded from the OBJ model
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer1);
-
-	// Rotate based on time
-	glm::mat4 RotationMatrix;
-	if (rotating) {
-		rotationX += (float)((M_PI / 2.0f) * deltaTime * (magnitude));
-		if (rotationX >= 360 * (M_PI / 180)) {
-			rotationX = 0;
+// Bind the textures of a mesh (1 = AoL Logo, 2 = AoL Man), the vertices of every mesh are in the geometry arena
+static void bindMaterial(int mesh) {
+	if (mesh == 1) {
+		// Load texture into buffer
+		cachedBindTexture(0, GL_TEXTURE_2D, texture1);
+
+		// Load normal and specular maps into buffer (units 1 and 4, the virtual texture uses 2 and 3)
+		if (LOGO_DETAIL_MAPS) {
+			cachedBindTexture(1, GL_TEXTURE_2D, normalTexture);
+			cachedBindTexture(4, GL_TEXTURE_2D, specularTexture);
 		}
-		rotationAngleDegree = (float)(rotationX * (180 / M_PI));
-		RotationMatrix = eulerAngleYXZ(rotationX, 0.0f, 0.0f);
 	} else {
-		RotationMatrix = eulerAngleYXZ(0.0f, 0.0f, 0.0f);
+		cachedBindTexture(0, GL_TEXTURE_2D, texture2);
 	}
+}
 
-	// Scale based on abs Sin (0 to 1)
-	glm::mat4 ScalingMatrix;
-	if (scaling) {
-		scalingValue = (float)(abs(sin(velocity)*1.0f));
-		ScalingMatrix = scale(mat4(), vec3(scalingValue, scalingValue, scalingValue));
-	} else {
-		ScalingMatrix = scale(mat4(), vec3(1.0f, 1.0f, 1.0f));
-	}
+// Render queue backend: the queue calls these in sort key order, binding only the state that changes
+static void executeShader(unsigned int shader) {
+	GLuint program = queuePrograms[shader];
+	cachedUseProgram(program);
 
-	// Translate based on Sin (-1 to 1)
-	glm::mat4 TranslationMatrix;
-	if (translating) {
-		translationValue = (float)(sin(velocity)*1.0f);
-		TranslationMatrix = translate(mat4(), vec3(position.x + translationValue, position.y, position.z));
-	} else {
-		TranslationMatrix = translate(mat4(), position);
+	// Sample the logos' diffuse map through the virtual texture
+	if (logoVirtualTexture && program == logoProgram)
+		bindVirtualTexture(logoVirtualTexture, program, 2, 3);
+}
+
+static void executeMaterial(unsigned int material) {
+	bindMaterial(material);
+	queuedMesh = material;	// Every mesh has its own material
+}
+
+// Upload the transforms of the batched draws in one call and issue them as one multi-draw
+static void executeFlush(void) {
+	if (arenaCommands.empty())
+		return;
+	uploadObjectUniforms(uniformBuffers);
+	drawCalls += multiDrawArena(geometryArena, &arenaCommands[0], arenaCommands.size());
+	arenaCommands.clear();
+}
+
+static void executeDraw(const RenderPacket& packet) {
+	const ObjectUniforms& object = queuedObjects[packet.data];
+	int drawID = addObjectUniforms(uniformBuffers, object.MVP, object.M);
+	if (drawID < 0) {
+		// Per-object uniform buffer full: submit this batch and start the next one
+		executeFlush();
+		drawID = addObjectUniforms(uniformBuffers, object.MVP, object.M);
 	}
+	// The shader finds each draw's transforms with its draw ID (the command's baseInstance)
+	arenaCommands.push_back(arenaDrawCommand(queuedMesh == 1 ? logoMesh : manMesh, drawID));
+}
 
-	glm::mat4 ModelMatrix = TranslationMatrix * RotationMatrix * ScalingMatrix;
-	glm::mat4 MVP = projectionMatrix * viewMatrix * ModelMatrix;
+// Sort the recorded draws and issue one multi-draw per run of draws sharing a program and textures
+static void submitDraws(void) {
+	PROFILE_ZONE("submitDraws");
+	PROFILE_GPU_ZONE("Scene draws");
+	RenderQueueBackend backend = { executeShader, executeMaterial, NULL, executeDraw, executeFlush };
+	bindGeometryArena(geometryArena);
+	executeRenderQueue(renderQueue, backend);
+	queuedObjects.clear();
+
+	RenderQueueStats stats = getRenderQueueStats(renderQueue);
+	stateChanges = stats.shaderChanges + stats.materialChanges;
+	sortMilliseconds = stats.sortMilliseconds;
+}
 
-	// Send transformation information to current bound shader
-	glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-	glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &viewMatrix[0][0]);
+// Record a draw: its transforms, its world space box for culling, and a packet sorted by shader, material, mesh, then front to back
+static void queueDraw(unsigned int shader, int mesh, const glm::mat4& MVP, const glm::mat4& ModelMatrix) {
+	ObjectUniforms object = { MVP, ModelMatrix };
+	queuedObjects.push_back(object);
+
+	// The n-th draw of every frame is the same object, so it keeps its culling object and only moves it (refit)
+	BoundingBox box = transformBoundingBox(mesh == 1 ? logoBounds : manBounds, ModelMatrix);
+	size_t draw = pendingPackets.size();
+	if (draw == sceneCullingObjects.size())
+		sceneCullingObjects.push_back(addCullingObject(cullingBVH, box));
+	else
+		updateCullingObject(cullingBVH, sceneCullingObjects[draw], box);
+
+	// View depth of the object's origin, 0 at the near plane (0.1) and 1 at the far plane (100)
+	float depth = (-(viewMatrix * ModelMatrix[3]).z - 0.1f) / (100.0f - 0.1f);
+	RenderPacket packet = { makeSortKey(RENDER_PASS_OPAQUE, shader, mesh, mesh, depth), (unsigned int)(queuedObjects.size() - 1) };
+	pendingPackets.push_back(packet);
+}
 
-	// Draw Logo
-	glDrawElements(GL_TRIANGLES, indices1.size(), GL_UNSIGNED_SHORT, nullptr);
+// Test every object against the camera's frustum: the recorded draws that are visible go into the render queue,
+// the visible instanced logos are packed into the buffer the instanced draw reads
+static void cullDraws(void) {
+	PROFILE_ZONE("cullDraws");
+	Frustum frustum = extractFrustum(viewProjectionMatrix);
+	cullBVH(cullingBVH, frustum, visibleObjects);
+
+	objectVisible.assign(getCullingObjectCount(cullingBVH), 0);
+	for (size_t i = 0; i < visibleObjects.size(); i++)
+		objectVisible[visibleObjects[i]] = 1;
+
+	// Rasterize the visible scene draws as occluders and drop the instanced logos they hide
+	if (occlusionBuffer) {
+		beginOcclusionFrame(occlusionBuffer);
+		for (size_t i = 0; i < pendingPackets.size(); i++) {
+			if (!objectVisible[sceneCullingObjects[i]])
+				continue;
+			const vector<glm::vec3>& occluder = SORT_KEY_MESH(pendingPackets[i].key) == 1 ? logoOccluder : manOccluder;
+			addOccluder(occlusionBuffer, &occluder[0], occluder.size(), queuedObjects[pendingPackets[i].data].MVP);
+		}
+		rasterizeOccluders(occlusionBuffer);
+		cullOccludedObjects(occlusionBuffer, &logoInstanceBounds[0], LOGO_INSTANCES, viewProjectionMatrix, visibleObjects);
+
+		for (int i = 0; i < LOGO_INSTANCES; i++)
+			objectVisible[i] = 0;
+		for (size_t i = 0; i < visibleObjects.size(); i++)
+			objectVisible[visibleObjects[i]] = 1;
+
+		OcclusionStats occlusion = getOcclusionStats(occlusionBuffer);
+		occludedObjectCount = occlusion.occluded;
+		occlusionMilliseconds = occlusion.rasterMilliseconds + occlusion.testMilliseconds;
+	}
+
+	for (size_t i = 0; i < pendingPackets.size(); i++) {
+		if (objectVisible[sceneCullingObjects[i]])
+			submitRenderPacket(renderQueue, pendingPackets[i].key, pendingPackets[i].data);
+	}
+	pendingPackets.clear();
+
+	// All visible: draw from the static buffer, otherwise upload only the visible ones
+	if (LOGO_INSTANCES > 0) {
+		visibleInstances.clear();
+		for (int i = 0; i < LOGO_INSTANCES; i++) {
+			if (objectVisible[i])
+				visibleInstances.push_back(logoInstances[i]);
+		}
+		visibleLogoInstances = visibleInstances.size();
+		if (visibleLogoInstances > 0 && visibleLogoInstances < LOGO_INSTANCES)
+			updateInstanceBuffer(visibleInstanceBuffer, &visibleInstances[0], visibleLogoInstances, LOGO_INSTANCES);
+	}
+
+	CullingStats stats = getCullingStats(cullingBVH);
+	visibleObjectCount = stats.visible;
+	culledObjectCount = stats.culled;
+	cullMilliseconds = stats.milliseconds;
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
 /*
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
-*	DRAW MAN - Draw a copy of the man (create geometry first), bool to make Man rotate, scale, or translate over time
+*	SIMULATION - advance the scene objects by one fixed tick (on the simulation thread), rotate, scale, or translate them over time
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
-void drawMan(glm::vec3 position, bool rotating, bool scaling, bool translating) {
+// One entity per scene object, its animations as components. The rates are the ones the animations always had: rotations
+// at PI/2 radians per second times magnitude (twice that for the man), and the sin waves at magnitude * 0.005 per frame
+// of 60 frames a second. The man walks his path at constant speed, there and back as often as he used to swing along it
+static void createSceneEntities(void) {
+	glm::vec3 controlPoints[4] = { controlPoint1, controlPoint2, controlPoint3, controlPoint4 };
+	manPath = createBezierPath(controlPoints, 4, false);
+	sceneEntities = createEntityWorld();
+	float rotationSpeed = (float)((M_PI / 2.0f) * magnitude);
+	float waveSpeed = (float)(magnitude * 0.005f * 60.0f);
+	for (int i = 0; i < SCENE_OBJECTS; i++) {
+		const SceneObject& object = sceneObjects[i];
+		int entity = createEntity(sceneEntities, COMPONENT_TRANSFORM | object.animations);
+		sceneEntityIds[i] = entity;
+
+		TransformComponent transform = { object.position, quat(1.0f, 0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 1.0f) };
+		setTransform(sceneEntities, entity, transform);
+
+		// Logos rotate around Y, the man around -Z twice as fast
+		if (object.animations & COMPONENT_SPIN) {
+			SpinComponent spin = { object.mesh == 1 ? vec3(0.0f, 1.0f, 0.0f) : vec3(0.0f, 0.0f, -1.0f), object.mesh == 1 ? rotationSpeed : rotationSpeed * 2.0f, 0.0f };
+			setSpin(sceneEntities, entity, spin);
+		}
 
-	float velocity = (float)(magnitude * 0.005f * elapsedFrames);
+		// Scale based on abs Sin (0 to 1)
+		if (object.animations & COMPONENT_PULSE_SCALE) {
+			PulseScaleComponent pulseScale = { waveSpeed, 0.0f };
+			setPulseScale(sceneEntities, entity, pulseScale);
+		}
 
-	// Load into buffer
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	glUniform1i(textureId2, 0);
+		// Translate based on Sin (-1 to 1) along X
+		if (object.animations & COMPONENT_OSCILLATE_TRANSLATE) {
+			OscillateTranslateComponent oscillateTranslate = { object.position, vec3(1.0f, 0.0f, 0.0f), waveSpeed, 0.0f };
+			setOscillateTranslate(sceneEntities, entity, oscillateTranslate);
+		}
 
-	glBindBuffer(GL_ARRAY_BUFFER, positions_vbo2);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(vertexPosition_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+		// Travel the bezier curve back and forth, a return trip every PI / (waveSpeed / 4) seconds
+		if (object.animations & COMPONENT_PATH_FOLLOW) {
+			PathFollowComponent pathFollow = { manPath, (float)(2.0f * getSplinePathLength(manPath) * waveSpeed * 0.25f / M_PI), 0.0f };
+			setPathFollow(sceneEntities, entity, pathFollow);
+		}
+	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, textureCoords_vbo2);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(vertexUVID, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+// Simulation tick: the animation systems move every entity (rotations advance by the tick, the rest follow the simulation time)
+static void tickScene(void* snapshotData, double time, double tickSeconds, void*) {
+	SceneSnapshot& snapshot = *(SceneSnapshot*)snapshotData;
+	updateEntities(sceneEntities, time, tickSeconds);
+
+	// Tweak bar values of the first object with each animation
+	snapshot.rotationAngleDegree = 0.0f;
+	snapshot.scalingValue = 0.0f;
+	snapshot.translationValue = 0.0f;
+	unsigned int shown = 0;
+	for (int i = 0; i < SCENE_OBJECTS; i++) {
+		TransformComponent transform = getTransform(sceneEntities, sceneEntityIds[i]);
+		snapshot.objects[i].position = transform.position;
+		snapshot.objects[i].orientation = transform.orientation;
+		snapshot.objects[i].scale = transform.scale;
+
+		unsigned int animations = sceneObjects[i].animations & ~shown;
+		if (animations & COMPONENT_SPIN)
+			snapshot.rotationAngleDegree = (float)(getSpin(sceneEntities, sceneEntityIds[i]).angle * (180 / M_PI));
+		if (animations & COMPONENT_PULSE_SCALE)
+			snapshot.scalingValue = transform.scale.x;
+		if (animations & COMPONENT_OSCILLATE_TRANSLATE)
+			snapshot.translationValue = transform.position.x - sceneObjects[i].position.x;
+		shown |= animations;
+	}
+	snapshot.time = time;
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
 
-	glBindBuffer(GL_ARRAY_BUFFER, normals_vbo2);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(vertexNormal_modelspaceID, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	DRAW LOGO - Draw a copy of the logo (create geometry first) where the simulation put it
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+void drawLogo(const glm::mat4& ModelMatrix) {
+	PROFILE_ZONE("drawLogo");
+	glm::mat4 MVP = viewProjectionMatrix * ModelMatrix;
+
+	// Have the next virtual texture feedback pass request this draw's tiles
+	if (logoVirtualTexture) {
+		GLuint vertexBuffer, indexBuffer;
+		getGeometryArenaBuffers(geometryArena, vertexBuffer, indexBuffer);
+		addVirtualTextureFeedbackDraw(logoVirtualTexture, vertexBuffer, sizeof(ArenaVertex), offsetof(ArenaVertex, position), offsetof(ArenaVertex, uv),
+			indexBuffer, logoMesh.firstIndex, logoMesh.indexCount, logoMesh.baseVertex, MVP);
+	}
+
+	// Draw Logo
+	queueDraw(QUEUE_SHADER_LOGO, 1, MVP, ModelMatrix);
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	DRAW MAN - Draw a copy of the man (create geometry first) where the simulation put it
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+void drawMan(const glm::mat4& ModelMatrix) {
+	PROFILE_ZONE("drawMan");
+	glm::mat4 MVP = viewProjectionMatrix * ModelMatrix;
 
-	// Index the buffer and draw the triangles loaded from the OBJ model
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer2);
+	// Draw Man
+	queueDraw(QUEUE_SHADER_MAN, 2, MVP, ModelMatrix);
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
 
-	// Rotate based on time
-	glm::mat4 RotationMatrix;
-	if (rotating) {
-		rotationZ += (float)((M_PI / 2.0f) * deltaTime * (magnitude*2));
-		if (rotationZ >= 360 * (M_PI / 180)) {
-			rotationZ = 0;
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	LOGO INSTANCES - a wall of LOGO_INSTANCES animated logos behind the scene, drawn with a single instanced draw call
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+static void createLogoInstances(void) {
+	if (LOGO_INSTANCES <= 0)
+		return;
+
+	// Grid with the window's aspect ratio, filling the view 40 units in front of the camera
+	int columns = (int)ceil(sqrt(LOGO_INSTANCES * 1.25));
+	int rows = (LOGO_INSTANCES + columns - 1) / columns;
+	float spacing = 40.0f / columns;
+
+	// Culling box of an instance: the logo rotates around Y, scales up to 1 and moves up to 1 along X, in instance space
+	float radius = length(logoSphere.center) + logoSphere.radius;
+	BoundingBox animatedBounds;
+	animatedBounds.min = vec3(-radius - 1.0f, -radius, -radius);
+	animatedBounds.max = vec3(radius + 1.0f, radius, radius);
+
+	vector<InstanceData>& instances = logoInstances;
+	instances.resize(LOGO_INSTANCES);
+	for (int i = 0; i < LOGO_INSTANCES; i++) {
+		vec3 position((i % columns - (columns - 1) * 0.5f) * spacing, (i / columns - (rows - 1) * 0.5f) * spacing, -30.0f);
+		instances[i].model = translate(mat4(1.0f), position) * scale(mat4(1.0f), vec3(spacing * 0.5f));
+
+		// Same four animations as the logos of the scene (static, rotating, scaling, translating), out of phase
+		float rotationSpeed = (float)((M_PI / 2.0f) * magnitude);	// createSceneEntities: spin at PI/2 * magnitude radians per second
+		float velocitySpeed = (float)(magnitude * 0.005f * 60.0f);	// createSceneEntities: sin waves at magnitude * 0.005 * 60 per simulated second
+		switch (i % 4) {
+			case 0: instances[i].animation = vec4(0.0f, 0.0f, 0.0f, 0.0f); break;
+			case 1: instances[i].animation = vec4(rotationSpeed, 0.0f, 0.0f, 0.0f); break;
+			case 2: instances[i].animation = vec4(0.0f, velocitySpeed, 0.0f, 0.0f); break;
+			case 3: instances[i].animation = vec4(0.0f, 0.0f, velocitySpeed, 0.0f); break;
 		}
-		rotationAngleDegree = (float)(rotationZ * (180 / M_PI));
-		RotationMatrix = eulerAngleYXZ(0.0f, 0.0f, -rotationZ);
-	}
-	else {
-		RotationMatrix = eulerAngleYXZ(0.0f, 0.0f, 0.0f);
-	}
+		instances[i].animation.w = (float)(i % 97) * 0.25f;
 
-	// Scale based on abs Sin (0 to 1)
-	glm::mat4 ScalingMatrix;
-	if (scaling) {
-		float scalingValue = (float)(abs(sin(velocity)*1.0f));
-		ScalingMatrix = scale(mat4(), vec3(scalingValue, scalingValue, scalingValue));
-	}
-	else {
-		ScalingMatrix = scale(mat4(), vec3(1.0f, 1.0f, 1.0f));
+		logoInstanceBounds.push_back(transformBoundingBox(animatedBounds, instances[i].model));
+		addCullingObject(cullingBVH, logoInstanceBounds[i]);	// Object i
 	}
+	logoInstanceBuffer = createInstanceBuffer(&instances[0], LOGO_INSTANCES);
+	visibleInstanceBuffer = createInstanceBuffer(&instances[0], LOGO_INSTANCES);
+	visibleLogoInstances = LOGO_INSTANCES;
 
-	// Translate in sin/cos curve
-	glm::mat4 TranslationMatrix;
-	if (translating) {
-		//float manX = (float)(cos(velocity)*0.5f); // AoL man in sin/cos movement
-		//float manY = (float)(sin(velocity)*0.5f);
-		moveBezierPath(abs(sin(velocity*0.25)));	// call function to set manX, manY, manZ to part of bezier curve specified in time (sin 0 to 1)
-		TranslationMatrix = translate(mat4(), vec3(manX, manY, manZ));
-	}
-	else {
-		TranslationMatrix = translate(mat4(), position);
-	}
+	// Low resolution depth buffer for the occluders (a quarter of the window each way), filled by the job system
+	if (OCCLUSION_CULLING)
+		occlusionBuffer = createOcclusionBuffer(SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4);
+}
 
-	glm::mat4 ModelMatrix = TranslationMatrix * RotationMatrix * ScalingMatrix;
-	glm::mat4 MVP = projectionMatrix * viewMatrix * ModelMatrix;
+// Nothing per instance happens on the CPU: the vertex shader animates every instance from the simulation time
+static void drawLogoInstances(void) {
+	if (visibleLogoInstances <= 0)
+		return;
+	PROFILE_ZONE("drawLogoInstances");
+	PROFILE_GPU_ZONE("Logo instances");
+
+	cachedUseProgram(logoInstancedProgram);
+	if (logoVirtualTexture)
+		bindVirtualTexture(logoVirtualTexture, logoInstancedProgram, 2, 3);
+	bindMaterial(1);
+	bindGeometryArena(geometryArena);
+	bindInstanceAttributes(visibleLogoInstances == LOGO_INSTANCES ? logoInstanceBuffer : visibleInstanceBuffer);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, logoMesh.indexCount, GL_UNSIGNED_SHORT,
+		(const void *)(logoMesh.firstIndex * sizeof(unsigned short)), visibleLogoInstances, logoMesh.baseVertex);
+	unbindInstanceAttributes();
+	drawCalls++;
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
 
-	// Send transformation information to current bound shader
-	glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-	glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &viewMatrix[0][0]);
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	SKINNED CHARACTERS - SKINNED_CHARACTERS bending characters in rows on the ground, posed and skinned on the CPU every frame
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+static void createSkinnedCharacters(void) {
+	if (SKINNED_CHARACTERS <= 0)
+		return;
+	skinnedCrowd = createSkinnedCrowd("../aol/mail.fbx", SKINNED_CHARACTERS, SKINNING_LINEAR_BLEND);
+	if (skinnedCrowd == NULL)
+		return;
+
+	// Rows going back from in front of the scene, each character scaled to most of its cell and centred on it
+	vec3 low, high;
+	getSkinnedCrowdBounds(skinnedCrowd, low, high);
+	vec3 size = high - low;
+	int columns = (int)ceil(sqrt((double)SKINNED_CHARACTERS));
+	float spacing = 8.0f / columns;
+	float fit = spacing * 0.8f / glm::max(glm::max(size.x, size.y), glm::max(size.z, 1e-6f));
+	characterModels.resize(SKINNED_CHARACTERS);
+	for (int i = 0; i < SKINNED_CHARACTERS; i++) {
+		vec3 position((i % columns - (columns - 1) * 0.5f) * spacing, -2.5f, 1.0f - (i / columns) * spacing);
+		characterModels[i] = translate(mat4(1.0f), position) * scale(mat4(1.0f), vec3(fit)) * translate(mat4(1.0f), -(low + high) * 0.5f);
+	}
+}
 
-	// Draw Man
-	glDrawElements(GL_TRIANGLES, indices2.size(), GL_UNSIGNED_SHORT, nullptr);
+// Not culled: every character is skinned every frame anyway, then drawn with its own draw ID
+static void drawSkinnedCharacters(double time) {
+	if (skinnedCrowd == NULL)
+		return;
+	PROFILE_ZONE("drawSkinnedCharacters");
+	PROFILE_GPU_ZONE("Skinned characters");
+
+	double start = getTime();
+	updateSkinnedCrowd(skinnedCrowd, time);
+	skinningMilliseconds = (float)((getTime() - start) * 1000.0);
+
+	cachedUseProgram(manProgram);
+	bindMaterial(2);
+	bindSkinnedCrowd(skinnedCrowd);
+	int drawIDs[UBO_MAX_OBJECTS];
+	for (int first = 0; first < SKINNED_CHARACTERS; first += UBO_MAX_OBJECTS) {
+		int count = glm::min(SKINNED_CHARACTERS - first, UBO_MAX_OBJECTS);
+		for (int i = 0; i < count; i++)
+			drawIDs[i] = addObjectUniforms(uniformBuffers, viewProjectionMatrix * characterModels[first + i], characterModels[first + i]);
+		uploadObjectUniforms(uniformBuffers);
+		for (int i = 0; i < count; i++) {
+			cachedVertexAttribI1i(DRAW_ID_LOCATION, drawIDs[i]);
+			drawSkinnedCharacter(skinnedCrowd, first + i);
+		}
+		drawCalls += count;
+	}
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -456,6 +933,12 @@ void drawMan(glm::vec3 position, bool rotating, bool scaling, bool translating)
 */
 static int initWindows(int screenWidth, int screenHeight) {
 
+	// Headless: an offscreen context and framebuffer instead of GLFW, no tweak bar
+	if (HEADLESS) {
+		headlessContext = createHeadlessContext(screenWidth, screenHeight);
+		return headlessContext ? 0 : -1;
+	}
+
 	// Initialize GLFW and its configurations
 	if (!glfwInit())
 	{
@@ -507,11 +990,128 @@ static int initWindows(int screenWidth, int screenHeight) {
 	TwAddVarRW(EulerGUI, "Rotation (deg)", TW_TYPE_FLOAT, &rotationAngleDegree, "step=1.0");
 	TwAddVarRW(EulerGUI, "Scaling factor", TW_TYPE_FLOAT, &scalingValue, "step=0.01");
 	TwAddVarRW(EulerGUI, "Translation", TW_TYPE_FLOAT, &translationValue, "step=0.01");
+	TwAddVarRO(EulerGUI, "Shader programs", TW_TYPE_INT32, &shaderPrograms, "");
+	TwAddVarRO(EulerGUI, "Submit time (ms)", TW_TYPE_FLOAT, &submitMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Draw calls", TW_TYPE_INT32, &drawCalls, "");
+	TwAddVarRO(EulerGUI, "State changes", TW_TYPE_INT32, &stateChanges, "");
+	TwAddVarRO(EulerGUI, "Queue sort (ms)", TW_TYPE_FLOAT, &sortMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Elided GL calls", TW_TYPE_INT32, &elidedGLCalls, "");
+	TwAddVarRO(EulerGUI, "Issued GL calls", TW_TYPE_INT32, &issuedGLCalls, "");
+	TwAddVarRO(EulerGUI, "Visible objects", TW_TYPE_INT32, &visibleObjectCount, "");
+	TwAddVarRO(EulerGUI, "Culled objects", TW_TYPE_INT32, &culledObjectCount, "");
+	TwAddVarRO(EulerGUI, "Cull time (ms)", TW_TYPE_FLOAT, &cullMilliseconds, "precision=3");
+	if (OCCLUSION_CULLING && LOGO_INSTANCES > 0) {
+		TwAddVarRO(EulerGUI, "Occluded instances", TW_TYPE_INT32, &occludedObjectCount, "");
+		TwAddVarRO(EulerGUI, "Occlusion (ms)", TW_TYPE_FLOAT, &occlusionMilliseconds, "precision=3");
+	}
+	TwAddVarRO(EulerGUI, "Frame time (ms)", TW_TYPE_FLOAT, &framePacing.meanFrameMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Frame jitter (ms)", TW_TYPE_FLOAT, &framePacing.frameDeviationMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Worst frame (ms)", TW_TYPE_FLOAT, &framePacing.worstFrameMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Input latency (ms)", TW_TYPE_FLOAT, &framePacing.meanLatencyMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Missed frames", TW_TYPE_INT32, &framePacing.missedFrames, "");
+	TwAddVarRO(EulerGUI, "Sim ticks", TW_TYPE_INT32, &simulationTicks, "");
+	TwAddVarRO(EulerGUI, "Dropped ticks", TW_TYPE_INT32, &droppedTicks, "");
+	TwAddVarRO(EulerGUI, "Tick time (ms)", TW_TYPE_FLOAT, &tickMilliseconds, "precision=3");
+	TwAddVarRO(EulerGUI, "Scene nodes updated", TW_TYPE_INT32, &updatedSceneNodes, "");
+	if (LOGO_INSTANCES > 0)
+		TwAddVarRO(EulerGUI, "Logo instances", TW_TYPE_INT32, &LOGO_INSTANCES, "");
+	if (SKINNED_CHARACTERS > 0)
+		TwAddVarRO(EulerGUI, "Skinning (ms)", TW_TYPE_FLOAT, &skinningMilliseconds, "precision=3");
+	if (OUTPUT_DIRECTORY) {
+		TwAddVarRO(EulerGUI, "Captured frames", TW_TYPE_INT32, &frameCaptureStats.captured, "");
+		TwAddVarRO(EulerGUI, "Encode queue", TW_TYPE_INT32, &frameCaptureStats.queueDepth, "");
+		TwAddVarRO(EulerGUI, "Capture stalls", TW_TYPE_INT32, &frameCaptureStats.stalls, "");
+		TwAddVarRO(EulerGUI, "Capture (ms)", TW_TYPE_FLOAT, &frameCaptureStats.captureMilliseconds, "precision=3");
+	}
+	if (VIRTUAL_TEXTURE) {
+		TwAddVarRO(EulerGUI, "VT resident tiles", TW_TYPE_INT32, &vtResidentTiles, "");
+		TwAddVarRO(EulerGUI, "VT pending tiles", TW_TYPE_INT32, &vtPendingTiles, "");
+		TwAddVarRO(EulerGUI, "VT uploads/frame", TW_TYPE_INT32, &vtUploadedTiles, "");
+	}
 
 	return 0;
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	LOAD SHADERS - compile the shader variants the objects need (identical variants are compiled once)
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+// Lets the shader loader bind the hidden compile windows' contexts on its worker threads
+static void makeContextCurrent(void * context) {
+	glfwMakeContextCurrent((GLFWwindow *)context);
+}
+
+// Compiles started by loadShaders() and collected by finishShaders()
+static ShaderBatch* shaderBatch = NULL;
+static vector<GLFWwindow*> compileWindows;
+
+static void loadShaders(void) {
+	// Logos: diffuse map (or virtual texture), plus normal and specular maps if enabled. Man: diffuse map only
+	unsigned int features[3];
+	features[0] = (LOGO_DETAIL_MAPS ? SHADER_NORMAL_MAP | SHADER_SPECULAR_MAP : 0) | (logoVirtualTexture ? SHADER_VIRTUAL_TEXTURE : 0);
+	features[1] = 0;
+
+	// Multi-draws without baseInstance get the draw ID from gl_DrawIDARB
+	if (getArenaDrawPath(geometryArena) == ARENA_MULTI_DRAW_BASE_VERTEX) {
+		features[0] |= SHADER_DRAW_PARAMETERS;
+		features[1] |= SHADER_DRAW_PARAMETERS;
+	}
+	features[2] = (features[0] & ~SHADER_DRAW_PARAMETERS) | SHADER_INSTANCED;	// Instanced logos: same material, transform animated on the GPU
+
+	// Light and material constants are compiled in rather than sent as uniforms
+	char defines[64];
+	sprintf(defines, "#define LIGHT_POWER %f\n", LIGHT_POWER);
+
+	// Without parallel shader compile the variants are compiled on hidden windows sharing our context
+	if (!HEADLESS && !isParallelShaderCompileSupported()) {
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		for (int i = 0; i < 3; i++) {
+			GLFWwindow* compileWindow = glfwCreateWindow(1, 1, "", NULL, window);
+			if (compileWindow != NULL)
+				compileWindows.push_back(compileWindow);
+		}
+		glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+		glfwMakeContextCurrent(window);
+		if (!compileWindows.empty())
+			setShaderCompileContexts((void **)&compileWindows[0], compileWindows.size(), makeContextCurrent);
+	}
+
+	// With parallel shader compile this returns once the compiles are issued, the driver works on them until finishShaders()
+	shaderBatch = beginShaderPermutations("shaders/vertex.glsl", "shaders/fragment.glsl", defines, features, LOGO_INSTANCES > 0 ? 3 : 2);
+}
+
+static void finishShaders(void) {
+	GLuint programs[3] = { 0, 0, 0 };
+	shaderPrograms = finishShaderPermutations(shaderBatch, programs);
+	shaderBatch = NULL;
+	logoProgram = programs[0];
+	manProgram = programs[1];
+	logoInstancedProgram = LOGO_INSTANCES > 0 ? programs[2] : 0;
+	queuePrograms[QUEUE_SHADER_LOGO] = logoProgram;
+	queuePrograms[QUEUE_SHADER_MAN] = manProgram;
+
+	setShaderCompileContexts(NULL, 0, NULL);
+	for (size_t i = 0; i < compileWindows.size(); i++)
+		glfwDestroyWindow(compileWindows[i]);
+	compileWindows.clear();
+}
+
+// Connect a shader variant to the uniform buffers and set its texture units, none of which change afterwards
+static void setupShaderProgram(GLuint program) {
+	cachedUseProgram(program);
+
+	// Camera, light and transforms come from the uniform buffers
+	bindUniformBlocks(program);
+
+	// Texture units of the diffuse, normal and specular maps
+	cachedUniform1i(glGetUniformLocation(program, "DiffuseTextureSampler"), 0);
+	cachedUniform1i(glGetUniformLocation(program, "NormalTextureSampler"), 1);
+	cachedUniform1i(glGetUniformLocation(program, "SpecularTextureSampler"), 4);
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
+
 /*
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 *	RENDER - render setup and constants (ie. background colour)
@@ -521,9 +1121,6 @@ static void render(void) {
 	// Create specified background colour
 	glClearColor(BG_RED, BG_GREEN, BG_BLUE, 1.0);
 
-	// Use our shader
-	glUseProgram(programId);
-
 	// Turn on depth buffering
 	glEnable(GL_DEPTH_TEST);
 
@@ -534,20 +1131,21 @@ static void render(void) {
 	glEnable(GL_CULL_FACE);
 
 	// Position of our light
-	glUseProgram(programId);
-	LightID = glGetUniformLocation(programId, "LightPosition_worldspace");
 	lightPos = glm::vec3(LIGHT_X, LIGHT_Y, LIGHT_Z);
-	glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
 
-	// Handle for model-view-projection MVP (adapted from method in link specified at the top of program)
-	MatrixID = glGetUniformLocation(programId, "MVP");
-	ViewMatrixID = glGetUniformLocation(programId, "V");
-	ModelMatrixID = glGetUniformLocation(programId, "M");
+	// Per-frame and per-object uniform buffers, and the texture units of each shader variant
+	uniformBuffers = createUniformBuffers();
+	renderQueue = createRenderQueue();
+
+	// The shader compiles loadShaders() started have had the scene setup above to run in
+	finishShaders();
+	setupShaderProgram(logoProgram);
+	setupShaderProgram(manProgram);
+	if (logoInstancedProgram)
+		setupShaderProgram(logoInstancedProgram);
 
-	// Handle for buffers (adapted from method in link specified at the top of program)
-	vertexPosition_modelspaceID = glGetAttribLocation(programId, "vertexPosition_modelspace");
-	vertexUVID = glGetAttribLocation(programId, "vertexUV");
-	vertexNormal_modelspaceID = glGetAttribLocation(programId, "vertexNormal_modelspace");
+	// Texture loading bound textures and buffers behind the state cache's back
+	invalidateGLState();
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -557,48 +1155,191 @@ static void render(void) {
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
 static void update(void) {
+	PROFILE_ZONE("update");
+
 	// Update time/deltaTime values
-	currentTime = glfwGetTime();
+	currentTime = getTime();
 	deltaTime = (float)(currentTime - lastFrameTime);
 	lastFrameTime = currentTime;
-	elapsedFrames++; // For scaling/translation/rotation over time
 
-	// Clear screen so we can swap the buffer and draw new screen
+	// Benchmark: exactly one tick per frame, the frame shows that tick's snapshot
+	if (benchmark)
+		stepSimulation(sceneSimulation);
+
+	// Newest two simulation snapshots, and where this frame falls between them
+	SceneSnapshot previous, current;
+	float blend = getSimulationSnapshots(sceneSimulation, &previous, &current);
+	rotationAngleDegree = current.rotationAngleDegree;
+	scalingValue = current.scalingValue;
+	translationValue = current.translationValue;
+
+	SimulationStats simulation = getSimulationStats(sceneSimulation);
+	simulationTicks = simulation.ticks;
+	droppedTicks = simulation.droppedTicks;
+	tickMilliseconds = simulation.tickMilliseconds;
+
+	// Clear screen so we can swap the buffer and draw new screen (headless: the offscreen framebuffer)
+	if (headlessContext)
+		bindHeadlessFramebuffer(headlessContext);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Compute matrix from mouse/keyboard input for camera control
-	computeMatricesFromInputs();
+	// Virtual texture: feedback pass over last frame's logo draws, then stream and upload the tiles they need
+	if (logoVirtualTexture) {
+		PROFILE_ZONE("Virtual texture");
+		PROFILE_GPU_ZONE("Virtual texture");
+		renderVirtualTextureFeedback(logoVirtualTexture);
+		updateVirtualTexture(logoVirtualTexture);
+		getVirtualTextureStats(logoVirtualTexture, vtResidentTiles, vtPendingTiles, vtUploadedTiles);
+		invalidateGLState();	// The feedback pass and the tile uploads bind GL state directly
+		if (headlessContext)
+			bindHeadlessFramebuffer(headlessContext);	// The feedback pass ends on framebuffer 0
+	}
 
-	//glm::mat4 projectionMatrix = getProjectionMatrix();
-	//glm::mat4 ViewMatrix = getViewMatrix();
-	projectionMatrix = glm::perspective(0.75f, 1.25f, 0.1f, 100.0f);
-	viewMatrix = glm::lookAt(
-		glm::vec3(0, 0, 10), // Camera 
-		glm::vec3(0, 0, 0),  // Look At
-		glm::vec3(0, 1, 0)   // Head up
-	);
+	// Late latch: read the input and compute the camera as late as possible, right before the draws using it are recorded
+	if (!HEADLESS) {
+		glfwPollEvents();
+		computeMatricesFromInputs();
+	}
+	markInputSampled(framePacer);
+
+	if (benchmark) {
+		// Once along the camera path over the whole run, by frame number
+		glm::vec3 eye, target;
+		float t = (float)getBenchmarkFrame(benchmark) / (BENCHMARK_WARMUP + HEADLESS_FRAMES);
+		evaluateCameraPath(benchmarkCameraPath, sizeof(benchmarkCameraPath) / sizeof(benchmarkCameraPath[0]), t, eye, target);
+		projectionMatrix = glm::perspective(0.75f, 1.25f, 0.1f, 100.0f);
+		viewMatrix = glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+	} else if (CAMERA_CONTROLS && !HEADLESS) {
+		projectionMatrix = getProjectionMatrix();
+		viewMatrix = getViewMatrix();
+	} else {
+		projectionMatrix = glm::perspective(0.75f, 1.25f, 0.1f, 100.0f);
+		viewMatrix = glm::lookAt(
+			glm::vec3(0, 0, 10), // Camera 
+			glm::vec3(0, 0, 0),  // Look At
+			glm::vec3(0, 1, 0)   // Head up
+		);
+	}
 
-	glm::mat4 modelMatrix = glm::mat4(1.0);
-	glm::mat4 MVP = projectionMatrix * viewMatrix * modelMatrix;
+	viewProjectionMatrix = projectionMatrix * viewMatrix;
+
+	// Camera and light, the same for every draw of the frame
+	FrameUniforms frame;
+	frame.V = viewMatrix;
+	frame.P = projectionMatrix;
+	frame.LightPosition_worldspace[0] = glm::vec4(lightPos, 1.0f);
+	frame.Time = glm::vec4((float)glm::mix(previous.time, current.time, (double)blend), 0.0f, 0.0f, 0.0f);
+	setFrameUniforms(uniformBuffers, frame);
+
+	// Move the scene nodes to this frame's blend of the snapshots (the static logo's transform doesn't change, its node stays clean)
+	double submitStart = getTime();
+	for (int i = 0; i < SCENE_OBJECTS; i++) {
+		SimulationTransform transform = blendTransform(previous.objects[i], current.objects[i], blend);
+		setSceneNodeTransform(sceneGraph, sceneNodes[i], transform.position, transform.orientation, transform.scale);
+	}
+	updateSceneGraph(sceneGraph);
+	updatedSceneNodes = getSceneGraphStats(sceneGraph).updatedNodes;
 
 	// Draw Logos
-	drawLogo(vec3(-1.0f, 1.0f, 0.0f), false, false, false);	// Draw a [static]		logo in top left
-	drawLogo(vec3(2.0f, 1.0f, 0.0f), true, false, false);	// Draw a [rotating]	logo in top right
-	drawLogo(vec3(-1.0f, -2.0f, 0.0f), false, true, false);	// Draw a [scaling]		logo in bottom left
-	drawLogo(vec3(2.0f, -2.0f, 0.0f), false, false, true);	// Draw a [translating] logo in bottom right
+	const glm::mat4* worldMatrices = getWorldMatrices(sceneGraph);
+	drawCalls = 0;
+	for (int i = 0; i < SCENE_OBJECTS; i++) {
+		if (sceneObjects[i].mesh == 1)
+			drawLogo(worldMatrices[sceneNodes[i]]);	// Draw Logos (static, rotating, scaling, translating)
+		else
+			drawMan(worldMatrices[sceneNodes[i]]);	// Draw the rotating and translating man
+	}
 
-	drawMan(vec3(-3.0f, -2.0f, 0.2f), true, false, true);	// Draw a [rotating] and [translating] man in bottom right
+	cullDraws();
+	submitDraws();
+	drawLogoInstances();
+	drawSkinnedCharacters(frame.Time.x);
+	if (benchmark)
+		endBenchmarkGPU(benchmark);
+	submitMilliseconds = (float)((getTime() - submitStart) * 1000.0);
+	markFrameSubmitted(framePacer);
+	framePacing = getFramePacingStats(framePacer);
+
+	// GL calls the state cache skipped and let through this frame
+	GLStateStats glStats = getGLStateStats();
+	elidedGLCalls = getElidedGLCalls(glStats);
+	issuedGLCalls = glStats.issued;
+	resetGLStateStats();
+
+	// Start reading the frame back before the tweak bar is drawn over it, earlier readbacks go to the encoders
+	if (frameCapture) {
+		captureFrame(frameCapture);
+		frameCaptureStats = getFrameCaptureStats(frameCapture);
+	}
 
-	// Draw the Tw Bar window (debug variable display)
-	TwDraw();
+	// Headless: no tweak bar or buffer swap
+	renderedFrames++;
+	if (HEADLESS)
+		return;
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
+	// Draw the Tw Bar window (debug variable display), it changes GL state behind the state cache's back
+	{
+		PROFILE_ZONE("TwDraw");
+		PROFILE_GPU_ZONE("TwDraw");
+		TwDraw();
+	}
+	invalidateGLState();
 
-	// Buffer swap
+	// Buffer swap (events are polled at the next frame's late latch)
+	PROFILE_ZONE("glfwSwapBuffers");
 	glfwSwapBuffers(window);
-	glfwPollEvents();
+}
+// ----------------------------------------------------------------------------------------------------------------------------------------------------
+
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	SELF-TEST - every module's benchmark and check, run once by --self-test after initialization
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+struct SelfTest {
+	const char* name;
+	void (*run)(void);
+};
+
+const SelfTest selfTests[] = {
+	// Cost of a profiler zone (skipped while a --profile trace is recording)
+	{ "Profiler", [] { benchmarkProfiler(1000000); } },
+	// Compare image loader throughput for the same normal map pixels
+	{ "Image loaders", [] { benchmarkImageLoaders("Logo_Norm_Map.bmp", "Logo_Norm_Map.qoi", "Logo_Norm_Map.png", 20); } },
+	// Software DXT decode speed (the fallback when S3TC is unavailable)
+	{ "DXT decoder", [] { benchmarkDXTDecoder("Logo_Diffuse_Map.DDS", 100); } },
+	// Render queue sort cost and state changes saved, on a scene with many more draws than ours
+	{ "Render queue", [] { benchmarkRenderQueue(20000, 50); } },
+	// Frustum culling cost through the BVH against testing every box, at far more objects than we draw
+	{ "Culling", [] { benchmarkCulling(100000, 50); } },
+	// World matrix updates of a deep tree with a few nodes moving, against rebuilding every node
+	{ "Scene graph", [] { benchmarkSceneGraph(100000, 50); } },
+	// Batched world and MVP composition against glm one object at a time (and checked against it)
+	{ "Transforms", [] { benchmarkTransforms(100000, 50); } },
+	// Constant speed path followers in SIMD batches against one at a time and the old pow() evaluation
+	{ "Spline paths", [] { benchmarkSplinePaths(100000, 50); } },
+	// Animation systems over packed entity chunks on every thread, against one object at a time
+	{ "Entities", [] { benchmarkEntities(300000, 20); } },
+	// Animation clips: memory per clip (the FBX import and baked clips) and batched sampling against float keys
+	{ "Animation clips", [] { benchmarkAnimationClips("../aol/mail.fbx", 2000, 50); } },
+	// Skinned vertices per second per core, linear blend and dual quaternions against glm, and into a mapped vertex buffer
+	{ "Skinning", [] { benchmarkSkinning("../aol/mail.fbx", 2000, 50, true); } },
+	// Occluder rasterization and Hi-Z box tests from 1 thread up to one per core
+	{ "Occlusion", [] { benchmarkOcclusion(12, 100000, 20); } },
+	// Job system scaling from 1 thread to one per core, and the cost of a job
+	{ "Job system", [] { benchmarkJobSystem(20000, 20); } },
+	// Encode cost of a frame in each capture format
+	{ "Image encoders", [] { benchmarkImageEncoders("Logo_Norm_Map.qoi", 20); } },
+};
+
+// The tests bind GL state directly, the state cache starts over after them
+static void runSelfTests(void) {
+	int count = sizeof(selfTests) / sizeof(selfTests[0]);
+	for (int i = 0; i < count; i++) {
+		printf("Self-test %d/%d: %s\n", i + 1, count, selfTests[i].name);
+		selfTests[i].run();
+	}
+	invalidateGLState();
 }
 // ----------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -607,42 +1348,170 @@ static void update(void) {
 *	MAIN FUNCTION
 * -----------------------------------------------------------------------------------------------------------------------------------------------------
 */
-int main(void)
+int main(int argc, char* argv[])
 {
-	// Initialize GLFW Windows
-	initWindows(SCREEN_WIDTH, SCREEN_HEIGHT);
+	if (!parseCommandLine(argc, argv)) {
+		printf("Usage: %s [--headless] [--frames N] [--resolution WIDTHxHEIGHT] [--output DIRECTORY] [--format png|qoi|y4m]\n"
+			"\t[--benchmark] [--warmup N] [--instances N] [--characters N] [--virtual-texture] [--report PATH] [--profile PATH] [--self-test]\n", argv[0]);
+		return -1;
+	}
 
-	// Initialize Vertex and Fragment Shaders
-	programId = LoadShaders("shaders/vertex.glsl", "shaders/fragment.glsl");
-		// To-do: Normal map shaders for our normal maps
+	// Initialize GLFW Windows (or the headless context)
+	if (initWindows(SCREEN_WIDTH, SCREEN_HEIGHT) != 0)
+		return -1;
+
+	// Record from here on (before any thread is started) if a trace was asked for
+	if (PROFILE_TRACE)
+		startProfiler();
+
+	// Worker threads for everything that doesn't touch GL (mesh loading, image decoding, culling, sorting)
+	initJobSystem(JOB_THREADS);
+
+	// Read and index the OBJs in jobs while the textures load on this thread (the one owning the GL context)
+	LoadedMesh logoOBJ, manOBJ;
+	logoOBJ.path = "aol_logo_textured_1.obj";
+	manOBJ.path = "aol_man_textured_1.obj";
+	Job* meshLoading = createJob(NULL, NULL);
+	runJob(createChildJob(meshLoading, loadMeshJob, &logoOBJ));
+	runJob(createChildJob(meshLoading, loadMeshJob, &manOBJ));
+	runJob(meshLoading);
+
+	// Initialize Logo Geometry (every mesh goes into one shared vertex and index buffer)
+	geometryArena = createGeometryArena(8192, 16384);
+	cullingBVH = createCullingBVH();
+	createLogoGeometry(meshLoading, logoOBJ);
+	createManGeometry(meshLoading, manOBJ);
+	createLogoInstances();
+	createSkinnedCharacters();
+
+	// Start the Vertex and Fragment Shaders (after the geometry, the variants depend on which textures loaded)
+	loadShaders();
+
+	// Scene graph: the objects hang under one root, placed by the simulation every frame
+	sceneGraph = createSceneGraph();
+	sceneRootNode = addSceneNode(sceneGraph, -1);
+	for (int i = 0; i < SCENE_OBJECTS; i++)
+		sceneNodes[i] = addSceneNode(sceneGraph, sceneRootNode);
 
 	// Initialize Rendering
 	render();
 
-	// Initialize Logo Geometry
-	createLogoGeometry();
-	createManGeometry();
+	// Module benchmarks and checks, only when asked for: they take a while and would skew the frames measured after them
+	if (SELF_TEST)
+		runSelfTests();
  
 	// Time computation (adapted from method in link specified at the top of program)
-	lastTime = glfwGetTime();
+	lastTime = getTime();
 	lastFrameTime = lastTime;
 
+	// Animate the scene on its own thread from now on, whatever the frame rate (benchmark: stepped once per frame instead)
+	createSceneEntities();
+	sceneSimulation = createSimulation(1.0 / SIMULATION_HZ, sizeof(SceneSnapshot), tickScene, NULL);
+	if (BENCHMARK)
+		benchmark = createBenchmark(BENCHMARK_WARMUP, HEADLESS_FRAMES);
+	else
+		startSimulation(sceneSimulation);
+
+	// Record every frame: readbacks are mapped up to 3 frames later, at most 8 frames wait for the encoders
+	if (OUTPUT_DIRECTORY) {
+		int captureWidth = SCREEN_WIDTH, captureHeight = SCREEN_HEIGHT;
+		if (!HEADLESS)
+			glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+		frameCapture = createFrameCapture(captureWidth, captureHeight, CAPTURE_FORMAT, OUTPUT_DIRECTORY, TARGET_FPS > 0.0 ? (int)TARGET_FPS : 60,
+			3, CAPTURE_ENCODERS, 8);
+	}
+
+	// Start frames at TARGET_FPS rather than as fast as the swap returns (headless runs and benchmarks are not limited)
+	framePacer = createFramePacer(HEADLESS || BENCHMARK ? 0.0 : TARGET_FPS);
+	if (!HEADLESS)
+		setSwapInterval(framePacer, BENCHMARK ? VSYNC_OFF : VSYNC);
+
 	// The program will enter this loop and will continue to run and translate/rotate/scale objects over time until ESC key is pressed
+	// (headless: until HEADLESS_FRAMES frames are rendered, benchmark: until the warm-up and measured frames are done)
+	double runStart = getTime();
 	do{
+		{
+			PROFILE_ZONE("waitForNextFrame");
+			waitForNextFrame(framePacer);
+		}
+		if (benchmark)
+			beginBenchmarkFrame(benchmark);
 		update();
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+		if (benchmark)
+			endBenchmarkFrame(benchmark, submitMilliseconds, drawCalls, visibleLogoInstances);
+		flushProfiler();
+	} while ((benchmark ? !isBenchmarkFinished(benchmark) : !HEADLESS || renderedFrames < HEADLESS_FRAMES)
+		&& (HEADLESS || (glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS && glfwWindowShouldClose(window) == 0)));
+
+	// Headless throughput, every frame finished on the GPU (and written, if captured)
+	if (frameCapture)
+		finishFrameCapture(frameCapture);
+	if (HEADLESS) {
+		glFinish();
+		double seconds = getTime() - runStart;
+		printf("Headless: %d frames at %dx%d in %.3f s, %.1f frames/s\n", renderedFrames, SCREEN_WIDTH, SCREEN_HEIGHT, seconds, renderedFrames / seconds);
+	}
+	if (benchmark) {
+		BenchmarkInfo info;
+		info.build = __DATE__ " " __TIME__;
+		info.renderer = (const char*)glGetString(GL_RENDERER);
+		info.version = (const char*)glGetString(GL_VERSION);
+		info.width = SCREEN_WIDTH;
+		info.height = SCREEN_HEIGHT;
+		if (!HEADLESS)
+			glfwGetFramebufferSize(window, &info.width, &info.height);
+		info.sceneObjects = SCENE_OBJECTS;
+		info.instances = LOGO_INSTANCES;
+		info.tickSeconds = 1.0 / SIMULATION_HZ;
+		writeBenchmarkReport(benchmark, info, BENCHMARK_REPORT);
+	}
+	if (PROFILE_TRACE)
+		writeProfilerTrace(PROFILE_TRACE);
+	if (frameCapture) {
+		frameCaptureStats = getFrameCaptureStats(frameCapture);
+		printf("Capture: %d frames written, %.3f ms encode per frame, encode queue up to %d frames, %d stalls\n", frameCaptureStats.written,
+			frameCaptureStats.encodeMilliseconds, frameCaptureStats.maxQueueDepth, frameCaptureStats.stalls);
+	}
  
 	// Loop escaped, ending program, clean vertex buffer object, shader, avoid memory leaks
-	glDeleteBuffers(1, &positions_vbo1);
-	glDeleteBuffers(1, &textureCoords_vbo1);
-	glDeleteBuffers(1, &normals_vbo1);
-	glDeleteBuffers(1, &indexBuffer1);
-	glDeleteProgram(programId);
+	deleteSimulation(sceneSimulation);
+	deleteEntityWorld(sceneEntities);
+	deleteSplinePath(manPath);
+	deleteFramePacer(framePacer);
+	deleteFrameCapture(frameCapture);
+	deleteBenchmark(benchmark);
+	deleteGeometryArena(geometryArena);
+	deleteSkinnedCrowd(skinnedCrowd);
+	glDeleteProgram(logoProgram);
+	if (logoInstancedProgram)
+		glDeleteProgram(logoInstancedProgram);
+	if (LOGO_INSTANCES > 0) {
+		glDeleteBuffers(1, &logoInstanceBuffer);
+		glDeleteBuffers(1, &visibleInstanceBuffer);
+	}
+	if (manProgram != logoProgram)
+		glDeleteProgram(manProgram);
+	deleteUniformBuffers(uniformBuffers);
+	deleteRenderQueue(renderQueue);
+	deleteCullingBVH(cullingBVH);
+	deleteSceneGraph(sceneGraph);
+	deleteOcclusionBuffer(occlusionBuffer);
 	glDeleteTextures(1, &texture1);
+	glDeleteTextures(1, &texture2);
+	glDeleteTextures(1, &normalTexture);
+	glDeleteTextures(1, &specularTexture);
+	deleteVirtualTexture(logoVirtualTexture);
  
-	// Close both windows
-	TwTerminate();
-	glfwTerminate();
+	shutdownJobSystem();
+	stopProfiler();
+
+	// Close both windows (headless: the offscreen context)
+	if (HEADLESS) {
+		deleteHeadlessContext(headlessContext);
+	} else {
+		TwTerminate();
+		glfwTerminate();
+	}
  
 	return 0;
 }
@@ -1,62 +1,155 @@
 #version 330 core
 
+// Permutations (injected by LoadShaderPermutations) :
+//  - LIGHT_COUNT n			: number of point lights (1 if not defined)
+//  - NORMAL_MAP			: perturb the normal with NormalTextureSampler (tangent frame from screen space derivatives)
+//  - SPECULAR_MAP			: specular colour from SpecularTextureSampler instead of a constant
+//  - VIRTUAL_TEXTURE		: diffuse colour through the virtual texture tile cache instead of DiffuseTextureSampler
+//  - LIGHT_POWER, SPECULAR_EXPONENT : light and material constants, folded into the code at compile time
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+#ifndef LIGHT_POWER
+#define LIGHT_POWER 50.0
+#endif
+#ifndef SPECULAR_EXPONENT
+#define SPECULAR_EXPONENT 5.0
+#endif
+
 // Interpolated values from the vertex shaders
 in vec2 UV;
 in vec3 Position_worldspace;
 in vec3 Normal_cameraspace;
 in vec3 EyeDirection_cameraspace;
-in vec3 LightDirection_cameraspace;
+in vec3 LightDirection_cameraspace[LIGHT_COUNT];
 
 // Ouput data
 out vec3 color;
 
+// Values that stay constant for the whole frame (see uniformbuffer.hpp)
+layout(std140) uniform FrameBlock {
+	mat4 V;
+	mat4 P;
+	vec4 LightPosition_worldspace[16];
+	vec4 Time;		// x = seconds since start
+};
+
 // Values that stay constant for the whole mesh.
-uniform sampler2D myTextureSampler;
-uniform mat4 MV;
-uniform vec3 LightPosition_worldspace;
+uniform sampler2D DiffuseTextureSampler;
+#ifdef NORMAL_MAP
+uniform sampler2D NormalTextureSampler;
+#endif
+#ifdef SPECULAR_MAP
+uniform sampler2D SpecularTextureSampler;
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+// Virtual texture (tile cache + indirection)
+uniform sampler2D VTPhysical;		// Physical tile cache
+uniform sampler2D VTIndirection;	// One texel per page: physical slot (x, y) and resident mip level
+uniform vec2 VTSize;				// Virtual texture size in texels (level 0)
+uniform vec4 VTParams;				// x = tile size, y = tile border, z = physical slot size, w = highest mip level
+uniform float VTPhysicalSize;		// Physical tile cache width in texels
+
+vec4 virtualTexture(vec2 uv){
+	// Pick the mip level from the screen space derivatives, like the hardware would
+	vec2 texel = fract(uv) * VTSize;
+	vec2 dx = dFdx(uv * VTSize);
+	vec2 dy = dFdy(uv * VTSize);
+	float lod = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, VTParams.w);
+
+	// Look up the page, it points at itself or at the closest resident coarser tile
+	ivec2 page = ivec2(texel / (VTParams.x * exp2(lod)));
+	vec3 entry = floor(texelFetch(VTIndirection, page, int(lod)).xyz * 255.0 + 0.5);
+
+	// Position inside the resident tile, then inside its slot of the physical cache
+	float tileTexels = VTParams.x * exp2(entry.z);
+	vec2 inTile = fract(texel / tileTexels) * VTParams.x;
+	vec2 physical = entry.xy * VTParams.z + VTParams.y + inTile;
+	return textureLod(VTPhysical, physical / VTPhysicalSize, 0.0);
+}
+#endif
+
+#ifdef NORMAL_MAP
+// Tangent frame built from the derivatives of the camera space position and of the UVs, so the mesh needs no tangents
+mat3 cotangentFrame(vec3 N, vec3 p, vec2 uv){
+	vec3 dp1 = dFdx(p);
+	vec3 dp2 = dFdy(p);
+	vec2 duv1 = dFdx(uv);
+	vec2 duv2 = dFdy(uv);
+
+	vec3 dp2perp = cross(dp2, N);
+	vec3 dp1perp = cross(N, dp1);
+	vec3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+	vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+
+	float invmax = inversesqrt(max(dot(T,T), dot(B,B)));
+	return mat3(T * invmax, B * invmax, N);
+}
+#endif
 
 void main(){
 
 	// Light emission properties
-	// You probably want to put them as uniforms
 	vec3 LightColor = vec3(1,1,1);
-	float LightPower = 50.0f;
-	
+	float LightPower = LIGHT_POWER;
+
 	// Material properties
-	vec3 MaterialDiffuseColor = texture( myTextureSampler, UV ).rgb;
+#ifdef VIRTUAL_TEXTURE
+	vec3 MaterialDiffuseColor = virtualTexture( UV ).rgb;
+#else
+	vec3 MaterialDiffuseColor = texture( DiffuseTextureSampler, UV ).rgb;
+#endif
 	vec3 MaterialAmbientColor = vec3(0.1,0.1,0.1) * MaterialDiffuseColor;
+#ifdef SPECULAR_MAP
+	vec3 MaterialSpecularColor = texture( SpecularTextureSampler, UV ).rgb * 0.3;
+#else
 	vec3 MaterialSpecularColor = vec3(0.3,0.3,0.3);
-
-	// Distance to the light
-	float distance = length( LightPosition_worldspace - Position_worldspace );
+#endif
 
 	// Normal of the computed fragment, in camera space
 	vec3 n = normalize( Normal_cameraspace );
-	// Direction of the light (from the fragment to the light)
-	vec3 l = normalize( LightDirection_cameraspace );
-	// Cosine of the angle between the normal and the light direction, 
-	// clamped above 0
-	//  - light is at the vertical of the triangle -> 1
-	//  - light is perpendicular to the triangle -> 0
-	//  - light is behind the triangle -> 0
-	float cosTheta = clamp( dot( n,l ), 0,1 );
-	
+#ifdef NORMAL_MAP
+	// V tex coordinate is inverted because the normal map is a BMP/QOI (not a DDS)
+	vec2 NormalUV = vec2(UV.x,-UV.y);
+	vec3 TextureNormal_tangentspace = normalize(texture( NormalTextureSampler, NormalUV ).rgb*2.0 - 1.0);
+	n = normalize(cotangentFrame(n, -EyeDirection_cameraspace, NormalUV) * TextureNormal_tangentspace);
+#endif
+
 	// Eye vector (towards the camera)
 	vec3 E = normalize(EyeDirection_cameraspace);
-	// Direction in which the triangle reflects the light
-	vec3 R = reflect(-l,n);
-	// Cosine of the angle between the Eye vector and the Reflect vector,
-	// clamped to 0
-	//  - Looking into the reflection -> 1
-	//  - Looking elsewhere -> < 1
-	float cosAlpha = clamp( dot( E,R ), 0,1 );
-	
-	color = 
+
+	color =
 		// Ambient : simulates indirect lighting
-		MaterialAmbientColor +
-		// Diffuse : "color" of the object
-		MaterialDiffuseColor * LightColor * LightPower * cosTheta / (distance*distance) +
-		// Specular : reflective highlight, like a mirror
-		MaterialSpecularColor * LightColor * LightPower * pow(cosAlpha,5) / (distance*distance);
+		MaterialAmbientColor;
+
+	for (int i = 0; i < LIGHT_COUNT; i++){
+		// Distance to the light
+		float distance = length( LightPosition_worldspace[i].xyz - Position_worldspace );
+
+		// Direction of the light (from the fragment to the light)
+		vec3 l = normalize( LightDirection_cameraspace[i] );
+		// Cosine of the angle between the normal and the light direction,
+		// clamped above 0
+		//  - light is at the vertical of the triangle -> 1
+		//  - light is perpendicular to the triangle -> 0
+		//  - light is behind the triangle -> 0
+		float cosTheta = clamp( dot( n,l ), 0,1 );
+
+		// Direction in which the triangle reflects the light
+		vec3 R = reflect(-l,n);
+		// Cosine of the angle between the Eye vector and the Reflect vector,
+		// clamped to 0
+		//  - Looking into the reflection -> 1
+		//  - Looking elsewhere -> < 1
+		float cosAlpha = clamp( dot( E,R ), 0,1 );
+
+		color +=
+			// Diffuse : "color" of the object
+			MaterialDiffuseColor * LightColor * LightPower * cosTheta / (distance*distance) +
+			// Specular : reflective highlight, like a mirror
+			MaterialSpecularColor * LightColor * LightPower * pow(cosAlpha,SPECULAR_EXPONENT) / (distance*distance);
+	}
 
-}
\ No newline at end of file
+}
@@ -1,43 +1,117 @@
 #version 330 core
 
+// Permutations (injected by LoadShaderPermutations) :
+//  - LIGHT_COUNT n			: number of point lights (1 if not defined)
+//  - QUANTIZED_VERTICES	: positions arrive as normalized shorts and are expanded with QuantizationScale/Offset
+//  - INSTANCED			: transform from the per-instance attributes, animated here from the frame time (see instancebuffer.hpp)
+//  - DRAW_PARAMETERS		: draw ID = drawID + gl_DrawIDARB, for glMultiDrawElementsBaseVertex (see geometryarena.hpp)
+
+#ifdef DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
 // Input vertex data, different for all executions of this shader.
 layout(location = 0) in vec3 vertexPosition_modelspace;
 layout(location = 1) in vec2 vertexUV;
 layout(location = 2) in vec3 vertexNormal_modelspace;
+#ifdef INSTANCED
+layout(location = 8) in mat4 instanceModel;			// Base transform, locations 8 to 11
+layout(location = 12) in vec4 instanceAnimation;	// Rotation speed, scaling speed, translation speed, phase
+#else
+layout(location = 7) in int drawID;		// Index of this draw's entry in ObjectBlock
+#endif
 
 // Output data ; will be interpolated for each fragment.
 out vec2 UV;
 out vec3 Position_worldspace;
 out vec3 Normal_cameraspace;
 out vec3 EyeDirection_cameraspace;
-out vec3 LightDirection_cameraspace;
+out vec3 LightDirection_cameraspace[LIGHT_COUNT];
+
+// Values that stay constant for the whole frame (see uniformbuffer.hpp)
+layout(std140) uniform FrameBlock {
+	mat4 V;
+	mat4 P;
+	vec4 LightPosition_worldspace[16];
+	vec4 Time;		// x = seconds since start
+};
 
-// Values that stay constant for the whole mesh.
-uniform mat4 MVP;
-uniform mat4 V;
-uniform mat4 M;
-uniform vec3 LightPosition_worldspace;
+// Values that stay constant for the whole mesh, one entry per draw of the frame
+struct ObjectData {
+	mat4 MVP;
+	mat4 M;
+};
+layout(std140) uniform ObjectBlock {
+	ObjectData objects[128];
+};
+
+#ifdef QUANTIZED_VERTICES
+uniform vec3 QuantizationScale;
+uniform vec3 QuantizationOffset;
+#endif
+
+#ifdef INSTANCED
+// Same animation as drawLogo: translate along X by sin, rotate around Y, scale by abs(sin)
+mat4 animate(vec4 animation){
+	float t = Time.x + animation.w;
+	float angle = animation.x * t;
+	float s = animation.y > 0.0 ? abs(sin(animation.y * t)) : 1.0;
+	float x = animation.z > 0.0 ? sin(animation.z * t) : 0.0;
+	float c = cos(angle);
+	float n = sin(angle);
+	return mat4(
+		vec4(c * s, 0, -n * s, 0),
+		vec4(0, s, 0, 0),
+		vec4(n * s, 0, c * s, 0),
+		vec4(x, 0, 0, 1));
+}
+#endif
 
 void main(){
 
+#ifdef INSTANCED
+	mat4 M = instanceModel * animate(instanceAnimation);
+	mat4 MVP = P * V * M;
+#else
+#ifdef DRAW_PARAMETERS
+	int object = drawID + gl_DrawIDARB;
+#else
+	int object = drawID;
+#endif
+	mat4 MVP = objects[object].MVP;
+	mat4 M = objects[object].M;
+#endif
+
+#ifdef QUANTIZED_VERTICES
+	vec3 position_modelspace = vertexPosition_modelspace * QuantizationScale + QuantizationOffset;
+#else
+	vec3 position_modelspace = vertexPosition_modelspace;
+#endif
+
 	// Output position of the vertex, in clip space : MVP * position
-	gl_Position =  MVP * vec4(vertexPosition_modelspace,1);
-	
+	gl_Position =  MVP * vec4(position_modelspace,1);
+
 	// Position of the vertex, in worldspace : M * position
-	Position_worldspace = (M * vec4(vertexPosition_modelspace,1)).xyz;
-	
+	Position_worldspace = (M * vec4(position_modelspace,1)).xyz;
+
 	// Vector that goes from the vertex to the camera, in camera space.
 	// In camera space, the camera is at the origin (0,0,0).
-	vec3 vertexPosition_cameraspace = ( V * M * vec4(vertexPosition_modelspace,1)).xyz;
+	vec3 vertexPosition_cameraspace = ( V * M * vec4(position_modelspace,1)).xyz;
 	EyeDirection_cameraspace = vec3(0,0,0) - vertexPosition_cameraspace;
 
-	// Vector that goes from the vertex to the light, in camera space. M is ommited because it's identity.
-	vec3 LightPosition_cameraspace = ( V * vec4(LightPosition_worldspace,1)).xyz;
-	LightDirection_cameraspace = LightPosition_cameraspace + EyeDirection_cameraspace;
-	
+	// Vector that goes from the vertex to each light, in camera space. M is ommited because it's identity.
+	for (int i = 0; i < LIGHT_COUNT; i++){
+		vec3 LightPosition_cameraspace = ( V * vec4(LightPosition_worldspace[i].xyz,1)).xyz;
+		LightDirection_cameraspace[i] = LightPosition_cameraspace + EyeDirection_cameraspace;
+	}
+
 	// Normal of the the vertex, in camera space
 	Normal_cameraspace = ( V * M * vec4(vertexNormal_modelspace,0)).xyz; // Only correct if ModelMatrix does not scale the model ! Use its inverse transpose if not.
-	
+
 	// UV of the vertex. No special space for this one.
 	UV = vertexUV;
 }
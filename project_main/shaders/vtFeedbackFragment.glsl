@@ -0,0 +1,24 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+
+// Ouput data : the virtual texture tile this pixel needs (x, y, mip level), alpha 0 = nothing
+out vec4 feedback;
+
+// Values that stay constant for the whole mesh.
+uniform vec2 VTSize;			// Virtual texture size in texels (level 0)
+uniform vec4 VTParams;			// x = tile size, y = tile border, z = physical slot size, w = highest mip level
+uniform float VTFeedbackBias;	// log2(feedback width / window width), undoes the lower resolution of this pass
+
+void main(){
+
+	// Same mip and page selection as virtualTexture() in fragment.glsl
+	vec2 texel = fract(UV) * VTSize;
+	vec2 dx = dFdx(UV * VTSize);
+	vec2 dy = dFdy(UV * VTSize);
+	float lod = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + VTFeedbackBias), 0.0, VTParams.w);
+	vec2 page = floor(texel / (VTParams.x * exp2(lod)));
+
+	feedback = vec4(page, lod, 255.0) / 255.0;
+}
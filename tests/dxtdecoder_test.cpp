@@ -0,0 +1,178 @@
+/*
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*	DXT DECODER TEST - decodeDXT against a per-texel reference decode, byte for byte
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+* - Every mip level of the bundled DDS files, and random DXT1/3/5 blocks (every colour and alpha mode) at sizes that
+*	aren't multiples of 4, decoded in several block row ranges like the job system does.
+* - The reference follows the S3TC rules one texel at a time with no tables or SIMD: 565 endpoints expanded to 8 bits
+*	by replicating the high bits, (2 * c0 + c1) / 3 and (c0 + c1) / 2 truncated, DXT3 alpha * 17, DXT5 ramps truncated.
+*
+* - Build and run from this directory (the SSE2 path is the default on x86-64, add -mno-sse2 on 32 bit for the scalar one):
+*	g++ -O2 -DGLEW_STATIC -I../external/glew-1.13.0/include -I../external/glfw-3.1.2/include -I.. dxtdecoder_test.cpp
+*		../common/dxtdecoder.cpp ../common/texture.cpp ../common/jobsystem.cpp ../common/timer.cpp ../common/profiler.cpp
+*		../external/glew-1.13.0/src/glew.c -lGL -pthread -o dxtdecoder_test
+*	./dxtdecoder_test [DDS directory, default ../project_main]
+* -----------------------------------------------------------------------------------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <common/texture.hpp>
+#include <common/dxtdecoder.hpp>
+
+static unsigned char expand5(unsigned int c) {
+	return (unsigned char)((c << 3) | (c >> 2));
+}
+
+static unsigned char expand6(unsigned int c) {
+	return (unsigned char)((c << 2) | (c >> 4));
+}
+
+// RGBA of texel (x, y) of a 4x4 block
+static void referenceTexel(unsigned int fourCC, const unsigned char* block, int x, int y, unsigned char rgba[4]) {
+	int i = y * 4 + x;
+	const unsigned char* color = fourCC == FOURCC_DXT1 ? block : block + 8;
+	unsigned int c0 = color[0] | (color[1] << 8);
+	unsigned int c1 = color[2] | (color[3] << 8);
+	unsigned char e0[3] = { expand5(c0 >> 11), expand6((c0 >> 5) & 63), expand5(c0 & 31) };
+	unsigned char e1[3] = { expand5(c1 >> 11), expand6((c1 >> 5) & 63), expand5(c1 & 31) };
+	unsigned int code = (color[4 + y] >> (2 * x)) & 3;
+	bool fourColors = fourCC != FOURCC_DXT1 || c0 > c1;
+
+	rgba[3] = 255;
+	for (int c = 0; c < 3; c++) {
+		if (code == 0)
+			rgba[c] = e0[c];
+		else if (code == 1)
+			rgba[c] = e1[c];
+		else if (fourColors)
+			rgba[c] = (unsigned char)(code == 2 ? (2 * e0[c] + e1[c]) / 3 : (e0[c] + 2 * e1[c]) / 3);
+		else if (code == 2)
+			rgba[c] = (unsigned char)((e0[c] + e1[c]) / 2);
+		else
+			rgba[c] = rgba[3] = 0;	// DXT1 transparent black
+	}
+
+	if (fourCC == FOURCC_DXT3) {
+		rgba[3] = (unsigned char)(((block[i / 2] >> (4 * (i & 1))) & 15) * 17);
+	} else if (fourCC == FOURCC_DXT5) {
+		unsigned int a0 = block[0], a1 = block[1];
+		int bit = 16 + 3 * i;
+		unsigned int index = 0;
+		for (int b = 0; b < 3; b++, bit++)
+			index |= ((block[bit / 8] >> (bit % 8)) & 1) << b;
+		if (index == 0)
+			rgba[3] = (unsigned char)a0;
+		else if (index == 1)
+			rgba[3] = (unsigned char)a1;
+		else if (a0 > a1)
+			rgba[3] = (unsigned char)(((8 - index) * a0 + (index - 1) * a1) / 7);
+		else if (index < 6)
+			rgba[3] = (unsigned char)(((6 - index) * a0 + (index - 1) * a1) / 5);
+		else
+			rgba[3] = index == 6 ? 0 : 255;
+	}
+}
+
+static void referenceDecode(unsigned int fourCC, const unsigned char* blocks, unsigned int width, unsigned int height, unsigned char* out) {
+	unsigned int blockSize = fourCC == FOURCC_DXT1 ? 8 : 16;
+	unsigned int blocksWide = (width + 3) / 4;
+	for (unsigned int y = 0; y < height; y++) {
+		for (unsigned int x = 0; x < width; x++)
+			referenceTexel(fourCC, blocks + ((y / 4) * blocksWide + x / 4) * blockSize, x % 4, y % 4, out + ((size_t)y * width + x) * 4);
+	}
+}
+
+// decodeDXT in ranges of rowsPerCall block rows against the reference; prints the first mismatch
+static bool checkImage(const char* name, unsigned int fourCC, const unsigned char* blocks, unsigned int width, unsigned int height,
+	unsigned int rowsPerCall) {
+	std::vector<unsigned char> expected((size_t)width * height * 4), decoded(expected.size(), 0xCD);
+	referenceDecode(fourCC, blocks, width, height, &expected[0]);
+	unsigned int blocksHigh = (height + 3) / 4;
+	for (unsigned int row = 0; row < blocksHigh; row += rowsPerCall)
+		decodeDXT(fourCC, blocks, width, height, row, rowsPerCall, &decoded[0]);
+
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (expected[i] != decoded[i]) {
+			size_t texel = i / 4;
+			printf("FAIL %s %ux%u: texel (%u, %u) channel %u is %u, expected %u\n", name, width, height, (unsigned int)(texel % width),
+				(unsigned int)(texel / width), (unsigned int)(i % 4), decoded[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool checkDDS(const std::string& path) {
+	unsigned int width, height, mipMapCount, fourCC, bufsize;
+	unsigned char* buffer = readDDS(path.c_str(), width, height, mipMapCount, fourCC, bufsize);
+	if (buffer == NULL) {
+		printf("FAIL %s could not be read\n", path.c_str());
+		return false;
+	}
+
+	bool passed = true;
+	unsigned int blockSize = fourCC == FOURCC_DXT1 ? 8 : 16, offset = 0, level;
+	for (level = 0; level < mipMapCount && passed; level++) {
+		unsigned int size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		if (offset + size > bufsize)
+			break;
+		passed = checkImage(path.c_str(), fourCC, buffer + offset, width, height, 3);
+		offset += size;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	if (passed)
+		printf("ok   %s: %u mip levels\n", path.c_str(), level);
+	free(buffer);
+	return passed;
+}
+
+// Random blocks, a quarter of them with the endpoints swapped into the other colour / alpha mode
+static bool checkRandomBlocks(unsigned int fourCC, const char* name, unsigned int width, unsigned int height) {
+	unsigned int blockSize = fourCC == FOURCC_DXT1 ? 8 : 16;
+	std::vector<unsigned char> blocks(((width + 3) / 4) * ((height + 3) / 4) * blockSize);
+	for (size_t i = 0; i < blocks.size(); i++)
+		blocks[i] = (unsigned char)(rand() >> 7);
+	for (size_t b = 0; b < blocks.size(); b += blockSize) {
+		unsigned char* color = fourCC == FOURCC_DXT1 ? &blocks[b] : &blocks[b + 8];
+		if (rand() % 4 == 0) {
+			unsigned char swap[2] = { color[0], color[1] };
+			color[0] = color[2]; color[1] = color[3];
+			color[2] = swap[0]; color[3] = swap[1];
+		}
+		if (rand() % 8 == 0)
+			color[2] = color[0], color[3] = color[1];	// Equal endpoints
+	}
+
+	bool passed = checkImage(name, fourCC, &blocks[0], width, height, 2);
+	if (passed)
+		printf("ok   random %s blocks: %ux%u\n", name, width, height);
+	return passed;
+}
+
+int main(int argc, char* argv[]) {
+	std::string directory = argc > 1 ? argv[1] : "../project_main";
+	const char* files[] = { "aol_logo_textured_1.DDS", "Logo_Diffuse_Map.DDS", "Logo_Spec_Map.DDS" };
+
+	int failures = 0;
+	for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+		failures += checkDDS(directory + "/" + files[f]) ? 0 : 1;
+
+	srand(1);
+	const unsigned int sizes[][2] = { { 64, 64 }, { 13, 7 }, { 1, 1 }, { 250, 3 } };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		failures += checkRandomBlocks(FOURCC_DXT1, "DXT1", sizes[s][0], sizes[s][1]) ? 0 : 1;
+		failures += checkRandomBlocks(FOURCC_DXT3, "DXT3", sizes[s][0], sizes[s][1]) ? 0 : 1;
+		failures += checkRandomBlocks(FOURCC_DXT5, "DXT5", sizes[s][0], sizes[s][1]) ? 0 : 1;
+	}
+
+	printf(failures ? "%d FAILED\n" : "all passed\n", failures);
+	return failures ? 1 : 0;
+}